@@ -66,11 +66,16 @@
 
 #include "BNO080.h"
 #include "BNO080Constants.h"
-/// Set to 1 to enable debug printouts.  Should be very useful if the chip is giving you trouble.
+#include "Log.h"
+#include "Profile.h"
+#include "LatencyTracer.h"
+#include "RateMonitor.h"
+/// Set to 1 to enable the packet and metadata dumps.  Should be very useful if the chip is giving you trouble.
 /// When debugging, it is recommended to use the highest possible serial baudrate so as not to interrupt the timing of operations.
+/// The other messages go through Log.h; build with LOG_LEVEL=LOG_LEVEL_DEBUG (or TRACE) to see them.
 #define BNO_DEBUG 0
 
-BNO080::BNO080(Serial *debugPort, PinName user_SDApin, PinName user_SCLpin, PinName user_INTPin, PinName user_RSTPin,
+BNO080::BNO080(Stream *debugPort, PinName user_SDApin, PinName user_SCLpin, PinName user_INTPin, PinName user_RSTPin,
                uint8_t i2cAddress, int i2cPortSpeed) :
     _debugPort(debugPort),
     _i2cPort(user_SDApin, user_SCLpin),
@@ -78,6 +83,9 @@ BNO080::BNO080(Serial *debugPort, PinName user_SDApin, PinName user_SCLpin, PinN
     _int(user_INTPin),
     _rst(user_RSTPin, 1),
     commandSequenceNumber(0),
+    _interruptTime(0),
+    _packetInterruptTime(0),
+    _packetReadTime(0),
     stability(UNKNOWN),
     stepDetected(false),
     stepCount(0),
@@ -85,10 +93,26 @@ BNO080::BNO080(Serial *debugPort, PinName user_SDApin, PinName user_SCLpin, PinN
     shakeDetected(false),
     xAxisShake(false),
     yAxisShake(false),
-    zAxisShake(false)
+    zAxisShake(false),
+    _latencyTracer(NULL),
+    _rateMonitor(NULL)
 {
     // zero sequence numbers
     memset(sequenceNumber, 0, sizeof(sequenceNumber));
+    memset(shtpHeader, 0, sizeof(shtpHeader));
+    memset(shtpData, 0, sizeof(shtpData));
+    packetLength = 0;
+    memset(reportTimestamp, 0, sizeof(reportTimestamp));
+    memset(reportStatus, 0, sizeof(reportStatus));
+    memset(reportStatusKnown, 0, sizeof(reportStatusKnown));
+    memset(statusSince, 0, sizeof(statusSince));
+    resetStatusStatistics();
+
+    PROFILE_INIT();
+
+    // sensor timestamps are measured back from the falling edge of the interrupt pin
+    _hostClock.start();
+    _int.fall(callback(this, &BNO080::onInterrupt));
 
     //Get user settings
     _i2cPortSpeed = i2cPortSpeed;
@@ -116,7 +140,7 @@ bool BNO080::begin()
 
     while(true) {
         if(timeoutTimer.read() > BNO080_RESET_TIMEOUT) {
-            _debugPort->printf("Error: BNO080 reset timed out, chip not detected.\n");
+            LOG_MSG(RESET_TIMEOUT);
             return false;
         }
 
@@ -135,7 +159,7 @@ bool BNO080::begin()
         }
     }
 
-    _debugPort->printf("BNO080 detected!\n");
+    LOG_MSG(DETECTED);
 
     // At system startup, the hub must send its full advertisement message (see SHTP 5.2 and 5.3) to the
     // host. It must not send any other data until this step is complete.
@@ -153,13 +177,11 @@ sendCommand(COMMAND_INITIALIZE);
 wait(0.02f);
 
     if(!waitForPacket(CHANNEL_CONTROL, SHTP_REPORT_COMMAND_RESPONSE) || shtpData[2] != COMMAND_INITIALIZE || shtpData[5] != 0) {
-        _debugPort->printf("BNO080 reports initialization failed.\n");
+        LOG_MSG(INIT_FAILED);
         __enable_irq();
         return false;
     } else {
-#if BNO_DEBUG
-        _debugPort->printf("BNO080 reports initialization successful!\n");
-#endif
+        LOG_MSG(INIT_OK);
     }
 
 
@@ -178,14 +200,11 @@ wait(0.02f);
         partNumber = (shtpData[7] << 24) | (shtpData[6] << 16) | (shtpData[5] << 8) | shtpData[4];
         buildNumber = (shtpData[11] << 24) | (shtpData[10] << 16) | (shtpData[9] << 8) | shtpData[8];
 
-#if BNO_DEBUG
-        _debugPort->printf("BNO080 reports as SW version %hhu.%hhu.%hu, build %lu, part no. %lu\n",
-                           majorSoftwareVersion, minorSoftwareVersion, patchSoftwareVersion,
-                           buildNumber, partNumber);
-#endif
+        LOG_MSG(SW_VERSION, majorSoftwareVersion, minorSoftwareVersion, patchSoftwareVersion);
+        LOG_MSG(BUILD_PART, buildNumber, partNumber);
 
     } else {
-        _debugPort->printf("Bad response from product ID command.\n");
+        LOG_MSG(PRODUCT_ID_BAD);
         return false;
     }
 
@@ -229,23 +248,17 @@ bool BNO080::enableCalibration(bool calibrateAccel, bool calibrateGyro, bool cal
 
     // now, wait for the response
     if(!waitForPacket(CHANNEL_CONTROL, SHTP_REPORT_COMMAND_RESPONSE)) {
-#if BNO_DEBUG
-        _debugPort->printf("Timeout waiting for calibration response!\n");
-#endif
+        LOG_MSG(CAL_TIMEOUT);
         return false;
     }
 
     if(shtpData[2] != COMMAND_ME_CALIBRATE) {
-#if BNO_DEBUG
-        _debugPort->printf("Received wrong response to calibration command!\n");
-#endif
+        LOG_MSG(CAL_WRONG_RESPONSE);
         return false;
     }
 
     if(shtpData[5] != 0) {
-#if BNO_DEBUG
-        _debugPort->printf("IMU reports calibrate command failed!\n");
-#endif
+        LOG_MSG(CAL_FAILED);
         return false;
     }
 
@@ -262,23 +275,17 @@ bool BNO080::saveCalibration()
 
     // now, wait for the response
     if(!waitForPacket(CHANNEL_CONTROL, SHTP_REPORT_COMMAND_RESPONSE)) {
-#if BNO_DEBUG
-        _debugPort->printf("Timeout waiting for calibration response!\n");
-#endif
+        LOG_MSG(CAL_TIMEOUT);
         return false;
     }
 
     if(shtpData[2] != COMMAND_SAVE_DCD) {
-#if BNO_DEBUG
-        _debugPort->printf("Received wrong response to calibration command!\n");
-#endif
+        LOG_MSG(CAL_WRONG_RESPONSE);
         return false;
     }
 
     if(shtpData[5] != 0) {
-#if BNO_DEBUG
-        _debugPort->printf("IMU reports calibrate command failed!\n");
-#endif
+        LOG_MSG(CAL_FAILED);
         return false;
     }
 
@@ -288,31 +295,31 @@ bool BNO080::saveCalibration()
 
 void BNO080::setSensorOrientation(Quaternion orientation)
 {
-    zeroBuffer();
+    // convert floats to Q
+    OrientationQ orientationQ = orientationToQ(orientation);
 
-    _debugPort->printf("y: %f", orientation.y());
+    LOG_MSG(ORIENTATION, orientation.y(), orientationQ.y);
 
-    // convert floats to Q
-    int16_t Q_x = floatToQ(orientation.x(), ORIENTATION_QUAT_Q_POINT);
-    int16_t Q_y = floatToQ(orientation.y(), ORIENTATION_QUAT_Q_POINT);
-    int16_t Q_z = floatToQ(orientation.z(), ORIENTATION_QUAT_Q_POINT);
-    int16_t Q_w = floatToQ(orientation.w(), ORIENTATION_QUAT_Q_POINT);
+    setSensorOrientation(orientationQ);
+}
 
-    _debugPort->printf("Q_y: %hd", Q_y);
+void BNO080::setSensorOrientation(const OrientationQ& orientation)
+{
+    zeroBuffer();
 
     shtpData[3] = 2; // set reorientation
 
-    shtpData[4] = static_cast<uint8_t>(Q_x & 0xFF); //P1 - X component LSB
-    shtpData[5] = static_cast<uint8_t>(Q_x >> 8); //P2 - X component MSB
+    shtpData[4] = static_cast<uint8_t>(orientation.x & 0xFF); //P1 - X component LSB
+    shtpData[5] = static_cast<uint8_t>(orientation.x >> 8); //P2 - X component MSB
 
-    shtpData[6] = static_cast<uint8_t>(Q_y & 0xFF); //P3 - Y component LSB
-    shtpData[7] = static_cast<uint8_t>(Q_y >> 8); //P4 - Y component MSB
+    shtpData[6] = static_cast<uint8_t>(orientation.y & 0xFF); //P3 - Y component LSB
+    shtpData[7] = static_cast<uint8_t>(orientation.y >> 8); //P4 - Y component MSB
 
-    shtpData[8] = static_cast<uint8_t>(Q_z & 0xFF); //P5 - Z component LSB
-    shtpData[9] = static_cast<uint8_t>(Q_z >> 8); //P6 - Z component MSB
+    shtpData[8] = static_cast<uint8_t>(orientation.z & 0xFF); //P5 - Z component LSB
+    shtpData[9] = static_cast<uint8_t>(orientation.z >> 8); //P6 - Z component MSB
 
-    shtpData[10] = static_cast<uint8_t>(Q_w & 0xFF); //P7 - W component LSB
-    shtpData[11] = static_cast<uint8_t>(Q_w >> 8); //P8 - W component MSB
+    shtpData[10] = static_cast<uint8_t>(orientation.w & 0xFF); //P7 - W component LSB
+    shtpData[11] = static_cast<uint8_t>(orientation.w >> 8); //P8 - W component MSB
 
     //Using this shtpData packet, send a command
     sendCommand(COMMAND_TARE); // Send tare command
@@ -320,6 +327,18 @@ void BNO080::setSensorOrientation(Quaternion orientation)
     // NOTE: unlike literally every other command, a sensor orientation command is never acknowledged in any way.
 }
 
+bool BNO080::setPermanentOrientation(Quaternion orientation)
+{
+    // the system orientation record holds x, y, z, w in Q30
+    uint32_t orientationWords[4];
+    orientationWords[0] = static_cast<uint32_t>(floatToQ_dword(orientation.x(), FRS_ORIENTATION_Q_POINT));
+    orientationWords[1] = static_cast<uint32_t>(floatToQ_dword(orientation.y(), FRS_ORIENTATION_Q_POINT));
+    orientationWords[2] = static_cast<uint32_t>(floatToQ_dword(orientation.z(), FRS_ORIENTATION_Q_POINT));
+    orientationWords[3] = static_cast<uint32_t>(floatToQ_dword(orientation.w(), FRS_ORIENTATION_Q_POINT));
+
+    return writeFRSRecord(FRS_RECORDID_SYSTEM_ORIENTATION, orientationWords, 4);
+}
+
 
 bool BNO080::updateData()
 {
@@ -345,7 +364,7 @@ bool BNO080::updateData()
 uint8_t BNO080::getReportStatus(Report report)
 {
     uint8_t reportNum = static_cast<uint8_t>(report);
-    if(reportNum > STATUS_ARRAY_LEN) {
+    if(reportNum >= STATUS_ARRAY_LEN) {
         return 0;
     }
 
@@ -371,7 +390,7 @@ const char* BNO080::getReportStatusString(Report report)
 bool BNO080::hasNewData(Report report)
 {
     uint8_t reportNum = static_cast<uint8_t>(report);
-    if(reportNum > STATUS_ARRAY_LEN) {
+    if(reportNum >= STATUS_ARRAY_LEN) {
         return false;
     }
 
@@ -380,15 +399,151 @@ bool BNO080::hasNewData(Report report)
     return newData;
 }
 
+uint32_t BNO080::getReportTimestamp(Report report)
+{
+    uint8_t reportNum = static_cast<uint8_t>(report);
+    if(reportNum >= STATUS_ARRAY_LEN) {
+        return 0;
+    }
+
+    return reportTimestamp[reportNum];
+}
+
+uint32_t BNO080::getHostTime()
+{
+    return static_cast<uint32_t>(_hostClock.read_us());
+}
+
+void BNO080::attachSampleCallback(Callback<void(const SensorSample&)> callback)
+{
+    _sampleCallback = callback;
+}
+
+void BNO080::attachStatusCallback(Callback<void(const StatusChange&)> callback)
+{
+    _statusCallback = callback;
+}
+
+void BNO080::attachPacketCallback(Callback<void(const RawPacket&)> callback)
+{
+    _packetCallback = callback;
+}
+
+void BNO080::attachLatencyTracer(LatencyTracer* tracer)
+{
+    _latencyTracer = tracer;
+}
+
+void BNO080::attachRateMonitor(RateMonitor* monitor)
+{
+    _rateMonitor = monitor;
+}
+
+void BNO080::capturePacket(bool outbound, const uint8_t* data, uint16_t length)
+{
+    if(_packetCallback) {
+        RawPacket packet;
+        packet.outbound = outbound;
+        packet.timestamp = outbound ? getHostTime() : _packetInterruptTime;
+        packet.data = data;
+        packet.length = length;
+        _packetCallback(packet);
+    }
+}
+
+uint32_t BNO080::getStatusDwellTime(Report report, uint8_t status)
+{
+    uint8_t reportNum = static_cast<uint8_t>(report);
+    if(reportNum >= STATUS_ARRAY_LEN || status > 3) {
+        return 0;
+    }
+
+#if BNO080_STATUS_STATISTICS
+    uint32_t dwell = statusDwell[reportNum][status];
+    if(reportStatusKnown[reportNum] && reportStatus[reportNum] == status) {
+        dwell += reportTimestamp[reportNum] - statusSince[reportNum];
+    }
+    return dwell;
+#else
+    return 0;
+#endif
+}
+
+uint16_t BNO080::getStatusChangeCount(Report report)
+{
+    uint8_t reportNum = static_cast<uint8_t>(report);
+    if(reportNum >= STATUS_ARRAY_LEN) {
+        return 0;
+    }
+
+#if BNO080_STATUS_STATISTICS
+    return statusChanges[reportNum];
+#else
+    return 0;
+#endif
+}
+
+void BNO080::resetStatusStatistics()
+{
+#if BNO080_STATUS_STATISTICS
+    memset(statusDwell, 0, sizeof(statusDwell));
+    memset(statusChanges, 0, sizeof(statusChanges));
+#endif
+
+    // the current stretches start over from the latest samples
+    for(size_t reportNum = 0; reportNum < STATUS_ARRAY_LEN; reportNum++) {
+        statusSince[reportNum] = reportTimestamp[reportNum];
+    }
+}
+
+void BNO080::updateReportStatus(uint8_t reportNum, uint8_t status, uint32_t timestamp)
+{
+    bool known = reportStatusKnown[reportNum];
+    uint8_t previousStatus = reportStatus[reportNum];
+    reportStatus[reportNum] = status;
+
+    if(known && status == previousStatus) {
+        return;
+    }
+
+    uint32_t dwellTime = 0;
+    if(known) {
+        dwellTime = timestamp - statusSince[reportNum];
+#if BNO080_STATUS_STATISTICS
+        statusDwell[reportNum][previousStatus] += dwellTime;
+        if(statusChanges[reportNum] < UINT16_MAX) {
+            statusChanges[reportNum]++;
+        }
+#endif
+        LOG_MSG(STATUS_CHANGE, reportNum, previousStatus, status);
+    }
+    reportStatusKnown[reportNum] = true;
+    statusSince[reportNum] = timestamp;
+
+    if(_statusCallback) {
+        StatusChange change;
+        change.report = static_cast<Report>(reportNum);
+        change.previousStatus = known ? previousStatus : REPORT_STATUS_NONE;
+        change.status = status;
+        change.timestamp = timestamp;
+        change.dwellTime = dwellTime;
+        _statusCallback(change);
+    }
+}
+
+void BNO080::onInterrupt()
+{
+    _interruptTime = static_cast<uint32_t>(_hostClock.read_us());
+}
+
 //Sends the packet to enable the rotation vector
-void BNO080::enableReport(Report report, uint16_t timeBetweenReports)
+void BNO080::enableReport(Report report, uint16_t timeBetweenReports, uint16_t batchInterval)
 {
     // check time
     float periodSeconds = timeBetweenReports / 1000.0;
 
     if(periodSeconds < getMinPeriod(report)) {
-        _debugPort->printf("Error: attempt made to set report 0x%02hhx to period of %.06f s, which is smaller than its min period of %.06f s.\n",
-                           static_cast<uint8_t>(report), periodSeconds, getMinPeriod(report));
+        LOG_MSG(PERIOD_TOO_SHORT, static_cast<uint8_t>(report), periodSeconds, getMinPeriod(report));
         return;
     }
     /*
@@ -399,7 +554,12 @@ void BNO080::enableReport(Report report, uint16_t timeBetweenReports)
     return;
     }
     */
-    setFeatureCommand(static_cast<uint8_t>(report), timeBetweenReports);
+    setFeatureCommand(static_cast<uint8_t>(report), timeBetweenReports, 0, batchInterval);
+
+    // until the IMU says which period it rounded this to, in its Get Feature Response
+    if(_rateMonitor != NULL) {
+        _rateMonitor->setPeriod(static_cast<uint8_t>(report), static_cast<uint32_t>(timeBetweenReports) * 1000);
+    }
 
     // note: we don't wait for ACKs on these packets because they can take quite a while, like half a second, to come in
 }
@@ -408,6 +568,10 @@ void BNO080::disableReport(Report report)
 {
     // set the report's polling period to zero to disable it
     setFeatureCommand(static_cast<uint8_t>(report), 0);
+
+    if(_rateMonitor != NULL) {
+        _rateMonitor->setPeriod(static_cast<uint8_t>(report), 0);
+    }
 }
 
 uint32_t BNO080::getSerialNumber()
@@ -505,8 +669,14 @@ int16_t BNO080::getQ3(Report report)
 
 void BNO080::processPacket()
 {
+    PROFILE_SCOPE(PROCESS_PACKET);
+
     if(shtpHeader[2] == CHANNEL_CONTROL) {
-        // currently no command reports are read
+        // the only command report read is the period the IMU actually uses for a report (SH-2 section 6.5.5)
+        if(shtpData[0] == SHTP_REPORT_GET_FEATURE_RESPONSE && packetLength >= 9 && _rateMonitor != NULL) {
+            uint32_t period = (uint32_t)shtpData[8] << 24 | (uint32_t)shtpData[7] << 16 | (uint32_t)shtpData[6] << 8 | shtpData[5];
+            _rateMonitor->setPeriod(shtpData[1], period);
+        }
     } else if(shtpHeader[2] == CHANNEL_EXECUTABLE) {
         // currently no executable reports are read
     } else if(shtpHeader[2] == CHANNEL_COMMAND) {
@@ -539,39 +709,84 @@ void BNO080::processPacket()
 
 void BNO080::parseSensorDataPacket()
 {
+    PROFILE_SCOPE(PARSE_SENSOR_DATA);
+
     size_t currReportOffset = 0;
 
+    if(packetLength < SIZEOF_BASE_TIMESTAMP) {
+        LOG_MSG(REPORT_TRUNCATED, shtpData[0], 0, packetLength);
+        return;
+    }
+
     // every sensor data report first contains a timestamp offset to show how long it has been between when
-    // the host interrupt was sent and when the packet was transmitted.
-    // We don't use interrupts and don't care about times, so we can throw this out.
+    // the host interrupt was sent and when the packet was transmitted (SH-2 section 7.2.1).
+    // Sample times are kept relative to the interrupt, in the sensor's 100us ticks.  The time base is
+    // signed, but kept unsigned so that garbage deltas wrap instead of overflowing.
+    uint32_t baseDelta = (uint32_t)shtpData[4] << 24 | (uint32_t)shtpData[3] << 16 | (uint32_t)shtpData[2] << 8 | shtpData[1];
+    uint32_t timebase = 0u - baseDelta;
     currReportOffset += SIZEOF_BASE_TIMESTAMP;
 
     while(currReportOffset < packetLength) {
         if(currReportOffset >= STORED_PACKET_SIZE) {
-            _debugPort->printf("Error: sensor report longer than packet buffer!\n");
+            LOG_MSG(REPORT_TOO_LONG);
+            return;
+        }
+
+        // the whole report has to be there before any of it is read.  This also rejects report IDs
+        // we don't know, so from here on reportNum indexes the per report arrays safely.
+        uint8_t reportNum = shtpData[currReportOffset];
+        size_t reportLength = sensorReportLength(reportNum);
+        if(reportLength == 0) {
+            LOG_MSG(UNKNOWN_REPORT, reportNum, currReportOffset, packetLength);
+            return;
+        }
+        if(currReportOffset + reportLength > packetLength) {
+            LOG_MSG(REPORT_TRUNCATED, reportNum, currReportOffset, packetLength);
+            return;
+        }
+        if(currReportOffset + reportLength > STORED_PACKET_SIZE) {
+            LOG_MSG(REPORT_TOO_LONG);
             return;
         }
 
         // lots of sensor reports use 3 16-bit numbers stored in bytes 4 through 9
         // we can save some time by parsing those out here.
-        uint16_t data1 = (uint16_t)shtpData[currReportOffset + 5] << 8 | shtpData[currReportOffset + 4];
-        uint16_t data2 = (uint16_t)shtpData[currReportOffset + 7] << 8 | shtpData[currReportOffset + 6];
-        uint16_t data3 = (uint16_t)shtpData[currReportOffset + 9] << 8 | shtpData[currReportOffset + 8];
+        uint16_t data1 = 0;
+        uint16_t data2 = 0;
+        uint16_t data3 = 0;
+        if(reportLength >= 10) {
+            data1 = (uint16_t)shtpData[currReportOffset + 5] << 8 | shtpData[currReportOffset + 4];
+            data2 = (uint16_t)shtpData[currReportOffset + 7] << 8 | shtpData[currReportOffset + 6];
+            data3 = (uint16_t)shtpData[currReportOffset + 9] << 8 | shtpData[currReportOffset + 8];
+        }
 
-        uint8_t reportNum = shtpData[currReportOffset];
+        size_t reportStart = currReportOffset;
+        uint32_t timestamp = 0;
 
         if(reportNum != SENSOR_REPORTID_TIMESTAMP_REBASE) {
+            // the upper 6 bits of byte 2 and byte 3 hold a 14 bit delay from the time base (SH-2 section 6.5.1)
+            uint16_t delay = (uint16_t)(shtpData[currReportOffset + 2] & 0xFC) << 6 | shtpData[currReportOffset + 3];
+            timestamp = _packetInterruptTime + (timebase + delay) * 100;
+            reportTimestamp[reportNum] = timestamp;
+
             // set status from byte 2
-            reportStatus[reportNum] = static_cast<uint8_t>(shtpData[currReportOffset + 2] & 0b11);
+            updateReportStatus(reportNum, static_cast<uint8_t>(shtpData[currReportOffset + 2] & 0b11), timestamp);
 
             // set updated flag
             reportHasBeenUpdated[reportNum] = true;
         }
 
+        PROFILE_BEGIN(Q_CONVERSION);
         switch(shtpData[currReportOffset]) {
-            case SENSOR_REPORTID_TIMESTAMP_REBASE:
+            case SENSOR_REPORTID_TIMESTAMP_REBASE: {
+                // moves the time base of the reports that follow (SH-2 section 7.2.2)
+                uint32_t rebaseDelta = (uint32_t)shtpData[currReportOffset + 4] << 24 | (uint32_t)shtpData[currReportOffset + 3] << 16 |
+                                       (uint32_t)shtpData[currReportOffset + 2] << 8 | shtpData[currReportOffset + 1];
+                timebase += rebaseDelta;
+
                 currReportOffset += SIZEOF_TIMESTAMP_REBASE;
-                break;
+            }
+            break;
 
             case SENSOR_REPORTID_ACCELEROMETER:
 
@@ -733,6 +948,7 @@ void BNO080::parseSensorDataPacket()
                 significantMotionDetected = true;
 
                 currReportOffset += SIZEOF_SIGNIFICANT_MOTION;
+                break;
 
             case SENSOR_REPORTID_SHAKE_DETECTOR:
 
@@ -743,15 +959,96 @@ void BNO080::parseSensorDataPacket()
                 zAxisShake = (shtpData[currReportOffset + 4] & (1 << 2)) != 0;
 
                 currReportOffset += SIZEOF_SHAKE_DETECTOR;
+                break;
 
             default:
-                _debugPort->printf("Error: unrecognized report ID in sensor report: %hhx.  Byte %u, length %hu\n", shtpData[currReportOffset], currReportOffset, packetLength);
+                LOG_MSG(UNKNOWN_REPORT, shtpData[currReportOffset], currReportOffset, packetLength);
                 return;
         }
+        PROFILE_END(Q_CONVERSION);
+
+        if(reportNum != SENSOR_REPORTID_TIMESTAMP_REBASE && _latencyTracer != NULL) {
+            _latencyTracer->sampleDecoded(reportNum, timestamp, _packetInterruptTime, _packetReadTime, getHostTime());
+        }
+
+        if(reportNum != SENSOR_REPORTID_TIMESTAMP_REBASE && _rateMonitor != NULL) {
+            _rateMonitor->sample(reportNum, timestamp);
+        }
+
+        if(reportNum != SENSOR_REPORTID_TIMESTAMP_REBASE && _sampleCallback) {
+            SensorSample sample;
+            sample.report = static_cast<Report>(reportNum);
+            sample.status = reportStatus[reportNum];
+            sample.timestamp = timestamp;
+
+            // the report was parsed, so currReportOffset is now at its end
+            size_t dataStart = reportStart + 4;
+            size_t dataEnd = currReportOffset < STORED_PACKET_SIZE ? currReportOffset : STORED_PACKET_SIZE;
+            size_t dataLength = dataEnd > dataStart ? dataEnd - dataStart : 0;
+            if(dataLength > SENSOR_SAMPLE_MAX_VALUES * 2) {
+                dataLength = SENSOR_SAMPLE_MAX_VALUES * 2;
+            }
+            sample.numValues = static_cast<uint8_t>((dataLength + 1) / 2);
+            for(size_t i = 0; i < sample.numValues; i++) {
+                uint8_t high = (2 * i + 1 < dataLength) ? shtpData[dataStart + 2 * i + 1] : 0;
+                sample.values[i] = static_cast<int16_t>(high << 8 | shtpData[dataStart + 2 * i]);
+            }
+
+            _sampleCallback(sample);
+        }
+
+        // with no callback, the sample is published as soon as it is in the member variables
+        if(reportNum != SENSOR_REPORTID_TIMESTAMP_REBASE && _latencyTracer != NULL) {
+            _latencyTracer->samplePublished(reportNum, getHostTime());
+        }
     }
 
 }
 
+uint8_t BNO080::getReportLength(Report report)
+{
+    return sensorReportLength(static_cast<uint8_t>(report));
+}
+
+uint8_t BNO080::sensorReportLength(uint8_t reportID)
+{
+    switch(reportID) {
+        case SENSOR_REPORTID_TIMESTAMP_REBASE:
+            return SIZEOF_TIMESTAMP_REBASE;
+        case SENSOR_REPORTID_ACCELEROMETER:
+            return SIZEOF_ACCELEROMETER;
+        case SENSOR_REPORTID_LINEAR_ACCELERATION:
+        case SENSOR_REPORTID_GRAVITY:
+            return SIZEOF_LINEAR_ACCELERATION;
+        case SENSOR_REPORTID_GYROSCOPE_CALIBRATED:
+            return SIZEOF_GYROSCOPE_CALIBRATED;
+        case SENSOR_REPORTID_MAGNETIC_FIELD_CALIBRATED:
+            return SIZEOF_MAGNETIC_FIELD_CALIBRATED;
+        case SENSOR_REPORTID_MAGNETIC_FIELD_UNCALIBRATED:
+            return SIZEOF_MAGNETIC_FIELD_UNCALIBRATED;
+        case SENSOR_REPORTID_ROTATION_VECTOR:
+            return SIZEOF_ROTATION_VECTOR;
+        case SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR:
+            return SIZEOF_GEOMAGNETIC_ROTATION_VECTOR;
+        case SENSOR_REPORTID_GAME_ROTATION_VECTOR:
+            return SIZEOF_GAME_ROTATION_VECTOR;
+        case SENSOR_REPORTID_TAP_DETECTOR:
+            return SIZEOF_TAP_DETECTOR;
+        case SENSOR_REPORTID_STABILITY_CLASSIFIER:
+            return SIZEOF_STABILITY_REPORT;
+        case SENSOR_REPORTID_STEP_DETECTOR:
+            return SIZEOF_STEP_DETECTOR;
+        case SENSOR_REPORTID_STEP_COUNTER:
+            return SIZEOF_STEP_COUNTER;
+        case SENSOR_REPORTID_SIGNIFICANT_MOTION:
+            return SIZEOF_SIGNIFICANT_MOTION;
+        case SENSOR_REPORTID_SHAKE_DETECTOR:
+            return SIZEOF_SHAKE_DETECTOR;
+    }
+
+    return 0;
+}
+
 bool BNO080::waitForPacket(int channel, uint8_t reportID, float timeout)
 {
     Timer timeoutTimer;
@@ -765,42 +1062,37 @@ bool BNO080::waitForPacket(int channel, uint8_t reportID, float timeout)
 
             if(channel == shtpHeader[2] && reportID == shtpData[0]) {
                 // found correct packet!
-                _debugPort->printf("\r\t found the correct packet \r\n");
+                LOG_MSG(PACKET_FOUND);
                 return true;
             } else {
                 // other data packet, send to proper channels
-                _debugPort->printf("\r\t other data packets, sending to proper channel\r\n");
+                LOG_MSG(PACKET_OTHER);
                 processPacket();
             }
         }
     }
 
-    _debugPort->printf("Packet wait timeout.\n");
+    LOG_MSG(PACKET_WAIT_TIMEOUT);
     return false;
 }
 
 //Given a register value and a Q point, convert to float
 //See https://en.wikipedia.org/wiki/Q_(number_format)
+//Scaling by a power of two is exact, so ldexpf() gives the same result as
+//multiplying by pow(2.0, -qPoint) without going through double
 float BNO080::qToFloat(int16_t fixedPointValue, uint8_t qPoint)
 {
-    float qFloat = fixedPointValue;
-    qFloat *= pow(2.0, qPoint * -1.0);
-    return (qFloat);
+    return ldexpf(static_cast<float>(fixedPointValue), -qPoint);
 }
 
 float BNO080::qToFloat_dword(uint32_t fixedPointValue, int16_t qPoint)
 {
-    float qFloat = fixedPointValue;
-    qFloat *= pow(2.0, qPoint * -1.0);
-    return (qFloat);
+    return ldexpf(static_cast<float>(fixedPointValue), -qPoint);
 }
 
-//Given a floating point value and a Q point, convert to Q
-//See https://en.wikipedia.org/wiki/Q_(number_format)
-int16_t BNO080::floatToQ(float qFloat, uint8_t qPoint)
+int32_t BNO080::floatToQ_dword(float qFloat, uint16_t qPoint)
 {
-    int16_t qVal = static_cast<int16_t>(qFloat * pow(2.0, qPoint));
-    return qVal;
+    return static_cast<int32_t>(ldexpf(qFloat, qPoint));
 }
 
 //Tell the sensor to do a command
@@ -812,16 +1104,7 @@ void BNO080::sendCommand(uint8_t command)
     shtpData[1] = commandSequenceNumber++; //Increments automatically each function call
     shtpData[2] = command; //Command
 
-    //Caller must set these
-    shtpData[3] = 0; //P0
-    shtpData[4] = 0; //P1
-    shtpData[5] = 0; //P2
-    shtpData[6] = 0;
-    shtpData[7] = 0;
-    shtpData[8] = 0;
-    shtpData[9] = 0;
-    shtpData[10] = 0;
-    shtpData[11] = 0;
+    //P0 to P8 (shtpData[3] to shtpData[11]) are left as the caller set them, after zeroBuffer()
 
     //Transmit packet on channel 2, 12 bytes
     sendPacket(CHANNEL_CONTROL, 12);
@@ -829,11 +1112,11 @@ void BNO080::sendCommand(uint8_t command)
 
 //Given a sensor's report ID, this tells the BNO080 to begin reporting the values
 //Also sets the specific config word. Useful for personal activity classifier
-void BNO080::setFeatureCommand(uint8_t reportID, uint16_t timeBetweenReports, uint32_t specificConfig)
+void BNO080::setFeatureCommand(uint8_t reportID, uint16_t timeBetweenReports, uint32_t specificConfig, uint16_t batchInterval)
 {
     uint32_t microsBetweenReports = static_cast<uint32_t>(timeBetweenReports * 1000);
 
-    const uint32_t batchMicros = 0;
+    const uint32_t batchMicros = static_cast<uint32_t>(batchInterval * 1000);
 
     shtpData[0] = SHTP_REPORT_SET_FEATURE_COMMAND; //Set feature command. Reference page 55
     shtpData[1] = reportID; //Feature Report ID. 0x01 = Accelerometer, 0x05 = Rotation vector
@@ -879,9 +1162,7 @@ bool BNO080::readFRSRecord(uint16_t recordID, uint32_t* readBuffer, uint16_t rea
     size_t readOffset = 0;
     while(readOffset < readLength) {
         if(!waitForPacket(CHANNEL_CONTROL, SHTP_REPORT_FRS_READ_RESPONSE)) {
-#if BNO_DEBUG
-            _debugPort->printf("Error: did not receive FRS read response after sending read request!\n");
-#endif
+            LOG_MSG(FRS_TIMEOUT);
             return false;
         }
 
@@ -890,43 +1171,29 @@ bool BNO080::readFRSRecord(uint16_t recordID, uint32_t* readBuffer, uint16_t rea
 
         // check status
         if(status == 1) {
-#if BNO_DEBUG
-            _debugPort->printf("Error: FRS reports invalid record ID!\n");
-#endif
+            LOG_MSG(FRS_INVALID_RECORD);
             return false;
         } else if(status == 2) {
-#if BNO_DEBUG
-            _debugPort->printf("Error: FRS is busy!\n");
-#endif
+            LOG_MSG(FRS_BUSY);
             return false;
         } else if(status == 4) {
-#if BNO_DEBUG
-            _debugPort->printf("Error: FRS reports offset is out of range!\n");
-#endif
+            LOG_MSG(FRS_OFFSET_RANGE);
             return false;
         } else if(status == 5) {
-#if BNO_DEBUG
-            _debugPort->printf("Error: FRS reports record %hx is empty!\n", recordID);
-#endif
+            LOG_MSG(FRS_RECORD_EMPTY, recordID);
             return false;
         } else if(status == 8) {
-#if BNO_DEBUG
-            _debugPort->printf("Error: FRS reports flash memory device unavailable!\n");
-#endif
+            LOG_MSG(FRS_FLASH_UNAVAILABLE);
             return false;
         }
 
         // check data length
         if(dataLength == 0) {
-#if BNO_DEBUG
-            _debugPort->printf("Error: Received FRS packet with 0 data length!\n");
-#endif
+            LOG_MSG(FRS_ZERO_LENGTH);
             return false;
         } else if(dataLength == 1) {
             if(readOffset + 1 != readLength) {
-#if BNO_DEBUG
-                _debugPort->printf("Error: Received 1 length packet but more than 1 byte remains to be be read!\n");
-#endif
+                LOG_MSG(FRS_SHORT_PACKET);
                 return false;
             }
         }
@@ -949,10 +1216,77 @@ bool BNO080::readFRSRecord(uint16_t recordID, uint32_t* readBuffer, uint16_t rea
 
 }
 
+bool BNO080::writeFRSRecord(uint16_t recordID, uint32_t* buffer, uint16_t length)
+{
+    // send the write request, which tells the IMU what is coming
+    zeroBuffer();
+
+    shtpData[0] = SHTP_REPORT_FRS_WRITE_REQUEST;
+    // length in words
+    shtpData[2] = static_cast<uint8_t>(length & 0xFF);
+    shtpData[3] = static_cast<uint8_t>(length >> 8);
+    // record ID
+    shtpData[4] = static_cast<uint8_t>(recordID & 0xFF);
+    shtpData[5] = static_cast<uint8_t>(recordID >> 8);
+
+    sendPacket(CHANNEL_CONTROL, 6);
+
+    // the IMU answers with status 4 once it is ready for the data (SH-2 section 6.3.5)
+    if(!waitForPacket(CHANNEL_CONTROL, SHTP_REPORT_FRS_WRITE_RESPONSE)) {
+        LOG_MSG(FRS_WRITE_TIMEOUT);
+        return false;
+    }
+    if(shtpData[1] != 4) {
+        LOG_MSG(FRS_WRITE_FAILED, recordID, shtpData[1]);
+        return false;
+    }
+
+    // now send the words, two per packet, each acknowledged with status 0
+    for(uint16_t wordIndex = 0; wordIndex < length; wordIndex += 2) {
+        zeroBuffer();
+
+        shtpData[0] = SHTP_REPORT_FRS_WRITE_DATA;
+        shtpData[2] = static_cast<uint8_t>(wordIndex & 0xFF);
+        shtpData[3] = static_cast<uint8_t>(wordIndex >> 8);
+        for(uint16_t word = 0; word < 2 && wordIndex + word < length; word++) {
+            for(uint8_t byte = 0; byte < 4; byte++) {
+                shtpData[4 + word * 4 + byte] = static_cast<uint8_t>(buffer[wordIndex + word] >> (byte * 8));
+            }
+        }
+
+        sendPacket(CHANNEL_CONTROL, 12);
+
+        if(!waitForPacket(CHANNEL_CONTROL, SHTP_REPORT_FRS_WRITE_RESPONSE)) {
+            LOG_MSG(FRS_WRITE_TIMEOUT);
+            return false;
+        }
+        if(shtpData[1] != 0 && shtpData[1] != 3) {
+            LOG_MSG(FRS_WRITE_FAILED, recordID, shtpData[1]);
+            return false;
+        }
+    }
+
+    // after the last words the IMU validates the record (status 8) and writes it to flash (status 3),
+    // which can take a few hundred ms
+    while(shtpData[1] != 3) {
+        if(!waitForPacket(CHANNEL_CONTROL, SHTP_REPORT_FRS_WRITE_RESPONSE, .5f)) {
+            LOG_MSG(FRS_WRITE_TIMEOUT);
+            return false;
+        }
+        if(shtpData[1] != 0 && shtpData[1] != 3 && shtpData[1] != 8) {
+            LOG_MSG(FRS_WRITE_FAILED, recordID, shtpData[1]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 //Given the data packet, send the header then the data
 //Returns false if sensor does not ACK
 bool BNO080::sendPacket(uint8_t channelNumber, uint8_t dataLength)
 {
+    PROFILE_SCOPE(SEND_PACKET);
     
     uint16_t totalLength = dataLength + 4; //Add four bytes for the header
     packetLength = dataLength;
@@ -976,6 +1310,8 @@ bool BNO080::sendPacket(uint8_t channelNumber, uint8_t dataLength)
     {
     readBuffer[index + 4] = shtpData[index];
     }
+    capturePacket(true, readBuffer, totalLength);
+
     int writeRetval = _i2cPort.write(
     _i2cAddress << 1,
     reinterpret_cast<char*>(readBuffer),
@@ -983,7 +1319,7 @@ bool BNO080::sendPacket(uint8_t channelNumber, uint8_t dataLength)
 
     if(writeRetval < 0) 
 {
-_debugPort->printf("BNO I2C body write failed!\n");
+LOG_MSG(I2C_WRITE_FAILED);
         return false;
 }
     
@@ -996,15 +1332,20 @@ _debugPort->printf("BNO I2C body write failed!\n");
 //Read the contents of the incoming packet into the shtpData array
 bool BNO080::receivePacket(float timeout)
 {
+    PROFILE_SCOPE(RECEIVE_PACKET);
+
     Timer waitStartTime;
     waitStartTime.start();
 
     while(_int.read() != 0) {
         if(waitStartTime.read() > timeout) {
-            _debugPort->printf("BNO I2C wait timeout\n");
+            LOG_MSG(I2C_WAIT_TIMEOUT);
             return false;
         }
     }
+
+    // the interrupt for this packet has been seen, so its time is final
+    _packetInterruptTime = _interruptTime;
     
     const size_t headerLen = 4;
     uint8_t headerData[headerLen];
@@ -1015,7 +1356,7 @@ bool BNO080::receivePacket(float timeout)
 
     if(readRetval < 0) 
 {
-_debugPort->printf("BNO I2C header read failed!\n");
+LOG_MSG(I2C_HEADER_FAILED);
         return false;
 }
 
@@ -1035,7 +1376,7 @@ _debugPort->printf("BNO I2C header read failed!\n");
     if(shtpHeader[0] == 0xFF && shtpHeader[1] == 0xFF) {
         // invalid according to BNO080 datasheet section 1.4.1
 
-        _debugPort->printf("Recieved 0xFFFF packet length, protocol error!\n");
+        LOG_MSG(BAD_PACKET_LENGTH);
         return false;
     }
 
@@ -1052,6 +1393,12 @@ _debugPort->printf("BNO I2C header read failed!\n");
         // Packet is empty
         return (false); //All done
     }
+    else if(packetLength < headerLen)
+    {
+        // the length includes the header, so this can't be a packet
+        LOG_MSG(PACKET_TOO_SHORT, packetLength);
+        return false;
+    }
     else if(packetLength > READ_BUFFER_SIZE)
     {
     return false; // read buffer too small
@@ -1067,10 +1414,15 @@ _debugPort->printf("BNO I2C header read failed!\n");
 
     if(readRetval < 0) 
 {
-_debugPort->printf("BNO I2C body read failed!\n");
+LOG_MSG(I2C_BODY_FAILED);
         return false;
 }
 
+    if(_latencyTracer != NULL) {
+        _packetReadTime = getHostTime();
+    }
+    capturePacket(false, readBuffer, static_cast<uint16_t>(packetLength + headerLen));
+
     //Read incoming data into the shtpData array
     for (uint16_t dataSpot = 0 ; dataSpot < packetLength ; dataSpot++) {
 
@@ -1189,6 +1541,9 @@ bool BNO080::loadReportMetadata(BNO080::Report report)
         case SHAKE_DETECTOR:
             reportMetaRecord = 0xE318;
             break;
+        default:
+            // not a report the IMU has metadata for
+            return false;
     }
 
     // if we already have that data stored, everything's OK
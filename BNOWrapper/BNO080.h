@@ -27,6 +27,9 @@
 
 #include "BNO080Constants.h"
 
+class LatencyTracer;
+class RateMonitor;
+
 // useful define when working with orientation quaternions
 #define SQRT_2 1.414213562f
 
@@ -38,9 +41,10 @@
 class BNO080
 {
 	/**
-	 * Serial stream to print debug info to.  Used for errors, and debugging output if debugging is enabled.
+	 * Stream to print debug info to.  Used for errors, and debugging output if debugging is enabled.
+	 * A BufferedSerialTx keeps these prints from holding up the driver.
 	 */
-	Serial * _debugPort;
+	Stream * _debugPort;
 
 	/**
 	 * I2C port object.  Provides physical layer communications with the chip.
@@ -55,8 +59,9 @@ class BNO080
 	/// i2c address of IMU (7 bits)
 	uint8_t _i2cAddress;
 
-	/// Interrupt pin -- signals to the host that the IMU has data to send
-	DigitalIn _int;
+	/// Interrupt pin -- signals to the host that the IMU has data to send.
+	/// Its falling edge is also the reference point of the sensor timestamps.
+	InterruptIn _int;
 	
 	// Reset pin -- resets IMU when held low.
 	DigitalOut _rst;
@@ -68,7 +73,25 @@ class BNO080
 
 	// Arbitrarily chosen, but should hopefully be large enough for all packets we need.
 	// If you enable lots of sensor reports and get an error, you might need to increase this.
-#define STORED_PACKET_SIZE 128 
+	// Override with -D, e.g. to shrink the driver for several IMUs on one MCU (see MemoryBudget.h).
+#ifndef STORED_PACKET_SIZE
+#define STORED_PACKET_SIZE 128
+#endif
+
+	// Longest packet read from the IMU, header included.  Longer ones are dropped unread.  The IMU's
+	// advertisement, the longest packet it sends, is 276 bytes, but the driver has no use for it.
+#ifndef READ_BUFFER_SIZE
+#define READ_BUFFER_SIZE 512
+#endif
+
+	// the longest packet sent is a 17 byte Set Feature Command, and a sensor packet needs room for the
+	// base timestamp and at least one report, the longest being the uncalibrated magnetic field at 16 bytes
+	static_assert(STORED_PACKET_SIZE >= 21, "STORED_PACKET_SIZE can't hold a sensor packet");
+	// sendPacket() puts the header and shtpData together in readBuffer
+	static_assert(READ_BUFFER_SIZE >= SHTP_HEADER_SIZE + STORED_PACKET_SIZE, "READ_BUFFER_SIZE must hold a whole stored packet");
+
+/// RAM of the packet buffers
+#define BNO080_PACKET_RAM (SHTP_HEADER_SIZE + STORED_PACKET_SIZE + READ_BUFFER_SIZE)
 
 	/// Each SHTP packet has a header of 4 uint8_ts
 	uint8_t shtpHeader[SHTP_HEADER_SIZE];
@@ -77,8 +100,8 @@ class BNO080
 	/// rarely get over a hundred bytes unless you have a million sensor reports enabled.
 	/// The only long packets we actually care about are batched sensor data packets.
 	uint8_t shtpData[STORED_PACKET_SIZE];
-	
-	#define READ_BUFFER_SIZE 512
+
+	/// Whole packets as they go over the bus, header included
 	uint8_t readBuffer[READ_BUFFER_SIZE];
 
 	/// Length of packet that was received into buffer.  Does NOT include header bytes.
@@ -105,11 +128,29 @@ class BNO080
 	/// Buffer for current metadata record.
 	uint32_t metadataRecord[METADATA_BUFFER_LEN];
 
+/// RAM of the metadata buffer
+#define BNO080_METADATA_RAM (METADATA_BUFFER_LEN * sizeof(uint32_t))
+
 	// data storage
 	//-----------------------------------------------------------------------------------------------------------------
 
 	// 1 larger than the largest sensor report ID
-#define STATUS_ARRAY_LEN MAX_SENSOR_REPORTID + 1
+#define STATUS_ARRAY_LEN (MAX_SENSOR_REPORTID + 1)
+
+/// RAM of the per report state: status, new data flag, timestamp, status known flag and status start
+#define BNO080_REPORT_RAM (STATUS_ARRAY_LEN * (sizeof(uint8_t) + 2 * sizeof(bool) + 2 * sizeof(uint32_t)))
+
+/// 0 leaves out the status dwell times and change counts, see getStatusDwellTime().  The status callback still works.
+#ifndef BNO080_STATUS_STATISTICS
+#define BNO080_STATUS_STATISTICS 1
+#endif
+
+/// RAM of the status dwell times and change counts
+#if BNO080_STATUS_STATISTICS
+#define BNO080_STATUS_STATISTICS_RAM (STATUS_ARRAY_LEN * (4 * sizeof(uint32_t) + sizeof(uint16_t)))
+#else
+#define BNO080_STATUS_STATISTICS_RAM 0
+#endif
 
 	/// stores status of each sensor, indexed by report ID
 	uint8_t reportStatus[STATUS_ARRAY_LEN];
@@ -117,6 +158,41 @@ class BNO080
 	/// stores whether a sensor has been updated since the last call to hasNewData()
 	bool reportHasBeenUpdated[STATUS_ARRAY_LEN];
 
+	// sensor timestamps
+	//-----------------------------------------------------------------------------------------------------------------
+
+	/// Free running host clock that all timestamps are given on
+	Timer _hostClock;
+
+	/// Host time in us of the latest falling edge of the interrupt pin.  Written from the ISR.
+	volatile uint32_t _interruptTime;
+
+	/// Interrupt time of the packet currently in shtpData, latched when it was received
+	uint32_t _packetInterruptTime;
+
+	/// Host time at which the I2C read of the packet currently in shtpData completed, kept while a latency tracer is attached
+	uint32_t _packetReadTime;
+
+	/// Host time in us at which the latest sample of each report was taken, indexed by report ID
+	uint32_t reportTimestamp[STATUS_ARRAY_LEN];
+
+	// status change tracking
+	//-----------------------------------------------------------------------------------------------------------------
+
+	/// whether a report has had a sample yet, so its status is known
+	bool reportStatusKnown[STATUS_ARRAY_LEN];
+
+	/// sample time at which each report entered its current status
+	uint32_t statusSince[STATUS_ARRAY_LEN];
+
+#if BNO080_STATUS_STATISTICS
+	/// us each report has spent in each status, not counting its current stretch
+	uint32_t statusDwell[STATUS_ARRAY_LEN][4];
+
+	/// number of status changes of each report
+	uint16_t statusChanges[STATUS_ARRAY_LEN];
+#endif
+
 public:
 
 	// list of reports
@@ -220,6 +296,70 @@ public:
 		SHAKE_DETECTOR = SENSOR_REPORTID_SHAKE_DETECTOR
 	};
 
+	/// Most 16 bit words in the data of one sensor report (the uncalibrated magnetic field has 6)
+#define SENSOR_SAMPLE_MAX_VALUES 6
+
+	/**
+	 * One sensor sample as it came from the IMU, passed to the function set with attachSampleCallback().
+	 */
+	struct SensorSample
+	{
+		Report report;
+
+		/// 2 bit status, see getReportStatus()
+		uint8_t status;
+
+		/// Sample time in microseconds, see getReportTimestamp()
+		uint32_t timestamp;
+
+		/// Number of words in values
+		uint8_t numValues;
+
+		/// The report's data after its 4 byte header, as raw little endian 16 bit words (before Q point scaling).
+		/// An odd last byte is zero extended.
+		int16_t values[SENSOR_SAMPLE_MAX_VALUES];
+	};
+
+	/// previousStatus of a report's first sample, whose status wasn't known before
+#define REPORT_STATUS_NONE 0xFF
+
+	/**
+	 * A change in the status of a report, passed to the function set with attachStatusCallback().
+	 */
+	struct StatusChange
+	{
+		Report report;
+
+		/// Status before the change, or REPORT_STATUS_NONE for the first sample of the report
+		uint8_t previousStatus;
+
+		/// New status, see getReportStatus()
+		uint8_t status;
+
+		/// Time of the first sample with the new status, on the clock of getReportTimestamp()
+		uint32_t timestamp;
+
+		/// Microseconds the report spent in previousStatus (0 for the first sample)
+		uint32_t dwellTime;
+	};
+
+	/**
+	 * One SHTP packet as it went over the bus, passed to the function set with attachPacketCallback().
+	 */
+	struct RawPacket
+	{
+		/// true for packets sent to the IMU, false for packets read from it
+		bool outbound;
+
+		/// For a packet read, the time of the interrupt that announced it (the base of its sample timestamps);
+		/// for a packet sent, the time it was sent.  On the clock of getHostTime().
+		uint32_t timestamp;
+
+		/// The whole packet, its 4 byte header included
+		const uint8_t* data;
+		uint16_t length;
+	};
+
 	// data variables to read reports from
 	//-----------------------------------------------------------------------------------------------------------------
 
@@ -389,7 +529,8 @@ public:
 	 * NOTE: while some schematics tell you to connect the BOOTN pin to the processor, this driver does not use or require it.
 	 * Just tie it to VCC per the datasheet.
 	 *
-	 * @param debugPort Serial port to write output to.  Cannot be nullptr.
+	 * @param debugPort Serial port or other stream for the BNO_DEBUG packet and metadata dumps.  Cannot be nullptr.
+	 * Errors and other messages go to the log ring of Log.h instead; empty it with logDrain() or logDrainText().
 	 * @param user_SDApin Hardware I2C SDA pin connected to the IMU
 	 * @param user_SCLpin Hardware I2C SCL pin connected to the IMU
 	 * @param user_INTPin Input pin connected to HINTN
@@ -397,7 +538,7 @@ public:
 	 * @param i2cAddress I2C address.  The BNO defaults to 0x4a, but can also be set to 0x4b via a pin.
 	 * @param i2cPortSpeed I2C frequency.  The BNO's max is 400kHz.
 	 */
-	BNO080(Serial *debugPort, 
+	BNO080(Stream *debugPort, 
 	       PinName user_SDApin, 
 		   PinName user_SCLpin, 
 		   PinName user_INTPin, 
@@ -409,7 +550,7 @@ public:
 	 * Resets and connects to the IMU.  Verifies that it's connected, and reads out its version
 	 * info into the class variables above.
 	 *
-	 * If this function is failing, it would be a good idea to turn on BNO_DEBUG in the cpp file to get detailed output.
+	 * If this function is failing, it would be a good idea to build with LOG_LEVEL=LOG_LEVEL_DEBUG to get detailed output.
 	 *
 	 * @return whether or not initialization was successful
 	 */
@@ -472,6 +613,39 @@ public:
 	 */
 	void setSensorOrientation(Quaternion orientation);
 
+	/**
+	 * An orientation quaternion already converted to the Q14 words of the set orientation command.
+	 */
+	struct OrientationQ
+	{
+		int16_t x, y, z, w;
+	};
+
+	/**
+	 * Converts an orientation quaternion to the words sent by setSensorOrientation().
+	 * With C++14 this is constexpr, so a fixed mounting can be converted at compile time:
+	 *
+	 *   constexpr BNO080::OrientationQ mounting = BNO080::orientationToQ(Quaternion(0, 0, -SQRT_2/2, SQRT_2/2));
+	 *   imu.setSensorOrientation(mounting);
+	 *
+	 * make -C host orientation-bench compares the two.
+	 */
+	static TMATRIX_CONSTEXPR OrientationQ orientationToQ(const Quaternion& orientation)
+	{
+		return OrientationQ{floatToQ(orientation.x(), ORIENTATION_QUAT_Q_POINT),
+							floatToQ(orientation.y(), ORIENTATION_QUAT_Q_POINT),
+							floatToQ(orientation.z(), ORIENTATION_QUAT_Q_POINT),
+							floatToQ(orientation.w(), ORIENTATION_QUAT_Q_POINT)};
+	}
+
+	/**
+	 * Same as setSensorOrientation(Quaternion), but takes precomputed words from orientationToQ(),
+	 * so no float conversion is done at runtime.
+	 *
+	 * @param orientation quaternion mapping from IMU space to world space, in Q14.
+	 */
+	void setSensorOrientation(const OrientationQ& orientation);
+
 	/**
 	 * Sets the orientation quaternion, telling the sensor how it's mounted
 	 * in relation to world space. See page 40 of the BNO080 datasheet.
@@ -525,14 +699,89 @@ public:
 	 */
 	bool hasNewData(Report report);
 
+	/**
+	 * Gets the time at which the IMU took the latest sample of a report.
+	 * This comes from the timestamps in the sensor data packets (SH-2 section 7.2), so it is the time
+	 * of the measurement itself, not of when updateData() happened to read it.
+	 *
+	 * @return Time in microseconds on the clock returned by getHostTime().  Wraps around every 71 minutes,
+	 * so compare two times by subtracting them.
+	 */
+	uint32_t getReportTimestamp(Report report);
+
+	/**
+	 * Gets the current time of the clock used for report timestamps.
+	 * @return Time in microseconds.
+	 */
+	uint32_t getHostTime();
+
+	/**
+	 * Sets a function to be called right after each sensor sample is decoded, with the report it belongs to,
+	 * its timestamp and its raw data.  The public data members already hold the new sample when it is called.
+	 *
+	 * Unlike hasNewData(), this sees every sample when the IMU sends several in one batched packet.
+	 * It runs inside updateData(), so keep it short.
+	 */
+	void attachSampleCallback(Callback<void(const SensorSample&)> callback);
+
+	/**
+	 * Sets a function to be called when the status of a report changes, e.g. when the magnetometer drops to
+	 * unreliable because the motors came on, and for the first sample of each report.  It is called once per
+	 * change, before the sample callback of the sample that changed it, so nothing has to poll getReportStatus().
+	 * It runs inside updateData(), so keep it short.
+	 */
+	void attachStatusCallback(Callback<void(const StatusChange&)> callback);
+
+	/**
+	 * Sets a function to be called with every SHTP packet sent to or read from the IMU, header included,
+	 * e.g. to capture the raw traffic of a field problem for replay (see ShtpCapture.h).
+	 * It runs inside the driver's bus transfers, so keep it short.
+	 */
+	void attachPacketCallback(Callback<void(const RawPacket&)> callback);
+
+	/**
+	 * Follows every sample from its timestamp through the interrupt, the I2C read and the decode to
+	 * the sample callback, see LatencyTracer.h.  NULL stops it.  The tracer must outlive the driver.
+	 */
+	void attachLatencyTracer(LatencyTracer* tracer);
+
+	/**
+	 * Measures the interval between the samples of every report against the period it was enabled at,
+	 * see RateMonitor.h.  Attach it before enabling reports.  NULL stops it.  The monitor must outlive the driver.
+	 */
+	void attachRateMonitor(RateMonitor* monitor);
+
+	/**
+	 * Gets how long a report has been in a status, going by its sample times.  This adds up every stretch
+	 * in the status since startup or resetStatusStatistics(), including the current one up to the latest sample.
+	 * Always 0 when built with BNO080_STATUS_STATISTICS=0.
+	 *
+	 * @param status 0 to 3, see getReportStatus()
+	 * @return Time in microseconds.
+	 */
+	uint32_t getStatusDwellTime(Report report, uint8_t status);
+
+	/**
+	 * Gets how many times the status of a report has changed since startup or resetStatusStatistics().
+	 * Always 0 when built with BNO080_STATUS_STATISTICS=0.
+	 */
+	uint16_t getStatusChangeCount(Report report);
+
+	/**
+	 * Clears the dwell times and change counts of all reports.  The current statuses are kept.
+	 */
+	void resetStatusStatistics();
+
 	/**
 	 * Enable a data report from the IMU.  Look at the comments above to see what the reports do.
 	 * This function checks your polling period against the report's max speed in the IMU's metadata,
 	 * and reports an error if you're trying to poll too fast.
 	 *
 	 * @param timeBetweenReports time in milliseconds between data updates.
+	 * @param batchInterval maximum time in milliseconds that the IMU may hold samples of this report before
+	 * sending them, so that several samples share one packet.  0 (the default) sends every sample as soon as it is ready.
 	 */
-	void enableReport(Report report, uint16_t timeBetweenReports);
+	void enableReport(Report report, uint16_t timeBetweenReports, uint16_t batchInterval = 0);
 
 	/**
 	 * Disable a data report from the IMU.
@@ -541,6 +790,14 @@ public:
 	 */
 	void disableReport(Report report);
 
+	/**
+	 * Gets the length in bytes of one sample of a report inside a sensor data packet.
+	 * Useful for estimating how much I2C traffic a set of reports generates.
+	 *
+	 * @return Sample length in bytes, or 0 for an unknown report.
+	 */
+	static uint8_t getReportLength(Report report);
+
 	/**
 	 * Gets the serial number (used to uniquely identify each individual device).
 	 *
@@ -635,6 +892,13 @@ private:
 	 */
 	void parseSensorDataPacket();
 
+	/**
+	 * Gets the length in bytes of a report in a sensor data packet, by its report ID.
+	 *
+	 * @return Report length in bytes, or 0 for an ID the parser doesn't know.
+	 */
+	static uint8_t sensorReportLength(uint8_t reportID);
+
 	/**
 	 * Call to wait for a packet with the given parameters to come in.
 	 *
@@ -669,7 +933,11 @@ private:
 	 * @param qPoint
 	 * @return
 	 */
-	int16_t floatToQ(float qFloat, uint8_t qPoint);
+	static TMATRIX_CONSTEXPR int16_t floatToQ(float qFloat, uint8_t qPoint)
+	{
+		// scaling by a power of two is exact in float, so this matches multiplying by pow(2.0, qPoint)
+		return static_cast<int16_t>(qFloat * static_cast<float>(1UL << qPoint));
+	}
 
 	/**
 	 * Given a floating point value and a Q point, convert to Q
@@ -696,8 +964,9 @@ private:
 	 * @param reportID
 	 * @param timeBetweenReports
 	 * @param specificConfig the specific config word. Useful for personal activity classifier.
+	 * @param batchInterval maximum batching delay in milliseconds, 0 to disable batching.
 	 */
-	void setFeatureCommand(uint8_t reportID, uint16_t timeBetweenReports, uint32_t specificConfig = 0);
+	void setFeatureCommand(uint8_t reportID, uint16_t timeBetweenReports, uint32_t specificConfig = 0, uint16_t batchInterval = 0);
 
 	/**
 	 * Read a record from the FRS (Flash Record System) on the IMU.  FRS records are composed of 32-bit words,
@@ -756,6 +1025,36 @@ private:
 	 */
 	 void zeroBuffer();
 
+	/**
+	 * Interrupt pin ISR.  Records the time of the falling edge for the sensor timestamps.
+	 */
+	void onInterrupt();
+
+	/// Called with every decoded sensor sample, see attachSampleCallback()
+	Callback<void(const SensorSample&)> _sampleCallback;
+
+	/// Called on every status change, see attachStatusCallback()
+	Callback<void(const StatusChange&)> _statusCallback;
+
+	/// Called with every packet sent or read, see attachPacketCallback()
+	Callback<void(const RawPacket&)> _packetCallback;
+
+	/// Gets the stage times of every sample, see attachLatencyTracer()
+	LatencyTracer* _latencyTracer;
+
+	/// Gets the period of every report and the timestamp of every sample, see attachRateMonitor()
+	RateMonitor* _rateMonitor;
+
+	/**
+	 * Passes a packet to the packet callback, if there is one, timestamped as RawPacket describes.
+	 */
+	void capturePacket(bool outbound, const uint8_t* data, uint16_t length);
+
+	/**
+	 * Records the status of a new sample, and on a change updates the statistics and calls the status callback.
+	 */
+	void updateReportStatus(uint8_t reportNum, uint8_t status, uint32_t timestamp);
+
 	 /**
 	  * Loads the metadata for this report into the metadata buffer.
 	  * @param report
@@ -763,6 +1062,14 @@ private:
 	  */
 	 bool loadReportMetadata(Report report);
 
+	// the RAM macros above, which MemoryBudget.h budgets, must match the members
+	static_assert(sizeof(shtpHeader) + sizeof(shtpData) + sizeof(readBuffer) == BNO080_PACKET_RAM, "BNO080_PACKET_RAM is out of date");
+	static_assert(sizeof(metadataRecord) == BNO080_METADATA_RAM, "BNO080_METADATA_RAM is out of date");
+	static_assert(sizeof(reportStatus) + sizeof(reportHasBeenUpdated) + sizeof(reportTimestamp) + sizeof(reportStatusKnown)
+				  + sizeof(statusSince) == BNO080_REPORT_RAM, "BNO080_REPORT_RAM is out of date");
+#if BNO080_STATUS_STATISTICS
+	static_assert(sizeof(statusDwell) + sizeof(statusChanges) == BNO080_STATUS_STATISTICS_RAM, "BNO080_STATUS_STATISTICS_RAM is out of date");
+#endif
 };
 
 
@@ -1,38 +1,280 @@
 #include "BNO080Wheelchair.h"
+#include "Profile.h"
 float total_yaw;
 
+//Bytes added to every SHTP packet: the 4 byte header, plus the base timestamp
+//that starts every sensor data packet
+#define PACKET_OVERHEAD (SHTP_HEADER_SIZE + 5)
+
+//Bytes added to every I2C read: the driver reads the header on its own first,
+//then the whole packet again, each read starting with the address byte
+#define I2C_READ_OVERHEAD (1 + SHTP_HEADER_SIZE + 1)
+
+//Each byte on the bus takes 9 clocks (8 data + ACK)
+#define I2C_BITS_PER_BYTE 9
+
+static const BNO080ReportConfig legacyReports[] = {
+    {BNO080::TOTAL_ACCELERATION, 200, 0},
+    {BNO080::LINEAR_ACCELERATION, 200, 0},
+    {BNO080::GRAVITY_ACCELERATION, 200, 0},
+    {BNO080::GYROSCOPE, 200, 0},
+    {BNO080::MAG_FIELD, 200, 0},
+};
+
+static const BNO080ReportConfig indoorReports[] = {
+    {BNO080::GAME_ROTATION, 20, 0},
+    {BNO080::GYROSCOPE, 20, 0},
+    {BNO080::LINEAR_ACCELERATION, 50, 0},
+};
+
+static const BNO080ReportConfig outdoorReports[] = {
+    {BNO080::ROTATION, 20, 0},
+    {BNO080::GYROSCOPE, 20, 0},
+    {BNO080::LINEAR_ACCELERATION, 50, 0},
+    {BNO080::MAG_FIELD, 100, 0},
+};
+
+static const BNO080ReportConfig parkedReports[] = {
+    {BNO080::GRAVITY_ACCELERATION, 500, 2000},
+    {BNO080::STABILITY_CLASSIFIER, 1000, 2000},
+};
+
+static const BNO080ReportConfig mountingReports[] = {
+    {BNO080::GRAVITY_ACCELERATION, 20, 0},
+    {BNO080::LINEAR_ACCELERATION, 10, 0},
+};
+
+#define PROFILE_LENGTH(reports) (sizeof(reports) / sizeof(reports[0]))
+
+const BNO080Profile PROFILE_LEGACY = {"legacy", legacyReports, PROFILE_LENGTH(legacyReports)};
+const BNO080Profile PROFILE_INDOOR_NAVIGATION = {"indoor", indoorReports, PROFILE_LENGTH(indoorReports)};
+const BNO080Profile PROFILE_OUTDOOR = {"outdoor", outdoorReports, PROFILE_LENGTH(outdoorReports)};
+const BNO080Profile PROFILE_PARKED = {"parked", parkedReports, PROFILE_LENGTH(parkedReports)};
+const BNO080Profile PROFILE_MOUNTING_CALIBRATION = {"mounting", mountingReports, PROFILE_LENGTH(mountingReports)};
+
+//Returns true if the profile turns on the given report
+static bool profileUses(const BNO080Profile& profile, BNO080::Report report) {
+    for (uint8_t i = 0; i < profile.numReports; i++) {
+        if (profile.reports[i].report == report) {
+            return true;
+        }
+    }
+    return false;
+}
+
 //The constructor for the BNO080 imu. Needs 7 parameters
-BNO080Wheelchair::BNO080Wheelchair(Serial *debugPort, PinName sdaPin, 
+BNO080Wheelchair::BNO080Wheelchair(Stream *debugPort, PinName sdaPin, 
                                  PinName sclPin, PinName intPin, PinName rstPin,
-                                 uint8_t i2cAddress, int i2cPortpeed) {
-    imu = new BNO080(debugPort, sdaPin, sclPin, intPin,rstPin,i2cAddress, i2cPortpeed);
-    //setUp
-    
+                                 uint8_t i2cAddress, int i2cPortpeed) :
+    imu(debugPort, sdaPin, sclPin, intPin, rstPin, i2cAddress, i2cPortpeed),
+    currentProfile(&PROFILE_LEGACY),
+    resampling(false),
+    blockLog(NULL),
+    latencyTracer(NULL),
+    lastDriveTime(0),
+    i2cFrequency(i2cPortpeed) {
+    t.start();
+    imu.attachSampleCallback(callback(this, &BNO080Wheelchair::onImuSample));
 }
 //Check if all the
 bool BNO080Wheelchair::setup() {
-    bool setup = imu -> begin();
-    //Tell the IMU to report every 100ms
-    imu -> enableReport(BNO080::TOTAL_ACCELERATION, 200);
-    imu -> enableReport(BNO080::LINEAR_ACCELERATION, 200);
-    imu -> enableReport(BNO080::GRAVITY_ACCELERATION, 200);
-    imu -> enableReport(BNO080::GYROSCOPE, 200);
-    imu -> enableReport(BNO080::MAG_FIELD, 200);    
-//    imu -> enableReport(BNO080::MAG_FIELD_UNCALIBRATED, 100);    
-//    imu -> enableReport(BNO080::ROTATION, 100);
-//    imu -> enableReport(BNO080::GEOMAGNETIC_ROTATION, 100);    
-//    imu -> enableReport(BNO080::GAME_ROTATION, 100);    
-//    imu -> enableReport(BNO080::TAP_DETECTOR, 100);   
-//    imu -> enableReport(BNO080::STABILITY_CLASSIFIER, 100);    
-//    imu -> enableReport(BNO080::STEP_DETECTOR, 100);    
-//    imu -> enableReport(BNO080::STEP_COUNTER, 100);
-//    imu -> enableReport(BNO080::SIGNIFICANT_MOTION, 100);    
-//    imu -> enableReport(BNO080::SHAKE_DETECTOR, 100);    
+    bool setup = imu.begin();
+    //Tell the IMU which reports to send, and how often
+    for (uint8_t i = 0; i < currentProfile->numReports; i++) {
+        const BNO080ReportConfig& config = currentProfile->reports[i];
+        imu.enableReport(config.report, config.period, config.batchInterval);
+    }
     return setup;
 }
 
+//Turn off what the old profile needed and the new one doesn't, then enable the new reports
+void BNO080Wheelchair::setProfile(const BNO080Profile& profile) {
+    for (uint8_t i = 0; i < currentProfile->numReports; i++) {
+        BNO080::Report report = currentProfile->reports[i].report;
+        if (!profileUses(profile, report)) {
+            imu.disableReport(report);
+        }
+    }
+    for (uint8_t i = 0; i < profile.numReports; i++) {
+        const BNO080ReportConfig& config = profile.reports[i];
+        imu.enableReport(config.report, config.period, config.batchInterval);
+    }
+    currentProfile = &profile;
+    if (resampling) {
+        addResamplerChannels();
+    }
+}
+
+const BNO080Profile& BNO080Wheelchair::profile() {
+    return *currentProfile;
+}
+
+//Without batching every sample arrives in its own packet. With batching the IMU
+//holds samples for up to batchInterval, so one packet carries several of them.
+BNO080BusLoad BNO080Wheelchair::busLoad() {
+    BNO080BusLoad load = {0, 0, 0, 0};
+    for (uint8_t i = 0; i < currentProfile->numReports; i++) {
+        const BNO080ReportConfig& config = currentProfile->reports[i];
+        if (config.period == 0) {
+            continue;
+        }
+        float samples = 1000.0f / config.period;
+        float packets = samples;
+        if (config.batchInterval > config.period) {
+            packets = 1000.0f / config.batchInterval;
+        }
+        load.samplesPerSecond += samples;
+        load.packetsPerSecond += packets;
+        load.bytesPerSecond += samples * BNO080::getReportLength(config.report);
+    }
+    load.bytesPerSecond += load.packetsPerSecond * (PACKET_OVERHEAD + I2C_READ_OVERHEAD);
+    if (i2cFrequency > 0) {
+        load.utilization = load.bytesPerSecond * I2C_BITS_PER_BYTE / i2cFrequency;
+    }
+    return load;
+}
+
+float BNO080Wheelchair::recorderBytesPerSecond() {
+    float bytes = 0;
+    for (uint8_t i = 0; i < currentProfile->numReports; i++) {
+        const BNO080ReportConfig& config = currentProfile->reports[i];
+        if (config.period > 0) {
+            bytes += 1000.0f / config.period * FlightRecorder::recordLength(config.report);
+        }
+    }
+    return bytes;
+}
+
+void BNO080Wheelchair::setBlockLog(BlockLog* log) {
+    blockLog = log;
+}
+
+void BNO080Wheelchair::setLatencyTracer(LatencyTracer* tracer) {
+    latencyTracer = tracer;
+    imu.attachLatencyTracer(tracer);
+}
+
+void BNO080Wheelchair::setRateMonitor(RateMonitor* monitor) {
+    imu.attachRateMonitor(monitor);
+}
+
+void BNO080Wheelchair::traceRead(BNO080::Report report) {
+    if (latencyTracer != NULL) {
+        latencyTracer->sampleConsumed(report, imu.getHostTime());
+    }
+}
+
+void BNO080Wheelchair::enableResampling(uint32_t outputPeriod) {
+    resampler.setOutputPeriod(outputPeriod);
+    addResamplerChannels();
+    resampling = true;
+}
+
+bool BNO080Wheelchair::applyMounting(bool permanent) {
+    MountingResult result;
+    if (!mounting.solve(result)) {
+        return false;
+    }
+    if (permanent) {
+        return imu.setPermanentOrientation(result.orientation);
+    }
+    imu.setSensorOrientation(result.orientation);
+    return true;
+}
+
+//Which reports the resampler can interpolate, and how
+static bool resamplerKind(BNO080::Report report, ReportResampler::Kind& kind) {
+    switch (report) {
+        case BNO080::TOTAL_ACCELERATION:
+        case BNO080::LINEAR_ACCELERATION:
+        case BNO080::GRAVITY_ACCELERATION:
+        case BNO080::GYROSCOPE:
+        case BNO080::MAG_FIELD:
+        case BNO080::MAG_FIELD_UNCALIBRATED:
+            kind = ReportResampler::VECTOR;
+            return true;
+        case BNO080::ROTATION:
+        case BNO080::GAME_ROTATION:
+        case BNO080::GEOMAGNETIC_ROTATION:
+            kind = ReportResampler::QUATERNION;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void BNO080Wheelchair::addResamplerChannels() {
+    resampler.removeAllChannels();
+    for (uint8_t i = 0; i < currentProfile->numReports; i++) {
+        ReportResampler::Kind kind;
+        if (resamplerKind(currentProfile->reports[i].report, kind)) {
+            resampler.addChannel(currentProfile->reports[i].report, kind);
+        }
+    }
+}
+
+void BNO080Wheelchair::onImuSample(const BNO080::SensorSample& sample) {
+    PROFILE_SCOPE(WHEELCHAIR_SAMPLE);
+    BNO080::Report report = sample.report;
+    uint32_t timestamp = sample.timestamp;
+    
+    recorder.add(report, sample.status, timestamp, sample.values, sample.numValues);
+    if (blockLog != NULL) {
+        blockLog->add(report, sample.status, timestamp, sample.values, sample.numValues);
+    }
+    
+    if (mounting.phase() != MountingCalibration::IDLE) {
+        if (report == BNO080::GRAVITY_ACCELERATION) {
+            mounting.addGravity(imu.gravityAcceleration);
+        } else if (report == BNO080::LINEAR_ACCELERATION) {
+            float dt = 0;
+            if (mounting.sampleCount(MountingCalibration::DRIVE) > 0) {
+                dt = (timestamp - lastDriveTime) * 1e-6f;
+            }
+            mounting.addLinearAcceleration(imu.linearAcceleration, dt);
+            lastDriveTime = timestamp;
+        }
+    }
+    
+    if (!resampling) {
+        return;
+    }
+    
+    switch (report) {
+        case BNO080::TOTAL_ACCELERATION:
+            resampler.push(report, timestamp, imu.totalAcceleration);
+            break;
+        case BNO080::LINEAR_ACCELERATION:
+            resampler.push(report, timestamp, imu.linearAcceleration);
+            break;
+        case BNO080::GRAVITY_ACCELERATION:
+            resampler.push(report, timestamp, imu.gravityAcceleration);
+            break;
+        case BNO080::GYROSCOPE:
+            resampler.push(report, timestamp, imu.gyroRotation);
+            break;
+        case BNO080::MAG_FIELD:
+            resampler.push(report, timestamp, imu.magField);
+            break;
+        case BNO080::MAG_FIELD_UNCALIBRATED:
+            resampler.push(report, timestamp, imu.magFieldUncalibrated);
+            break;
+        case BNO080::ROTATION:
+            resampler.push(report, timestamp, imu.rotationVector);
+            break;
+        case BNO080::GAME_ROTATION:
+            resampler.push(report, timestamp, imu.gameRotationVector);
+            break;
+        case BNO080::GEOMAGNETIC_ROTATION:
+            resampler.push(report, timestamp, imu.geomagneticRotationVector);
+            break;
+        default:
+            break;
+    }
+}
+
 bool BNO080Wheelchair::hasNewData(BNO080::Report report) {
-    return imu -> hasNewData(report);
+    return imu.hasNewData(report);
 }
 
 //Get the x component of the angular velocity from IMU. Stores the component
@@ -40,8 +282,9 @@ bool BNO080Wheelchair::hasNewData(BNO080::Report report) {
 //Returns a double, the value of the x-acceleration (m/s^2)
 double BNO080Wheelchair::gyro_x() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> gyroRotation[0];
+    imu.updateData();
+    traceRead(BNO080::GYROSCOPE);
+    return (double)imu.gyroRotation[0];
 }
 
 //Get the y component of the angular velocity from IMU. Stores the component
@@ -49,8 +292,9 @@ double BNO080Wheelchair::gyro_x() {
 //Returns a double, the value of the y-acceleration (m/s^2)
 double BNO080Wheelchair::gyro_y() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> gyroRotation[1];
+    imu.updateData();
+    traceRead(BNO080::GYROSCOPE);
+    return (double)imu.gyroRotation[1];
 }
 
 //Get the z component of the angular velocity from IMU. Stores the component
@@ -58,8 +302,9 @@ double BNO080Wheelchair::gyro_y() {
 //Returns a double, the value of the z-acceleration (m/s^2)
 double BNO080Wheelchair::gyro_z() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> gyroRotation[2];
+    imu.updateData();
+    traceRead(BNO080::GYROSCOPE);
+    return (double)imu.gyroRotation[2];
 }
 
 //Get the x component of the linear acceleration from IMU. Stores the component
@@ -67,8 +312,9 @@ double BNO080Wheelchair::gyro_z() {
 //Returns a double, the value of the x-acceleration (m/s^2)
 double BNO080Wheelchair::accel_x() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> totalAcceleration[0];
+    imu.updateData();
+    traceRead(BNO080::TOTAL_ACCELERATION);
+    return (double)imu.totalAcceleration[0];
 }
 
 //Get the y component of the linear acceleration from IMU. Stores the component
@@ -76,8 +322,9 @@ double BNO080Wheelchair::accel_x() {
 //Returns a double, the value of the y-acceleration (m/s^2)
 double BNO080Wheelchair::accel_y() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> totalAcceleration[1];
+    imu.updateData();
+    traceRead(BNO080::TOTAL_ACCELERATION);
+    return (double)imu.totalAcceleration[1];
 }
 
 //Get the z component of the linear acceleration from IMU. Stores the component
@@ -85,8 +332,9 @@ double BNO080Wheelchair::accel_y() {
 //Returns a double, the value of the z-acceleration (m/s^2)
 double BNO080Wheelchair::accel_z() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> totalAcceleration[2];
+    imu.updateData();
+    traceRead(BNO080::TOTAL_ACCELERATION);
+    return (double)imu.totalAcceleration[2];
 }
 
 //Get yaw
@@ -94,11 +342,11 @@ double BNO080Wheelchair::yaw() {
 
     float gyroZ = .4+(BNO080Wheelchair::gyro_x())*180/3.141593;
     if(abs(gyroZ) >= .5) {
-     //printf("t->read(): %lf, gyroscope %lf, change %lf\r\n", t->read(), gyroZ, t->read()*gyroZ*2.25);
-        total_yaw = total_yaw - t->read()*gyroZ;
+     //printf("t.read(): %lf, gyroscope %lf, change %lf\r\n", t.read(), gyroZ, t.read()*gyroZ*2.25);
+        total_yaw = total_yaw - t.read()*gyroZ;
      //printf("total_yaw: %lf, gyroZ: %f \r\n", total_yaw, gyroZ);
     }
-    t->reset();
+    t.reset();
     if(total_yaw > 360)
         total_yaw -= 360;
     if(total_yaw < 0)
@@ -109,29 +357,33 @@ double BNO080Wheelchair::yaw() {
 //Get x component of magnetic field vector
 double BNO080Wheelchair::mag_x() {
     wait(1);
-    imu -> updateData();
-    return (double)imu -> magField[0];
+    imu.updateData();
+    traceRead(BNO080::MAG_FIELD);
+    return (double)imu.magField[0];
 }
 
 //Get y component of magnetic field vector
 double BNO080Wheelchair::mag_y() {
     wait(1);
-    imu -> updateData();
-    return (double)imu -> magField[1];
+    imu.updateData();
+    traceRead(BNO080::MAG_FIELD);
+    return (double)imu.magField[1];
 }
 
 //Get z component of magnetic field vector
 double BNO080Wheelchair::mag_z() {
     wait(1);
-    imu -> updateData();
-    return (double)imu -> magField[2];
+    imu.updateData();
+    traceRead(BNO080::MAG_FIELD);
+    return (double)imu.magField[2];
 }
 
 //Check if IMU is pointing in one of the 4 cardinal directions (NSWE)
 char BNO080Wheelchair::compass() {
-    imu -> updateData();
-    double x = imu -> magField[0];
-    double y = imu -> magField[1];
+    imu.updateData();
+    traceRead(BNO080::MAG_FIELD);
+    double x = imu.magField[0];
+    double y = imu.magField[1];
     
     if ( (x>10) && (y<-5) && (y>-10) ) {
         return 'N'; //Facing NORTH
@@ -161,38 +413,39 @@ char BNO080Wheelchair::compass() {
 //Get the rotation of the IMU (from magnetic north) in radians
 TVector4 BNO080Wheelchair::rotation() {
     wait(0.05);
-    //printf("Update Data GYRO X: %d \n", imu -> updateData());            // hasNewData()?
-    imu -> updateData();
+    //printf("Update Data GYRO X: %d \n", imu.updateData());            // hasNewData()?
+    imu.updateData();
     //wait(0.05);
-    return imu -> rotationVector.vector();
+    traceRead(BNO080::ROTATION);
+    return imu.rotationVector.vector();
 }
 
 /*
 //Returns Qw component of rotation vector
 double BNO080Wheelchair::rot_w() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> rotationVector[0];
+    imu.updateData();
+    return (double)imu.rotationVector[0];
 }
 
 //Returns Qx component of rotation vector
 double BNO080Wheelchair::rot_x() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> rotationVector[1];
+    imu.updateData();
+    return (double)imu.rotationVector[1];
 }
 
 //Returns Qy component of rotation vector
 double BNO080Wheelchair::rot_y() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> rotationVector[2];
+    imu.updateData();
+    return (double)imu.rotationVector[2];
 }
 
 //Returns Qz component of rotation vector
 double BNO080Wheelchair::rot_z() {
     wait(0.05);
-    imu -> updateData();
-    return (double)imu -> rotationVector[2];
+    imu.updateData();
+    return (double)imu.rotationVector[2];
 }
 */
\ No newline at end of file
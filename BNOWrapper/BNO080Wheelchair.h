@@ -5,6 +5,12 @@
 #include "math.h"
 #include "BNO080.h"
 #include "BNO080Constants.h"
+#include "ReportResampler.h"
+#include "MountingCalibration.h"
+#include "FlightRecorder.h"
+#include "BlockLog.h"
+#include "LatencyTracer.h"
+#include "RateMonitor.h"
 
 #define PI 3.141593
 
@@ -13,20 +19,103 @@
 #define INT_PIN D12        // Change once actually connected
 #define RST_PIN D10        // Change once actually connected
 
-#define SAMPLEFREQ 50
-#define CAL_TIME 3
+//One report that a profile turns on, and how often
+struct BNO080ReportConfig {
+    BNO080::Report report;
+    uint16_t period;            //time between samples, in ms
+    uint16_t batchInterval;     //how long the IMU may hold samples before sending, in ms (0 = no batching)
+};
+
+//A set of reports chosen for one use case of the chair
+struct BNO080Profile {
+    const char* name;
+    const BNO080ReportConfig* reports;
+    uint8_t numReports;
+};
+
+//Estimated traffic that a profile puts on the I2C bus
+struct BNO080BusLoad {
+    float samplesPerSecond;
+    float packetsPerSecond;
+    float bytesPerSecond;       //bytes clocked over I2C, including SHTP headers and addressing
+    float utilization;          //fraction of the bus bit rate, 0 to 1
+};
+
+//The five reports at 200 ms that setup() has always turned on
+extern const BNO080Profile PROFILE_LEGACY;
+
+//Driving indoors: game rotation (motors and steel frames make the magnetometer useless), gyro, linear accel
+extern const BNO080Profile PROFILE_INDOOR_NAVIGATION;
+
+//Driving outdoors: magnetometer-referenced rotation for a true heading, plus gyro and linear accel
+extern const BNO080Profile PROFILE_OUTDOOR;
 
+//Chair is parked: slow, batched gravity and stability reports so tips and bumps are still seen
+extern const BNO080Profile PROFILE_PARKED;
+
+//Recording the maneuvers of a mounting calibration: gravity and linear accel, fast
+extern const BNO080Profile PROFILE_MOUNTING_CALIBRATION;
+
+//Owns its BNO080 by value, so like the driver it uses no dynamic allocation.
+//Declare it as a global or static object and all of its buffers show up in
+//MBed's static RAM size printout.
 class BNO080Wheelchair {
     public:
-        BNO080* imu; //The IMU we're testing from, BNO080
+        BNO080 imu; //The IMU we're testing from, BNO080
+        
+        ReportResampler resampler; //Frames of the profile's reports on one clock, once enableResampling() is called
+        
+        //Works out how the IMU sits on the chair. Call mounting.begin() with each maneuver while
+        //PROFILE_MOUNTING_CALIBRATION is on, and imu.updateData() feeds it the samples.
+        MountingCalibration mounting;
         
-        BNO080Wheelchair(Serial *debugPort, PinName sdaPin, 
+        //The last seconds of every sample the IMU sent, frozen by an impact, a tip or recorder.trigger().
+        //Send it with recorder.dump() once recorder.frozen(), then recorder.rearm().
+        FlightRecorder recorder;
+        
+        BNO080Wheelchair(Stream *debugPort, PinName sdaPin, 
                                  PinName sclPin, PinName intPin, PinName rstPin,
                                  uint8_t i2cAddress, int i2cPortpeed);
       
-        //Set up the IMU, check if it connects
+        //Set up the IMU, check if it connects, and turn on the reports of the current profile
         bool setup();
         
+        //Switch to another set of reports. Reports that the new profile does not use are
+        //turned off, the rest are (re)enabled at the new rates. Does not reset the IMU.
+        void setProfile(const BNO080Profile& profile);
+        
+        //The profile currently applied (PROFILE_LEGACY until setProfile() is called)
+        const BNO080Profile& profile();
+        
+        //Estimate of the I2C traffic that the current profile generates
+        BNO080BusLoad busLoad();
+        
+        //RAM the flight recorder fills per second with the current profile.
+        //FLIGHT_RECORDER_SIZE divided by this is how many seconds it holds.
+        float recorderBytesPerSecond();
+        
+        //Also store every sample in a block log (NULL to stop). The log must be mounted, and its
+        //service() called from a writer thread or the main loop to write the blocks out.
+        void setBlockLog(BlockLog* log);
+        
+        //Put the vector and rotation reports of the profile onto one clock, one frame every
+        //outputPeriod microseconds. Read the frames with resampler.poll() after imu.updateData().
+        //Channels are numbered in profile order, skipping reports that aren't vectors or rotations.
+        void enableResampling(uint32_t outputPeriod);
+        
+        //Trace the latency of every sample through the driver (NULL to stop). The getters below count as
+        //the consumer reading their report: gyro_* and yaw() the gyroscope, accel_* the total acceleration,
+        //mag_* and compass() the magnetic field, rotation() the rotation vector.
+        void setLatencyTracer(LatencyTracer* tracer);
+        
+        //Check that every report of the profile arrives at its period (NULL to stop). Call it before setup(),
+        //so that the monitor sees the periods the profile enables.
+        void setRateMonitor(RateMonitor* monitor);
+        
+        //Solve the mounting calibration and send the orientation to the IMU. If permanent, it is
+        //written to the IMU's flash and survives resets. Returns false if it couldn't be solved or written.
+        bool applyMounting(bool permanent);
+        
         //Checks if IMU has new data
         bool hasNewData(BNO080::Report report);
         
@@ -81,7 +170,29 @@ class BNO080Wheelchair {
         
     private:
 
-        Timer* t;//to calculate the time
+        Timer t;//to calculate the time
+        
+        const BNO080Profile* currentProfile;
+        
+        bool resampling;
+        
+        BlockLog* blockLog;
+        
+        LatencyTracer* latencyTracer;
+        
+        //Timestamp of the last linear acceleration sample, to integrate the calibration drive
+        uint32_t lastDriveTime;
+        
+        //Give the resampler a channel for each report of the current profile it can interpolate
+        void addResamplerChannels();
+        
+        //Tell the latency tracer, if there is one, that the data of a report was just used
+        void traceRead(BNO080::Report report);
+        
+        //Called by the driver with each new sample, feeds it to the recorder, the block log, the mounting calibration and the resampler
+        void onImuSample(const BNO080::SensorSample& sample);
+        
+        int i2cFrequency;
 
 };
 
@@ -0,0 +1,223 @@
+#include "BlockLog.h"
+
+// offset of the CRC within the footer, everything before it is covered
+#define BLOCK_LOG_CRC_OFFSET (BLOCK_LOG_FOOTER_SIZE - 2)
+
+static void put16(uint8_t* p, uint16_t value)
+{
+	p[0] = static_cast<uint8_t>(value);
+	p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t value)
+{
+	put16(p, static_cast<uint16_t>(value));
+	put16(p + 2, static_cast<uint16_t>(value >> 16));
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+	return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+	return get16(p) | static_cast<uint32_t>(get16(p + 2)) << 16;
+}
+
+BlockLog::BlockLog(BlockDevice& device, bd_addr_t start, bd_size_t length) :
+	_device(device),
+	_start(start),
+	_length(length),
+	_numBlocks(0),
+	_active(0),
+	_used(0),
+	_records(0),
+	_firstTimestamp(0),
+	_lastTimestamp(0),
+	_pending(-1),
+	_nextBlock(0),
+	_nextSequence(0),
+	_blocksWritten(0),
+	_samplesLost(0),
+	_writeErrors(0)
+{
+}
+
+bool BlockLog::mount()
+{
+	if(_device.init() != 0) {
+		return false;
+	}
+
+	bd_size_t readSize = _device.get_read_size();
+	if(BLOCK_LOG_BLOCK_SIZE % _device.get_erase_size() != 0 || BLOCK_LOG_BLOCK_SIZE % _device.get_program_size() != 0 ||
+	   BLOCK_LOG_BLOCK_SIZE % readSize != 0 || _start % BLOCK_LOG_BLOCK_SIZE != 0) {
+		return false;
+	}
+
+	bd_size_t length = _length > 0 ? _length : _device.size() - _start;
+	_numBlocks = static_cast<uint32_t>(length / BLOCK_LOG_BLOCK_SIZE);
+	if(_numBlocks < 2) {
+		return false;
+	}
+
+	// only the read-size chunk with the footer is read from each block, the CRC is
+	// left to readBlock().  A torn block still has an erased or older footer.
+	bd_size_t chunk = ((BLOCK_LOG_FOOTER_SIZE + readSize - 1) / readSize) * readSize;
+	uint8_t* footerChunk = _buffers[0] + BLOCK_LOG_BLOCK_SIZE - chunk;
+	bool found = false;
+	uint32_t newest = 0;
+
+	for(uint32_t i = 0; i < _numBlocks; i++) {
+		bd_addr_t address = _start + static_cast<bd_addr_t>(i) * BLOCK_LOG_BLOCK_SIZE + BLOCK_LOG_BLOCK_SIZE - chunk;
+		if(_device.read(footerChunk, address, chunk) != 0) {
+			continue;
+		}
+
+		BlockLogFooter footer;
+		if(parseFooter(_buffers[0], footer) && (!found || static_cast<int32_t>(footer.sequence - newest) > 0)) {
+			found = true;
+			newest = footer.sequence;
+			_nextBlock = (i + 1) % _numBlocks;
+		}
+	}
+	_nextSequence = found ? newest + 1 : 0;
+
+	_active = 0;
+	_used = 0;
+	_records = 0;
+	_pending = -1;
+	return true;
+}
+
+bool BlockLog::add(uint8_t reportID, uint8_t status, uint32_t timestamp, const int16_t* words, uint8_t numWords)
+{
+	const TelemetrySchema* schema = telemetrySchema(reportID);
+	if(schema == NULL || numWords < schema->numWords) {
+		return false;
+	}
+	uint16_t length = static_cast<uint16_t>(TELEMETRY_RECORD_HEADER_SIZE + 2 * schema->numWords);
+
+	if(_used + length > BLOCK_LOG_PAYLOAD_SIZE) {
+		// the other buffer is still being written: the device can't keep up
+		if(_pending >= 0) {
+			_samplesLost++;
+			return false;
+		}
+		seal();
+	}
+
+	uint8_t* record = _buffers[_active] + _used;
+	record[0] = reportID;
+	record[1] = static_cast<uint8_t>((status & 0x3) | schema->numWords << 2 | (schema->version & 0x7) << 5);
+	put32(record + 2, timestamp);
+	for(uint8_t i = 0; i < schema->numWords; i++) {
+		put16(record + TELEMETRY_RECORD_HEADER_SIZE + 2 * i, static_cast<uint16_t>(words[i]));
+	}
+
+	if(_records == 0) {
+		_firstTimestamp = timestamp;
+	}
+	_lastTimestamp = timestamp;
+	_used = static_cast<uint16_t>(_used + length);
+	_records++;
+	return true;
+}
+
+void BlockLog::flush()
+{
+	if(_records > 0 && _pending < 0) {
+		seal();
+	}
+}
+
+void BlockLog::seal()
+{
+	uint8_t* block = _buffers[_active];
+	memset(block + _used, 0xFF, BLOCK_LOG_PAYLOAD_SIZE - _used);
+
+	uint8_t* footer = block + BLOCK_LOG_PAYLOAD_SIZE;
+	put32(footer, BLOCK_LOG_MAGIC);
+	put32(footer + 4, _nextSequence++);
+	put32(footer + 8, _firstTimestamp);
+	put32(footer + 12, _lastTimestamp);
+	put16(footer + 16, _used);
+	put16(footer + 18, _records);
+	footer[20] = BLOCK_LOG_VERSION;
+	footer[21] = 0xFF;
+
+	// the CRC is left to service(), to keep a pass over the whole block out of add().
+	// Hand the block over only once everything else is in it: volatile orders _pending
+	// against other volatiles only, so the barrier keeps the fill and footer ahead of it.
+	__DMB();
+	_pending = static_cast<int8_t>(_active);
+	_active ^= 1;
+	_used = 0;
+	_records = 0;
+}
+
+bool BlockLog::service()
+{
+	int8_t pending = _pending;
+	if(pending < 0) {
+		return false;
+	}
+	// read the block only after seeing it handed over
+	__DMB();
+
+	uint8_t* block = _buffers[pending];
+	put16(block + BLOCK_LOG_PAYLOAD_SIZE + BLOCK_LOG_CRC_OFFSET, telemetryCRC16(block, BLOCK_LOG_PAYLOAD_SIZE + BLOCK_LOG_CRC_OFFSET));
+
+	bd_addr_t address = _start + static_cast<bd_addr_t>(_nextBlock) * BLOCK_LOG_BLOCK_SIZE;
+	if(_device.erase(address, BLOCK_LOG_BLOCK_SIZE) != 0 ||
+	   _device.program(block, address, BLOCK_LOG_BLOCK_SIZE) != 0) {
+		// the block is lost, but the log goes on at the next one
+		_writeErrors++;
+	} else {
+		_blocksWritten++;
+	}
+
+	_nextBlock = (_nextBlock + 1) % _numBlocks;
+
+	// and give it back only once done with it, as add() fills it next
+	__DMB();
+	_pending = -1;
+	return true;
+}
+
+bool BlockLog::parseFooter(const uint8_t* block, BlockLogFooter& footer)
+{
+	const uint8_t* p = block + BLOCK_LOG_PAYLOAD_SIZE;
+	if(get32(p) != BLOCK_LOG_MAGIC || p[20] != BLOCK_LOG_VERSION) {
+		return false;
+	}
+
+	footer.sequence = get32(p + 4);
+	footer.firstTimestamp = get32(p + 8);
+	footer.lastTimestamp = get32(p + 12);
+	footer.payloadLength = get16(p + 16);
+	footer.records = get16(p + 18);
+	footer.version = p[20];
+	return footer.payloadLength <= BLOCK_LOG_PAYLOAD_SIZE;
+}
+
+bool BlockLog::readBlock(uint32_t index, uint8_t* buffer, BlockLogFooter& footer)
+{
+	if(index >= _numBlocks) {
+		return false;
+	}
+
+	bd_addr_t address = _start + static_cast<bd_addr_t>(index) * BLOCK_LOG_BLOCK_SIZE;
+	return _device.read(buffer, address, BLOCK_LOG_BLOCK_SIZE) == 0 && checkBlock(buffer, footer);
+}
+
+bool BlockLog::checkBlock(const uint8_t* block, BlockLogFooter& footer)
+{
+	if(!parseFooter(block, footer)) {
+		return false;
+	}
+
+	uint16_t crc = get16(block + BLOCK_LOG_PAYLOAD_SIZE + BLOCK_LOG_CRC_OFFSET);
+	return telemetryCRC16(block, BLOCK_LOG_PAYLOAD_SIZE + BLOCK_LOG_CRC_OFFSET) == crc;
+}
@@ -0,0 +1,189 @@
+#ifndef BLOCK_LOG_H
+#define BLOCK_LOG_H
+
+/**
+ * @file BlockLog.h
+ *
+ * @brief Long recordings of IMU samples on a block device (SD card or SPI flash).
+ *
+ * Samples are stored as the raw telemetry records of Telemetry.h, packed into
+ * buffers of exactly one log block.  A full buffer is written with one erase and
+ * one program of the whole block, so the device only ever sees aligned block
+ * writes: that is what keeps SD cards fast and flash from wearing out, where
+ * printf to a file writes a few bytes at a time.
+ *
+ * There are two buffers.  While one is waiting to be written (service()), add()
+ * fills the other, so writing overlaps acquisition.  If the device is so slow
+ * that both are full, new samples are dropped and counted in samplesLost().
+ *
+ * Every block ends with a footer holding a sequence number and a CRC of the whole
+ * block.  A block torn by a reset or power loss fails its CRC, so a reader keeps
+ * every block that was completely written and ignores the rest.  The log is a
+ * ring over its region of the device; mount() finds the newest block and carries
+ * on after it, overwriting the oldest.
+ *
+ * add() and service() may run in different threads, e.g. service() in a low
+ * priority writer thread woken whenever blockReady() is true:
+ *
+ * @code
+ * while (true) {
+ *     if (!log.service()) {
+ *         ThisThread::sleep_for(5);
+ *     }
+ * }
+ * @endcode
+ *
+ * host/blocklog_sim.cpp runs it against simulated SD cards and flash chips, and
+ * host/log_export turns an image of the device into columnar files or CSV.
+ */
+
+#include <mbed.h>
+#include "BlockDevice.h"
+
+#include "Telemetry.h"
+
+/// Bytes per log block.  Must be a multiple of the device's erase and program sizes.
+#ifndef BLOCK_LOG_BLOCK_SIZE
+#define BLOCK_LOG_BLOCK_SIZE 4096
+#endif
+
+/// Bytes of the footer at the end of every block
+#define BLOCK_LOG_FOOTER_SIZE 24
+
+/// Bytes of records a block holds
+#define BLOCK_LOG_PAYLOAD_SIZE (BLOCK_LOG_BLOCK_SIZE - BLOCK_LOG_FOOTER_SIZE)
+
+/// First bytes of a footer, "BLOG" in little endian
+#define BLOCK_LOG_MAGIC 0x474F4C42
+
+/// Version of the block layout.  Bump when the footer or record format changes.
+#define BLOCK_LOG_VERSION 1
+
+static_assert(BLOCK_LOG_PAYLOAD_SIZE >= TELEMETRY_RECORD_HEADER_SIZE + 2 * TELEMETRY_MAX_WORDS,
+			  "a block must hold the largest record");
+
+/**
+ * @brief Footer of a log block.
+ *
+ * Stored little endian at the end of the block:
+ * magic, sequence, first timestamp, last timestamp (4 bytes each), payload
+ * length, record count (2 bytes each), version, reserved (1 byte each), then a
+ * CRC-16/CCITT-FALSE of the payload and the footer before it (2 bytes).
+ */
+struct BlockLogFooter {
+	uint32_t sequence;
+	uint32_t firstTimestamp;
+	uint32_t lastTimestamp;
+	uint16_t payloadLength;
+	uint16_t records;
+	uint8_t version;
+};
+
+class BlockLog {
+public:
+
+	/**
+	 * @param start Address of the log's region, a multiple of BLOCK_LOG_BLOCK_SIZE.
+	 * @param length Bytes of the region, or 0 for the rest of the device.
+	 */
+	BlockLog(BlockDevice& device, bd_addr_t start = 0, bd_size_t length = 0);
+
+	/**
+	 * Initializes the device and finds where the log left off.  Must be called
+	 * before anything else.
+	 *
+	 * @return false if the device failed, its erase or program size doesn't divide
+	 * BLOCK_LOG_BLOCK_SIZE, or the region has fewer than 2 blocks.
+	 */
+	bool mount();
+
+	/**
+	 * Adds a sample to the current buffer.  O(1) and never touches the device.
+	 *
+	 * @param words Raw words of the sample.  Only as many as the report's telemetry schema has are stored.
+	 * @return false if the sample was dropped: both buffers full, or no schema for the report.
+	 */
+	bool add(uint8_t reportID, uint8_t status, uint32_t timestamp, const int16_t* words, uint8_t numWords);
+
+	/**
+	 * Closes the current buffer even though it isn't full, so the next service() writes it.
+	 * Call before powering down.  Does nothing if the buffer is empty or the other is still waiting.
+	 */
+	void flush();
+
+	/// Whether a full buffer is waiting for service()
+	bool blockReady() const { return _pending >= 0; }
+
+	/**
+	 * Writes the waiting buffer to the device, if there is one.
+	 *
+	 * @return true if a block was written (or failed to write, see writeErrors()).
+	 */
+	bool service();
+
+	/**
+	 * Reads and checks one block of the log.
+	 *
+	 * @param index Block number within the region.
+	 * @param buffer Receives the block, BLOCK_LOG_BLOCK_SIZE bytes.
+	 * @return false if the block couldn't be read, or has no valid footer (never written, or torn).
+	 */
+	bool readBlock(uint32_t index, uint8_t* buffer, BlockLogFooter& footer);
+
+	/**
+	 * Decodes the footer at the end of a block.  Doesn't check the CRC.
+	 *
+	 * @return false if there is no footer of this version.
+	 */
+	static bool parseFooter(const uint8_t* block, BlockLogFooter& footer);
+
+	/**
+	 * Decodes the footer and checks the CRC of a whole block, e.g. in a memory mapped image of the device.
+	 *
+	 * @return false if the block has no valid footer (never written, or torn).
+	 */
+	static bool checkBlock(const uint8_t* block, BlockLogFooter& footer);
+
+	/// Blocks in the log's region
+	uint32_t numBlocks() const { return _numBlocks; }
+
+	/// Region index of the block the next service() writes to
+	uint32_t nextBlock() const { return _nextBlock; }
+
+	/// Sequence number the next block gets
+	uint32_t nextSequence() const { return _nextSequence; }
+
+	uint32_t blocksWritten() const { return _blocksWritten; }
+	uint32_t samplesLost() const { return _samplesLost; }
+	uint32_t writeErrors() const { return _writeErrors; }
+
+private:
+	BlockDevice& _device;
+	bd_addr_t _start;
+	bd_size_t _length;
+	uint32_t _numBlocks;
+
+	uint8_t _buffers[2][BLOCK_LOG_BLOCK_SIZE];
+
+	/// Buffer add() writes to, and bytes and records in it
+	uint8_t _active;
+	uint16_t _used;
+	uint16_t _records;
+	uint32_t _firstTimestamp;
+	uint32_t _lastTimestamp;
+
+	/// Buffer waiting for service(), or -1.  Set by add(), cleared by service(), each behind a __DMB().
+	volatile int8_t _pending;
+
+	uint32_t _nextBlock;
+	uint32_t _nextSequence;
+
+	uint32_t _blocksWritten;
+	uint32_t _samplesLost;
+	uint32_t _writeErrors;
+
+	/// Writes the footer into the active buffer and hands it to service()
+	void seal();
+};
+
+#endif /* BLOCK_LOG_H */
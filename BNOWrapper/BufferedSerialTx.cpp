@@ -0,0 +1,45 @@
+#include "BufferedSerialTx.h"
+
+BufferedSerialTx::BufferedSerialTx(PinName tx, PinName rx, int baud) :
+	_serial(tx, rx, baud),
+	_transmitting(false)
+{
+}
+
+int BufferedSerialTx::_putc(int c)
+{
+	_ring.put(static_cast<uint8_t>(c));
+
+	// the byte is in the ring before the flag is read, so either the interrupt is
+	// still running and will send it, or it has stopped and is started again here
+	if(!_transmitting) {
+		_transmitting = true;
+		_serial.attach(callback(this, &BufferedSerialTx::onTxReady), SerialBase::TxIrq);
+	}
+	return c;
+}
+
+int BufferedSerialTx::_getc()
+{
+	return _serial.getc();
+}
+
+void BufferedSerialTx::onTxReady()
+{
+	uint8_t byte;
+	while(_serial.writeable()) {
+		if(!_ring.get(byte)) {
+			// nothing left: stop the interrupt, or it fires for as long as the UART is empty
+			_serial.attach(Callback<void()>(), SerialBase::TxIrq);
+			_transmitting = false;
+			return;
+		}
+		_serial.putc(byte);
+	}
+}
+
+void BufferedSerialTx::drain()
+{
+	while(_transmitting) {
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef BUFFERED_SERIAL_TX_H
+#define BUFFERED_SERIAL_TX_H
+
+/**
+ * @file BufferedSerialTx.h
+ *
+ * @brief Serial port whose output never blocks the caller.
+ *
+ * mbed's Serial waits in putc() until the UART takes each byte, so a 40 byte
+ * printf at 57600 baud holds the caller for 7 ms.  BufferedSerialTx copies output
+ * into a TxRing and returns; the UART's TX interrupt sends it from there.
+ *
+ * If output is produced faster than the link sends it, the oldest unsent bytes
+ * are dropped and counted (see droppedBytes()), rather than the writer waiting.
+ * Binary telemetry recovers from that at the next frame; text may show a cut line.
+ *
+ * Input is not buffered: getc() reads straight from the UART and blocks.
+ */
+
+#include <mbed.h>
+
+#include "TxRing.h"
+
+class BufferedSerialTx : public Stream {
+public:
+
+	BufferedSerialTx(PinName tx, PinName rx, int baud);
+
+	void baud(int baudRate) { _serial.baud(baudRate); }
+
+	/// Bytes waiting to be sent
+	size_t pending() const { return _ring.used(); }
+
+	/// Bytes dropped because the ring was full
+	uint32_t droppedBytes() const { return _ring.droppedBytes(); }
+
+	/// Most bytes that were ever waiting at once.  If it is near TX_RING_SIZE, the ring is too small.
+	size_t highWater() const { return _ring.highWater(); }
+
+	/**
+	 * Waits until everything written has been handed to the UART, e.g. before a reset.
+	 */
+	void drain();
+
+protected:
+	virtual int _putc(int c);
+	virtual int _getc();
+
+private:
+	RawSerial _serial;
+	TxRing _ring;
+
+	/// Whether the TX interrupt is attached.  Cleared by the interrupt once the ring is empty.
+	volatile bool _transmitting;
+
+	/// TX interrupt: refills the UART from the ring
+	void onTxReady();
+};
+
+#endif /* BUFFERED_SERIAL_TX_H */
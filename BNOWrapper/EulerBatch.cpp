@@ -0,0 +1,25 @@
+#include "EulerBatch.h"
+
+void quaternionsToEuler(const float* x, const float* y, const float* z, const float* w,
+                        float* roll, float* pitch, float* yaw, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        const float qx = x[i], qy = y[i], qz = z[i], qw = w[i];
+        const float sqx = qx*qx, sqy = qy*qy, sqz = qz*qz, sqw = qw*qw;
+
+        const float sinPitch = 2.0f * (qw*qy - qx*qz);
+        pitch[i] = fastAsin(sinPitch);
+
+        if (fabsf(sinPitch) < EULER_GIMBAL_LOCK_SIN_THRESHOLD) {
+            yaw[i] = fastAtan2(2.0f * (qx*qy + qw*qz), sqx - sqy - sqz + sqw);
+            roll[i] = fastAtan2(2.0f * (qw*qx + qy*qz), sqw - sqx - sqy + sqz);
+        } else {
+            // compute heading from local 'down' vector
+            float heading = fastAtan2(2.0f * (qy*qz - qx*qw), 2.0f * (qx*qz + qy*qw));
+
+            // If facing down, reverse yaw
+            yaw[i] = sinPitch < 0 ? FAST_MATH_PI - heading : heading;
+            roll[i] = 0.0f;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef EULER_BATCH_H
+#define EULER_BATCH_H
+
+/**
+ * @file EulerBatch.h
+ *
+ * @brief Converts many quaternions to Euler angles in one pass.
+ *
+ * Quaternion::euler() calls libm's asin and atan2 three times per sample, which
+ * dominates logging and telemetry of long quaternion streams.  quaternionsToEuler()
+ * takes the quaternions as separate component arrays (structure of arrays) and uses
+ * the approximations in FastMath.h, so its results are within EULER_BATCH_MAX_ERROR
+ * of Quaternion::euler() away from the +-90 degree pitch singularity.
+ */
+
+#include <stddef.h>
+
+#include "FastMath.h"
+
+/// How close |sin(pitch)| has to get to 1 before the roll/yaw split is treated as undefined.
+/// 1e-6 is about the smallest margin that float resolves near 1, and corresponds to a
+/// pitch within about 0.08 degrees of +-90.
+#define EULER_GIMBAL_LOCK_SIN_THRESHOLD (1.0f - 1e-6f)
+
+/// Maximum difference, in radians, between quaternionsToEuler() and the exact angles.
+#define EULER_BATCH_MAX_ERROR FAST_ATAN_MAX_ERROR
+
+/**
+ * @brief Converts n unit quaternions to roll, pitch and yaw in radians.
+ *
+ * Angles follow Quaternion::euler(): roll about X, pitch about Y, yaw about Z,
+ * including its handling of the pitch singularity (roll is set to 0 and the
+ * heading is taken from the down vector).
+ *
+ * @param x,y,z,w Quaternion components, n of each.
+ * @param roll,pitch,yaw Output arrays, n of each.  May not alias the inputs.
+ * @param n Number of quaternions.
+ */
+void quaternionsToEuler(const float* x, const float* y, const float* z, const float* w,
+						float* roll, float* pitch, float* yaw, size_t n);
+
+#endif /* EULER_BATCH_H */
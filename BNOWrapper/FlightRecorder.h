@@ -0,0 +1,152 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+/**
+ * @file FlightRecorder.h
+ *
+ * @brief Keeps the last few seconds of full rate IMU samples in RAM, and freezes them when something goes wrong.
+ *
+ * Every sample is stored raw, as the telemetry record of Telemetry.h (6 bytes of
+ * header plus the report's words), in one byte ring.  When the ring is full the
+ * oldest records are dropped, so adding a sample is O(1).
+ *
+ * A trigger stops the recording, after a configurable post-trigger time so the
+ * moments after the event are kept too.  Triggers are:
+ *
+ *  - IMPACT:   an accelerometer or linear acceleration sample above a magnitude threshold.
+ *  - TIP:      a gravity sample further than an angle from the chassis z axis.  Assumes
+ *              the mounting is applied (see MountingCalibration), so z is up.
+ *  - WATCHDOG: raised by the application when the loop misses its watchdog deadline,
+ *              e.g. from a Ticker.  The STM32 independent watchdog has no early warning
+ *              interrupt, so the recorder can't see the reset coming on its own.
+ *  - FAULT:    raised by the application, e.g. when the IMU resets or stops answering.
+ *  - MANUAL:   raised by the application, e.g. from a button.
+ *
+ * Once frozen, dump() sends the recording as telemetry frames (decode with
+ * host/telemetry_decode), and readRecord() walks it for writing elsewhere, like flash.
+ *
+ * RAM cost is the record size times the sample rate of each report.  For the
+ * wheelchair profiles (BNO080Wheelchair::recorderBytesPerSecond()):
+ *
+ *     legacy   300 B/s   the default FLIGHT_RECORDER_SIZE holds 54 s
+ *     indoor  1540 B/s   10.6 s
+ *     outdoor 1760 B/s   9.3 s
+ */
+
+#include <mbed.h>
+
+#include "Telemetry.h"
+
+/// Bytes of samples kept.  Must be a power of two.
+#ifndef FLIGHT_RECORDER_SIZE
+#define FLIGHT_RECORDER_SIZE 16384
+#endif
+
+static_assert(FLIGHT_RECORDER_SIZE > 0 && (FLIGHT_RECORDER_SIZE & (FLIGHT_RECORDER_SIZE - 1)) == 0,
+			  "FLIGHT_RECORDER_SIZE must be a power of two");
+
+class FlightRecorder {
+public:
+
+	/// What stopped the recording.  Several can be set at once.
+	enum Trigger {
+		TRIGGER_IMPACT = 1,
+		TRIGGER_TIP = 2,
+		TRIGGER_WATCHDOG = 4,
+		TRIGGER_FAULT = 8,
+		TRIGGER_MANUAL = 16,
+		TRIGGER_ALL = 31
+	};
+
+	FlightRecorder();
+
+	/**
+	 * Stores a sample, or does nothing once frozen.  Checks the IMPACT and TIP triggers.
+	 *
+	 * @param words Raw words of the sample.  Only as many as the report's telemetry schema has are kept.
+	 * @return false if frozen, or the report has no telemetry schema.
+	 */
+	bool add(uint8_t reportID, uint8_t status, uint32_t timestamp, const int16_t* words, uint8_t numWords);
+
+	/**
+	 * Raises a trigger.  Can be called from an interrupt.  Ignored if the trigger is not enabled.
+	 *
+	 * @param timestamp Time of the event, on the clock of the samples (BNO080::getHostTime()).
+	 */
+	void trigger(Trigger cause, uint32_t timestamp);
+
+	/// Triggers that stop the recording, as a mask of Trigger.  All by default.
+	void setTriggers(uint8_t mask) { _enabledTriggers = mask; }
+
+	/// Acceleration magnitude in m/s^2 that counts as an impact.  3 g by default.
+	void setImpactThreshold(float threshold);
+
+	/// Angle from vertical in radians that counts as tipping.  30 degrees by default.
+	void setTipAngle(float angle);
+
+	/// Time in microseconds to keep recording after a trigger.  1 s by default.
+	void setPostTriggerTime(uint32_t time) { _postTriggerTime = time; }
+
+	/// Whether the recording has stopped
+	bool frozen() const { return _frozen; }
+
+	/// Triggers raised since the last rearm(), as a mask of Trigger
+	uint8_t triggerCause() const { return _cause; }
+
+	/// Time of the first trigger since the last rearm()
+	uint32_t triggerTime() const { return _triggerTime; }
+
+	/**
+	 * Discards the recording and starts recording again.
+	 */
+	void rearm();
+
+	/// Bytes in use
+	size_t used() const { return static_cast<size_t>(_head - _tail); }
+
+	/**
+	 * Reads the recording, oldest record first.  Start with cursor at 0.
+	 * Don't call add() between reads unless frozen.
+	 *
+	 * @return false at the end of the recording.
+	 */
+	bool readRecord(size_t& cursor, TelemetryRecord& record) const;
+
+	/**
+	 * Sends the trigger and then the whole recording as telemetry frames, and flushes.
+	 *
+	 * @return Number of records sent.
+	 */
+	uint32_t dump(TelemetryEncoder& encoder) const;
+
+	/**
+	 * @return Bytes one sample of a report takes, or 0 if the report has no telemetry schema.
+	 */
+	static size_t recordLength(uint8_t reportID);
+
+private:
+	uint8_t _buffer[FLIGHT_RECORDER_SIZE];
+
+	/// Free running byte offsets of the next record and the oldest record
+	uint32_t _head;
+	uint32_t _tail;
+
+	uint8_t _enabledTriggers;
+	volatile uint8_t _cause;
+	volatile uint32_t _triggerTime;
+	volatile bool _frozen;
+	uint32_t _postTriggerTime;
+
+	/// Squared impact threshold, in raw accelerometer units
+	uint32_t _impactThreshold2;
+
+	/// Squared cosine of the tip angle
+	float _tipCos2;
+
+	uint8_t byteAt(uint32_t offset) const { return _buffer[offset & (FLIGHT_RECORDER_SIZE - 1)]; }
+
+	/// Checks a sample against the IMPACT and TIP thresholds
+	void checkTriggers(uint8_t reportID, uint32_t timestamp, const int16_t* words);
+};
+
+#endif /* FLIGHT_RECORDER_H */
@@ -0,0 +1,192 @@
+#include "LatencyTracer.h"
+#include "Telemetry.h"
+
+#define LATENCY_LABEL_ENTRY(name, label) label,
+
+static const char* const stageNames[] = {
+	LATENCY_STAGES(LATENCY_LABEL_ENTRY)
+};
+
+static_assert(LATENCY_TRACE_BUCKETS <= PROFILE_BUCKETS, "the histograms use Profile.h's bucket numbering");
+
+LatencyTracer::LatencyTracer()
+{
+	reset();
+}
+
+void LatencyTracer::reset()
+{
+	_slots.clear();
+}
+
+void LatencyTracer::record(Histogram& histogram, uint32_t from, uint32_t to)
+{
+	// the clock wraps, and a sensor timestamp can come out a little after its interrupt
+	int32_t difference = static_cast<int32_t>(to - from);
+	uint32_t us = difference > 0 ? static_cast<uint32_t>(difference) : 0;
+
+	uint8_t bucket = profileBucket(us);
+	if(bucket >= LATENCY_TRACE_BUCKETS) {
+		bucket = LATENCY_TRACE_BUCKETS - 1;
+	}
+	if(histogram.buckets[bucket] == UINT16_MAX) {
+		for(uint8_t i = 0; i < LATENCY_TRACE_BUCKETS; i++) {
+			histogram.buckets[i] /= 2;
+		}
+	}
+	histogram.buckets[bucket]++;
+
+	histogram.count++;
+	if(us > histogram.max) {
+		histogram.max = us;
+	}
+}
+
+void LatencyTracer::sampleDecoded(uint8_t report, uint32_t sensorTime, uint32_t interruptTime, uint32_t readTime,
+								  uint32_t decodeTime)
+{
+	Slot* slot = _slots.addSample(report);
+	if(slot == NULL) {
+		return;
+	}
+
+	if(slot->published && !slot->consumed) {
+		slot->unread++;
+	}
+
+	record(slot->stages[LATENCY_STAGE_INTERRUPT], sensorTime, interruptTime);
+	record(slot->stages[LATENCY_STAGE_READ], interruptTime, readTime);
+	record(slot->stages[LATENCY_STAGE_DECODE], readTime, decodeTime);
+
+	slot->sensorTime = sensorTime;
+	slot->decodeTime = decodeTime;
+	slot->published = false;
+	slot->consumed = false;
+}
+
+void LatencyTracer::samplePublished(uint8_t report, uint32_t time)
+{
+	Slot* slot = _slots.find(report);
+	if(slot == NULL || slot->published) {
+		return;
+	}
+
+	record(slot->stages[LATENCY_STAGE_PUBLISH], slot->decodeTime, time);
+	slot->publishTime = time;
+	slot->published = true;
+}
+
+void LatencyTracer::sampleConsumed(uint8_t report, uint32_t time)
+{
+	Slot* slot = _slots.find(report);
+	if(slot == NULL || !slot->published) {
+		return;
+	}
+
+	record(slot->stages[LATENCY_STAGE_AGE], slot->sensorTime, time);
+	if(!slot->consumed) {
+		record(slot->stages[LATENCY_STAGE_CONSUME], slot->publishTime, time);
+		slot->consumed = true;
+	}
+}
+
+bool LatencyTracer::stats(uint8_t report, uint8_t stage, LatencyStats& stats) const
+{
+	const Slot* slot = _slots.find(report);
+	if(slot == NULL || stage >= LATENCY_STAGE_COUNT || slot->stages[stage].count == 0) {
+		return false;
+	}
+	const Histogram& histogram = slot->stages[stage];
+
+	// after a halving the buckets hold fewer samples than the count
+	uint32_t total = 0;
+	for(uint8_t bucket = 0; bucket < LATENCY_TRACE_BUCKETS; bucket++) {
+		total += histogram.buckets[bucket];
+	}
+
+	// the first buckets by which half and 99% of the samples are in
+	uint32_t halfTarget = total - total / 2;
+	uint32_t p99Target = total - total / 100;
+	uint32_t seen = 0;
+	stats.p50 = histogram.max;
+	stats.p99 = histogram.max;
+	bool haveP50 = false;
+	for(uint8_t bucket = 0; bucket < LATENCY_TRACE_BUCKETS; bucket++) {
+		seen += histogram.buckets[bucket];
+		uint32_t top = profileBucketTop(bucket);
+		if(top > histogram.max) {
+			top = histogram.max;
+		}
+		if(!haveP50 && seen >= halfTarget) {
+			stats.p50 = top;
+			haveP50 = true;
+		}
+		if(seen >= p99Target) {
+			stats.p99 = top;
+			break;
+		}
+	}
+
+	stats.count = histogram.count;
+	stats.max = histogram.max;
+	return true;
+}
+
+uint32_t LatencyTracer::unreadSamples(uint8_t report) const
+{
+	const Slot* slot = _slots.find(report);
+	return slot != NULL ? slot->unread : 0;
+}
+
+const char* LatencyTracer::stageName(uint8_t stage)
+{
+	return stage < LATENCY_STAGE_COUNT ? stageNames[stage] : "?";
+}
+
+void LatencyTracer::send(TelemetryEncoder& encoder, uint32_t timestamp) const
+{
+	LatencyStats latency;
+	for(uint8_t i = 0; i < _slots.size(); i++) {
+		for(uint8_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+			if(!stats(_slots[i].report, stage, latency)) {
+				continue;
+			}
+
+			int16_t words[7] = {
+				static_cast<int16_t>(_slots[i].report),
+				static_cast<int16_t>(stage),
+				static_cast<int16_t>(latency.count),
+				static_cast<int16_t>(latency.count >> 16),
+				static_cast<int16_t>(profileEncodeTime(latency.p50)),
+				static_cast<int16_t>(profileEncodeTime(latency.p99)),
+				static_cast<int16_t>(profileEncodeTime(latency.max))
+			};
+			encoder.add(TELEMETRY_REPORTID_LATENCY, 0, timestamp, words, 7);
+		}
+	}
+}
+
+void LatencyTracer::print(Stream& out) const
+{
+	LatencyStats latency;
+	out.printf("%-22s %-20s %10s %10s %10s %10s\n", "# report", "stage (us)", "count", "p50", "p99", "max");
+	for(uint8_t i = 0; i < _slots.size(); i++) {
+		for(uint8_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+			if(!stats(_slots[i].report, stage, latency)) {
+				continue;
+			}
+			_slots.printName(out, _slots[i].report, 22);
+			out.printf(" %-20s %10u %10u %10u %10u\n", stageNames[stage], static_cast<unsigned>(latency.count),
+					   static_cast<unsigned>(latency.p50), static_cast<unsigned>(latency.p99),
+					   static_cast<unsigned>(latency.max));
+		}
+		if(_slots[i].unread > 0) {
+			out.printf("# ");
+			_slots.printName(out, _slots[i].report, 0);
+			out.printf(": %u samples replaced before they were read\n", static_cast<unsigned>(_slots[i].unread));
+		}
+	}
+	if(_slots.untracked() > 0) {
+		out.printf("# %u samples of untraced reports\n", static_cast<unsigned>(_slots.untracked()));
+	}
+}
@@ -0,0 +1,154 @@
+#ifndef LATENCY_TRACER_H
+#define LATENCY_TRACER_H
+
+/**
+ * @file LatencyTracer.h
+ *
+ * @brief How stale the IMU's data is by the time it is used, stage by stage.
+ *
+ * Each sample is followed from the time the sensor took it to the time a
+ * consumer reads it:
+ *
+ *     sensor timestamp -> HINTN edge -> I2C read complete -> decoded -> published -> consumer read
+ *
+ * and each step goes into a histogram per report, as does the whole age at
+ * every consumer read.  The driver stamps the first four, all on its host clock
+ * (getHostTime()): the sensor timestamp is its usual estimate, and the HINTN
+ * edge is the timer captured by the interrupt pin's ISR.  A sample is published
+ * once the sample callback has handled it, and read when the consumer says so:
+ *
+ *     LatencyTracer tracer;
+ *     imu.attachLatencyTracer(&tracer);
+ *     ...
+ *     float heading = imu.rotationVector...;
+ *     tracer.sampleConsumed(BNO080::ROTATION, imu.getHostTime());
+ *
+ * BNO080Wheelchair does the last part in its getters, see setLatencyTracer().
+ *
+ * The histograms have the log-linear buckets of Profile.h, in us, so
+ * percentiles are within 25%.  Nothing is timed unless a tracer is attached.
+ */
+
+#include <mbed.h>
+#include "Profile.h"
+#include "ReportSlots.h"
+
+/// Reports traced, in the order their first sample arrives.  Samples of further reports are only counted.
+#ifndef LATENCY_TRACE_REPORTS
+#define LATENCY_TRACE_REPORTS 4
+#endif
+
+/// Doublings the histograms cover, up to about 2^(LATENCY_TRACE_OCTAVES + 1) us (longer ones go in the last bucket)
+#define LATENCY_TRACE_OCTAVES 20
+
+#define LATENCY_TRACE_BUCKETS (LATENCY_TRACE_OCTAVES * PROFILE_SUB_BUCKETS)
+
+/**
+ * Every traced stage: X(name, label).  Add new stages at the end, so the IDs of
+ * captured telemetry stay valid.
+ */
+#define LATENCY_STAGES(X) \
+	X(INTERRUPT, "sensor to HINTN") \
+	X(READ,      "HINTN to I2C read") \
+	X(DECODE,    "I2C read to decode") \
+	X(PUBLISH,   "decode to publish") \
+	X(CONSUME,   "publish to read") \
+	X(AGE,       "sensor to read")
+
+#define LATENCY_STAGE_ENTRY(name, label) LATENCY_STAGE_##name,
+
+enum LatencyStage {
+	LATENCY_STAGES(LATENCY_STAGE_ENTRY)
+	LATENCY_STAGE_COUNT
+};
+
+#undef LATENCY_STAGE_ENTRY
+
+/**
+ * @brief Summary of one stage of one report, in us.
+ */
+struct LatencyStats {
+	uint32_t count;
+	uint32_t p50;		///< upper edge of the bucket holding the median, at most max
+	uint32_t p99;		///< upper edge of the bucket holding the 99th percentile, at most max
+	uint32_t max;
+};
+
+class TelemetryEncoder;
+
+class LatencyTracer {
+public:
+
+	LatencyTracer();
+
+	/**
+	 * Called by the driver when it has decoded a sample.  All times in us on the driver's host clock.
+	 *
+	 * @param sensorTime The sample's timestamp
+	 * @param interruptTime The HINTN edge of the packet it came in
+	 * @param readTime When the I2C read of the packet completed
+	 * @param decodeTime Now
+	 */
+	void sampleDecoded(uint8_t report, uint32_t sensorTime, uint32_t interruptTime, uint32_t readTime, uint32_t decodeTime);
+
+	/// Called by the driver once the sample callback has handled the latest sample
+	void samplePublished(uint8_t report, uint32_t time);
+
+	/**
+	 * Call when the consumer uses a report's data.  Every call adds the age of the
+	 * latest sample; the first one after a new sample also adds its publish to read time.
+	 */
+	void sampleConsumed(uint8_t report, uint32_t time);
+
+	/**
+	 * @return false if the report isn't traced or the stage has no samples yet.
+	 */
+	bool stats(uint8_t report, uint8_t stage, LatencyStats& stats) const;
+
+	/// Samples that a newer one replaced before the consumer read them
+	uint32_t unreadSamples(uint8_t report) const;
+
+	/// Samples of reports beyond the first LATENCY_TRACE_REPORTS
+	uint32_t untrackedSamples() const { return _slots.untracked(); }
+
+	/// Forgets all reports and samples
+	void reset();
+
+	/// Label of a stage, e.g. "HINTN to I2C read", or "?" if the ID is unknown
+	static const char* stageName(uint8_t stage);
+
+	/**
+	 * Sends a TELEMETRY_REPORTID_LATENCY record for each stage of each report with samples.
+	 * Does not flush the encoder.
+	 */
+	void send(TelemetryEncoder& encoder, uint32_t timestamp) const;
+
+	/// Prints a table of the stages of each report
+	void print(Stream& out) const;
+
+private:
+
+	struct Histogram {
+		uint32_t count;
+		uint32_t max;
+		/// halved together when one fills up, so the percentiles stay right
+		uint16_t buckets[LATENCY_TRACE_BUCKETS];
+	};
+
+	struct Slot {
+		uint8_t report;
+		bool published;
+		bool consumed;
+		uint32_t sensorTime;
+		uint32_t decodeTime;
+		uint32_t publishTime;
+		uint32_t unread;
+		Histogram stages[LATENCY_STAGE_COUNT];
+	};
+
+	ReportSlots<Slot, LATENCY_TRACE_REPORTS> _slots;
+
+	static void record(Histogram& histogram, uint32_t from, uint32_t to);
+};
+
+#endif /* LATENCY_TRACER_H */
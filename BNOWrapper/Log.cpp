@@ -0,0 +1,233 @@
+#include "Log.h"
+#include "Telemetry.h"
+
+#define LOG_TABLE_ENTRY(name, level, format) {level, format},
+
+static const struct {
+	uint8_t level;
+	const char* format;
+} messages[] = {
+	LOG_MESSAGES(LOG_TABLE_ENTRY)
+};
+
+static_assert(2 * LOG_MAX_ARGS + 1 <= TELEMETRY_MAX_WORDS, "an entry must fit in one telemetry record");
+
+static LogEntry ring[LOG_RING_ENTRIES];
+
+/// Index of the next entry to write, moved by the writer only
+static volatile uint16_t head = 0;
+
+/// Index of the oldest entry, moved by the reader only
+static volatile uint16_t tail = 0;
+
+static uint32_t dropped = 0;
+
+/// Drops already reported with a DROPPED message
+static uint32_t droppedReported = 0;
+
+void logPush(uint16_t id, const uint32_t* args, uint8_t numArgs)
+{
+	uint16_t index = head;
+	if(static_cast<uint16_t>(index - tail) >= LOG_RING_ENTRIES) {
+		dropped++;
+		return;
+	}
+
+	LogEntry& entry = ring[index & (LOG_RING_ENTRIES - 1)];
+	entry.id = id;
+	entry.numArgs = numArgs;
+	entry.timestamp = us_ticker_read();
+	for(uint8_t i = 0; i < numArgs; i++) {
+		entry.args[i] = args[i];
+	}
+
+	// the entry must be complete before the reader can see it
+	__atomic_signal_fence(__ATOMIC_RELEASE);
+	head = static_cast<uint16_t>(index + 1);
+}
+
+bool logPop(LogEntry& entry)
+{
+	uint16_t index = tail;
+	if(index == head) {
+		return false;
+	}
+
+	__atomic_signal_fence(__ATOMIC_ACQUIRE);
+	entry = ring[index & (LOG_RING_ENTRIES - 1)];
+	tail = static_cast<uint16_t>(index + 1);
+	return true;
+}
+
+uint32_t logDropped()
+{
+	return dropped;
+}
+
+uint8_t logLevel(uint16_t id)
+{
+	return id < LOG_MESSAGE_COUNT ? messages[id].level : LOG_LEVEL_NONE;
+}
+
+const char* logLevelName(uint8_t level)
+{
+	static const char* const names[] = {"?", "E", "W", "I", "D", "T"};
+	return level < sizeof(names) / sizeof(names[0]) ? names[level] : "?";
+}
+
+// appends printf output at out + length, without going past size
+static void logAppend(char* out, size_t size, size_t& length, const char* format, ...)
+{
+	size_t end = length < size ? length : size;
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(out + end, size - end, format, args);
+	va_end(args);
+	if(written > 0) {
+		length += written;
+	}
+}
+
+size_t logFormat(char* out, size_t size, uint16_t id, const uint32_t* args, uint8_t numArgs)
+{
+	if(size == 0) {
+		return 0;
+	}
+	out[0] = '\0';
+
+	if(id >= LOG_MESSAGE_COUNT) {
+		size_t length = 0;
+		logAppend(out, size, length, "unknown log message %u", id);
+		return length < size ? length : size - 1;
+	}
+
+	const char* format = messages[id].format;
+	size_t length = 0;
+	uint8_t argIndex = 0;
+
+	while(*format != '\0') {
+		if(*format != '%') {
+			logAppend(out, size, length, "%c", *format++);
+			continue;
+		}
+
+		if(format[1] == '%') {
+			logAppend(out, size, length, "%%");
+			format += 2;
+			continue;
+		}
+
+		// copy the flags, width and precision, and note the length modifier
+		char spec[16];
+		size_t specLength = 0;
+		spec[specLength++] = *format++;
+		while(*format != '\0' && strchr("-+ #0123456789.", *format) != NULL && specLength < sizeof(spec) - 2) {
+			spec[specLength++] = *format++;
+		}
+
+		uint8_t modifierBits = 32;
+		while(*format != '\0' && strchr("hlLqjzt", *format) != NULL) {
+			if(*format == 'h') {
+				modifierBits = modifierBits == 16 ? 8 : 16;
+			}
+			format++;
+		}
+
+		char conversion = *format;
+		if(conversion == '\0') {
+			break;
+		}
+		format++;
+		spec[specLength++] = conversion;
+		spec[specLength] = '\0';
+
+		uint32_t arg = argIndex < numArgs ? args[argIndex] : 0;
+		argIndex++;
+		if(modifierBits < 32) {
+			arg &= (1u << modifierBits) - 1;
+		}
+
+		if(strchr("fFeEgGaA", conversion) != NULL) {
+			float value;
+			memcpy(&value, &arg, sizeof(value));
+			logAppend(out, size, length, spec, static_cast<double>(value));
+		} else if(conversion == 'd' || conversion == 'i') {
+			// sign extend from the width of the modifier
+			int32_t value = static_cast<int32_t>(arg << (32 - modifierBits)) >> (32 - modifierBits);
+			logAppend(out, size, length, spec, static_cast<int>(value));
+		} else if(strchr("uxXoc", conversion) != NULL) {
+			logAppend(out, size, length, spec, static_cast<unsigned>(arg));
+		} else {
+			logAppend(out, size, length, "%s", spec);
+		}
+	}
+
+	return length < size ? length : size - 1;
+}
+
+// the DROPPED message for drops since the last one, if any
+static bool logDroppedEntry(LogEntry& entry)
+{
+	uint32_t newDrops = dropped - droppedReported;
+	if(newDrops == 0) {
+		return false;
+	}
+	droppedReported += newDrops;
+
+	entry.id = LOG_ID_DROPPED;
+	entry.numArgs = 1;
+	entry.timestamp = us_ticker_read();
+	entry.args[0] = newDrops;
+	return true;
+}
+
+static void logSendEntry(TelemetryEncoder& encoder, const LogEntry& entry)
+{
+	int16_t words[2 * LOG_MAX_ARGS + 1] = {static_cast<int16_t>(entry.id)};
+	for(uint8_t i = 0; i < entry.numArgs; i++) {
+		words[1 + 2 * i] = static_cast<int16_t>(entry.args[i]);
+		words[2 + 2 * i] = static_cast<int16_t>(entry.args[i] >> 16);
+	}
+	encoder.add(TELEMETRY_REPORTID_LOG, 0, entry.timestamp, words, 2 * LOG_MAX_ARGS + 1);
+}
+
+size_t logDrain(TelemetryEncoder& encoder)
+{
+	LogEntry entry;
+	size_t sent = 0;
+
+	while(logPop(entry)) {
+		logSendEntry(encoder, entry);
+		sent++;
+	}
+
+	if(logDroppedEntry(entry)) {
+		logSendEntry(encoder, entry);
+		sent++;
+	}
+	return sent;
+}
+
+static void logPrintEntry(Stream& out, const LogEntry& entry)
+{
+	char text[160];
+	logFormat(text, sizeof(text), entry.id, entry.args, entry.numArgs);
+	out.printf("%s\n", text);
+}
+
+size_t logDrainText(Stream& out)
+{
+	LogEntry entry;
+	size_t printed = 0;
+
+	while(logPop(entry)) {
+		logPrintEntry(out, entry);
+		printed++;
+	}
+
+	if(logDroppedEntry(entry)) {
+		logPrintEntry(out, entry);
+		printed++;
+	}
+	return printed;
+}
@@ -0,0 +1,214 @@
+#ifndef LOG_H
+#define LOG_H
+
+/**
+ * @file Log.h
+ *
+ * @brief Leveled logging that costs a few stores instead of a printf.
+ *
+ * Every message is listed once, with its level and format, in LOG_MESSAGES.
+ * Code logs by name:
+ *
+ *     LOG_MSG(PERIOD_TOO_SHORT, reportID, period, minPeriod);
+ *
+ * Messages above LOG_LEVEL compile to nothing, arguments included.  The rest
+ * put the message ID, the time and the raw arguments into a ring, and nothing
+ * is formatted at the call.  The application empties the ring when it has time
+ * to: logDrain() sends the entries as telemetry records, which the host
+ * formats with the same table (host/telemetry_decode), and logDrainText()
+ * formats them on the board for a plain serial terminal.
+ *
+ * Arguments are stored as 32 bit words: integers as they are, floats as their
+ * bits.  Formats may use the d, i, u, x, X, o, c and the float conversions with
+ * any flags, width and precision; length modifiers (hh, h, l) only truncate.
+ * There are no string arguments, since the pointer may be stale by the time the
+ * entry is formatted.
+ *
+ * Writing is for one thread only: the driver and the main loop, not interrupts.
+ */
+
+#include <mbed.h>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5
+
+/// Messages with a higher level are compiled out
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/// Entries the ring holds.  Must be a power of two, at most 32768.
+#ifndef LOG_RING_ENTRIES
+#define LOG_RING_ENTRIES 32
+#endif
+
+/// Most arguments of one message, so that an entry fits in one telemetry record
+#define LOG_MAX_ARGS 3
+
+static_assert(LOG_RING_ENTRIES > 0 && (LOG_RING_ENTRIES & (LOG_RING_ENTRIES - 1)) == 0, "LOG_RING_ENTRIES must be a power of two");
+static_assert(LOG_RING_ENTRIES <= 32768, "ring indices are 16 bits");
+
+/**
+ * Every log message: X(name, level, format).  The format has no trailing newline.
+ * Add new messages at the end, so the IDs of captured logs stay valid.
+ */
+#define LOG_MESSAGES(X) \
+	X(DROPPED,               LOG_LEVEL_WARN,  "%u log messages dropped, the ring was full") \
+	X(RESET_TIMEOUT,         LOG_LEVEL_ERROR, "Error: BNO080 reset timed out, chip not detected.") \
+	X(DETECTED,              LOG_LEVEL_INFO,  "BNO080 detected!") \
+	X(INIT_FAILED,           LOG_LEVEL_ERROR, "BNO080 reports initialization failed.") \
+	X(INIT_OK,               LOG_LEVEL_DEBUG, "BNO080 reports initialization successful!") \
+	X(SW_VERSION,            LOG_LEVEL_DEBUG, "BNO080 reports as SW version %u.%u.%u") \
+	X(BUILD_PART,            LOG_LEVEL_DEBUG, "BNO080 build %u, part no. %u") \
+	X(PRODUCT_ID_BAD,        LOG_LEVEL_ERROR, "Bad response from product ID command.") \
+	X(CAL_TIMEOUT,           LOG_LEVEL_DEBUG, "Timeout waiting for calibration response!") \
+	X(CAL_WRONG_RESPONSE,    LOG_LEVEL_DEBUG, "Received wrong response to calibration command!") \
+	X(CAL_FAILED,            LOG_LEVEL_DEBUG, "IMU reports calibrate command failed!") \
+	X(ORIENTATION,           LOG_LEVEL_DEBUG, "Sensor orientation y: %f, Q_y: %hd") \
+	X(PERIOD_TOO_SHORT,      LOG_LEVEL_ERROR, "Error: attempt made to set report 0x%02hhx to period of %.06f s, which is smaller than its min period of %.06f s.") \
+	X(REPORT_TOO_LONG,       LOG_LEVEL_ERROR, "Error: sensor report longer than packet buffer!") \
+	X(UNKNOWN_REPORT,        LOG_LEVEL_ERROR, "Error: unrecognized report ID in sensor report: %hhx.  Byte %u, length %hu") \
+	X(PACKET_FOUND,          LOG_LEVEL_TRACE, "found the correct packet") \
+	X(PACKET_OTHER,          LOG_LEVEL_TRACE, "other data packets, sending to proper channel") \
+	X(PACKET_WAIT_TIMEOUT,   LOG_LEVEL_WARN,  "Packet wait timeout.") \
+	X(FRS_TIMEOUT,           LOG_LEVEL_DEBUG, "Error: did not receive FRS read response after sending read request!") \
+	X(FRS_INVALID_RECORD,    LOG_LEVEL_DEBUG, "Error: FRS reports invalid record ID!") \
+	X(FRS_BUSY,              LOG_LEVEL_DEBUG, "Error: FRS is busy!") \
+	X(FRS_OFFSET_RANGE,      LOG_LEVEL_DEBUG, "Error: FRS reports offset is out of range!") \
+	X(FRS_RECORD_EMPTY,      LOG_LEVEL_DEBUG, "Error: FRS reports record %hx is empty!") \
+	X(FRS_FLASH_UNAVAILABLE, LOG_LEVEL_DEBUG, "Error: FRS reports flash memory device unavailable!") \
+	X(FRS_ZERO_LENGTH,       LOG_LEVEL_DEBUG, "Error: Received FRS packet with 0 data length!") \
+	X(FRS_SHORT_PACKET,      LOG_LEVEL_DEBUG, "Error: Received 1 length packet but more than 1 byte remains to be be read!") \
+	X(I2C_WRITE_FAILED,      LOG_LEVEL_ERROR, "BNO I2C body write failed!") \
+	X(I2C_WAIT_TIMEOUT,      LOG_LEVEL_WARN,  "BNO I2C wait timeout") \
+	X(I2C_HEADER_FAILED,     LOG_LEVEL_ERROR, "BNO I2C header read failed!") \
+	X(BAD_PACKET_LENGTH,     LOG_LEVEL_ERROR, "Recieved 0xFFFF packet length, protocol error!") \
+	X(I2C_BODY_FAILED,       LOG_LEVEL_ERROR, "BNO I2C body read failed!") \
+	X(STATUS_CHANGE,         LOG_LEVEL_INFO,  "Report 0x%02hhx status changed from %hhu to %hhu") \
+	X(FRS_WRITE_TIMEOUT,     LOG_LEVEL_ERROR, "Error: no FRS write response from the IMU!") \
+	X(FRS_WRITE_FAILED,      LOG_LEVEL_ERROR, "Error: FRS write of record %hx failed with status %hhu!") \
+	X(PACKET_TOO_SHORT,      LOG_LEVEL_ERROR, "Error: packet length %hu is shorter than the SHTP header!") \
+	X(REPORT_TRUNCATED,      LOG_LEVEL_ERROR, "Error: sensor report %hhx at byte %u runs past the end of the packet, length %hu") \
+	X(RATE_LOW,              LOG_LEVEL_WARN,  "Report 0x%02hhx falls short of its rate: mean interval %.0f us for a period of %u us")
+
+#define LOG_ID_ENTRY(name, level, format) LOG_ID_##name,
+#define LOG_LEVEL_ENTRY(name, level, format) LOG_LEVEL_OF_##name = level,
+
+enum LogMessageID {
+	LOG_MESSAGES(LOG_ID_ENTRY)
+	LOG_MESSAGE_COUNT
+};
+
+enum LogMessageLevel {
+	LOG_MESSAGES(LOG_LEVEL_ENTRY)
+};
+
+#undef LOG_ID_ENTRY
+#undef LOG_LEVEL_ENTRY
+
+/**
+ * Logs the message called name with its arguments, if its level is enabled.
+ */
+#define LOG_MSG(name, ...) \
+	do { \
+		if(LOG_LEVEL_OF_##name <= LOG_LEVEL) { \
+			logWrite(LOG_ID_##name, ##__VA_ARGS__); \
+		} \
+	} while(0)
+
+/**
+ * @brief One message waiting in the ring.
+ */
+struct LogEntry {
+	uint16_t id;
+	uint8_t numArgs;
+	uint32_t timestamp;		///< us_ticker_read() when it was logged
+	uint32_t args[LOG_MAX_ARGS];
+};
+
+/// RAM of the ring
+#define LOG_RING_RAM (LOG_RING_ENTRIES * sizeof(LogEntry))
+
+/// Integer arguments are stored as they are
+template<typename T>
+inline uint32_t logArg(T value)
+{
+	return static_cast<uint32_t>(value);
+}
+
+/// Float arguments are stored as their bits
+inline uint32_t logArg(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+inline uint32_t logArg(double value)
+{
+	return logArg(static_cast<float>(value));
+}
+
+/**
+ * Puts a message in the ring.  If the ring is full it is dropped and counted,
+ * so the oldest messages -- usually the ones that explain the rest -- survive.
+ */
+void logPush(uint16_t id, const uint32_t* args, uint8_t numArgs);
+
+/**
+ * Use LOG_MSG() rather than this, so that disabled levels compile out.
+ */
+template<typename... Args>
+inline void logWrite(uint16_t id, Args... args)
+{
+	static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "a log message takes at most LOG_MAX_ARGS arguments");
+	const uint32_t words[] = {0, logArg(args)...};
+	logPush(id, words + 1, sizeof...(Args));
+}
+
+/**
+ * Takes the oldest entry out of the ring.
+ *
+ * @return false if the ring is empty.
+ */
+bool logPop(LogEntry& entry);
+
+/// Messages dropped because the ring was full, since startup
+uint32_t logDropped();
+
+/// Level of a message, or LOG_LEVEL_NONE if the ID is unknown
+uint8_t logLevel(uint16_t id);
+
+/// Short name of a level: "E", "W", "I", "D" or "T"
+const char* logLevelName(uint8_t level);
+
+/**
+ * Formats a message the way printf would have.  Missing arguments read as 0.
+ *
+ * @return Length of the text, truncated to fit size including the terminator.
+ */
+size_t logFormat(char* out, size_t size, uint16_t id, const uint32_t* args, uint8_t numArgs);
+
+class TelemetryEncoder;
+
+/**
+ * Sends the waiting entries as TELEMETRY_REPORTID_LOG records, and a DROPPED
+ * message if some were lost since the last call.  Does not flush the encoder.
+ *
+ * @return Number of entries sent.
+ */
+size_t logDrain(TelemetryEncoder& encoder);
+
+/**
+ * Formats the waiting entries and prints them, one per line.  Formatting
+ * happens here rather than at the call, so call it where a delay is harmless.
+ *
+ * @return Number of entries printed.
+ */
+size_t logDrainText(Stream& out);
+
+#endif /* LOG_H */
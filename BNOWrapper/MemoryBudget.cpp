@@ -0,0 +1,24 @@
+#include "MemoryBudget.h"
+#include "BNO080Wheelchair.h"
+#include "Telemetry.h"
+#include "ShtpCapture.h"
+#include "TxRing.h"
+#include "Log.h"
+#include "Profile.h"
+
+// Nothing but checks: every configuration that builds fits its budgets, see MemoryBudget.h
+
+static_assert(sizeof(BNO080) <= BNO080_RAM_BUDGET, "BNO080 is over BNO080_RAM_BUDGET");
+static_assert(BNO080_PACKET_RAM <= BNO080_PACKET_RAM_BUDGET, "the BNO080 packet buffers are over BNO080_PACKET_RAM_BUDGET");
+static_assert(sizeof(BNO080Wheelchair) <= BNO080_WHEELCHAIR_RAM_BUDGET, "BNO080Wheelchair is over BNO080_WHEELCHAIR_RAM_BUDGET");
+static_assert(sizeof(FlightRecorder) <= FLIGHT_RECORDER_RAM_BUDGET, "FlightRecorder is over FLIGHT_RECORDER_RAM_BUDGET");
+static_assert(sizeof(ReportResampler) <= RESAMPLER_RAM_BUDGET, "ReportResampler is over RESAMPLER_RAM_BUDGET");
+static_assert(sizeof(LatencyTracer) <= LATENCY_TRACER_RAM_BUDGET, "LatencyTracer is over LATENCY_TRACER_RAM_BUDGET");
+static_assert(sizeof(RateMonitor) <= RATE_MONITOR_RAM_BUDGET, "RateMonitor is over RATE_MONITOR_RAM_BUDGET");
+static_assert(LOG_RING_RAM <= LOG_RAM_BUDGET, "the log ring is over LOG_RAM_BUDGET");
+static_assert(PROFILE_RAM <= PROFILE_RAM_BUDGET, "the profiling statistics are over PROFILE_RAM_BUDGET");
+static_assert(sizeof(TelemetryEncoder) <= TELEMETRY_RAM_BUDGET, "TelemetryEncoder is over TELEMETRY_RAM_BUDGET");
+static_assert(sizeof(ShtpCaptureEncoder) <= SHTP_CAPTURE_RAM_BUDGET, "ShtpCaptureEncoder is over SHTP_CAPTURE_RAM_BUDGET");
+static_assert(sizeof(TxRing) <= TX_RING_RAM_BUDGET, "TxRing is over TX_RING_RAM_BUDGET");
+static_assert(BNO080_IMU_COUNT * sizeof(BNO080) + LOG_RING_RAM + PROFILE_RAM <= BNO080_TOTAL_RAM_BUDGET,
+			  "BNO080_IMU_COUNT IMUs with the log and profiling are over BNO080_TOTAL_RAM_BUDGET");
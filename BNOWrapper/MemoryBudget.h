@@ -0,0 +1,97 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+/**
+ * @file MemoryBudget.h
+ *
+ * @brief RAM budget of each part of the driver, checked at compile time.
+ *
+ * Nothing here allocates on the heap: the driver, BNO080Wheelchair and the
+ * optional parts keep their buffers in the object, so their RAM is their size.
+ * That size is set by these macros, each overridable with -D:
+ *
+ *     part                     sized by
+ *     BNO080 packet buffers    STORED_PACKET_SIZE, READ_BUFFER_SIZE
+ *     BNO080 status stats      BNO080_STATUS_STATISTICS (0 leaves them out)
+ *     FlightRecorder           FLIGHT_RECORDER_SIZE
+ *     ReportResampler          RESAMPLER_MAX_CHANNELS, RESAMPLER_FRAME_DEPTH
+ *     LatencyTracer            LATENCY_TRACE_REPORTS
+ *     RateMonitor              RATE_MONITOR_REPORTS
+ *     log ring                 LOG_RING_ENTRIES
+ *     profiling                PROFILE_ENABLED
+ *     TelemetryEncoder         TELEMETRY_MAX_FRAME
+ *     ShtpCaptureEncoder       SHTP_CAPTURE_MAX_PACKET
+ *     TxRing                   TX_RING_SIZE
+ *
+ * MemoryBudget.cpp fails the build when a part outgrows its budget below, so
+ * that a configuration that fits stays fitting.  To fit a smaller MCU, or
+ * several IMUs on one (BNO080_IMU_COUNT), shrink the sizes and the budgets
+ * together.  host/ram_report prints what each part takes in a configuration:
+ *
+ *     make -C host ram-report RAM_CONFIG="-DREAD_BUFFER_SIZE=280 -DBNO080_STATUS_STATISTICS=0"
+ *
+ * The budgets are in bytes, and leave room for the 8 byte pointers of a host build.
+ */
+
+/// IMUs the firmware drives, each with its own BNO080
+#ifndef BNO080_IMU_COUNT
+#define BNO080_IMU_COUNT 1
+#endif
+
+/// One BNO080, all of it
+#ifndef BNO080_RAM_BUDGET
+#define BNO080_RAM_BUDGET 2048
+#endif
+
+/// The packet buffers inside each BNO080
+#ifndef BNO080_PACKET_RAM_BUDGET
+#define BNO080_PACKET_RAM_BUDGET 768
+#endif
+
+/// One BNO080Wheelchair, its BNO080, recorder and resampler included
+#ifndef BNO080_WHEELCHAIR_RAM_BUDGET
+#define BNO080_WHEELCHAIR_RAM_BUDGET 20480
+#endif
+
+#ifndef FLIGHT_RECORDER_RAM_BUDGET
+#define FLIGHT_RECORDER_RAM_BUDGET 16896
+#endif
+
+#ifndef RESAMPLER_RAM_BUDGET
+#define RESAMPLER_RAM_BUDGET 1024
+#endif
+
+#ifndef LATENCY_TRACER_RAM_BUDGET
+#define LATENCY_TRACER_RAM_BUDGET 4608
+#endif
+
+#ifndef RATE_MONITOR_RAM_BUDGET
+#define RATE_MONITOR_RAM_BUDGET 512
+#endif
+
+#ifndef LOG_RAM_BUDGET
+#define LOG_RAM_BUDGET 1024
+#endif
+
+#ifndef PROFILE_RAM_BUDGET
+#define PROFILE_RAM_BUDGET 4096
+#endif
+
+#ifndef TELEMETRY_RAM_BUDGET
+#define TELEMETRY_RAM_BUDGET 256
+#endif
+
+#ifndef SHTP_CAPTURE_RAM_BUDGET
+#define SHTP_CAPTURE_RAM_BUDGET 768
+#endif
+
+#ifndef TX_RING_RAM_BUDGET
+#define TX_RING_RAM_BUDGET 640
+#endif
+
+/// Every BNO080, the log ring and the profiling statistics together
+#ifndef BNO080_TOTAL_RAM_BUDGET
+#define BNO080_TOTAL_RAM_BUDGET 8192
+#endif
+
+#endif /* MEMORY_BUDGET_H */
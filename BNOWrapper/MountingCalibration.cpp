@@ -0,0 +1,216 @@
+#include "MountingCalibration.h"
+
+// power iterations used to find the main axis of the drive's acceleration
+#define MOUNTING_POWER_ITERATIONS 24
+
+MountingCalibration::MountingCalibration()
+{
+	reset();
+}
+
+void MountingCalibration::reset()
+{
+	_phase = IDLE;
+	_level.reset();
+	_tilted.reset();
+	resetDrive();
+}
+
+void MountingCalibration::resetDrive()
+{
+	_driveCount = 0;
+	for (uint8_t i = 0; i < 6; i++) {
+		_driveScatter[i] = 0;
+	}
+	_driveVelocity = TVector3::zero();
+	_driveDisplacement = TVector3::zero();
+}
+
+void MountingCalibration::begin(Phase phase)
+{
+	_phase = phase;
+
+	switch (phase) {
+		case LEVEL:
+			_level.reset();
+			break;
+		case TILTED:
+			_tilted.reset();
+			break;
+		case DRIVE:
+			resetDrive();
+			break;
+		default:
+			break;
+	}
+}
+
+void MountingCalibration::MeanVector::reset()
+{
+	count = 0;
+	mean = TVector3::zero();
+	m2 = 0;
+}
+
+// Welford's update, so long recordings don't lose precision in float
+void MountingCalibration::MeanVector::add(const TVector3& v)
+{
+	count++;
+	TVector3 delta = v - mean;
+	mean = mean + delta * (1.0f / count);
+	m2 += delta.dot(v - mean);
+}
+
+void MountingCalibration::addGravity(const TVector3& gravity)
+{
+	if (_phase == LEVEL) {
+		_level.add(gravity);
+	} else if (_phase == TILTED) {
+		_tilted.add(gravity);
+	}
+}
+
+void MountingCalibration::addLinearAcceleration(const TVector3& acceleration, float dt)
+{
+	if (_phase != DRIVE) {
+		return;
+	}
+
+	_driveCount++;
+	_driveScatter[0] += acceleration[0] * acceleration[0];
+	_driveScatter[1] += acceleration[0] * acceleration[1];
+	_driveScatter[2] += acceleration[0] * acceleration[2];
+	_driveScatter[3] += acceleration[1] * acceleration[1];
+	_driveScatter[4] += acceleration[1] * acceleration[2];
+	_driveScatter[5] += acceleration[2] * acceleration[2];
+
+	_driveVelocity = _driveVelocity + acceleration * dt;
+	_driveDisplacement = _driveDisplacement + _driveVelocity * dt;
+}
+
+uint32_t MountingCalibration::sampleCount(Phase phase) const
+{
+	switch (phase) {
+		case LEVEL:
+			return _level.count;
+		case TILTED:
+			return _tilted.count;
+		case DRIVE:
+			return _driveCount;
+		default:
+			return 0;
+	}
+}
+
+bool MountingCalibration::driveForward(const TVector3& up, TVector3& forward, float& curvature) const
+{
+	if (_driveCount < MOUNTING_MIN_SAMPLES) {
+		return false;
+	}
+
+	const float* s = _driveScatter;
+	TMatrix3 scatter;
+	scatter.element(0,0, s[0]); scatter.element(0,1, s[1]); scatter.element(0,2, s[2]);
+	scatter.element(1,0, s[1]); scatter.element(1,1, s[3]); scatter.element(1,2, s[4]);
+	scatter.element(2,0, s[2]); scatter.element(2,1, s[4]); scatter.element(2,2, s[5]);
+
+	// only the horizontal part counts: bumps and the fusion's leftover gravity error are vertical
+	TMatrix3 flatten = TMatrix3::identity() - up * up.transpose();
+	TMatrix3 horizontal = flatten * scatter * flatten;
+
+	// the largest eigenvector is the axis of acceleration and braking.  Start from
+	// the direction of travel, which is close to it.
+	TVector3 axis = flatten * _driveDisplacement;
+	if (axis.norm() <= 0) {
+		return false;
+	}
+	axis = axis / axis.norm();
+	float lambda = 0;
+	for (uint8_t i = 0; i < MOUNTING_POWER_ITERATIONS; i++) {
+		TVector3 next = horizontal * axis;
+		lambda = next.norm();
+		if (lambda <= 0) {
+			return false;
+		}
+		axis = next / lambda;
+	}
+
+	// the other horizontal eigenvalue is what's left of the trace
+	float trace = horizontal.element(0,0) + horizontal.element(1,1) + horizontal.element(2,2);
+	float sideways = trace - lambda;
+	curvature = std::sqrt((sideways > 0 ? sideways : 0) / lambda);
+	if (curvature > MOUNTING_MAX_DRIVE_CURVATURE) {
+		return false;
+	}
+
+	// the axis points either way; the chair drove forward
+	forward = axis.dot(_driveDisplacement) < 0 ? axis * -1.0f : axis;
+	return true;
+}
+
+bool MountingCalibration::solve(MountingResult& result) const
+{
+	result.tiltAngle = 0;
+	result.driveCurvature = 0;
+	result.headingDisagreement = 0;
+	result.levelNoise = 0;
+
+	if (_level.count < MOUNTING_MIN_SAMPLES || _level.mean.norm() <= 0) {
+		return false;
+	}
+
+	// the gravity report points up, away from the ground
+	TVector3 up = _level.mean / _level.mean.norm();
+	result.levelNoise = std::sqrt(_level.m2 / _level.count);
+
+	// nose up tilts gravity toward +x, so up x tilted gravity points left
+	TVector3 tiltForward;
+	bool haveTilt = false;
+	if (_tilted.count >= MOUNTING_MIN_SAMPLES && _tilted.mean.norm() > 0) {
+		TVector3 left = up.cross(_tilted.mean / _tilted.mean.norm());
+		float sinTilt = left.norm();
+		if (sinTilt > std::sin(MOUNTING_MIN_TILT)) {
+			result.tiltAngle = std::asin(sinTilt < 1 ? sinTilt : 1);
+			left = left / sinTilt;
+			tiltForward = left.cross(up);
+			haveTilt = true;
+		}
+	}
+
+	TVector3 driveForwardAxis;
+	bool haveDrive = driveForward(up, driveForwardAxis, result.driveCurvature);
+	if (!haveDrive) {
+		result.driveCurvature = 0;
+	}
+
+	TVector3 forward;
+	if (haveTilt && haveDrive) {
+		float c = tiltForward.dot(driveForwardAxis);
+		result.headingDisagreement = std::acos(c < -1 ? -1 : (c > 1 ? 1 : c));
+		forward = tiltForward + driveForwardAxis;
+	} else if (haveTilt) {
+		forward = tiltForward;
+	} else if (haveDrive) {
+		forward = driveForwardAxis;
+	} else {
+		return false;
+	}
+
+	// orthonormal chassis axes, keeping up exact
+	TVector3 left = up.cross(forward);
+	if (left.norm() <= 0) {
+		return false;
+	}
+	left = left / left.norm();
+	forward = left.cross(up);
+
+	// rows are the chassis axes in IMU coordinates, so this maps IMU to chassis
+	TMatrix3 imuToChassis;
+	for (uint16_t i = 0; i < 3; i++) {
+		imuToChassis.element(0,i, forward[i]);
+		imuToChassis.element(1,i, left[i]);
+		imuToChassis.element(2,i, up[i]);
+	}
+	result.orientation.rotationMatrix(imuToChassis);
+	return true;
+}
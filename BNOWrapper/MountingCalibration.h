@@ -0,0 +1,155 @@
+#ifndef MOUNTING_CALIBRATION_H
+#define MOUNTING_CALIBRATION_H
+
+/**
+ * @file MountingCalibration.h
+ *
+ * @brief Estimates how the IMU is mounted on the chair from a few recorded maneuvers.
+ *
+ * The result is the sensor orientation quaternion that BNO080::setSensorOrientation()
+ * and BNO080::setPermanentOrientation() take, so the reports come out in chassis axes:
+ * x forward, y left, z up.
+ *
+ * Three maneuvers are recorded, in any order:
+ *
+ *  - LEVEL:  the chair standing still on level ground.  The mean gravity report gives z.
+ *  - TILTED: the chair standing still, nose up (on a ramp, or reclined backward).
+ *            Gravity swings about the chair's y axis, which gives the heading.
+ *  - DRIVE:  a short straight drive forward from standstill, recording the linear
+ *            acceleration report.  Its main axis of acceleration gives x, and the
+ *            direction it traveled gives the sign.
+ *
+ * LEVEL is required, plus at least one of TILTED and DRIVE.  With both, the two
+ * heading estimates are averaged and their disagreement is reported.
+ *
+ * Samples are folded into running sums as they arrive, so memory is fixed and each
+ * sample is O(1).  The same class runs on the board and in the host tool
+ * host/mounting_cal.cpp, which solves from recorded logs.
+ *
+ * @note Record with the identity sensor orientation applied (the chip's default).
+ * Otherwise the result is relative to the orientation in use and has to be
+ * multiplied onto it.
+ */
+
+#include <stdint.h>
+
+#include "quaternion.h"
+
+/// Fewest samples of each maneuver that solve() accepts
+#ifndef MOUNTING_MIN_SAMPLES
+#define MOUNTING_MIN_SAMPLES 10
+#endif
+
+/// Smallest tilt, in radians, that the TILTED maneuver has to reach to be used (about 5 degrees)
+#define MOUNTING_MIN_TILT 0.087f
+
+/// Largest ratio of sideways to forward acceleration for the DRIVE maneuver to count as straight
+#define MOUNTING_MAX_DRIVE_CURVATURE 0.25f
+
+/**
+ * @brief Result of MountingCalibration::solve(), with figures to judge it by.
+ */
+struct MountingResult {
+	/// Rotation from IMU axes to chassis axes, as taken by BNO080::setSensorOrientation()
+	Quaternion orientation;
+
+	/// Angle between the level and tilted gravity directions in radians, 0 if TILTED wasn't used
+	float tiltAngle;
+
+	/// Sideways over forward acceleration of the drive (0 is perfectly straight), 0 if DRIVE wasn't used
+	float driveCurvature;
+
+	/// Angle in radians between the headings given by TILTED and DRIVE, 0 unless both were used
+	float headingDisagreement;
+
+	/// RMS deviation of the level gravity samples from their mean, in m/s^2.  High values mean the chair moved.
+	float levelNoise;
+};
+
+class MountingCalibration {
+public:
+
+	/// Maneuver that incoming samples belong to
+	enum Phase {
+		IDLE,
+		LEVEL,
+		TILTED,
+		DRIVE
+	};
+
+	MountingCalibration();
+
+	/// Forgets all recorded samples.
+	void reset();
+
+	/**
+	 * Starts recording a maneuver.  Samples recorded earlier for the same maneuver are discarded.
+	 */
+	void begin(Phase phase);
+
+	/// Stops recording.  Samples are ignored until the next begin().
+	void end() { _phase = IDLE; }
+
+	Phase phase() const { return _phase; }
+
+	/**
+	 * Adds a gravity report sample, during LEVEL or TILTED.
+	 */
+	void addGravity(const TVector3& gravity);
+
+	/**
+	 * Adds a linear acceleration report sample, during DRIVE.
+	 *
+	 * @param dt Time since the previous sample in seconds.
+	 */
+	void addLinearAcceleration(const TVector3& acceleration, float dt);
+
+	/**
+	 * @return Samples recorded for a maneuver.
+	 */
+	uint32_t sampleCount(Phase phase) const;
+
+	/**
+	 * Works out the mounting from the samples recorded so far.  Can be called at
+	 * any time and doesn't change the recorded samples.
+	 *
+	 * @return false if LEVEL, or both TILTED and DRIVE, don't have usable samples.
+	 */
+	bool solve(MountingResult& result) const;
+
+private:
+
+	/// Running mean of a vector, with the sum of squared deviations for its spread
+	struct MeanVector {
+		uint32_t count;
+		TVector3 mean;
+		float m2;
+
+		void reset();
+		void add(const TVector3& v);
+	};
+
+	Phase _phase;
+
+	MeanVector _level;
+	MeanVector _tilted;
+
+	uint32_t _driveCount;
+
+	/// Upper triangle of the scatter matrix sum(a * a^T) of the drive, xx xy xz yy yz zz
+	float _driveScatter[6];
+
+	/// Integrated velocity and displacement of the drive, only used for the direction of travel
+	TVector3 _driveVelocity;
+	TVector3 _driveDisplacement;
+
+	void resetDrive();
+
+	/**
+	 * Forward direction from the drive, projected into the plane perpendicular to up.
+	 * @return false if the drive wasn't recorded or wasn't straight.
+	 */
+	bool driveForward(const TVector3& up, TVector3& forward, float& curvature) const;
+};
+
+#endif /* MOUNTING_CALIBRATION_H */
@@ -0,0 +1,197 @@
+#include "Profile.h"
+#include "Telemetry.h"
+
+#ifndef DWT
+#include <chrono>
+#endif
+
+#define PROFILE_LABEL_ENTRY(name, label) label,
+
+static const char* const scopeNames[] = {
+	PROFILE_SCOPES(PROFILE_LABEL_ENTRY)
+};
+
+static ProfileScopeData scopes[PROFILE_SCOPE_COUNT];
+
+/// Ticks an empty scope measures, taken off every sample
+static uint32_t overhead = 0;
+
+void profileInit()
+{
+#ifdef DWT
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+#if defined(__CORTEX_M) && (__CORTEX_M == 7)
+	// the M7 ignores writes to the DWT until it is unlocked
+	DWT->LAR = 0xC5ACCE55;
+#endif
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+	overhead = 0;
+	uint32_t fastest = UINT32_MAX;
+	for(int i = 0; i < 16; i++) {
+		uint32_t start = profileTicks();
+		uint32_t elapsed = profileTicks() - start;
+		if(elapsed < fastest) {
+			fastest = elapsed;
+		}
+	}
+	overhead = fastest;
+
+	profileReset();
+}
+
+uint32_t profileTicks()
+{
+#ifdef DWT
+	return DWT->CYCCNT;
+#else
+	return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+static uint32_t ticksToNs(uint32_t ticks)
+{
+#ifdef DWT
+	return static_cast<uint32_t>(static_cast<uint64_t>(ticks) * 1000 / (SystemCoreClock / 1000000));
+#else
+	return ticks;
+#endif
+}
+
+// below PROFILE_SUB_BUCKETS ticks one bucket per tick, then PROFILE_SUB_BUCKETS per doubling
+uint8_t profileBucket(uint32_t ticks)
+{
+	if(ticks < PROFILE_SUB_BUCKETS) {
+		return static_cast<uint8_t>(ticks);
+	}
+
+	int msb = 31 - __builtin_clz(ticks);
+	uint32_t sub = (ticks >> (msb - 2)) & (PROFILE_SUB_BUCKETS - 1);
+	uint32_t bucket = (msb - 1) * PROFILE_SUB_BUCKETS + sub;
+	return static_cast<uint8_t>(bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1);
+}
+
+uint32_t profileBucketTop(uint8_t bucket)
+{
+	if(bucket < PROFILE_SUB_BUCKETS) {
+		return bucket;
+	}
+
+	int msb = bucket / PROFILE_SUB_BUCKETS + 1;
+	uint32_t sub = bucket % PROFILE_SUB_BUCKETS;
+	return ((PROFILE_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+static_assert(PROFILE_SUB_BUCKETS == 4, "profileBucket() takes 2 bits below the top bit");
+static_assert(PROFILE_BUCKETS <= 256, "buckets are numbered in 8 bits");
+
+void profileRecord(uint8_t scope, uint32_t start)
+{
+	uint32_t ticks = profileTicks() - start;
+	ticks = ticks > overhead ? ticks - overhead : 0;
+
+	if(scope >= PROFILE_SCOPE_COUNT) {
+		return;
+	}
+
+	if(scopes[scope].count == 0 || ticks < scopes[scope].min) {
+		scopes[scope].min = ticks;
+	}
+	if(ticks > scopes[scope].max) {
+		scopes[scope].max = ticks;
+	}
+	scopes[scope].count++;
+	scopes[scope].sum += ticks;
+	scopes[scope].buckets[profileBucket(ticks)]++;
+}
+
+void profileReset()
+{
+	memset(scopes, 0, sizeof(scopes));
+}
+
+bool profileStats(uint8_t scope, ProfileStats& stats)
+{
+	if(scope >= PROFILE_SCOPE_COUNT || scopes[scope].count == 0) {
+		return false;
+	}
+
+	uint32_t count = scopes[scope].count;
+	stats.count = count;
+	stats.min = ticksToNs(scopes[scope].min);
+	stats.max = ticksToNs(scopes[scope].max);
+	stats.mean = ticksToNs(static_cast<uint32_t>(scopes[scope].sum / count));
+
+	// the first bucket by which 99% of the samples are in
+	uint32_t target = count - count / 100;
+	uint32_t seen = 0;
+	uint32_t p99 = scopes[scope].max;
+	for(uint8_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+		seen += scopes[scope].buckets[bucket];
+		if(seen >= target) {
+			uint32_t top = profileBucketTop(bucket);
+			p99 = top < scopes[scope].max ? top : scopes[scope].max;
+			break;
+		}
+	}
+	stats.p99 = ticksToNs(p99);
+	return true;
+}
+
+const char* profileScopeName(uint8_t scope)
+{
+	return scope < PROFILE_SCOPE_COUNT ? scopeNames[scope] : "?";
+}
+
+uint16_t profileEncodeTime(uint32_t ns)
+{
+	// an 11 bit mantissa and a 5 bit shift; below 2048 the shift is 0 and the mantissa is exact
+	uint16_t shift = 0;
+	while((ns >> shift) >= 2048) {
+		shift++;
+	}
+	return static_cast<uint16_t>(shift << 11 | (ns >> shift));
+}
+
+uint32_t profileDecodeTime(uint16_t code)
+{
+	return static_cast<uint32_t>(code & 0x7FF) << (code >> 11);
+}
+
+void profileSend(TelemetryEncoder& encoder, uint32_t timestamp)
+{
+	ProfileStats stats;
+	for(uint8_t scope = 0; scope < PROFILE_SCOPE_COUNT; scope++) {
+		if(!profileStats(scope, stats)) {
+			continue;
+		}
+
+		int16_t words[7] = {
+			static_cast<int16_t>(scope),
+			static_cast<int16_t>(stats.count),
+			static_cast<int16_t>(stats.count >> 16),
+			static_cast<int16_t>(profileEncodeTime(stats.min)),
+			static_cast<int16_t>(profileEncodeTime(stats.mean)),
+			static_cast<int16_t>(profileEncodeTime(stats.p99)),
+			static_cast<int16_t>(profileEncodeTime(stats.max))
+		};
+		encoder.add(TELEMETRY_REPORTID_PROFILE, 0, timestamp, words, 7);
+	}
+}
+
+void profilePrint(Stream& out)
+{
+	ProfileStats stats;
+	out.printf("%-30s %10s %10s %10s %10s %10s\n", "# scope (ns)", "count", "min", "mean", "p99", "max");
+	for(uint8_t scope = 0; scope < PROFILE_SCOPE_COUNT; scope++) {
+		if(!profileStats(scope, stats)) {
+			continue;
+		}
+		out.printf("%-30s %10u %10u %10u %10u %10u\n", scopeNames[scope], static_cast<unsigned>(stats.count),
+				   static_cast<unsigned>(stats.min), static_cast<unsigned>(stats.mean),
+				   static_cast<unsigned>(stats.p99), static_cast<unsigned>(stats.max));
+	}
+}
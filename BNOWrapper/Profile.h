@@ -0,0 +1,172 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/**
+ * @file Profile.h
+ *
+ * @brief Opt-in timing of the driver's hot paths.
+ *
+ * Build with PROFILE_ENABLED=1 and each scope listed in PROFILE_SCOPES times
+ * itself on every pass:
+ *
+ *     bool BNO080::receivePacket(float timeout)
+ *     {
+ *         PROFILE_SCOPE(RECEIVE_PACKET);
+ *         ...
+ *
+ * or, for part of a function, PROFILE_BEGIN(name) ... PROFILE_END(name).  An
+ * early return between the two just skips the sample.  With PROFILE_ENABLED
+ * at 0 (the default) the macros expand to nothing.
+ *
+ * On the board the time comes from the Cortex-M DWT cycle counter, which costs
+ * a load to read; on the host from std::chrono.  Each sample goes into a fixed
+ * log-linear histogram (4 buckets per doubling, so a percentile is within 25%),
+ * plus an exact count, min, max and sum.  profileInit() measures the cost of an
+ * empty scope, which is taken off every sample.
+ *
+ * Scopes nest (processPacket includes parseSensorDataPacket), and are for one
+ * thread only.
+ */
+
+#include <mbed.h>
+
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 0
+#endif
+
+/**
+ * Every timed scope: X(name, label).  Add new scopes at the end, so the IDs of
+ * captured telemetry stay valid.
+ */
+#define PROFILE_SCOPES(X) \
+	X(RECEIVE_PACKET,     "receivePacket") \
+	X(SEND_PACKET,        "sendPacket") \
+	X(PROCESS_PACKET,     "processPacket") \
+	X(PARSE_SENSOR_DATA,  "parseSensorDataPacket") \
+	X(Q_CONVERSION,       "Q conversion") \
+	X(WHEELCHAIR_SAMPLE,  "BNO080Wheelchair::onImuSample") \
+	X(RESAMPLER_POLL,     "ReportResampler::poll")
+
+#define PROFILE_ID_ENTRY(name, label) PROFILE_ID_##name,
+
+enum ProfileScopeID {
+	PROFILE_SCOPES(PROFILE_ID_ENTRY)
+	PROFILE_SCOPE_COUNT
+};
+
+#undef PROFILE_ID_ENTRY
+
+/// Buckets per doubling of the time
+#define PROFILE_SUB_BUCKETS 4
+
+/// Doublings the histogram covers, up to 2^(PROFILE_OCTAVES + 1) ticks (longer samples go in the last bucket)
+#define PROFILE_OCTAVES 28
+
+#define PROFILE_BUCKETS (PROFILE_OCTAVES * PROFILE_SUB_BUCKETS)
+
+/**
+ * @brief What is kept of each scope.
+ */
+struct ProfileScopeData {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+	uint32_t buckets[PROFILE_BUCKETS];
+};
+
+/// RAM of the statistics of all scopes.  Nothing uses them unless PROFILE_ENABLED is set, so the linker drops them.
+#define PROFILE_RAM (PROFILE_ENABLED ? PROFILE_SCOPE_COUNT * sizeof(ProfileScopeData) : 0)
+
+/**
+ * @brief Summary of one scope, in nanoseconds.
+ */
+struct ProfileStats {
+	uint32_t count;
+	uint32_t min;
+	uint32_t mean;
+	uint32_t p99;		///< upper edge of the bucket holding the 99th percentile, at most max
+	uint32_t max;
+};
+
+/**
+ * Turns on the cycle counter and measures the cost of an empty scope.
+ * BNO080's constructor calls it when profiling is enabled.
+ */
+void profileInit();
+
+/// Current time in ticks: CPU cycles on the board, nanoseconds on the host
+uint32_t profileTicks();
+
+/// Adds one sample of a scope, in ticks since start
+void profileRecord(uint8_t scope, uint32_t start);
+
+/// Clears the samples of all scopes
+void profileReset();
+
+/**
+ * Histogram bucket of a time: one bucket per tick below PROFILE_SUB_BUCKETS, then
+ * PROFILE_SUB_BUCKETS per doubling, capped at PROFILE_BUCKETS - 1.  Works for any unit.
+ */
+uint8_t profileBucket(uint32_t ticks);
+
+/// Largest time that lands in a bucket
+uint32_t profileBucketTop(uint8_t bucket);
+
+/**
+ * @return false if the scope has no samples yet.
+ */
+bool profileStats(uint8_t scope, ProfileStats& stats);
+
+/// Label of a scope, e.g. "receivePacket", or "?" if the ID is unknown
+const char* profileScopeName(uint8_t scope);
+
+/**
+ * Packs a time in ns into 16 bits for a telemetry record: below 2048 ns exactly,
+ * above that to within 0.1%.
+ */
+uint16_t profileEncodeTime(uint32_t ns);
+
+uint32_t profileDecodeTime(uint16_t code);
+
+class TelemetryEncoder;
+
+/**
+ * Sends a TELEMETRY_REPORTID_PROFILE record for each scope with samples.
+ * Does not flush the encoder.
+ */
+void profileSend(TelemetryEncoder& encoder, uint32_t timestamp);
+
+/// Prints a table of the scopes with samples
+void profilePrint(Stream& out);
+
+#if PROFILE_ENABLED
+
+/**
+ * @brief Records the time from its construction to the end of the enclosing block.
+ */
+class ProfileScope {
+public:
+	explicit ProfileScope(uint8_t scope) : _scope(scope), _start(profileTicks()) {}
+	~ProfileScope() { profileRecord(_scope, _start); }
+
+private:
+	uint8_t _scope;
+	uint32_t _start;
+};
+
+#define PROFILE_INIT() profileInit()
+#define PROFILE_SCOPE(name) ProfileScope profileScope_##name(PROFILE_ID_##name)
+#define PROFILE_BEGIN(name) uint32_t profileStart_##name = profileTicks()
+#define PROFILE_END(name) profileRecord(PROFILE_ID_##name, profileStart_##name)
+
+#else
+
+#define PROFILE_INIT() do {} while(0)
+#define PROFILE_SCOPE(name) do {} while(0)
+#define PROFILE_BEGIN(name) do {} while(0)
+#define PROFILE_END(name) do {} while(0)
+
+#endif
+
+#endif /* PROFILE_H */
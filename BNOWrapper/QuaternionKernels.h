@@ -0,0 +1,218 @@
+#ifndef QUATERNION_KERNELS_H
+#define QUATERNION_KERNELS_H
+
+/**
+ * @file QuaternionKernels.h
+ *
+ * @brief Fixed-size kernels for the hot quaternion and small matrix operations.
+ *
+ * These work on plain float arrays -- quaternions in x,y,z,w order like Quaternion,
+ * matrices row-major like TMatrix -- so they build no temporaries and skip the
+ * element accessors.  Every kernel may be called with the output aliasing an input.
+ *
+ * The scalar code is written so that GCC turns it into fused multiply-adds on the
+ * Cortex-M7's single precision FPU (which has no vector unit).  On hosts with SSE or
+ * AArch64 NEON, the 4x4 matrix-vector product and the batch kernels use explicit
+ * 4-wide code.  A single quaternion product is left scalar: the shuffles cost more
+ * than they save.
+ *
+ * Define QUATERNION_KERNELS_SCALAR to force the scalar versions everywhere.
+ */
+
+#include <stddef.h>
+#include <math.h>
+
+#if !defined(QUATERNION_KERNELS_SCALAR) && (defined(__SSE__) || defined(_M_X64))
+#define QUATERNION_KERNELS_SSE 1
+#include <xmmintrin.h>
+#elif !defined(QUATERNION_KERNELS_SCALAR) && defined(__aarch64__) && defined(__ARM_NEON)
+#define QUATERNION_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+/**
+ * @brief Quaternion product out = a * b, same convention as Quaternion::product().
+ */
+inline void quatProduct(const float* a, const float* b, float* out)
+{
+	const float ax = a[0], ay = a[1], az = a[2], aw = a[3];
+	const float bx = b[0], by = b[1], bz = b[2], bw = b[3];
+
+	out[0] = aw*bx + ax*bw + ay*bz - az*by;
+	out[1] = aw*by - ax*bz + ay*bw + az*bx;
+	out[2] = aw*bz + ax*by - ay*bx + az*bw;
+	out[3] = aw*bw - ax*bx - ay*by - az*bz;
+}
+
+/**
+ * @brief Rotates v by the unit quaternion q.
+ *
+ * Uses t = 2 (q.xyz x v), v' = v + w t + q.xyz x t, which is 15 multiplies
+ * instead of the 32 needed for q * v * q.conjugate().
+ */
+inline void quatRotate(const float* q, const float* v, float* out)
+{
+	const float qx = q[0], qy = q[1], qz = q[2], qw = q[3];
+	const float vx = v[0], vy = v[1], vz = v[2];
+
+	const float tx = 2 * (qy*vz - qz*vy);
+	const float ty = 2 * (qz*vx - qx*vz);
+	const float tz = 2 * (qx*vy - qy*vx);
+
+	out[0] = vx + qw*tx + (qy*tz - qz*ty);
+	out[1] = vy + qw*ty + (qz*tx - qx*tz);
+	out[2] = vz + qw*tz + (qx*ty - qy*tx);
+}
+
+/**
+ * @brief Scales q to unit length in place.  A zero quaternion is left unchanged.
+ */
+inline void quatNormalize(float* q)
+{
+	const float n2 = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+	if (n2 > 0) {
+		const float inv = 1.0f / sqrtf(n2);
+		q[0] *= inv;
+		q[1] *= inv;
+		q[2] *= inv;
+		q[3] *= inv;
+	}
+}
+
+/**
+ * @brief out = m * v for a row-major 3x3 matrix.
+ */
+inline void matVec3(const float* m, const float* v, float* out)
+{
+	const float vx = v[0], vy = v[1], vz = v[2];
+
+	out[0] = m[0]*vx + m[1]*vy + m[2]*vz;
+	out[1] = m[3]*vx + m[4]*vy + m[5]*vz;
+	out[2] = m[6]*vx + m[7]*vy + m[8]*vz;
+}
+
+/**
+ * @brief out = m * v for a row-major 4x4 matrix.
+ */
+inline void matVec4(const float* m, const float* v, float* out)
+{
+#if QUATERNION_KERNELS_SSE
+	// accumulate columns: out = m.col0*vx + m.col1*vy + ..., with the columns
+	// gathered by a transpose of the rows
+	__m128 r0 = _mm_loadu_ps(m);
+	__m128 r1 = _mm_loadu_ps(m + 4);
+	__m128 r2 = _mm_loadu_ps(m + 8);
+	__m128 r3 = _mm_loadu_ps(m + 12);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	__m128 r = _mm_mul_ps(r0, _mm_set1_ps(v[0]));
+	r = _mm_add_ps(r, _mm_mul_ps(r1, _mm_set1_ps(v[1])));
+	r = _mm_add_ps(r, _mm_mul_ps(r2, _mm_set1_ps(v[2])));
+	r = _mm_add_ps(r, _mm_mul_ps(r3, _mm_set1_ps(v[3])));
+	_mm_storeu_ps(out, r);
+#else
+	const float vx = v[0], vy = v[1], vz = v[2], vw = v[3];
+
+	out[0] = m[0]*vx  + m[1]*vy  + m[2]*vz  + m[3]*vw;
+	out[1] = m[4]*vx  + m[5]*vy  + m[6]*vz  + m[7]*vw;
+	out[2] = m[8]*vx  + m[9]*vy  + m[10]*vz + m[11]*vw;
+	out[3] = m[12]*vx + m[13]*vy + m[14]*vz + m[15]*vw;
+#endif
+}
+
+// 4-wide helpers for the batch kernels below.  Each backend provides the same
+// handful of operations so the kernels are written once.
+#if QUATERNION_KERNELS_SSE
+typedef __m128 QKVec;
+#define QK_WIDTH 4
+inline QKVec qkLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void qkStore(float* p, QKVec v) { _mm_storeu_ps(p, v); }
+inline QKVec qkSet(float s) { return _mm_set1_ps(s); }
+inline QKVec qkAdd(QKVec a, QKVec b) { return _mm_add_ps(a, b); }
+inline QKVec qkSub(QKVec a, QKVec b) { return _mm_sub_ps(a, b); }
+inline QKVec qkMul(QKVec a, QKVec b) { return _mm_mul_ps(a, b); }
+inline QKVec qkInvSqrt(QKVec a) { return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(a)); }
+#elif QUATERNION_KERNELS_NEON
+typedef float32x4_t QKVec;
+#define QK_WIDTH 4
+inline QKVec qkLoad(const float* p) { return vld1q_f32(p); }
+inline void qkStore(float* p, QKVec v) { vst1q_f32(p, v); }
+inline QKVec qkSet(float s) { return vdupq_n_f32(s); }
+inline QKVec qkAdd(QKVec a, QKVec b) { return vaddq_f32(a, b); }
+inline QKVec qkSub(QKVec a, QKVec b) { return vsubq_f32(a, b); }
+inline QKVec qkMul(QKVec a, QKVec b) { return vmulq_f32(a, b); }
+inline QKVec qkInvSqrt(QKVec a) { return vdivq_f32(vdupq_n_f32(1.0f), vsqrtq_f32(a)); }
+#else
+#define QK_WIDTH 1
+#endif
+
+/**
+ * @brief Rotates n vectors, stored as separate x, y and z arrays, by the unit quaternion q.
+ *
+ * The outputs may be the same arrays as the inputs.
+ */
+inline void quatRotateBatch(const float* q,
+							const float* vx, const float* vy, const float* vz,
+							float* outX, float* outY, float* outZ, size_t n)
+{
+	size_t i = 0;
+	const size_t vectorEnd = n - n % QK_WIDTH;
+#if QK_WIDTH > 1
+	const QKVec qx = qkSet(q[0]), qy = qkSet(q[1]), qz = qkSet(q[2]), qw = qkSet(q[3]);
+	const QKVec two = qkSet(2.0f);
+
+	for (; i < vectorEnd; i += QK_WIDTH) {
+		const QKVec x = qkLoad(vx + i), y = qkLoad(vy + i), z = qkLoad(vz + i);
+
+		const QKVec tx = qkMul(two, qkSub(qkMul(qy, z), qkMul(qz, y)));
+		const QKVec ty = qkMul(two, qkSub(qkMul(qz, x), qkMul(qx, z)));
+		const QKVec tz = qkMul(two, qkSub(qkMul(qx, y), qkMul(qy, x)));
+
+		qkStore(outX + i, qkAdd(qkAdd(x, qkMul(qw, tx)), qkSub(qkMul(qy, tz), qkMul(qz, ty))));
+		qkStore(outY + i, qkAdd(qkAdd(y, qkMul(qw, ty)), qkSub(qkMul(qz, tx), qkMul(qx, tz))));
+		qkStore(outZ + i, qkAdd(qkAdd(z, qkMul(qw, tz)), qkSub(qkMul(qx, ty), qkMul(qy, tx))));
+	}
+#endif
+	for (i = vectorEnd; i < n; i++) {
+		const float v[3] = {vx[i], vy[i], vz[i]};
+		float r[3];
+		quatRotate(q, v, r);
+		outX[i] = r[0];
+		outY[i] = r[1];
+		outZ[i] = r[2];
+	}
+}
+
+/**
+ * @brief Normalizes n quaternions stored as separate x, y, z and w arrays, in place.
+ *
+ * Unlike quatNormalize(), zero quaternions are not special-cased in the vector path
+ * and come out as NaN.
+ */
+inline void quatNormalizeBatch(float* x, float* y, float* z, float* w, size_t n)
+{
+	size_t i = 0;
+	const size_t vectorEnd = n - n % QK_WIDTH;
+#if QK_WIDTH > 1
+	for (; i < vectorEnd; i += QK_WIDTH) {
+		const QKVec qx = qkLoad(x + i), qy = qkLoad(y + i), qz = qkLoad(z + i), qw = qkLoad(w + i);
+		const QKVec n2 = qkAdd(qkAdd(qkMul(qx, qx), qkMul(qy, qy)), qkAdd(qkMul(qz, qz), qkMul(qw, qw)));
+		const QKVec inv = qkInvSqrt(n2);
+
+		qkStore(x + i, qkMul(qx, inv));
+		qkStore(y + i, qkMul(qy, inv));
+		qkStore(z + i, qkMul(qz, inv));
+		qkStore(w + i, qkMul(qw, inv));
+	}
+#endif
+	for (i = vectorEnd; i < n; i++) {
+		float q[4] = {x[i], y[i], z[i], w[i]};
+		quatNormalize(q);
+		x[i] = q[0];
+		y[i] = q[1];
+		z[i] = q[2];
+		w[i] = q[3];
+	}
+}
+
+#endif /* QUATERNION_KERNELS_H */
@@ -0,0 +1,153 @@
+#include "RateMonitor.h"
+#include "Telemetry.h"
+#include "Profile.h"
+#include "Log.h"
+
+#include <math.h>
+
+void RateMonitor::clear(Slot& slot)
+{
+	slot.haveLast = false;
+	slot.flagged = false;
+	slot.count = 0;
+	slot.mean = 0;
+	slot.m2 = 0;
+	slot.maxGap = 0;
+	slot.missed = 0;
+}
+
+void RateMonitor::setPeriod(uint8_t report, uint32_t period)
+{
+	// disabling a report that was never enabled needn't take a slot
+	Slot* slot = period != 0 ? _slots.add(report) : _slots.find(report);
+	if(slot == NULL || slot->period == period) {
+		return;
+	}
+	slot->period = period;
+	clear(*slot);
+}
+
+void RateMonitor::sample(uint8_t report, uint32_t timestamp)
+{
+	Slot* slot = _slots.addSample(report);
+	if(slot == NULL) {
+		return;
+	}
+
+	uint32_t last = slot->lastTime;
+	slot->lastTime = timestamp;
+	if(!slot->haveLast) {
+		slot->haveLast = true;
+		return;
+	}
+
+	// the clock wraps, and the timestamps of a batch are estimated, so they can step back a little
+	int32_t difference = static_cast<int32_t>(timestamp - last);
+	uint32_t interval = difference > 0 ? static_cast<uint32_t>(difference) : 0;
+
+	slot->count++;
+	float delta = static_cast<float>(interval) - slot->mean;
+	slot->mean += delta / static_cast<float>(slot->count);
+	slot->m2 += delta * (static_cast<float>(interval) - slot->mean);
+
+	if(interval > slot->maxGap) {
+		slot->maxGap = interval;
+	}
+
+	// an interval of k periods, give or take half of one, means k - 1 samples never came
+	if(slot->period != 0 && interval >= slot->period + slot->period / 2) {
+		slot->missed += (interval + slot->period / 2) / slot->period - 1;
+	}
+
+	if(!slot->flagged && !slotMeetsRate(*slot)) {
+		slot->flagged = true;
+		LOG_MSG(RATE_LOW, report, slot->mean, slot->period);
+	}
+}
+
+bool RateMonitor::slotMeetsRate(const Slot& slot)
+{
+	if(slot.period == 0 || slot.count < RATE_MONITOR_MIN_INTERVALS) {
+		return true;
+	}
+	if(slot.mean * 100 > static_cast<float>(slot.period) * (100 + RATE_MONITOR_TOLERANCE)) {
+		return false;
+	}
+	return static_cast<uint64_t>(slot.missed) * 100 <= static_cast<uint64_t>(slot.count + slot.missed) * RATE_MONITOR_TOLERANCE;
+}
+
+bool RateMonitor::meetsRate(uint8_t report) const
+{
+	const Slot* slot = _slots.find(report);
+	return slot == NULL || slotMeetsRate(*slot);
+}
+
+bool RateMonitor::stats(uint8_t report, RateStats& stats) const
+{
+	const Slot* slot = _slots.find(report);
+	if(slot == NULL || slot->count == 0) {
+		return false;
+	}
+
+	stats.period = slot->period;
+	stats.count = slot->count;
+	stats.mean = slot->mean;
+	stats.stddev = slot->count > 1 ? sqrtf(slot->m2 / static_cast<float>(slot->count - 1)) : 0;
+	stats.maxGap = slot->maxGap;
+	stats.missed = slot->missed;
+	stats.meetsRate = slotMeetsRate(*slot);
+	return true;
+}
+
+void RateMonitor::resetStatistics()
+{
+	for(uint8_t i = 0; i < _slots.size(); i++) {
+		clear(_slots[i]);
+	}
+	_slots.resetUntracked();
+}
+
+static int16_t saturate16(uint32_t value)
+{
+	return static_cast<int16_t>(value > UINT16_MAX ? UINT16_MAX : value);
+}
+
+void RateMonitor::send(TelemetryEncoder& encoder, uint32_t timestamp) const
+{
+	RateStats rate;
+	for(uint8_t i = 0; i < _slots.size(); i++) {
+		if(!stats(_slots[i].report, rate)) {
+			continue;
+		}
+
+		int16_t words[7] = {
+			static_cast<int16_t>(_slots[i].report | (rate.meetsRate ? 0 : 1) << 8),
+			saturate16(rate.count),
+			saturate16(rate.missed),
+			static_cast<int16_t>(profileEncodeTime(rate.period)),
+			static_cast<int16_t>(profileEncodeTime(static_cast<uint32_t>(rate.mean + 0.5f))),
+			static_cast<int16_t>(profileEncodeTime(static_cast<uint32_t>(rate.stddev + 0.5f))),
+			static_cast<int16_t>(profileEncodeTime(rate.maxGap))
+		};
+		encoder.add(TELEMETRY_REPORTID_RATE, 0, timestamp, words, 7);
+	}
+}
+
+void RateMonitor::print(Stream& out) const
+{
+	RateStats rate;
+	out.printf("%-22s %10s %10s %10s %10s %10s %8s %s\n", "# report (us)", "period", "intervals", "mean", "stddev",
+			   "max gap", "missed", "rate");
+	for(uint8_t i = 0; i < _slots.size(); i++) {
+		if(!stats(_slots[i].report, rate)) {
+			continue;
+		}
+		_slots.printName(out, _slots[i].report, 22);
+		out.printf(" %10u %10u %10.1f %10.1f %10u %8u %s\n", static_cast<unsigned>(rate.period),
+				   static_cast<unsigned>(rate.count), static_cast<double>(rate.mean), static_cast<double>(rate.stddev),
+				   static_cast<unsigned>(rate.maxGap), static_cast<unsigned>(rate.missed), rate.meetsRate ? "ok" : "LOW");
+	}
+	if(_slots.untracked() > 0) {
+		out.printf("# %u samples of unmonitored reports\n", static_cast<unsigned>(_slots.untracked()));
+	}
+}
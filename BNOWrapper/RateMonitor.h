@@ -0,0 +1,124 @@
+#ifndef RATE_MONITOR_H
+#define RATE_MONITOR_H
+
+/**
+ * @file RateMonitor.h
+ *
+ * @brief Whether each report really arrives at the rate it was enabled at.
+ *
+ * The IMU rounds the requested intervals, batching delivers samples in groups,
+ * and a slow loop lets the IMU's queue overflow, so the spacing of the samples
+ * the firmware gets can differ from what enableReport() asked for.  The monitor
+ * keeps, per report, the mean and standard deviation of the interval between
+ * consecutive sample timestamps (Welford's method, so a sample costs one
+ * division and no history), the longest gap, and how many periods had no sample.
+ *
+ * The driver tells it each report's period: the one requested in enableReport(),
+ * then the one the IMU answers with in its Get Feature Response.  Attach the
+ * monitor before enabling reports:
+ *
+ *     RateMonitor rates;
+ *     imu.attachRateMonitor(&rates);
+ *     imu.enableReport(BNO080::ROTATION, 10);
+ *     ...
+ *     if(!rates.meetsRate(BNO080::ROTATION)) ...
+ *
+ * A report that falls short (see meetsRate()) logs RATE_LOW once, until its
+ * statistics are reset.  Cheap enough to leave on.
+ */
+
+#include <mbed.h>
+#include "ReportSlots.h"
+
+/// Reports monitored, in the order they are enabled.  Samples of further reports are only counted.
+#ifndef RATE_MONITOR_REPORTS
+#define RATE_MONITOR_REPORTS 8
+#endif
+
+/// How far, in percent, the mean interval and the share of missed periods may be off before a report is flagged
+#ifndef RATE_MONITOR_TOLERANCE
+#define RATE_MONITOR_TOLERANCE 10
+#endif
+
+/// Intervals a report needs before it is judged
+#define RATE_MONITOR_MIN_INTERVALS 16
+
+/**
+ * @brief Interval statistics of one report, in us.
+ */
+struct RateStats {
+	uint32_t period;		///< configured period, 0 if unknown
+	uint32_t count;			///< intervals measured
+	float mean;
+	float stddev;
+	uint32_t maxGap;		///< longest interval
+	uint32_t missed;		///< periods with no sample, going by the configured period
+	bool meetsRate;			///< see RateMonitor::meetsRate()
+};
+
+class TelemetryEncoder;
+
+class RateMonitor {
+public:
+
+	/**
+	 * Called by the driver when a report is configured.  A new period restarts the report's statistics.
+	 *
+	 * @param period Time between samples in us, 0 when the report is disabled
+	 */
+	void setPeriod(uint8_t report, uint32_t period);
+
+	/// Called by the driver with the timestamp, in us, of every sample
+	void sample(uint8_t report, uint32_t timestamp);
+
+	/**
+	 * Whether a report arrives at its configured rate: its mean interval is at most
+	 * RATE_MONITOR_TOLERANCE percent longer than the period, and at most that share of
+	 * the periods had no sample.  True until RATE_MONITOR_MIN_INTERVALS intervals are in,
+	 * and for reports with no known period.
+	 */
+	bool meetsRate(uint8_t report) const;
+
+	/**
+	 * @return false if the report isn't monitored or has no intervals yet.
+	 */
+	bool stats(uint8_t report, RateStats& stats) const;
+
+	/// Samples of reports beyond the first RATE_MONITOR_REPORTS
+	uint32_t untrackedSamples() const { return _slots.untracked(); }
+
+	/// Restarts the statistics of all reports.  The periods are kept.
+	void resetStatistics();
+
+	/**
+	 * Sends a TELEMETRY_REPORTID_RATE record for each report with intervals.
+	 * Does not flush the encoder.
+	 */
+	void send(TelemetryEncoder& encoder, uint32_t timestamp) const;
+
+	/// Prints a table of the reports
+	void print(Stream& out) const;
+
+private:
+
+	struct Slot {
+		uint8_t report;
+		bool haveLast;
+		bool flagged;
+		uint32_t period;
+		uint32_t lastTime;
+		uint32_t count;
+		float mean;
+		/// sum of squared differences from the mean
+		float m2;
+		uint32_t maxGap;
+		uint32_t missed;
+	};
+
+	ReportSlots<Slot, RATE_MONITOR_REPORTS> _slots;
+
+	static void clear(Slot& slot);
+	static bool slotMeetsRate(const Slot& slot);
+};
+
+#endif /* RATE_MONITOR_H */
@@ -0,0 +1,207 @@
+#include "ReportResampler.h"
+#include "Profile.h"
+
+#include <string.h>
+
+ReportResampler::ReportResampler(uint32_t outputPeriod) :
+	_numChannels(0),
+	_quaternionInterpolation(NLERP)
+{
+	setOutputPeriod(outputPeriod);
+}
+
+int8_t ReportResampler::addChannel(uint8_t reportID, Kind kind)
+{
+	if(_numChannels >= RESAMPLER_MAX_CHANNELS || channel(reportID) >= 0) {
+		return -1;
+	}
+
+	Channel& c = _channels[_numChannels++];
+	c.reportID = reportID;
+	c.kind = static_cast<uint8_t>(kind);
+
+	restart();
+	return static_cast<int8_t>(_numChannels - 1);
+}
+
+void ReportResampler::removeAllChannels()
+{
+	_numChannels = 0;
+	restart();
+}
+
+int8_t ReportResampler::channel(uint8_t reportID) const
+{
+	for(uint8_t i = 0; i < _numChannels; i++) {
+		if(_channels[i].reportID == reportID) {
+			return static_cast<int8_t>(i);
+		}
+	}
+	return -1;
+}
+
+void ReportResampler::setOutputPeriod(uint32_t outputPeriod)
+{
+	// a zero period would put every output at the same time
+	_outputPeriod = outputPeriod > 0 ? outputPeriod : 1;
+	_maxLatency = (RESAMPLER_FRAME_DEPTH - 1) * _outputPeriod;
+	restart();
+}
+
+void ReportResampler::restart()
+{
+	_started = false;
+	_origin = 0;
+	_head = 0;
+	_newestTime = 0;
+	_droppedFrames = 0;
+	memset(_writtenMask, 0, sizeof(_writtenMask));
+	memset(_frames, 0, sizeof(_frames));
+
+	for(uint8_t i = 0; i < _numChannels; i++) {
+		_channels[i].hasSample = false;
+		_channels[i].nextIndex = 0;
+	}
+}
+
+bool ReportResampler::push(uint8_t reportID, uint32_t timestamp, const float* value)
+{
+	int8_t index = channel(reportID);
+	if(index < 0) {
+		return false;
+	}
+	Channel& c = _channels[index];
+
+	if(c.hasSample && static_cast<int32_t>(timestamp - c.lastTime) <= 0) {
+		return false;
+	}
+
+	if(!_started) {
+		_started = true;
+		_origin = timestamp;
+		_newestTime = timestamp;
+	} else if(static_cast<int32_t>(timestamp - _newestTime) > 0) {
+		_newestTime = timestamp;
+	}
+
+	// outputs that poll() already returned can't be filled any more
+	if(static_cast<int32_t>(c.nextIndex - _head) < 0) {
+		c.nextIndex = _head;
+	}
+
+	// fill every output time up to this sample
+	int32_t sinceOrigin = static_cast<int32_t>(timestamp - _origin);
+	if(sinceOrigin >= 0) {
+		uint32_t lastIndex = static_cast<uint32_t>(sinceOrigin) / _outputPeriod;
+
+		if(static_cast<int32_t>(lastIndex - c.nextIndex) >= 0) {
+			makeRoom(lastIndex);
+
+			// anything before the ring's oldest frame has just been dropped
+			if(static_cast<int32_t>(c.nextIndex - _head) < 0) {
+				c.nextIndex = _head;
+			}
+
+			const uint8_t bit = static_cast<uint8_t>(1 << index);
+			for(; static_cast<int32_t>(lastIndex - c.nextIndex) >= 0; c.nextIndex++) {
+				uint32_t slot = c.nextIndex % RESAMPLER_FRAME_DEPTH;
+				interpolate(c, timestamp, value, outputTime(c.nextIndex), _frames[slot].values[index]);
+				_writtenMask[slot] |= bit;
+			}
+		}
+	}
+
+	c.lastTime = timestamp;
+	memcpy(c.last, value, (c.kind == QUATERNION ? 4 : 3) * sizeof(float));
+	c.hasSample = true;
+	return true;
+}
+
+void ReportResampler::makeRoom(uint32_t lastIndex)
+{
+	if(lastIndex - _head < RESAMPLER_FRAME_DEPTH) {
+		return;
+	}
+
+	uint32_t newHead = lastIndex - (RESAMPLER_FRAME_DEPTH - 1);
+	uint32_t dropped = newHead - _head;
+	_droppedFrames += dropped;
+
+	// only the slots of the dropped frames that are still in the ring need clearing
+	if(dropped > RESAMPLER_FRAME_DEPTH) {
+		dropped = RESAMPLER_FRAME_DEPTH;
+	}
+	for(uint32_t i = 0; i < dropped; i++) {
+		_writtenMask[(_head + i) % RESAMPLER_FRAME_DEPTH] = 0;
+	}
+	_head = newHead;
+}
+
+void ReportResampler::interpolate(const Channel& c, uint32_t timestamp, const float* value, uint32_t t, float* out) const
+{
+	const uint8_t size = c.kind == QUATERNION ? 4 : 3;
+
+	// before a channel's first sample there is nothing to interpolate from, so the
+	// first value is held back to the output times it covers
+	if(!c.hasSample || static_cast<int32_t>(t - c.lastTime) <= 0) {
+		memcpy(out, c.hasSample ? c.last : value, size * sizeof(float));
+		return;
+	}
+
+	float alpha = static_cast<float>(t - c.lastTime) / static_cast<float>(timestamp - c.lastTime);
+
+	if(c.kind == QUATERNION) {
+		Quaternion a(c.last), b(value);
+		Quaternion q = _quaternionInterpolation == SLERP ? Quaternion::slerp(a, b, alpha) : Quaternion::nlerp(a, b, alpha);
+		memcpy(out, q.row(0), 4 * sizeof(float));
+	} else {
+		for(uint8_t i = 0; i < size; i++) {
+			out[i] = c.last[i] + (value[i] - c.last[i]) * alpha;
+		}
+	}
+}
+
+bool ReportResampler::poll(ResampledFrame& frame)
+{
+	PROFILE_SCOPE(RESAMPLER_POLL);
+
+	if(!_started || _numChannels == 0) {
+		return false;
+	}
+
+	const uint8_t allChannels = static_cast<uint8_t>((1 << _numChannels) - 1);
+	const uint32_t slot = _head % RESAMPLER_FRAME_DEPTH;
+	const uint32_t t = outputTime(_head);
+	uint8_t written = _writtenMask[slot];
+
+	if(written != allChannels) {
+		// wait for the slower channels unless they are too far behind
+		if(static_cast<int32_t>(_newestTime - t) <= static_cast<int32_t>(_maxLatency)) {
+			return false;
+		}
+
+		for(uint8_t i = 0; i < _numChannels; i++) {
+			if(written & (1 << i)) {
+				continue;
+			}
+
+			const Channel& c = _channels[i];
+			float* out = _frames[slot].values[i];
+			if(c.hasSample) {
+				memcpy(out, c.last, (c.kind == QUATERNION ? 4 : 3) * sizeof(float));
+			} else {
+				// no sample yet: zero vector or identity rotation
+				out[0] = out[1] = out[2] = 0;
+				out[3] = c.kind == QUATERNION ? 1 : 0;
+			}
+		}
+	}
+
+	frame = _frames[slot];
+	frame.timestamp = t;
+	frame.staleMask = static_cast<uint8_t>(allChannels & ~written);
+
+	_writtenMask[slot] = 0;
+	_head++;
+	return true;
+}
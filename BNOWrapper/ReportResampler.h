@@ -0,0 +1,200 @@
+#ifndef REPORT_RESAMPLER_H
+#define REPORT_RESAMPLER_H
+
+/**
+ * @file ReportResampler.h
+ *
+ * @brief Puts reports that arrive at different rates onto one output clock.
+ *
+ * Every report the IMU sends has its own period and its own sample times, so the
+ * latest rotation and the latest acceleration are generally not from the same
+ * instant.  ReportResampler takes the timestamped samples of several reports
+ * (see BNO080::attachSampleCallback()) and produces frames at a fixed output
+ * period in which every report is interpolated to the frame's time: vectors
+ * linearly, quaternions with nlerp or slerp.
+ *
+ * A frame can only be finished once every report has a sample at or after its
+ * time, so output lags the slowest report by up to one of its periods.  Frames
+ * waiting for slow reports are kept in a ring of RESAMPLER_FRAME_DEPTH frames.
+ * If a report falls further behind than the maximum latency (a report that was
+ * disabled, say), the frame is released with that report's latest value held
+ * and its bit set in ResampledFrame::staleMask.
+ *
+ * All storage is fixed size.  Each pushed sample does O(1) work for every output
+ * time it covers, and poll() is O(1) per frame.
+ */
+
+#include <stdint.h>
+
+#include "quaternion.h"
+
+/// Most reports that one resampler can align
+#ifndef RESAMPLER_MAX_CHANNELS
+#define RESAMPLER_MAX_CHANNELS 4
+#endif
+
+/// Frames that can wait for slow reports at once.  Should be at least the slowest
+/// report's period divided by the output period, or that report is held instead of interpolated.
+#ifndef RESAMPLER_FRAME_DEPTH
+#define RESAMPLER_FRAME_DEPTH 8
+#endif
+
+static_assert(RESAMPLER_MAX_CHANNELS <= 8, "channel masks are 8 bits");
+
+/**
+ * @brief One output sample: every channel at the same instant.
+ */
+struct ResampledFrame {
+	/// Time of the frame in microseconds, on the clock of the pushed timestamps
+	uint32_t timestamp;
+
+	/// Bit n is set if channel n had not reached this time and holds its latest value instead
+	uint8_t staleMask;
+
+	/// Values of each channel.  Vectors use the first 3 elements, quaternions are in x,y,z,w order.
+	float values[RESAMPLER_MAX_CHANNELS][4];
+
+	TVector3 vector(uint8_t channel) const { return TVector3(values[channel]); }
+	Quaternion quaternion(uint8_t channel) const { return Quaternion(values[channel]); }
+};
+
+class ReportResampler {
+public:
+
+	/// How a channel's values are interpolated
+	enum Kind {
+		VECTOR,
+		QUATERNION
+	};
+
+	/// Interpolation used for quaternion channels
+	enum QuaternionInterpolation {
+		NLERP,
+		SLERP
+	};
+
+	/**
+	 * @param outputPeriod Time between output frames in microseconds.
+	 */
+	explicit ReportResampler(uint32_t outputPeriod = 10000);
+
+	/**
+	 * Adds a report to align.  Channels are numbered in the order they are added,
+	 * which is also their index in ResampledFrame::values.
+	 *
+	 * Restarts the output clock.
+	 *
+	 * @return The channel number, or -1 if all channels are in use or the report was already added.
+	 */
+	int8_t addChannel(uint8_t reportID, Kind kind);
+
+	/// Removes every channel.
+	void removeAllChannels();
+
+	/**
+	 * @return The channel number of a report, or -1 if it was not added.
+	 */
+	int8_t channel(uint8_t reportID) const;
+
+	uint8_t numChannels() const { return _numChannels; }
+
+	/**
+	 * Sets the time between output frames.  Restarts the output clock and resets the
+	 * maximum latency to its default.
+	 */
+	void setOutputPeriod(uint32_t outputPeriod);
+
+	uint32_t outputPeriod() const { return _outputPeriod; }
+
+	/**
+	 * Sets how long after a frame's time poll() waits for the slowest channel before
+	 * releasing the frame with stale values.  Measured against the newest timestamp pushed.
+	 * Defaults to RESAMPLER_FRAME_DEPTH - 1 output periods, the most the ring can hold.
+	 */
+	void setMaxLatency(uint32_t maxLatency) { _maxLatency = maxLatency; }
+
+	void setQuaternionInterpolation(QuaternionInterpolation interpolation) { _quaternionInterpolation = interpolation; }
+
+	/**
+	 * Drops all pending frames and samples.  The next pushed sample starts a new output clock.
+	 */
+	void restart();
+
+	// @{
+	/**
+	 * Adds a sample of a report.  Samples of one report must come in time order.
+	 *
+	 * @param timestamp Sample time in microseconds, e.g. from BNO080::getReportTimestamp().
+	 *
+	 * @return false if the report has no channel or the sample is not newer than the previous one.
+	 */
+	bool push(uint8_t reportID, uint32_t timestamp, const float* value);
+	bool push(uint8_t reportID, uint32_t timestamp, const TVector3& value) { return push(reportID, timestamp, value.row(0)); }
+	bool push(uint8_t reportID, uint32_t timestamp, const Quaternion& value) { return push(reportID, timestamp, value.row(0)); }
+	// @}
+
+	/**
+	 * Gets the next output frame, if it is complete (or has waited longer than the maximum latency).
+	 * Call until it returns false after pushing samples.
+	 *
+	 * @return Whether a frame was written to @p frame.
+	 */
+	bool poll(ResampledFrame& frame);
+
+	/**
+	 * @return Frames dropped because the ring was full before poll() took them.
+	 */
+	uint32_t droppedFrames() const { return _droppedFrames; }
+
+private:
+
+	struct Channel {
+		uint8_t reportID;
+		uint8_t kind;
+		bool hasSample;
+
+		/// Index of the next output time this channel has to fill
+		uint32_t nextIndex;
+
+		/// Latest sample
+		uint32_t lastTime;
+		float last[4];
+	};
+
+	Channel _channels[RESAMPLER_MAX_CHANNELS];
+	uint8_t _numChannels;
+
+	/// Ring of pending frames, output index i is in slot i % RESAMPLER_FRAME_DEPTH
+	ResampledFrame _frames[RESAMPLER_FRAME_DEPTH];
+
+	/// Bit n is set once channel n has filled the frame in the same slot
+	uint8_t _writtenMask[RESAMPLER_FRAME_DEPTH];
+
+	uint32_t _outputPeriod;
+	uint32_t _maxLatency;
+	QuaternionInterpolation _quaternionInterpolation;
+
+	/// Whether a sample has set the output clock
+	bool _started;
+
+	/// Time of output index 0
+	uint32_t _origin;
+
+	/// Output index of the oldest frame not yet returned by poll()
+	uint32_t _head;
+
+	/// Newest timestamp pushed on any channel
+	uint32_t _newestTime;
+
+	uint32_t _droppedFrames;
+
+	uint32_t outputTime(uint32_t index) const { return _origin + index * _outputPeriod; }
+
+	/// Drops pending frames until output index lastIndex fits in the ring
+	void makeRoom(uint32_t lastIndex);
+
+	/// Writes channel c's value at time t, between its latest sample and (timestamp, value)
+	void interpolate(const Channel& c, uint32_t timestamp, const float* value, uint32_t t, float* out) const;
+};
+
+#endif /* REPORT_RESAMPLER_H */
@@ -0,0 +1,104 @@
+#ifndef REPORT_SLOTS_H
+#define REPORT_SLOTS_H
+
+/**
+ * @file ReportSlots.h
+ *
+ * @brief Fixed size table of per report state, for LatencyTracer and RateMonitor.
+ *
+ * Reports get a slot in the order they first show up, up to N of them; the
+ * samples of any further report are only counted.  A slot is any plain struct
+ * with a uint8_t report member, and starts out zeroed.
+ */
+
+#include <mbed.h>
+
+#include "Telemetry.h"
+
+template<typename Slot, uint8_t N>
+class ReportSlots {
+public:
+
+	ReportSlots()
+	{
+		clear();
+	}
+
+	/// Forgets all reports
+	void clear()
+	{
+		memset(_slots, 0, sizeof(_slots));
+		_size = 0;
+		_untracked = 0;
+	}
+
+	/// The report's slot, or NULL if it has none
+	Slot* find(uint8_t report)
+	{
+		for(uint8_t i = 0; i < _size; i++) {
+			if(_slots[i].report == report) {
+				return &_slots[i];
+			}
+		}
+		return NULL;
+	}
+
+	const Slot* find(uint8_t report) const
+	{
+		return const_cast<ReportSlots*>(this)->find(report);
+	}
+
+	/// The report's slot, a new one if it has none yet, or NULL if the table is full
+	Slot* add(uint8_t report)
+	{
+		Slot* slot = find(report);
+		if(slot != NULL || _size >= N) {
+			return slot;
+		}
+		slot = &_slots[_size++];
+		slot->report = report;
+		return slot;
+	}
+
+	/// add() for a sample: one that finds the table full is counted in untracked()
+	Slot* addSample(uint8_t report)
+	{
+		Slot* slot = add(report);
+		if(slot == NULL) {
+			_untracked++;
+		}
+		return slot;
+	}
+
+	/// Slots in use, in the order their reports showed up
+	uint8_t size() const { return _size; }
+
+	Slot& operator[](uint8_t i) { return _slots[i]; }
+	const Slot& operator[](uint8_t i) const { return _slots[i]; }
+
+	/// Samples of reports that found the table full
+	uint32_t untracked() const { return _untracked; }
+
+	void resetUntracked() { _untracked = 0; }
+
+	/// Prints the report's name, or ?<ID> if it has no telemetry schema, left aligned in width characters
+	static void printName(Stream& out, uint8_t report, int width)
+	{
+		const TelemetrySchema* schema = telemetrySchema(report);
+		if(schema != NULL) {
+			out.printf("%-*s", width, schema->name);
+		} else {
+			char id[4];
+			snprintf(id, sizeof(id), "?%02x", report);
+			out.printf("%-*s", width, id);
+		}
+	}
+
+private:
+
+	Slot _slots[N];
+	uint8_t _size;
+	uint32_t _untracked;
+};
+
+#endif /* REPORT_SLOTS_H */
@@ -0,0 +1,41 @@
+#include "ShtpCapture.h"
+
+static_assert(SHTP_CAPTURE_MARKER != TELEMETRY_VERSION, "capture frames must not look like telemetry frames");
+
+ShtpCaptureEncoder::ShtpCaptureEncoder(Stream& out) :
+	_writer(out),
+	_packetsTruncated(0)
+{
+}
+
+void ShtpCaptureEncoder::add(bool outbound, uint32_t timestamp, const uint8_t* data, size_t length)
+{
+	uint8_t flags = outbound ? SHTP_CAPTURE_OUTBOUND : 0;
+	if(length > SHTP_CAPTURE_MAX_PACKET) {
+		length = SHTP_CAPTURE_MAX_PACKET;
+		flags |= SHTP_CAPTURE_TRUNCATED;
+		_packetsTruncated++;
+	}
+
+	_frame[0] = SHTP_CAPTURE_MARKER;
+	_frame[1] = _writer.sequence();
+	_frame[2] = flags;
+	_frame[3] = static_cast<uint8_t>(timestamp);
+	_frame[4] = static_cast<uint8_t>(timestamp >> 8);
+	_frame[5] = static_cast<uint8_t>(timestamp >> 16);
+	_frame[6] = static_cast<uint8_t>(timestamp >> 24);
+	memcpy(_frame + SHTP_CAPTURE_HEADER_SIZE, data, length);
+
+	_writer.write(_frame, SHTP_CAPTURE_HEADER_SIZE + length, _encoded);
+}
+
+ShtpCaptureDecoder::ShtpCaptureDecoder() :
+	_reader(_buffer, _frame, SHTP_CAPTURE_HEADER_SIZE + 2, SHTP_CAPTURE_MAX_FRAME, SHTP_CAPTURE_MARKER)
+{
+}
+
+uint32_t ShtpCaptureDecoder::timestamp() const
+{
+	return static_cast<uint32_t>(_frame[3]) | static_cast<uint32_t>(_frame[4]) << 8 |
+		   static_cast<uint32_t>(_frame[5]) << 16 | static_cast<uint32_t>(_frame[6]) << 24;
+}
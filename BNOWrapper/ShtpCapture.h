@@ -0,0 +1,142 @@
+#ifndef SHTP_CAPTURE_H
+#define SHTP_CAPTURE_H
+
+/**
+ * @file ShtpCapture.h
+ *
+ * @brief Records the raw SHTP traffic with the IMU, so a field problem can be replayed on a PC.
+ *
+ * Attach an encoder to the driver and every packet sent or read goes out on a
+ * stream, header and all, with the time the driver gave it:
+ *
+ *     ShtpCaptureEncoder capture(pc);
+ *     imu.attachPacketCallback(onPacket);     // calls capture.add(packet.outbound, ...)
+ *
+ * host/shtp_replay then feeds the capture through the unmodified driver, with
+ * the interrupts at their recorded times, so every sample comes out with the
+ * timestamp it had on the board.
+ *
+ * Wire format.  One packet per frame:
+ *
+ *     marker       1 byte   SHTP_CAPTURE_MARKER
+ *     sequence     1 byte   frame counter, to spot lost frames
+ *     flags        1 byte   SHTP_CAPTURE_OUTBOUND, SHTP_CAPTURE_TRUNCATED
+ *     timestamp    4 bytes  in us, little endian: for a packet read, the interrupt that announced it
+ *     packet       the SHTP header and payload, as they went over the bus
+ *     crc          2 bytes  CRC-16/CCITT-FALSE of all the bytes above, little endian
+ *
+ * framed like the telemetry of Telemetry.h, by the same CobsFrameWriter: COBS
+ * encoded and ended with a 0 byte.  The marker differs from TELEMETRY_VERSION, so a capture decoder skips
+ * telemetry frames; telemetry_decode counts capture frames as bad ones.
+ */
+
+#include <mbed.h>
+
+#include "Telemetry.h"
+
+/// First byte of every capture frame
+#define SHTP_CAPTURE_MARKER 0xC5
+
+/// Flag of a packet sent to the IMU
+#define SHTP_CAPTURE_OUTBOUND 0x01
+
+/// Flag of a packet that was longer than SHTP_CAPTURE_MAX_PACKET and got cut
+#define SHTP_CAPTURE_TRUNCATED 0x02
+
+/// Longest packet captured whole.  The IMU's packets are at most about 270 bytes; the driver keeps 128 of them.
+#ifndef SHTP_CAPTURE_MAX_PACKET
+#define SHTP_CAPTURE_MAX_PACKET 276
+#endif
+
+/// Frame header: marker, sequence, flags and timestamp
+#define SHTP_CAPTURE_HEADER_SIZE 7
+
+/// Largest frame before COBS encoding, header and CRC included
+#define SHTP_CAPTURE_MAX_FRAME (SHTP_CAPTURE_HEADER_SIZE + SHTP_CAPTURE_MAX_PACKET + 2)
+
+/// Longest COBS encoding of a frame, plus the 0 delimiter
+#define SHTP_CAPTURE_MAX_ENCODED (SHTP_CAPTURE_MAX_FRAME + SHTP_CAPTURE_MAX_FRAME / 254 + 2)
+
+/**
+ * @brief Writes each packet to a stream as one capture frame.
+ *
+ * Frames go out as soon as they are added.  With a BufferedSerialTx they are
+ * only queued, so capturing costs the driver little more than the copy.
+ */
+class ShtpCaptureEncoder {
+public:
+
+	explicit ShtpCaptureEncoder(Stream& out);
+
+	/**
+	 * Writes one packet.
+	 *
+	 * @param data The packet, its SHTP header included
+	 */
+	void add(bool outbound, uint32_t timestamp, const uint8_t* data, size_t length);
+
+	/// Packets written so far
+	uint32_t packetsSent() const { return _writer.framesSent(); }
+
+	/// Packets cut to SHTP_CAPTURE_MAX_PACKET
+	uint32_t packetsTruncated() const { return _packetsTruncated; }
+
+	/// Bytes written so far, framing included
+	uint32_t bytesSent() const { return _writer.bytesSent(); }
+
+private:
+	CobsFrameWriter _writer;
+	uint8_t _frame[SHTP_CAPTURE_MAX_FRAME];
+	uint8_t _encoded[SHTP_CAPTURE_MAX_ENCODED];
+	uint32_t _packetsTruncated;
+};
+
+/**
+ * @brief Finds capture frames in a byte stream.
+ *
+ * Feed it bytes with push(); when it returns true a frame passed its CRC check,
+ * and its packet can be read until the next push().
+ */
+class ShtpCaptureDecoder {
+public:
+
+	ShtpCaptureDecoder();
+
+	/**
+	 * @return true if the byte completed a valid capture frame.
+	 */
+	bool push(uint8_t byte) { return _reader.push(byte); }
+
+	/**
+	 * Decodes one whole COBS encoded frame, without its 0 delimiter.
+	 *
+	 * @return true if it is a valid capture frame.
+	 */
+	bool decodeFrame(const uint8_t* data, size_t length) { return _reader.decodeFrame(data, length); }
+
+	bool outbound() const { return (_frame[2] & SHTP_CAPTURE_OUTBOUND) != 0; }
+	bool truncated() const { return (_frame[2] & SHTP_CAPTURE_TRUNCATED) != 0; }
+	uint32_t timestamp() const;
+
+	/// The packet of the current frame, its SHTP header included
+	const uint8_t* packet() const { return _frame + SHTP_CAPTURE_HEADER_SIZE; }
+	size_t packetLength() const { return _reader.frameLength() - SHTP_CAPTURE_HEADER_SIZE; }
+
+	uint32_t validFrames() const { return _reader.validFrames(); }
+
+	/// Frames dropped for a bad CRC, bad COBS or too much data
+	uint32_t badFrames() const { return _reader.badFrames(); }
+
+	/// Frames of other kinds, like telemetry, that were skipped
+	uint32_t otherFrames() const { return _reader.otherFrames(); }
+
+	/// Frames missing between valid frames, going by their sequence numbers
+	uint32_t lostFrames() const { return _reader.lostFrames(); }
+
+private:
+	uint8_t _buffer[SHTP_CAPTURE_MAX_ENCODED];
+	uint8_t _frame[SHTP_CAPTURE_MAX_ENCODED];
+	CobsFrameReader _reader;
+};
+
+#endif /* SHTP_CAPTURE_H */
@@ -0,0 +1,325 @@
+#include "Telemetry.h"
+
+#define TELEMETRY_SCHEMA_ENTRY(name, reportID, version, numWords, qPoint, lastQPoint) \
+	{#name, reportID, version, numWords, qPoint, lastQPoint},
+
+static const TelemetrySchema schemas[] = {
+	TELEMETRY_RECORDS(TELEMETRY_SCHEMA_ENTRY)
+};
+
+#define TELEMETRY_CHECK_WORDS(name, reportID, version, numWords, qPoint, lastQPoint) \
+	static_assert(numWords <= TELEMETRY_MAX_WORDS, #name " has too many words for the info byte");
+TELEMETRY_RECORDS(TELEMETRY_CHECK_WORDS)
+
+static_assert(TELEMETRY_HEADER_SIZE + TELEMETRY_RECORD_HEADER_SIZE + 2 * TELEMETRY_MAX_WORDS + 2 <= TELEMETRY_MAX_FRAME,
+			  "the largest record must fit in a frame");
+
+const TelemetrySchema* telemetrySchema(uint8_t reportID)
+{
+	for(size_t i = 0; i < sizeof(schemas) / sizeof(schemas[0]); i++) {
+		if(schemas[i].reportID == reportID) {
+			return &schemas[i];
+		}
+	}
+	return NULL;
+}
+
+// CRC of each 4 bit value, for processing a nibble at a time
+static const uint16_t crcNibbleTable[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t telemetryCRC16(const uint8_t* data, size_t length, uint16_t crc)
+{
+	for(size_t i = 0; i < length; i++) {
+		crc = static_cast<uint16_t>((crc << 4) ^ crcNibbleTable[(crc >> 12) ^ (data[i] >> 4)]);
+		crc = static_cast<uint16_t>((crc << 4) ^ crcNibbleTable[(crc >> 12) ^ (data[i] & 0x0F)]);
+	}
+	return crc;
+}
+
+size_t cobsEncode(const uint8_t* data, size_t length, uint8_t* out)
+{
+	size_t codeIndex = 0;
+	size_t outIndex = 1;
+	uint8_t code = 1;
+
+	for(size_t i = 0; i < length; i++) {
+		if(data[i] != 0) {
+			out[outIndex++] = data[i];
+			code++;
+		}
+
+		// a zero, or a full block of 254 non-zero bytes, closes the block
+		if(data[i] == 0 || code == 0xFF) {
+			out[codeIndex] = code;
+			code = 1;
+			codeIndex = outIndex++;
+		}
+	}
+
+	out[codeIndex] = code;
+	return outIndex;
+}
+
+size_t cobsDecode(const uint8_t* data, size_t length, uint8_t* out)
+{
+	size_t inIndex = 0;
+	size_t outIndex = 0;
+
+	while(inIndex < length) {
+		uint8_t code = data[inIndex++];
+		if(code == 0 || inIndex + code - 1 > length) {
+			return 0;
+		}
+
+		for(uint8_t i = 1; i < code; i++) {
+			if(data[inIndex] == 0) {
+				return 0;
+			}
+			out[outIndex++] = data[inIndex++];
+		}
+
+		// every block but a full one or the last is followed by a zero
+		if(code != 0xFF && inIndex < length) {
+			out[outIndex++] = 0;
+		}
+	}
+
+	return outIndex;
+}
+
+CobsFrameWriter::CobsFrameWriter(Stream& out) :
+	_out(out),
+	_sequence(0),
+	_framesSent(0),
+	_bytesSent(0)
+{
+}
+
+void CobsFrameWriter::write(uint8_t* frame, size_t length, uint8_t* encoded)
+{
+	uint16_t crc = telemetryCRC16(frame, length);
+	frame[length++] = static_cast<uint8_t>(crc);
+	frame[length++] = static_cast<uint8_t>(crc >> 8);
+
+	// start with a delimiter too, so the first frame is cut off from whatever came before it
+	if(_framesSent == 0) {
+		_out.putc(0);
+		_bytesSent++;
+	}
+
+	size_t encodedLength = cobsEncode(frame, length, encoded);
+	encoded[encodedLength++] = 0;
+	for(size_t i = 0; i < encodedLength; i++) {
+		_out.putc(encoded[i]);
+	}
+
+	_bytesSent += encodedLength;
+	_framesSent++;
+	_sequence++;
+}
+
+CobsFrameReader::CobsFrameReader(uint8_t* buffer, uint8_t* frame, size_t minFrame, size_t maxFrame, uint8_t kind) :
+	_buffer(buffer),
+	_received(0),
+	_overflow(false),
+	_frame(frame),
+	_frameLength(0),
+	_minFrame(minFrame),
+	_maxFrame(maxFrame),
+	_kind(kind),
+	_haveSequence(false),
+	_lastSequence(0),
+	_validFrames(0),
+	_badFrames(0),
+	_otherFrames(0),
+	_lostFrames(0)
+{
+	memset(_frame, 0, maxFrame + maxFrame / 254 + 2);
+}
+
+bool CobsFrameReader::push(uint8_t byte)
+{
+	if(byte != 0) {
+		if(_received < _maxFrame + _maxFrame / 254 + 2) {
+			_buffer[_received++] = byte;
+		} else {
+			_overflow = true;
+		}
+		return false;
+	}
+
+	// end of a frame
+	bool valid = false;
+	if(_overflow) {
+		_badFrames++;
+	} else if(_received > 0) {
+		valid = decodeFrame(_buffer, _received);
+	}
+	_received = 0;
+	_overflow = false;
+	return valid;
+}
+
+bool CobsFrameReader::decodeFrame(const uint8_t* data, size_t length)
+{
+	if(length > _maxFrame + _maxFrame / 254 + 1) {
+		_badFrames++;
+		return false;
+	}
+
+	size_t frameLength = cobsDecode(data, length, _frame);
+	if(frameLength > 0 && _frame[0] != _kind) {
+		_otherFrames++;
+		return false;
+	}
+	if(frameLength < _minFrame || frameLength > _maxFrame) {
+		_badFrames++;
+		return false;
+	}
+
+	uint16_t crc = static_cast<uint16_t>(_frame[frameLength - 2] | _frame[frameLength - 1] << 8);
+	if(telemetryCRC16(_frame, frameLength - 2) != crc) {
+		_badFrames++;
+		return false;
+	}
+
+	uint8_t sequence = _frame[1];
+	if(_haveSequence) {
+		_lostFrames += static_cast<uint8_t>(sequence - _lastSequence - 1);
+	}
+	_haveSequence = true;
+	_lastSequence = sequence;
+
+	_frameLength = frameLength - 2;
+	_validFrames++;
+	return true;
+}
+
+TelemetryEncoder::TelemetryEncoder(Stream& out) :
+	_writer(out),
+	_length(0)
+{
+}
+
+bool TelemetryEncoder::add(uint8_t reportID, uint8_t status, uint32_t timestamp, const int16_t* words, uint8_t numWords)
+{
+	const TelemetrySchema* schema = telemetrySchema(reportID);
+	if(schema == NULL || numWords < schema->numWords) {
+		return false;
+	}
+
+	size_t recordLength = TELEMETRY_RECORD_HEADER_SIZE + 2 * schema->numWords;
+	if(_length + recordLength + 2 > TELEMETRY_MAX_FRAME) {
+		flush();
+	}
+	if(_length == 0) {
+		_frame[0] = TELEMETRY_VERSION;
+		_frame[1] = _writer.sequence();
+		_length = TELEMETRY_HEADER_SIZE;
+	}
+
+	uint8_t* record = _frame + _length;
+	record[0] = reportID;
+	record[1] = static_cast<uint8_t>((status & 0x3) | schema->numWords << 2 | (schema->version & 0x7) << 5);
+	record[2] = static_cast<uint8_t>(timestamp);
+	record[3] = static_cast<uint8_t>(timestamp >> 8);
+	record[4] = static_cast<uint8_t>(timestamp >> 16);
+	record[5] = static_cast<uint8_t>(timestamp >> 24);
+	for(uint8_t i = 0; i < schema->numWords; i++) {
+		uint16_t word = static_cast<uint16_t>(words[i]);
+		record[TELEMETRY_RECORD_HEADER_SIZE + 2 * i] = static_cast<uint8_t>(word);
+		record[TELEMETRY_RECORD_HEADER_SIZE + 2 * i + 1] = static_cast<uint8_t>(word >> 8);
+	}
+	_length += recordLength;
+	return true;
+}
+
+void TelemetryEncoder::flush()
+{
+	if(_length == 0) {
+		return;
+	}
+
+	uint8_t encoded[TELEMETRY_MAX_ENCODED];
+	_writer.write(_frame, _length, encoded);
+	_length = 0;
+}
+
+float TelemetryRecord::value(uint8_t i) const
+{
+	if(schema == NULL) {
+		return words[i];
+	}
+	uint8_t qPoint = (i == numWords - 1) ? schema->lastQPoint : schema->qPoint;
+	return ldexpf(static_cast<float>(words[i]), -qPoint);
+}
+
+TelemetryDecoder::TelemetryDecoder() :
+	_reader(_buffer, _frame, TELEMETRY_HEADER_SIZE + 2, TELEMETRY_MAX_FRAME, TELEMETRY_VERSION),
+	_readOffset(0)
+{
+}
+
+bool TelemetryDecoder::push(uint8_t byte)
+{
+	if(!_reader.push(byte)) {
+		return false;
+	}
+	_readOffset = TELEMETRY_HEADER_SIZE;
+	return true;
+}
+
+bool TelemetryDecoder::decodeFrame(const uint8_t* data, size_t length)
+{
+	if(!_reader.decodeFrame(data, length)) {
+		return false;
+	}
+	_readOffset = TELEMETRY_HEADER_SIZE;
+	return true;
+}
+
+bool TelemetryDecoder::nextRecord(TelemetryRecord& record)
+{
+	size_t frameLength = _reader.frameLength();
+	size_t length = telemetryParseRecord(_frame + _readOffset, frameLength - _readOffset, record);
+	if(length == 0) {
+		_readOffset = frameLength;
+		return false;
+	}
+	_readOffset += length;
+	return true;
+}
+
+size_t telemetryParseRecord(const uint8_t* data, size_t length, TelemetryRecord& record)
+{
+	if(length < TELEMETRY_RECORD_HEADER_SIZE) {
+		return 0;
+	}
+
+	uint8_t numWords = (data[1] >> 2) & 0x7;
+	size_t recordLength = TELEMETRY_RECORD_HEADER_SIZE + 2 * numWords;
+	if(recordLength > length) {
+		return 0;
+	}
+
+	record.reportID = data[0];
+	record.status = data[1] & 0x3;
+	record.version = data[1] >> 5;
+	record.timestamp = static_cast<uint32_t>(data[2]) | static_cast<uint32_t>(data[3]) << 8 |
+					   static_cast<uint32_t>(data[4]) << 16 | static_cast<uint32_t>(data[5]) << 24;
+	record.numWords = numWords;
+	for(uint8_t i = 0; i < numWords; i++) {
+		record.words[i] = static_cast<int16_t>(data[TELEMETRY_RECORD_HEADER_SIZE + 2 * i] |
+											   data[TELEMETRY_RECORD_HEADER_SIZE + 2 * i + 1] << 8);
+	}
+
+	// a record from another schema version keeps its words, but can't be scaled
+	record.schema = telemetrySchema(record.reportID);
+	if(record.schema != NULL && (record.schema->version != record.version || record.schema->numWords != numWords)) {
+		record.schema = NULL;
+	}
+	return recordLength;
+}
@@ -0,0 +1,371 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+/**
+ * @file Telemetry.h
+ *
+ * @brief Compact binary telemetry of sensor samples over a serial stream.
+ *
+ * Samples are sent as they came from the IMU -- raw fixed point words and the
+ * sensor timestamp -- so the board does no float conversion or formatting, and
+ * the host gets the exact values.  A rotation vector sample takes 16 bytes,
+ * against about 40 for the Euler angles as text.
+ *
+ * Wire format.  Several records are packed into one frame:
+ *
+ *     version      1 byte   TELEMETRY_VERSION
+ *     sequence     1 byte   frame counter, to spot lost frames
+ *     records...
+ *     crc          2 bytes  CRC-16/CCITT-FALSE of all the bytes above, little endian
+ *
+ * and each record is:
+ *
+ *     report ID    1 byte   SH-2 report ID, see TELEMETRY_RECORDS
+ *     info         1 byte   bits 0-1 status, bits 2-4 number of words, bits 5-7 schema version
+ *     timestamp    4 bytes  sample time in us, little endian
+ *     words        2 bytes each, little endian, as the IMU sent them
+ *
+ * Because each record carries its length, a decoder can skip records it has no
+ * schema for.  The frame is COBS encoded and ends with a 0 byte, so a receiver
+ * that starts mid-stream, or sees other text on the same port, finds the next
+ * frame at the next 0 and drops the garbage when its CRC doesn't match.
+ *
+ * Decoding lives here too (TelemetryDecoder) and is used by host/telemetry_decode.cpp.
+ */
+
+#include <mbed.h>
+
+#include "BNO080Constants.h"
+
+/// Version of the frame layout.  Bump when the frame or record header changes.
+#define TELEMETRY_VERSION 1
+
+/// Largest frame before COBS encoding, header and CRC included
+#ifndef TELEMETRY_MAX_FRAME
+#define TELEMETRY_MAX_FRAME 96
+#endif
+
+/// Most words in one record (3 bits in the info byte)
+#define TELEMETRY_MAX_WORDS 7
+
+/// Frame header: version and sequence
+#define TELEMETRY_HEADER_SIZE 2
+
+/// Record header: report ID, info and timestamp
+#define TELEMETRY_RECORD_HEADER_SIZE 6
+
+/// Longest COBS encoding of a frame, plus the 0 delimiter
+#define TELEMETRY_MAX_ENCODED (TELEMETRY_MAX_FRAME + TELEMETRY_MAX_FRAME / 254 + 2)
+
+/// Report ID of the loop statistics that main.cpp sends, above the SH-2 sensor report IDs.
+/// Words: longest loop in us, loops in the period, TX bytes dropped in the period (each saturated at 32767).
+#define TELEMETRY_REPORTID_LOOP_STATS 0x80
+
+/// Report ID of the record that FlightRecorder::dump() sends first.
+/// Word: the FlightRecorder::Trigger mask.  Timestamp: time of the first trigger.
+#define TELEMETRY_REPORTID_FLIGHT_TRIGGER 0x81
+
+/// Report ID of the log entries that logDrain() sends (see Log.h).
+/// Words: the message ID, then each 32 bit argument as its low and high word.  Timestamp: when it was logged.
+#define TELEMETRY_REPORTID_LOG 0x82
+
+/// Report ID of the timing summaries that profileSend() sends (see Profile.h).  Words: the scope ID, the sample
+/// count as a low and a high word, then min, mean, p99 and max, each packed by profileEncodeTime().
+#define TELEMETRY_REPORTID_PROFILE 0x83
+
+/// Report ID of the latency summaries that LatencyTracer::send() sends (see LatencyTracer.h).  Words: the sensor
+/// report ID, the stage, the sample count as a low and a high word, then p50, p99 and max in us, each packed by
+/// profileEncodeTime().
+#define TELEMETRY_REPORTID_LATENCY 0x84
+
+/// Report ID of the interval summaries that RateMonitor::send() sends (see RateMonitor.h).  Words: the sensor report
+/// ID with bit 8 set if it falls short of its rate, the interval count and the missed periods (both saturated at
+/// 65535, read unsigned), then the period, mean interval, standard deviation and max gap in us, each packed by
+/// profileEncodeTime().
+#define TELEMETRY_REPORTID_RATE 0x85
+
+/**
+ * Record schema of each report: X(name, report ID, schema version, words, Q point, Q point of the last word).
+ * The last word gets its own Q point because the rotation vectors end with an accuracy in a different format.
+ * Reports that count or classify things have Q point 0.
+ * Bump a report's schema version whenever its words change meaning.
+ */
+#define TELEMETRY_RECORDS(X) \
+	X(ACCELEROMETER,          SENSOR_REPORTID_ACCELEROMETER,               1, 3, ACCELEROMETER_Q_POINT, ACCELEROMETER_Q_POINT) \
+	X(GYROSCOPE,              SENSOR_REPORTID_GYROSCOPE_CALIBRATED,        1, 3, GYRO_Q_POINT,          GYRO_Q_POINT) \
+	X(MAG_FIELD,              SENSOR_REPORTID_MAGNETIC_FIELD_CALIBRATED,   1, 3, MAGNETOMETER_Q_POINT,  MAGNETOMETER_Q_POINT) \
+	X(LINEAR_ACCELERATION,    SENSOR_REPORTID_LINEAR_ACCELERATION,         1, 3, ACCELEROMETER_Q_POINT, ACCELEROMETER_Q_POINT) \
+	X(ROTATION,               SENSOR_REPORTID_ROTATION_VECTOR,             1, 5, ROTATION_Q_POINT,      ROTATION_ACCURACY_Q_POINT) \
+	X(GRAVITY,                SENSOR_REPORTID_GRAVITY,                     1, 3, ACCELEROMETER_Q_POINT, ACCELEROMETER_Q_POINT) \
+	X(GAME_ROTATION,          SENSOR_REPORTID_GAME_ROTATION_VECTOR,        1, 4, ROTATION_Q_POINT,      ROTATION_Q_POINT) \
+	X(GEOMAGNETIC_ROTATION,   SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR, 1, 5, ROTATION_Q_POINT,      ROTATION_ACCURACY_Q_POINT) \
+	X(MAG_FIELD_UNCALIBRATED, SENSOR_REPORTID_MAGNETIC_FIELD_UNCALIBRATED, 1, 6, MAGNETOMETER_Q_POINT,  MAGNETOMETER_Q_POINT) \
+	X(TAP_DETECTOR,           SENSOR_REPORTID_TAP_DETECTOR,                1, 1, 0, 0) \
+	X(STEP_COUNTER,           SENSOR_REPORTID_STEP_COUNTER,                1, 4, 0, 0) \
+	X(SIGNIFICANT_MOTION,     SENSOR_REPORTID_SIGNIFICANT_MOTION,          1, 1, 0, 0) \
+	X(STABILITY_CLASSIFIER,   SENSOR_REPORTID_STABILITY_CLASSIFIER,        1, 1, 0, 0) \
+	X(STEP_DETECTOR,          SENSOR_REPORTID_STEP_DETECTOR,               1, 2, 0, 0) \
+	X(SHAKE_DETECTOR,         SENSOR_REPORTID_SHAKE_DETECTOR,              1, 1, 0, 0) \
+	X(LOOP_STATS,             TELEMETRY_REPORTID_LOOP_STATS,               1, 3, 0, 0) \
+	X(FLIGHT_TRIGGER,         TELEMETRY_REPORTID_FLIGHT_TRIGGER,           1, 1, 0, 0) \
+	X(LOG,                    TELEMETRY_REPORTID_LOG,                      1, 7, 0, 0) \
+	X(PROFILE,                TELEMETRY_REPORTID_PROFILE,                  1, 7, 0, 0) \
+	X(LATENCY,                TELEMETRY_REPORTID_LATENCY,                  1, 7, 0, 0) \
+	X(RATE,                   TELEMETRY_REPORTID_RATE,                     1, 7, 0, 0)
+
+/**
+ * @brief Layout of one report's records.
+ */
+struct TelemetrySchema {
+	const char* name;
+	uint8_t reportID;
+	uint8_t version;
+	uint8_t numWords;
+	uint8_t qPoint;
+	uint8_t lastQPoint;
+};
+
+/**
+ * @return The schema of a report, or NULL if it has none.
+ */
+const TelemetrySchema* telemetrySchema(uint8_t reportID);
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+ *
+ * Uses a 16 entry table, which is a fair trade of flash for speed on the MCU.
+ *
+ * @param crc CRC of the data before, to continue a running CRC.
+ */
+uint16_t telemetryCRC16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+
+/**
+ * @brief COBS encodes data, so that the output contains no 0 bytes.
+ *
+ * @param out Must hold length + length / 254 + 1 bytes.  May not alias data.
+ * @return Length of the encoding, not including any delimiter.
+ */
+size_t cobsEncode(const uint8_t* data, size_t length, uint8_t* out);
+
+/**
+ * @brief Decodes COBS data (without the 0 delimiter).
+ *
+ * @param out Must hold length bytes.  May be the same as data.
+ * @return Decoded length, or 0 if the data isn't valid COBS.
+ */
+size_t cobsDecode(const uint8_t* data, size_t length, uint8_t* out);
+
+/**
+ * @brief Writes frames to a stream: CRC appended, COBS encoded, ended with a 0.
+ *
+ * The framing of telemetry and of SHTP captures (ShtpCapture.h).  A frame
+ * starts with a byte telling its kind and its sequence number, which the
+ * writer counts.
+ */
+class CobsFrameWriter {
+public:
+
+	explicit CobsFrameWriter(Stream& out);
+
+	/// Sequence number for the next frame
+	uint8_t sequence() const { return _sequence; }
+
+	/**
+	 * Appends the CRC to a frame and writes it out.
+	 *
+	 * @param frame Must have room for the 2 bytes of the CRC after length
+	 * @param encoded Scratch space for the encoding: n + n / 254 + 2 bytes, n being length + 2
+	 */
+	void write(uint8_t* frame, size_t length, uint8_t* encoded);
+
+	/// Frames written so far
+	uint32_t framesSent() const { return _framesSent; }
+
+	/// Bytes written so far, framing included
+	uint32_t bytesSent() const { return _bytesSent; }
+
+private:
+	Stream& _out;
+	uint8_t _sequence;
+	uint32_t _framesSent;
+	uint32_t _bytesSent;
+};
+
+/**
+ * @brief Finds the frames of one kind in a byte stream and checks their CRC and sequence number.
+ *
+ * The counterpart of CobsFrameWriter.  The owner provides the buffers, sized
+ * for its longest frame.
+ */
+class CobsFrameReader {
+public:
+
+	/**
+	 * @param buffer Collects the bytes of a frame: maxFrame + maxFrame / 254 + 2 of them
+	 * @param frame Receives the decoding, as large as buffer, since a corrupt frame can decode that long
+	 * @param minFrame Shortest valid frame, its header and CRC included
+	 * @param maxFrame Longest valid frame, its header and CRC included
+	 * @param kind First byte of every frame of this kind
+	 */
+	CobsFrameReader(uint8_t* buffer, uint8_t* frame, size_t minFrame, size_t maxFrame, uint8_t kind);
+
+	/**
+	 * @return true if the byte completed a valid frame.
+	 */
+	bool push(uint8_t byte);
+
+	/**
+	 * Decodes one whole COBS encoded frame, without its 0 delimiter.  Counts it like push() does.
+	 *
+	 * @return true if it is a valid frame.
+	 */
+	bool decodeFrame(const uint8_t* data, size_t length);
+
+	/// The current frame, its CRC left off
+	const uint8_t* frame() const { return _frame; }
+	size_t frameLength() const { return _frameLength; }
+
+	uint32_t validFrames() const { return _validFrames; }
+
+	/// Frames dropped for a bad CRC, bad COBS or too much data
+	uint32_t badFrames() const { return _badFrames; }
+
+	/// Frames that start with another kind byte
+	uint32_t otherFrames() const { return _otherFrames; }
+
+	/// Frames missing between valid frames, going by their sequence numbers
+	uint32_t lostFrames() const { return _lostFrames; }
+
+private:
+	uint8_t* _buffer;
+	size_t _received;
+	bool _overflow;
+
+	uint8_t* _frame;
+	size_t _frameLength;
+
+	size_t _minFrame;
+	size_t _maxFrame;
+	uint8_t _kind;
+
+	bool _haveSequence;
+	uint8_t _lastSequence;
+
+	uint32_t _validFrames;
+	uint32_t _badFrames;
+	uint32_t _otherFrames;
+	uint32_t _lostFrames;
+};
+
+/**
+ * @brief Packs samples into frames and writes them to a stream.
+ *
+ * All buffers are fixed size.  Frames are only written when full or on flush(),
+ * so call flush() once per loop to bound latency.
+ */
+class TelemetryEncoder {
+public:
+
+	explicit TelemetryEncoder(Stream& out);
+
+	/**
+	 * Adds a sample to the current frame.  Writes the frame out first if the sample doesn't fit.
+	 *
+	 * @param words Raw words of the sample.  Only as many as the report's schema has are sent.
+	 * @return false if the report has no schema or numWords is less than its schema needs.
+	 */
+	bool add(uint8_t reportID, uint8_t status, uint32_t timestamp, const int16_t* words, uint8_t numWords);
+
+	/**
+	 * Writes the current frame, if it has any records.
+	 */
+	void flush();
+
+	/// Frames written so far
+	uint32_t framesSent() const { return _writer.framesSent(); }
+
+	/// Bytes written so far, framing included
+	uint32_t bytesSent() const { return _writer.bytesSent(); }
+
+private:
+	CobsFrameWriter _writer;
+	uint8_t _frame[TELEMETRY_MAX_FRAME];
+	size_t _length;
+};
+
+/**
+ * @brief One sample read back from a frame.
+ */
+struct TelemetryRecord {
+	uint8_t reportID;
+	uint8_t version;
+	uint8_t status;
+	uint32_t timestamp;
+	uint8_t numWords;
+	int16_t words[TELEMETRY_MAX_WORDS];
+
+	/// Schema of the report, NULL if unknown (or another version) -- the words are still there
+	const TelemetrySchema* schema;
+
+	/**
+	 * @return Word i scaled by the schema's Q point, or the raw word if there is no schema.
+	 */
+	float value(uint8_t i) const;
+};
+
+/**
+ * @brief Finds frames in a byte stream and reads their records.
+ *
+ * Feed it bytes with push(); when it returns true a frame passed its CRC check,
+ * and its records can be read with nextRecord() until that returns false.
+ */
+class TelemetryDecoder {
+public:
+
+	TelemetryDecoder();
+
+	/**
+	 * @return true if the byte completed a valid frame.
+	 */
+	bool push(uint8_t byte);
+
+	/**
+	 * Decodes one whole COBS encoded frame, without its 0 delimiter, e.g. from a
+	 * memory mapped capture.  Counts it like push() does.
+	 *
+	 * @return true if it is a valid frame.
+	 */
+	bool decodeFrame(const uint8_t* data, size_t length);
+
+	/**
+	 * @return false once the frame has no more records.
+	 */
+	bool nextRecord(TelemetryRecord& record);
+
+	/// Sequence number of the current frame
+	uint8_t sequence() const { return _frame[1]; }
+
+	uint32_t validFrames() const { return _reader.validFrames(); }
+
+	/// Frames dropped for a bad CRC, bad COBS, a wrong version or too much data
+	uint32_t badFrames() const { return _reader.badFrames() + _reader.otherFrames(); }
+
+	/// Frames missing between valid frames, going by their sequence numbers
+	uint32_t lostFrames() const { return _reader.lostFrames(); }
+
+private:
+	uint8_t _buffer[TELEMETRY_MAX_ENCODED];
+	uint8_t _frame[TELEMETRY_MAX_ENCODED];
+	CobsFrameReader _reader;
+	size_t _readOffset;
+};
+
+/**
+ * Reads one record, in the format described above, from the start of data.
+ * Shared by every reader of records: TelemetryDecoder, and the readers of BlockLog blocks.
+ *
+ * @return Length of the record, or 0 if data is too short to hold it.
+ */
+size_t telemetryParseRecord(const uint8_t* data, size_t length, TelemetryRecord& record);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,63 @@
+#include "TxRing.h"
+
+#define TX_RING_MASK (TX_RING_SIZE - 1)
+
+TxRing::TxRing() :
+	_head(0),
+	_tail(0),
+	_dropped(0),
+	_highWater(0)
+{
+}
+
+bool TxRing::put(uint8_t byte)
+{
+	uint16_t head = _head;
+	uint16_t tail = _tail;
+	bool kept = true;
+
+	// full: drop the oldest byte.  If the reader took one meanwhile the swap
+	// fails, tail is reloaded and the ring may no longer be full.
+	while(static_cast<uint16_t>(head - tail) >= TX_RING_SIZE) {
+		if(core_util_atomic_cas_u16(&_tail, &tail, static_cast<uint16_t>(tail + 1))) {
+			_dropped++;
+			kept = false;
+			break;
+		}
+	}
+
+	_buffer[head & TX_RING_MASK] = byte;
+	_head = static_cast<uint16_t>(head + 1);
+
+	uint16_t used = static_cast<uint16_t>(head + 1 - _tail);
+	if(used > _highWater) {
+		_highWater = used;
+	}
+	return kept;
+}
+
+size_t TxRing::write(const uint8_t* data, size_t length)
+{
+	size_t dropped = 0;
+	for(size_t i = 0; i < length; i++) {
+		if(!put(data[i])) {
+			dropped++;
+		}
+	}
+	return dropped;
+}
+
+bool TxRing::get(uint8_t& byte)
+{
+	uint16_t tail = _tail;
+	do {
+		if(tail == _head) {
+			return false;
+		}
+		byte = _buffer[tail & TX_RING_MASK];
+
+		// if the writer dropped this byte meanwhile, the swap fails and the next one is read
+	} while(!core_util_atomic_cas_u16(&_tail, &tail, static_cast<uint16_t>(tail + 1)));
+
+	return true;
+}
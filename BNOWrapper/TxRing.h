@@ -0,0 +1,80 @@
+#ifndef TX_RING_H
+#define TX_RING_H
+
+/**
+ * @file TxRing.h
+ *
+ * @brief Byte ring between code that writes output and the interrupt that sends it.
+ *
+ * One writer (the main loop) and one reader (the UART TX interrupt) share the ring
+ * without locks or disabling interrupts.  The writer never waits: when the ring is
+ * full it drops the oldest byte and counts it, so a slow link loses old output
+ * instead of holding up the sensor loop.
+ *
+ * The indices run freely and are masked on access.  Only the writer moves the head.
+ * The tail is moved by the reader, and by the writer when it drops a byte, so both
+ * move it with a compare and swap; whichever loses the race sees the other's change
+ * and tries again.
+ */
+
+#include <mbed.h>
+
+/// Bytes the ring holds.  Must be a power of two, at most 32768.
+#ifndef TX_RING_SIZE
+#define TX_RING_SIZE 512
+#endif
+
+static_assert(TX_RING_SIZE > 0 && (TX_RING_SIZE & (TX_RING_SIZE - 1)) == 0, "TX_RING_SIZE must be a power of two");
+static_assert(TX_RING_SIZE <= 32768, "ring indices are 16 bits");
+
+class TxRing {
+public:
+
+	TxRing();
+
+	/**
+	 * Adds a byte, dropping the oldest byte if the ring is full.  Writer side only.
+	 *
+	 * @return false if a byte had to be dropped.
+	 */
+	bool put(uint8_t byte);
+
+	/**
+	 * Adds bytes, dropping the oldest as needed.  Writer side only.
+	 *
+	 * @return Number of bytes dropped to make room.
+	 */
+	size_t write(const uint8_t* data, size_t length);
+
+	/**
+	 * Takes the oldest byte.  Reader side only.
+	 *
+	 * @return false if the ring is empty.
+	 */
+	bool get(uint8_t& byte);
+
+	/// Bytes waiting to be read
+	size_t used() const { return static_cast<uint16_t>(_head - _tail); }
+
+	bool empty() const { return _head == _tail; }
+
+	/// Bytes dropped because the ring was full, since construction
+	uint32_t droppedBytes() const { return _dropped; }
+
+	/// Most bytes that were ever waiting at once
+	size_t highWater() const { return _highWater; }
+
+private:
+	volatile uint8_t _buffer[TX_RING_SIZE];
+
+	/// Index of the next byte to write, moved by the writer only
+	volatile uint16_t _head;
+
+	/// Index of the oldest byte, moved by the reader and by the writer when dropping
+	volatile uint16_t _tail;
+
+	uint32_t _dropped;
+	uint16_t _highWater;
+};
+
+#endif /* TX_RING_H */
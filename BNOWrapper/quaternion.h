@@ -4,6 +4,8 @@
 #include <cmath>
 #include <mbed.h>
 #include "tmatrix.h"
+#include "QuaternionKernels.h"
+#include "EulerBatch.h"
 //const double M_PI = 3.14159265358979323846;
 class Quaternion
 {
@@ -15,52 +17,41 @@ private:
 
 public:
 
-	Quaternion() {
-		mData[0] = mData[1] = mData[2] = 0;
-		mData[3] = 1;
+	TMATRIX_CONSTEXPR Quaternion() : mData{0, 0, 0, 1} {
 	}
 
-	Quaternion(const TVector3& v, FloatType w) {
-		mData[0] = v.element(0,0);
-		mData[1] = v.element(1,0);
-		mData[2] = v.element(2,0);
-		mData[3] = w;
+	TMATRIX_CONSTEXPR Quaternion(const TVector3& v, FloatType w) :
+		mData{v.element(0,0), v.element(1,0), v.element(2,0), w} {
 	}
 
-	Quaternion(const TVector4& v) {
-		mData[0] = v.element(0,0);
-		mData[1] = v.element(1,0);
-		mData[2] = v.element(2,0);
-		mData[3] = v.element(3,0);
+	TMATRIX_CONSTEXPR Quaternion(const TVector4& v) :
+		mData{v.element(0,0), v.element(1,0), v.element(2,0), v.element(3,0)} {
 	}
 
-	Quaternion(const FloatType* array) {
+	TMATRIX_CONSTEXPR Quaternion(const FloatType* array) : mData() {
 		MBED_ASSERT(array != NULL);
 		for (uint32_t i = 0; i < 4; i++) {
 			mData[i] = array[i];
 		}
 	}
 
-	Quaternion(FloatType x, FloatType y, FloatType z, FloatType w) {
-		mData[0] = x;
-		mData[1] = y;
-		mData[2] = z;
-		mData[3] = w;
+	TMATRIX_CONSTEXPR Quaternion(FloatType x, FloatType y, FloatType z, FloatType w) :
+		mData{x, y, z, w} {
 	}
 
-	FloatType x() const { return mData[0]; }
-	FloatType y() const { return mData[1]; }
-	FloatType z() const { return mData[2]; }
-	FloatType w() const { return real(); }
+	TMATRIX_CONSTEXPR FloatType x() const { return mData[0]; }
+	TMATRIX_CONSTEXPR FloatType y() const { return mData[1]; }
+	TMATRIX_CONSTEXPR FloatType z() const { return mData[2]; }
+	TMATRIX_CONSTEXPR FloatType w() const { return real(); }
 
-	TVector3 complex() const { return TVector3(mData); }
-	void complex(const TVector3& c) { mData[0] = c[0]; mData[1] = c[1];  mData[2] = c[2]; }
+	TMATRIX_CONSTEXPR TVector3 complex() const { return TVector3(mData); }
+	TMATRIX_CONSTEXPR void complex(const TVector3& c) { mData[0] = c[0]; mData[1] = c[1];  mData[2] = c[2]; }
 
-	FloatType real() const { return mData[3]; }
-	void real(FloatType r) { mData[3] = r; }
+	TMATRIX_CONSTEXPR FloatType real() const { return mData[3]; }
+	TMATRIX_CONSTEXPR void real(FloatType r) { mData[3] = r; }
 
-	Quaternion conjugate(void) const {
-		return Quaternion(-complex(), real());
+	TMATRIX_CONSTEXPR Quaternion conjugate(void) const {
+		return Quaternion(-x(), -y(), -z(), w());
 	}
 
 	/**
@@ -86,7 +77,7 @@ public:
 	 *
 	 * @return The quaternion product (*this) x @p rhs.
 	 */
-	Quaternion product(const Quaternion& rhs) const {
+	TMATRIX_CONSTEXPR Quaternion product(const Quaternion& rhs) const {
 		return Quaternion(y()*rhs.z() - z()*rhs.y() + x()*rhs.w() + w()*rhs.x(),
 						  z()*rhs.x() - x()*rhs.z() + y()*rhs.w() + w()*rhs.y(),
 						  x()*rhs.y() - y()*rhs.x() + z()*rhs.w() + w()*rhs.z(),
@@ -109,7 +100,7 @@ public:
 	 *
 	 * @return The quaternion product (*this) x rhs.
 	 */
-	Quaternion operator*(const Quaternion& rhs) const {
+	TMATRIX_CONSTEXPR Quaternion operator*(const Quaternion& rhs) const {
 		return product(rhs);
 	}
 
@@ -119,28 +110,28 @@ public:
 	 * of this quaternion.
 	 * @return The quaternion (*this) * s.
 	 */
-	Quaternion operator*(FloatType s) const {
-		return Quaternion(complex()*s, real()*s);
+	TMATRIX_CONSTEXPR Quaternion operator*(FloatType s) const {
+		return Quaternion(x()*s, y()*s, z()*s, w()*s);
 	}
 
 	/**
 	 * @brief Produces the sum of this quaternion and rhs.
 	 */
-	Quaternion operator+(const Quaternion& rhs) const {
+	TMATRIX_CONSTEXPR Quaternion operator+(const Quaternion& rhs) const {
 		return Quaternion(x()+rhs.x(), y()+rhs.y(), z()+rhs.z(), w()+rhs.w());
 	}
 
 	/**
 	 * @brief Produces the difference of this quaternion and rhs.
 	 */
-	Quaternion operator-(const Quaternion& rhs) const {
+	TMATRIX_CONSTEXPR Quaternion operator-(const Quaternion& rhs) const {
 		return Quaternion(x()-rhs.x(), y()-rhs.y(), z()-rhs.z(), w()-rhs.w());
 	}
 
 	/**
 	 * @brief Unary negation.
 	 */
-	Quaternion operator-() const {
+	TMATRIX_CONSTEXPR Quaternion operator-() const {
 		return Quaternion(-x(), -y(), -z(), -w());
 	}
 
@@ -150,9 +141,9 @@ public:
 	 * of this quaternion.
 	 * @return The quaternion (*this) / s.
 	 */
-	Quaternion operator/(FloatType s) const {
+	TMATRIX_CONSTEXPR Quaternion operator/(FloatType s) const {
 		MBED_ASSERT(s != 0);
-		return Quaternion(complex()/s, real()/s);
+		return Quaternion(x()/s, y()/s, z()/s, w()/s);
 	}
 
 	/**
@@ -166,7 +157,7 @@ public:
 	 * Note that this is @e NOT the rotation matrix that may be
 	 * represented by a unit quaternion.
 	 */
-	TMatrix4 matrix() const {
+	TMATRIX_CONSTEXPR TMatrix4 matrix() const {
 		FloatType m[16] = {
 				w(), -z(),  y(), x(),
 				z(),  w(), -x(), y(),
@@ -188,7 +179,7 @@ public:
 	 * Note that this is @e NOT the rotation matrix that may be
 	 * represented by a unit quaternion.
 	 */
-	TMatrix4 rightMatrix() const {
+	TMATRIX_CONSTEXPR TMatrix4 rightMatrix() const {
 		FloatType m[16] = {
 				+w(), -z(),  y(), -x(),
 				+z(),  w(), -x(), -y(),
@@ -203,13 +194,76 @@ public:
 	 *
 	 * This is simply the vector [x y z w]<sup>T</sup>
 	 */
-	TVector4 vector() const { return TVector4(mData); }
+	TMATRIX_CONSTEXPR TVector4 vector() const { return TVector4(mData); }
+
+	/**
+	 * @brief Returns the 4-vector dot product of this quaternion with rhs.
+	 *
+	 * For unit quaternions this is cos(theta/2), where theta is the angle of
+	 * the rotation between them.
+	 */
+	TMATRIX_CONSTEXPR FloatType dot(const Quaternion& rhs) const {
+		return x()*rhs.x() + y()*rhs.y() + z()*rhs.z() + w()*rhs.w();
+	}
+
+	/**
+	 * @brief Normalized linear interpolation between two unit quaternions.
+	 *
+	 * Takes the shorter of the two paths between a and b.  The rotation rate is
+	 * not constant over t, but for the small steps between consecutive sensor
+	 * samples it stays within a fraction of a percent of slerp(), for no
+	 * trig calls.
+	 *
+	 * @param t Position between a (t = 0) and b (t = 1).
+	 */
+	static Quaternion nlerp(const Quaternion& a, const Quaternion& b, FloatType t) {
+		FloatType tb = a.dot(b) < 0 ? -t : t;
+		FloatType ta = 1 - t;
+		FloatType q[4] = {
+				ta*a.x() + tb*b.x(),
+				ta*a.y() + tb*b.y(),
+				ta*a.z() + tb*b.z(),
+				ta*a.w() + tb*b.w()
+		};
+		quatNormalize(q);
+		return Quaternion(q);
+	}
+
+	/**
+	 * @brief Spherical linear interpolation between two unit quaternions.
+	 *
+	 * Rotates from a to b at a constant rate along the shorter path.  When the
+	 * two are closer than about 3 degrees, sin(theta) loses too much precision
+	 * in float and nlerp() is used instead.
+	 *
+	 * @param t Position between a (t = 0) and b (t = 1).
+	 */
+	static Quaternion slerp(const Quaternion& a, const Quaternion& b, FloatType t) {
+		FloatType cosHalfTheta = a.dot(b);
+		FloatType sign = 1;
+		if (cosHalfTheta < 0) {
+			cosHalfTheta = -cosHalfTheta;
+			sign = -1;
+		}
+		if (cosHalfTheta > 0.9995f) {
+			return nlerp(a, b, t);
+		}
+
+		FloatType halfTheta = std::acos(cosHalfTheta);
+		FloatType invSin = 1 / std::sin(halfTheta);
+		FloatType ta = std::sin((1 - t) * halfTheta) * invSin;
+		FloatType tb = sign * std::sin(t * halfTheta) * invSin;
+		return Quaternion(ta*a.x() + tb*b.x(),
+						  ta*a.y() + tb*b.y(),
+						  ta*a.z() + tb*b.z(),
+						  ta*a.w() + tb*b.w());
+	}
 
 	/**
 	 * @brief Returns the norm ("magnitude") of the quaternion.
 	 * @return The 2-norm of [ w(), x(), y(), z() ]<sup>T</sup>.
 	 */
-	FloatType norm() const { return sqrt(mData[0]*mData[0]+mData[1]*mData[1]+
+	FloatType norm() const { return std::sqrt(mData[0]*mData[0]+mData[1]*mData[1]+
 									  mData[2]*mData[2]+mData[3]*mData[3]); }
 
 	/**
@@ -220,7 +274,7 @@ public:
 	 * It formulaically returns the matrix, which will not be a
 	 * rotation if the quaternion is non-unit.
 	 */
-	TMatrix3 rotationMatrix() const {
+	TMATRIX_CONSTEXPR TMatrix3 rotationMatrix() const {
 		FloatType m[9] = {
 				1-2*y()*y()-2*z()*z(), 2*x()*y() - 2*z()*w(), 2*x()*z() + 2*y()*w(),
 				2*x()*y() + 2*z()*w(), 1-2*x()*x()-2*z()*z(), 2*y()*z() - 2*x()*w(),
@@ -228,18 +282,54 @@ public:
 		};
 		return TMatrix3(m);
 	}
+	/**
+	 * @brief Sets this quaternion to the rotation represented by a
+	 * rotation matrix, so that rotationMatrix() returns m again.
+	 *
+	 * @note m must be orthonormal.  Uses the largest of w, x, y and z
+	 * to divide by, which keeps full precision for any rotation.
+	 */
+	void rotationMatrix(const TMatrix3& m) {
+		FloatType trace = m.element(0,0) + m.element(1,1) + m.element(2,2);
+		if (trace > 0) {
+			FloatType s = 2 * std::sqrt(trace + 1);
+			mData[3] = 0.25f * s;
+			mData[0] = (m.element(2,1) - m.element(1,2)) / s;
+			mData[1] = (m.element(0,2) - m.element(2,0)) / s;
+			mData[2] = (m.element(1,0) - m.element(0,1)) / s;
+		} else if (m.element(0,0) > m.element(1,1) && m.element(0,0) > m.element(2,2)) {
+			FloatType s = 2 * std::sqrt(1 + m.element(0,0) - m.element(1,1) - m.element(2,2));
+			mData[3] = (m.element(2,1) - m.element(1,2)) / s;
+			mData[0] = 0.25f * s;
+			mData[1] = (m.element(0,1) + m.element(1,0)) / s;
+			mData[2] = (m.element(0,2) + m.element(2,0)) / s;
+		} else if (m.element(1,1) > m.element(2,2)) {
+			FloatType s = 2 * std::sqrt(1 + m.element(1,1) - m.element(0,0) - m.element(2,2));
+			mData[3] = (m.element(0,2) - m.element(2,0)) / s;
+			mData[0] = (m.element(0,1) + m.element(1,0)) / s;
+			mData[1] = 0.25f * s;
+			mData[2] = (m.element(1,2) + m.element(2,1)) / s;
+		} else {
+			FloatType s = 2 * std::sqrt(1 + m.element(2,2) - m.element(0,0) - m.element(1,1));
+			mData[3] = (m.element(1,0) - m.element(0,1)) / s;
+			mData[0] = (m.element(0,2) + m.element(2,0)) / s;
+			mData[1] = (m.element(1,2) + m.element(2,1)) / s;
+			mData[2] = 0.25f * s;
+		}
+	}
+
 	/**
 	 * @brief Sets quaternion to be same as rotation by scaled axis w.
 	 */
 	void scaledAxis(const TVector3& w) {
 		FloatType theta = w.norm();
-		if (theta > 0.0001) {
-			FloatType s = sin(theta / 2.0);
+		if (theta > 0.0001f) {
+			FloatType s = std::sin(theta * 0.5f);
 			TVector3 W(w / theta * s);
 			mData[0] = W[0];
 			mData[1] = W[1];
 			mData[2] = W[2];
-			mData[3] = cos(theta / 2.0);
+			mData[3] = std::cos(theta * 0.5f);
 		} else {
 			mData[0]=mData[1]=mData[2]=0;
 			mData[3]=1.0;
@@ -254,9 +344,14 @@ public:
 	 *
 	 * @warning conjugate() is used instead of inverse() for better
 	 * performance, when this quaternion must be normalized.
+	 *
+	 * @note Evaluated with quatRotate(), which needs about half the
+	 * multiplies of the two quaternion products above.
 	 */
 	TVector3 rotatedVector(const TVector3& v) const {
-		return (((*this) * Quaternion(v, 0)) * conjugate()).complex();
+		TVector3 result;
+		quatRotate(mData, v.row(0), result.row(0));
+		return result;
 	}
 
 
@@ -267,12 +362,12 @@ public:
 	 * @param euler A 3-vector in order:  roll-pitch-yaw.
 	 */
 	void euler(const TVector3& euler) {
-		FloatType c1 = cos(euler[2] * 0.5f);
-		FloatType c2 = cos(euler[1] * 0.5f);
-		FloatType c3 = cos(euler[0] * 0.5f);
-		FloatType s1 = sin(euler[2] * 0.5f);
-		FloatType s2 = sin(euler[1] * 0.5f);
-		FloatType s3 = sin(euler[0] * 0.5f);
+		FloatType c1 = std::cos(euler[2] * 0.5f);
+		FloatType c2 = std::cos(euler[1] * 0.5f);
+		FloatType c3 = std::cos(euler[0] * 0.5f);
+		FloatType s1 = std::sin(euler[2] * 0.5f);
+		FloatType s2 = std::sin(euler[1] * 0.5f);
+		FloatType s3 = std::sin(euler[0] * 0.5f);
 
 		mData[0] = c1*c2*s3 - s1*s2*c3;
 		mData[1] = c1*s2*c3 + s1*c2*s3;
@@ -282,12 +377,14 @@ public:
 
 	/** @brief Returns an equivalent euler angle representation of
 	 * this quaternion.
+	 *
+	 * @note To convert many quaternions at once, quaternionsToEuler()
+	 * in EulerBatch.h is several times faster.
+	 *
 	 * @return Euler angles in roll-pitch-yaw order.
 	 */
 	TVector3 euler(void) const {
 		TVector3 euler;
-		const static FloatType PI_OVER_2 = M_PI * 0.5;
-		const static FloatType EPSILON = 1e-10;
 		FloatType sqw, sqx, sqy, sqz;
 
 		// quick conversion to Euler angles to give tilt to user
@@ -296,21 +393,24 @@ public:
 		sqy = mData[1]*mData[1];
 		sqz = mData[2]*mData[2];
 
-		euler[1] = asin(2.0f * (mData[3]*mData[1] - mData[0]*mData[2]));
-		if (PI_OVER_2 - fabs(euler[1]) > EPSILON) {
-			euler[2] = atan2(2.0f * (mData[0]*mData[1] + mData[3]*mData[2]),
+		// the singularity test is done on sin(pitch): comparing the angle itself
+		// against pi/2 needs a margin far below what float can represent
+		FloatType sinPitch = 2.0f * (mData[3]*mData[1] - mData[0]*mData[2]);
+		euler[1] = std::asin(sinPitch);
+		if (std::fabs(sinPitch) < EULER_GIMBAL_LOCK_SIN_THRESHOLD) {
+			euler[2] = std::atan2(2.0f * (mData[0]*mData[1] + mData[3]*mData[2]),
 							 sqx - sqy - sqz + sqw);
-			euler[0] = atan2(2.0f * (mData[3]*mData[0] + mData[1]*mData[2]),
+			euler[0] = std::atan2(2.0f * (mData[3]*mData[0] + mData[1]*mData[2]),
 							 sqw - sqx - sqy + sqz);
 		} else {
 			// compute heading from local 'down' vector
-			euler[2] = atan2(2*mData[1]*mData[2] - 2*mData[0]*mData[3],
+			euler[2] = std::atan2(2*mData[1]*mData[2] - 2*mData[0]*mData[3],
 							 2*mData[0]*mData[2] + 2*mData[1]*mData[3]);
 			euler[0] = 0.0;
 
 			// If facing down, reverse yaw
 			if (euler[1] < 0)
-				euler[2] = M_PI - euler[2];
+				euler[2] = FloatType(M_PI) - euler[2];
 		}
 		return euler;
 	}
@@ -330,5 +430,25 @@ public:
  */
 Quaternion operator*(Quaternion::FloatType s, const Quaternion& q);
 
+/**
+ * @brief Linear interpolation between two vectors (or any matrices of the same size).
+ *
+ * @param t Position between a (t = 0) and b (t = 1).
+ * @return a + (b - a) * t, computed element by element without temporaries.
+ */
+template<uint16_t Rows, uint16_t Cols, typename value_type>
+TMatrix<Rows, Cols, value_type> lerp(const TMatrix<Rows, Cols, value_type>& a,
+									 const TMatrix<Rows, Cols, value_type>& b,
+									 typename TMatrixNonDeduced<value_type>::type t) {
+	TMatrix<Rows, Cols, value_type> result;
+	const value_type* pa = a.row(0);
+	const value_type* pb = b.row(0);
+	value_type* pr = result.row(0);
+	for (uint32_t i = 0; i < Rows*Cols; i++) {
+		pr[i] = pa[i] + (pb[i] - pa[i]) * t;
+	}
+	return result;
+}
+
 
 #endif /* QUATERNION_H */
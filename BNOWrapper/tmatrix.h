@@ -7,6 +7,8 @@
  * @brief A dimension-templatized class for matrices of values.
  */
 #include <cmath>
+#include <limits>
+#include <type_traits>
 #include <mbed.h>
 
 // Structures for static assert.  http://www.boost.org
@@ -23,11 +25,82 @@ template<int x> struct static_assert_test{};
 #define ERROR_CHECK(X)
 #endif
 
+// Construction, element access, identity() and matrix products can be evaluated
+// at compile time, so fixed transforms (mounting rotations, axis remaps) fold into
+// constants.  Element-wise operators and transpose() build on the uninitialized
+// TMatrixDummy constructor and stay runtime-only.
+// The loops in these functions need C++14 constexpr.
+#if __cplusplus >= 201402L
+#define TMATRIX_CONSTEXPR constexpr
+#else
+#define TMATRIX_CONSTEXPR
+#endif
+
+/**
+ * Precision policy.
+ *
+ * Float matrices compute in float end to end, and double is used only by matrices
+ * declared with value_type double.  On the M7 a double operation takes longer
+ * than a float one and uses two FPU registers, so a stray double accumulator
+ * costs more than it buys for filters that were written for float.
+ *
+ * TMatrixPrecision<value_type> says what sums of products (matrix products,
+ * norm2()) accumulate in and what pseudoRecip() treats as zero.  Specialize it
+ * to change the rule for one value type.
+ *
+ * Define TMATRIX_STRICT_PRECISION to turn accidental promotion into compile
+ * errors: a TMatrix declared without a value_type no longer defaults to double,
+ * and implicit float to double promotions inside these headers are errors.
+ * Build with -Wdouble-promotion to get the same check in calling code.
+ */
+template <typename value_type>
+struct TMatrixPrecision {
+	typedef value_type accumulator_type;
+
+	// smallest magnitude pseudoRecip() inverts: the smallest normal value, whose
+	// reciprocal is still finite (1 for integer types)
+	static TMATRIX_CONSTEXPR value_type recipEpsilon() {
+		return std::numeric_limits<value_type>::is_integer ? value_type(1) : std::numeric_limits<value_type>::min();
+	}
+};
+
+template <>
+struct TMatrixPrecision<double> {
+	typedef double accumulator_type;
+
+	static TMATRIX_CONSTEXPR double recipEpsilon() { return 1e-50; }
+};
+
+#ifdef TMATRIX_STRICT_PRECISION
+// Stands in for the value_type of a TMatrix declared without one; BasicMatrix
+// rejects it, so every matrix has to say float or double.
+struct TMatrixUnspecifiedPrecision { };
+#define TMATRIX_DEFAULT_VALUE_TYPE TMatrixUnspecifiedPrecision
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Wdouble-promotion"
+#else
+#define TMATRIX_DEFAULT_VALUE_TYPE double
+#endif
+
 // Forward Decl.
 template <uint16_t, uint16_t, typename> class BasicMatrix;
 template <uint16_t, uint16_t, typename> class TMatrix;
 class TMatrixDummy { };
 
+#include "tmatrix_expr.h"
+
+// Lets every TMatrix class be built from, and assigned from, a lazy() expression.
+#define TMATRIX_EXPRESSION_MEMBERS(Rows, Cols)                                        \
+	template <typename Expr>                                                          \
+	TMatrix(const TMatrixExpr<Rows, Cols, value_type, Expr>& e) : BaseType(TMatrixDummy()) { \
+		BaseType::assign(e);                                                          \
+	}                                                                                 \
+	template <typename Expr>                                                          \
+	TMatrix& operator=(const TMatrixExpr<Rows, Cols, value_type, Expr>& e) {          \
+		BaseType::assign(e);                                                          \
+		return *this;                                                                 \
+	}
+
 /**
  * @brief Class that layers on operator[] functionality for
  * typical matrices.
@@ -38,10 +111,10 @@ class BasicIndexMatrix : public BasicMatrix<Rows,Cols,value_type> {
 protected:
 	BasicIndexMatrix(TMatrixDummy d) : BaseType(d) { }
 public:
-	BasicIndexMatrix() { }
-	BasicIndexMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_CONSTEXPR BasicIndexMatrix() { }
+	TMATRIX_CONSTEXPR BasicIndexMatrix(const value_type* data) : BaseType(data) {}
 
-	const value_type* operator[](uint16_t r) const {
+	TMATRIX_CONSTEXPR const value_type* operator[](uint16_t r) const {
 		ERROR_CHECK(if (r >= Rows) {
 			std::clog << "Invalid row index " << r << std::endl;
 			return &BaseType::mData[0];
@@ -50,7 +123,7 @@ public:
 		return &BaseType::mData[r*Cols];
 	}
 
-	value_type* operator[](uint16_t r) {
+	TMATRIX_CONSTEXPR value_type* operator[](uint16_t r) {
 		ERROR_CHECK(if (r >= Rows) {
 			std::clog << "Invalid row index " << r << std::endl;
 			return &BaseType::mData[0];
@@ -71,17 +144,17 @@ class BasicIndexMatrix<Rows,1,value_type> :
 protected:
 	BasicIndexMatrix(TMatrixDummy dummy) : BaseType(dummy) {}
 public:
-	BasicIndexMatrix() { }
-	BasicIndexMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_CONSTEXPR BasicIndexMatrix() { }
+	TMATRIX_CONSTEXPR BasicIndexMatrix(const value_type* data) : BaseType(data) {}
 
-	value_type operator[](uint16_t r) const {
+	TMATRIX_CONSTEXPR value_type operator[](uint16_t r) const {
 		ERROR_CHECK(if (r >= Rows) {
 			std::clog << "Invalid vector index " << r << std::endl;
 			return BaseType::mData[0];
 		})
 		return BaseType::mData[r];
 	}
-	value_type& operator[](uint16_t r) {
+	TMATRIX_CONSTEXPR value_type& operator[](uint16_t r) {
 		ERROR_CHECK(if (r >= Rows) {
 			std::clog << "Invalid vector index " << r << std::endl;
 			return BaseType::mData[0];
@@ -90,11 +163,11 @@ public:
 	}
 
 	value_type norm() const {
-		return sqrt(norm2());
+		return std::sqrt(norm2());
 	}
 
 	value_type norm2() const {
-		double normSum = 0;
+		typename TMatrixPrecision<value_type>::accumulator_type normSum = 0;
 		for (uint32_t i = 0; i < Rows; i++) {
 			normSum += BaseType::mData[i]*BaseType::mData[i];
 		}
@@ -102,7 +175,7 @@ public:
 	}
 
 	/** @brief Returns matrix with vector elements on diagonal. */
-	TMatrix<Rows, Rows, value_type> diag(void) const {
+	TMATRIX_CONSTEXPR TMatrix<Rows, Rows, value_type> diag(void) const {
 		TMatrix<Rows, Rows, value_type> d;
 		for (uint32_t i = 0; i < Rows; i++) d.element(i,i, BaseType::mData[i]);
 		return d;
@@ -125,22 +198,23 @@ public:
  * of integers or floats.
  *
  * @note At present, type cohersion between matrices with different
- * @p value_type parameters is not implemented.  It is recommended
- * that matrices with value type @p double be used for all numerical
- * computation.
+ * @p value_type parameters is not implemented.  Arithmetic stays in
+ * @p value_type, see TMatrixPrecision; use @p float unless a filter
+ * needs the range or precision of @p double.
  *
  * Note that the special cases of row and column vectors are
  * subsumed by this class.
  */
-template <uint16_t Rows, uint16_t Cols, typename value_type = double>
+template <uint16_t Rows, uint16_t Cols, typename value_type = TMATRIX_DEFAULT_VALUE_TYPE>
 class TMatrix : public BasicIndexMatrix<Rows, Cols, value_type> {
 	typedef BasicIndexMatrix<Rows, Cols, value_type>  BaseType;
 	template <uint16_t R, uint16_t C, typename vt> friend class BasicMatrix;
 	TMatrix(TMatrixDummy d) : BaseType(d) {}
 
 public:
-	TMatrix() : BaseType() { }
-	TMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_CONSTEXPR TMatrix() : BaseType() { }
+	TMATRIX_CONSTEXPR TMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_EXPRESSION_MEMBERS(Rows, Cols)
 };
 
 /**
@@ -153,9 +227,12 @@ class TMatrix<4,1, value_type> : public BasicIndexMatrix<4,1, value_type> {
 	TMatrix(TMatrixDummy d) : BaseType(d) {}
 
 public:
-	TMatrix() { }
-	TMatrix(const value_type* data) : BaseType(data) {}
-	TMatrix(value_type a0, value_type a1, value_type a2, value_type a3) : BaseType(TMatrixDummy()) {
+	TMATRIX_CONSTEXPR TMatrix() { }
+	TMATRIX_CONSTEXPR TMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_EXPRESSION_MEMBERS(4, 1)
+	// zero-initialized so the constructor can be constexpr; at this size the
+	// compiler drops the zeroing stores
+	TMATRIX_CONSTEXPR TMatrix(value_type a0, value_type a1, value_type a2, value_type a3) : BaseType() {
 		BaseType::mData[0] = a0;
 		BaseType::mData[1] = a1;
 		BaseType::mData[2] = a2;
@@ -173,20 +250,26 @@ class TMatrix<3,1, value_type> : public BasicIndexMatrix<3,1, value_type> {
 	TMatrix(TMatrixDummy d) : BaseType(d) {}
 
 public:
-	TMatrix() { }
-	TMatrix(const value_type* data) : BaseType(data) {}
-	TMatrix(value_type a0, value_type a1, value_type a2) : BaseType(TMatrixDummy()) {
+	TMATRIX_CONSTEXPR TMatrix() { }
+	TMATRIX_CONSTEXPR TMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_EXPRESSION_MEMBERS(3, 1)
+	TMATRIX_CONSTEXPR TMatrix(value_type a0, value_type a1, value_type a2) : BaseType() {
 		BaseType::mData[0] = a0;
 		BaseType::mData[1] = a1;
 		BaseType::mData[2] = a2;
 	}
 
-	TMatrix<3,1,value_type> cross(const TMatrix<3,1, value_type>& v) const {
+	TMATRIX_CONSTEXPR TMatrix<3,1,value_type> cross(const TMatrix<3,1, value_type>& v) const {
 		const TMatrix<3,1,value_type>& u = *this;
 		return TMatrix<3,1,value_type>(u[1]*v[2]-u[2]*v[1],
 									   u[2]*v[0]-u[0]*v[2],
 									   u[0]*v[1]-u[1]*v[0]);
 	}
+
+	TMATRIX_CONSTEXPR value_type dot(const TMatrix<3,1, value_type>& v) const {
+		const TMatrix<3,1,value_type>& u = *this;
+		return u[0]*v[0] + u[1]*v[1] + u[2]*v[2];
+	}
 };
 
 /**
@@ -199,9 +282,10 @@ class TMatrix<2,1, value_type> : public BasicIndexMatrix<2,1, value_type> {
 	TMatrix(TMatrixDummy d) : BaseType(d) {}
 
 public:
-	TMatrix() { }
-	TMatrix(const value_type* data) : BaseType(data) {}
-	TMatrix(value_type a0, value_type a1) : BaseType(TMatrixDummy()) {
+	TMATRIX_CONSTEXPR TMatrix() { }
+	TMATRIX_CONSTEXPR TMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_EXPRESSION_MEMBERS(2, 1)
+	TMATRIX_CONSTEXPR TMatrix(value_type a0, value_type a1) : BaseType() {
 		BaseType::mData[0] = a0;
 		BaseType::mData[1] = a1;
 	}
@@ -217,16 +301,17 @@ class TMatrix<1,1, value_type> : public BasicIndexMatrix<1,1, value_type> {
 	TMatrix(TMatrixDummy dummy) : BaseType(dummy) {}
 
 public:
-	TMatrix() { }
-	TMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_CONSTEXPR TMatrix() { }
+	TMATRIX_CONSTEXPR TMatrix(const value_type* data) : BaseType(data) {}
+	TMATRIX_EXPRESSION_MEMBERS(1, 1)
 
 	// explicit conversion from value_type
-	explicit TMatrix(value_type a0) : BaseType(TMatrixDummy()) { // don't initialize
+	TMATRIX_CONSTEXPR explicit TMatrix(value_type a0) : BaseType() {
 		BaseType::mData[0] = a0;
 	}
 
 	// implicit conversion to value_type
-	operator value_type() const {
+	TMATRIX_CONSTEXPR operator value_type() const {
 		return BaseType::mData[0];
 	}
 
@@ -236,7 +321,7 @@ public:
 		return *this;
 	}
 
-	double operator=(double a0) {
+	value_type operator=(value_type a0) {
 		BaseType::mData[0] = a0;
 		return BaseType::mData[0];
 	}
@@ -246,20 +331,23 @@ public:
 /**
  * @brief Base class implementing standard matrix functionality.
  */
-template <uint16_t Rows, uint16_t Cols, typename value_type = double>
+template <uint16_t Rows, uint16_t Cols, typename value_type = TMATRIX_DEFAULT_VALUE_TYPE>
 class BasicMatrix {
+#ifdef TMATRIX_STRICT_PRECISION
+	static_assert(!std::is_same<value_type, TMatrixUnspecifiedPrecision>::value,
+				  "TMATRIX_STRICT_PRECISION: give this TMatrix an explicit value_type (float or double)");
+#endif
 protected:
 	value_type mData[Rows*Cols];
 
 	// Constructs uninitialized matrix.
+	// Not constexpr: that would mean zeroing mData, and GCC keeps those stores
+	// for 3x3 and larger results.  Functions built on it run at runtime only.
 	BasicMatrix(TMatrixDummy dummy) {}
 public:
-	BasicMatrix() { // constructs zero matrix
-		for (uint16_t i = 0; i < Rows*Cols; ++i) {
-			mData[i] = 0;
-		}
+	TMATRIX_CONSTEXPR BasicMatrix() : mData() { // constructs zero matrix
 	}
-	BasicMatrix(const value_type* data) { // constructs from array
+	TMATRIX_CONSTEXPR BasicMatrix(const value_type* data) : mData() { // constructs from array
 		MBED_ASSERT(data);
 
 		for (uint16_t i = 0; i < Rows*Cols; ++i) {
@@ -267,11 +355,11 @@ public:
 		}
 	}
 
-	uint32_t rows() const { return Rows; }
-	uint32_t columns() const { return Cols; }
-	uint32_t elementCount() const { return Cols*Rows; }
+	TMATRIX_CONSTEXPR uint32_t rows() const { return Rows; }
+	TMATRIX_CONSTEXPR uint32_t columns() const { return Cols; }
+	TMATRIX_CONSTEXPR uint32_t elementCount() const { return Cols*Rows; }
 
-	value_type element(uint16_t row, uint16_t col) const {
+	TMATRIX_CONSTEXPR value_type element(uint16_t row, uint16_t col) const {
 		ERROR_CHECK(if (row >= rows() || col >= columns()) {
 			std::cerr << "Illegal read access: " << row << ", " << col
 					  << " in " << Rows << "x" << Cols << " matrix." << std::endl;
@@ -280,7 +368,7 @@ public:
 		return mData[row*Cols+col];
 	}
 
-	value_type& element(uint16_t row, uint16_t col) {
+	TMATRIX_CONSTEXPR value_type& element(uint16_t row, uint16_t col) {
 		ERROR_CHECK(if (row >= rows() || col >= columns()) {
 			std::cerr << "Illegal read access: " << row << ", " << col
 					  << " in " << Rows << "x" << Cols << " matrix." << std::endl;
@@ -289,7 +377,7 @@ public:
 		return mData[row*Cols+col];
 	}
 
-	void element(uint16_t row, uint16_t col, value_type value) {
+	TMATRIX_CONSTEXPR void element(uint16_t row, uint16_t col, value_type value) {
 		ERROR_CHECK(if (row >= rows() || col >= columns()) {
 			std::cerr << "Illegal write access: " << row << ", " << col
 					  << " in " << Rows << "x" << Cols << " matrix." << std::endl;
@@ -298,11 +386,39 @@ public:
 		mData[row*Cols+col] = value;
 	}
 
+	/**
+	 * @brief Evaluates a lazy() expression into this matrix in a single pass.
+	 *
+	 * If the expression reads this matrix as an operand of a product, it is
+	 * evaluated into a temporary first so the product sees the old values.
+	 */
+	template <typename Expr>
+	void assign(const TMatrixExpr<Rows, Cols, value_type, Expr>& e) {
+		const Expr& expr = e.derived();
+		if (expr.readsInProduct(mData)) {
+			value_type result[Rows*Cols];
+			for (uint16_t i = 0; i < Rows; i++) {
+				for (uint16_t j = 0; j < Cols; j++) {
+					result[i*Cols+j] = expr.at(i, j);
+				}
+			}
+			for (uint16_t i = 0; i < Rows*Cols; i++) {
+				mData[i] = result[i];
+			}
+		} else {
+			for (uint16_t i = 0; i < Rows; i++) {
+				for (uint16_t j = 0; j < Cols; j++) {
+					mData[i*Cols+j] = expr.at(i, j);
+				}
+			}
+		}
+	}
+
 	TMatrix<Rows*Cols,1, value_type> vec() const {
 		return TMatrix<Rows*Cols,1, value_type>(mData);
 	}
 
-	void vec(const TMatrix<Rows*Cols, 1, value_type>& vector) {
+	TMATRIX_CONSTEXPR void vec(const TMatrix<Rows*Cols, 1, value_type>& vector) {
 		for (uint32_t i = 0; i < Rows*Cols; i++) {
 			mData[i] = vector.mData[i];
 		}
@@ -323,7 +439,7 @@ public:
 
 
 	template <uint16_t R, uint16_t C, uint16_t RowRangeSize, uint16_t ColRangeSize>
-	void subMatrix(const TMatrix<RowRangeSize, ColRangeSize, value_type>& m) {
+	TMATRIX_CONSTEXPR void subMatrix(const TMatrix<RowRangeSize, ColRangeSize, value_type>& m) {
 		STATIC_ASSERT((R+RowRangeSize <= Rows) &&
 					  (C+ColRangeSize <= Cols));
 		for (uint32_t i = 0; i < RowRangeSize; i++) {
@@ -339,7 +455,7 @@ public:
 	 * (*this) * rhs.
 	 */
 	template <uint16_t RhsCols>
-	TMatrix<Rows, RhsCols, value_type> operator*(const TMatrix<Cols, RhsCols, value_type>& rhs) const {
+	TMATRIX_CONSTEXPR TMatrix<Rows, RhsCols, value_type> operator*(const TMatrix<Cols, RhsCols, value_type>& rhs) const {
 
 		TMatrix<Rows, RhsCols, value_type> result;
 		const value_type* rPtr = rhs.row(0);
@@ -350,14 +466,12 @@ public:
 			value_type* resultRow = result.row(i);
 			for (uint32_t j = 0; j < RhsCols; j++)
 			{
-				const value_type* rR = cR; // start at first element of right col
-				const value_type* cL = rL; // start at first element of left row
-				double r = 0;
+				// indexed rather than stepping pointers: a pointer stepped past the
+				// end of rhs is not allowed in a constant expression
+				typename TMatrixPrecision<value_type>::accumulator_type r = 0;
 				for (uint32_t k = 0; k < Cols; k++)
 				{
-					r += (*cL)*(*rR);
-					cL++; // step to next col of left matrix
-					rR += Cols; // step to next row of right matrix
+					r += rL[k]*cR[k*RhsCols]; // left row k-th col times right col k-th row
 				}
 				resultRow[j] = r;
 				cR++; // step to next column of right matrix
@@ -456,7 +570,7 @@ public:
 	 */
 	TMatrix<(Rows>Cols)?Cols:Rows, 1, value_type> diag() const {
 		TMatrixDummy dummy;
-		TMatrix<(Rows>Cols)?Cols:Rows, 1> d(dummy);
+		TMatrix<(Rows>Cols)?Cols:Rows, 1, value_type> d(dummy);
 		for (uint32_t i = 0; i < d.rows(); i++) {
 			d[i] = mData[i*(Cols + 1)];
 		}
@@ -464,7 +578,7 @@ public:
 	}
 
 	/** @brief Returns the sum of the matrix entries. */
-	value_type sum(void) const {
+	TMATRIX_CONSTEXPR value_type sum(void) const {
 		value_type s = 0;
 		for (uint32_t i = 0; i < Rows*Cols; i++) { s += mData[i]; }
 		return s;
@@ -473,7 +587,7 @@ public:
 	 */
 	value_type sumLog(void) const {
 		value_type s = 0;
-		for (uint32_t i = 0; i < Rows*Cols; i++) { s += log(mData[i]); }
+		for (uint32_t i = 0; i < Rows*Cols; i++) { s += std::log(mData[i]); }
 		return s;
 	}
 
@@ -482,7 +596,7 @@ public:
 		TMatrixDummy dummy;
 		TMatrix<Rows,Cols, value_type> result(dummy);
 		for (uint32_t i = 0; i < Rows*Cols; i++) {
-			result.mData[i] = 1.0/mData[i];
+			result.mData[i] = value_type(1)/mData[i];
 		}
 		return result;
 	}
@@ -490,14 +604,15 @@ public:
 	/** @brief Returns this vector with its elements replaced by their reciprocals,
 	 * unless a value is less than epsilon, in which case it is left as zero.
 	 *
-	 * This is used mostly for pseudo-inverse computations.
+	 * This is used mostly for pseudo-inverse computations.  The default epsilon
+	 * comes from TMatrixPrecision.
 	 */
-	TMatrix<Rows,Cols, value_type> pseudoRecip(double epsilon = 1e-50) const {
+	TMatrix<Rows,Cols, value_type> pseudoRecip(value_type epsilon = TMatrixPrecision<value_type>::recipEpsilon()) const {
 		TMatrixDummy dummy;
 		TMatrix<Rows,Cols, value_type> result(dummy);
 		for (uint32_t i = 0; i < Rows*Cols; i++) {
-			if (fabs(mData[i]) >= epsilon) {
-				result.mData[i] = 1.0/mData[i];
+			if (std::abs(mData[i]) >= epsilon) {
+				result.mData[i] = value_type(1)/mData[i];
 			} else {
 				result.mData[i] = 0;
 			}
@@ -516,7 +631,7 @@ public:
 	 * @return A TMatrix<Rows, Cols, value_type> with off-diagonal
 	 * elements set to 0, and diagonal elements set to 1.
 	 */
-	static TMatrix<Rows, Cols, value_type> identity() {
+	TMATRIX_CONSTEXPR static TMatrix<Rows, Cols, value_type> identity() {
 		TMatrix<Rows, Cols, value_type> id;
 		for (uint16_t i = 0; i < Rows && i < Cols; i++) {
 			id.element(i,i) = 1;
@@ -531,7 +646,7 @@ public:
 	 * @return A TMatrix<Rows, Cols, value_type> with all elements set
 	 * to 1.
 	 */
-	static TMatrix<Rows, Cols, value_type> one() {
+	TMATRIX_CONSTEXPR static TMatrix<Rows, Cols, value_type> one() {
 		TMatrix<Rows, Cols, value_type> ones;
 		for (uint16_t i = 0; i < Rows; i++) {
 			for (uint16_t j = 0; j < Cols; j++) {
@@ -547,12 +662,12 @@ public:
 	 *
 	 * @return A TMatrix<Rows, Cols, value_type> containing all 0.
 	 */
-	static TMatrix<Rows, Cols, value_type> zero() {
+	TMATRIX_CONSTEXPR static TMatrix<Rows, Cols, value_type> zero() {
 		return TMatrix<Rows, Cols, value_type>();
 	}
 
-	value_type* row(uint32_t i) { return &mData[i*Cols]; }
-	const value_type* row(uint32_t i) const { return &mData[i*Cols]; }
+	TMATRIX_CONSTEXPR value_type* row(uint32_t i) { return &mData[i*Cols]; }
+	TMATRIX_CONSTEXPR const value_type* row(uint32_t i) const { return &mData[i*Cols]; }
 
 	/**
 	 * @brief Checks to see if any of this matrix's elements are NaN.
@@ -569,7 +684,7 @@ public:
 	void print(Stream & os, bool oneLine = false) const {
 		for (uint16_t i = 0; i < Rows; i++) {
 			for (uint16_t j = 0; j < Cols; j++) {
-				os.printf("%.06f ", element(i, j));
+				os.printf("%.06f ", static_cast<double>(element(i, j)));
 			}
 
 			if(!oneLine)
@@ -582,7 +697,8 @@ public:
 private:
 
 	template <uint16_t Rows2, uint16_t Cols2, typename value_type2>
-	friend TMatrix<Rows2,Cols2,value_type2> operator*(double s, const TMatrix<Rows2, Cols2, value_type2>& m);
+	friend TMatrix<Rows2,Cols2,value_type2> operator*(typename TMatrixNonDeduced<value_type2>::type s,
+													  const TMatrix<Rows2, Cols2, value_type2>& m);
 };
 
 typedef TMatrix<2,2, float>  TMatrix2;
@@ -592,11 +708,16 @@ typedef TMatrix<2,1, float>  TVector2;
 typedef TMatrix<3,1, float>  TVector3;
 typedef TMatrix<4,1, float>  TVector4;
 
-// left-side scalar multiply
+// left-side scalar multiply.  The scalar takes the matrix's value_type, so
+// 2.0 * m stays float for a float matrix.
 template <uint16_t Rows, uint16_t Cols, typename value_type>
-TMatrix<Rows,Cols,value_type> operator*(double s, const TMatrix<Rows, Cols, value_type>& m) {
+TMatrix<Rows,Cols,value_type> operator*(typename TMatrixNonDeduced<value_type>::type s, const TMatrix<Rows, Cols, value_type>& m) {
 	return m * s;
 }
 
+#ifdef TMATRIX_STRICT_PRECISION
+#pragma GCC diagnostic pop
+#endif
+
 
 #endif /* TMATRIX_H */
\ No newline at end of file
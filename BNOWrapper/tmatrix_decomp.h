@@ -0,0 +1,368 @@
+#ifndef TMATRIX_DECOMP_H
+#define TMATRIX_DECOMP_H
+
+/**
+ * @file tmatrix_decomp.h
+ *
+ * @brief Fixed-size Cholesky, LDL^T and LU decompositions, solves and inverses
+ * for small TMatrix sizes (the filters here use 3x3 up to 9x9).
+ *
+ * Everything is templated on the dimension, works in place in the caller's
+ * matrices and allocates nothing.  The loop bounds are compile-time constants,
+ * and the loops are marked for full unrolling where the compiler supports it.
+ *
+ * Stability is checked as the decomposition goes: a pivot that is not clearly
+ * above rounding noise (see tmatrixPivotTolerance()) makes the function return
+ * false.  The check doesn't stop the computation early, so the code has no
+ * data-dependent branches except the LU pivot search.  When false is
+ * returned the outputs are garbage (possibly NaN) and must not be used.
+ */
+
+#include <algorithm>
+#include "tmatrix.h"
+
+// Asks for a loop to be unrolled completely.  GCC before 8 doesn't know the
+// pragma, and unrolls constant-bound loops this small at -O2 anyway.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+#define TMATRIX_UNROLL _Pragma("GCC unroll 16")
+#else
+#define TMATRIX_UNROLL
+#endif
+
+/**
+ * @brief Smallest pivot accepted by the decompositions below.
+ *
+ * Pivots below N * epsilon * scale are indistinguishable from rounding error,
+ * where scale is the largest magnitude on the diagonal (Cholesky, LDL^T) or in
+ * the whole matrix (LU).
+ */
+template <uint16_t N, typename value_type>
+inline value_type tmatrixPivotTolerance(value_type scale)
+{
+	return N * std::numeric_limits<value_type>::epsilon() * scale;
+}
+
+/**
+ * @brief Cholesky decomposition A = L L^T of a symmetric positive definite matrix.
+ *
+ * Only the lower triangle of @p A is read.  @p L may be the same object as @p A.
+ *
+ * @return false if @p A is not (numerically) positive definite.
+ */
+template <uint16_t N, typename value_type>
+bool choleskyDecompose(const TMatrix<N, N, value_type>& A, TMatrix<N, N, value_type>& L)
+{
+	typedef typename TMatrixPrecision<value_type>::accumulator_type Acc;
+	const value_type* a = A.row(0);
+	value_type* l = L.row(0);
+
+	value_type scale = 0;
+	TMATRIX_UNROLL
+	for (uint16_t i = 0; i < N; i++) {
+		scale = std::max(scale, std::abs(a[i*N + i]));
+	}
+	const value_type tolerance = tmatrixPivotTolerance<N>(scale);
+
+	bool ok = true;
+	TMATRIX_UNROLL
+	for (uint16_t j = 0; j < N; j++) {
+		Acc d = a[j*N + j];
+		TMATRIX_UNROLL
+		for (uint16_t k = 0; k < j; k++) {
+			d -= l[j*N + k] * l[j*N + k];
+		}
+		ok &= d > tolerance;
+		const value_type ljj = std::sqrt(static_cast<value_type>(d));
+		const value_type inv = value_type(1) / ljj;
+
+		TMATRIX_UNROLL
+		for (uint16_t i = j + 1; i < N; i++) {
+			Acc s = a[i*N + j];
+			TMATRIX_UNROLL
+			for (uint16_t k = 0; k < j; k++) {
+				s -= l[i*N + k] * l[j*N + k];
+			}
+			l[i*N + j] = s * inv;
+		}
+		l[j*N + j] = ljj;
+
+		// clear the upper triangle of this column; A's upper triangle is never read
+		TMATRIX_UNROLL
+		for (uint16_t i = 0; i < j; i++) {
+			l[i*N + j] = 0;
+		}
+	}
+	return ok;
+}
+
+/**
+ * @brief Solves A X = B given the Cholesky factor L of A.  @p X may be the same object as @p B.
+ */
+template <uint16_t N, uint16_t M, typename value_type>
+void choleskySolve(const TMatrix<N, N, value_type>& L, const TMatrix<N, M, value_type>& B, TMatrix<N, M, value_type>& X)
+{
+	typedef typename TMatrixPrecision<value_type>::accumulator_type Acc;
+	const value_type* l = L.row(0);
+	const value_type* b = B.row(0);
+	value_type* x = X.row(0);
+
+	TMATRIX_UNROLL
+	for (uint16_t c = 0; c < M; c++) {
+		// forward substitution: L y = b
+		TMATRIX_UNROLL
+		for (uint16_t i = 0; i < N; i++) {
+			Acc s = b[i*M + c];
+			TMATRIX_UNROLL
+			for (uint16_t k = 0; k < i; k++) {
+				s -= l[i*N + k] * x[k*M + c];
+			}
+			x[i*M + c] = s / l[i*N + i];
+		}
+		// back substitution: L^T x = y
+		TMATRIX_UNROLL
+		for (uint16_t r = 0; r < N; r++) {
+			const uint16_t i = N - 1 - r;
+			Acc s = x[i*M + c];
+			TMATRIX_UNROLL
+			for (uint16_t k = i + 1; k < N; k++) {
+				s -= l[k*N + i] * x[k*M + c];
+			}
+			x[i*M + c] = s / l[i*N + i];
+		}
+	}
+}
+
+/**
+ * @brief LDL^T decomposition of a symmetric matrix: unit lower triangular L and diagonal D.
+ *
+ * Unlike Cholesky this needs no square roots and also handles symmetric
+ * indefinite matrices, as long as no pivot in D comes out (near) zero.
+ * Only the lower triangle of @p A is read.  @p L may be the same object as @p A.
+ *
+ * @return false if a pivot is too small.
+ */
+template <uint16_t N, typename value_type>
+bool ldltDecompose(const TMatrix<N, N, value_type>& A, TMatrix<N, N, value_type>& L, TMatrix<N, 1, value_type>& D)
+{
+	typedef typename TMatrixPrecision<value_type>::accumulator_type Acc;
+	const value_type* a = A.row(0);
+	value_type* l = L.row(0);
+
+	value_type scale = 0;
+	TMATRIX_UNROLL
+	for (uint16_t i = 0; i < N; i++) {
+		scale = std::max(scale, std::abs(a[i*N + i]));
+	}
+	const value_type tolerance = tmatrixPivotTolerance<N>(scale);
+
+	bool ok = true;
+	TMATRIX_UNROLL
+	for (uint16_t j = 0; j < N; j++) {
+		Acc d = a[j*N + j];
+		TMATRIX_UNROLL
+		for (uint16_t k = 0; k < j; k++) {
+			d -= l[j*N + k] * l[j*N + k] * D[k];
+		}
+		D[j] = d;
+		ok &= std::abs(D[j]) > tolerance;
+		const value_type inv = value_type(1) / D[j];
+
+		TMATRIX_UNROLL
+		for (uint16_t i = j + 1; i < N; i++) {
+			Acc s = a[i*N + j];
+			TMATRIX_UNROLL
+			for (uint16_t k = 0; k < j; k++) {
+				s -= l[i*N + k] * l[j*N + k] * D[k];
+			}
+			l[i*N + j] = s * inv;
+		}
+		l[j*N + j] = 1;
+		TMATRIX_UNROLL
+		for (uint16_t i = 0; i < j; i++) {
+			l[i*N + j] = 0;
+		}
+	}
+	return ok;
+}
+
+/**
+ * @brief Solves A X = B given the LDL^T factors of A.  @p X may be the same object as @p B.
+ */
+template <uint16_t N, uint16_t M, typename value_type>
+void ldltSolve(const TMatrix<N, N, value_type>& L, const TMatrix<N, 1, value_type>& D,
+			   const TMatrix<N, M, value_type>& B, TMatrix<N, M, value_type>& X)
+{
+	typedef typename TMatrixPrecision<value_type>::accumulator_type Acc;
+	const value_type* l = L.row(0);
+	const value_type* b = B.row(0);
+	value_type* x = X.row(0);
+
+	TMATRIX_UNROLL
+	for (uint16_t c = 0; c < M; c++) {
+		// L z = b, then D y = z
+		TMATRIX_UNROLL
+		for (uint16_t i = 0; i < N; i++) {
+			Acc s = b[i*M + c];
+			TMATRIX_UNROLL
+			for (uint16_t k = 0; k < i; k++) {
+				s -= l[i*N + k] * x[k*M + c];
+			}
+			x[i*M + c] = s;
+		}
+		TMATRIX_UNROLL
+		for (uint16_t i = 0; i < N; i++) {
+			x[i*M + c] /= D[i];
+		}
+		// L^T x = y
+		TMATRIX_UNROLL
+		for (uint16_t r = 0; r < N; r++) {
+			const uint16_t i = N - 1 - r;
+			Acc s = x[i*M + c];
+			TMATRIX_UNROLL
+			for (uint16_t k = i + 1; k < N; k++) {
+				s -= l[k*N + i] * x[k*M + c];
+			}
+			x[i*M + c] = s;
+		}
+	}
+}
+
+/**
+ * @brief LU decomposition with partial pivoting: P A = L U.
+ *
+ * @p LU receives U in its upper triangle and the unit lower triangular L
+ * (without its diagonal) below it.  Row i of P A is row perm[i] of A.
+ * @p LU may be the same object as @p A.
+ *
+ * @return false if @p A is (numerically) singular.
+ */
+template <uint16_t N, typename value_type>
+bool luDecompose(const TMatrix<N, N, value_type>& A, TMatrix<N, N, value_type>& LU, uint8_t (&perm)[N])
+{
+	if (&LU != &A) {
+		LU = A;
+	}
+	value_type* lu = LU.row(0);
+
+	value_type scale = 0;
+	TMATRIX_UNROLL
+	for (uint16_t i = 0; i < N*N; i++) {
+		scale = std::max(scale, std::abs(lu[i]));
+	}
+	const value_type tolerance = tmatrixPivotTolerance<N>(scale);
+
+	TMATRIX_UNROLL
+	for (uint16_t i = 0; i < N; i++) {
+		perm[i] = i;
+	}
+
+	bool ok = true;
+	TMATRIX_UNROLL
+	for (uint16_t k = 0; k < N; k++) {
+		uint16_t p = k;
+		value_type best = std::abs(lu[k*N + k]);
+		TMATRIX_UNROLL
+		for (uint16_t i = k + 1; i < N; i++) {
+			const value_type v = std::abs(lu[i*N + k]);
+			p = v > best ? i : p;
+			best = v > best ? v : best;
+		}
+		ok &= best > tolerance;
+
+		// swapping a row with itself is harmless, so no test for p == k
+		TMATRIX_UNROLL
+		for (uint16_t j = 0; j < N; j++) {
+			const value_type t = lu[k*N + j];
+			lu[k*N + j] = lu[p*N + j];
+			lu[p*N + j] = t;
+		}
+		const uint8_t t = perm[k];
+		perm[k] = perm[p];
+		perm[p] = t;
+
+		const value_type inv = value_type(1) / lu[k*N + k];
+		TMATRIX_UNROLL
+		for (uint16_t i = k + 1; i < N; i++) {
+			const value_type f = lu[i*N + k] * inv;
+			lu[i*N + k] = f;
+			TMATRIX_UNROLL
+			for (uint16_t j = k + 1; j < N; j++) {
+				lu[i*N + j] -= f * lu[k*N + j];
+			}
+		}
+	}
+	return ok;
+}
+
+/**
+ * @brief Solves A X = B given the LU factors of A.  @p X must not be the same object as @p B.
+ */
+template <uint16_t N, uint16_t M, typename value_type>
+void luSolve(const TMatrix<N, N, value_type>& LU, const uint8_t (&perm)[N],
+			 const TMatrix<N, M, value_type>& B, TMatrix<N, M, value_type>& X)
+{
+	typedef typename TMatrixPrecision<value_type>::accumulator_type Acc;
+	const value_type* lu = LU.row(0);
+	const value_type* b = B.row(0);
+	value_type* x = X.row(0);
+
+	TMATRIX_UNROLL
+	for (uint16_t c = 0; c < M; c++) {
+		// L y = P b
+		TMATRIX_UNROLL
+		for (uint16_t i = 0; i < N; i++) {
+			Acc s = b[perm[i]*M + c];
+			TMATRIX_UNROLL
+			for (uint16_t k = 0; k < i; k++) {
+				s -= lu[i*N + k] * x[k*M + c];
+			}
+			x[i*M + c] = s;
+		}
+		// U x = y
+		TMATRIX_UNROLL
+		for (uint16_t r = 0; r < N; r++) {
+			const uint16_t i = N - 1 - r;
+			Acc s = x[i*M + c];
+			TMATRIX_UNROLL
+			for (uint16_t k = i + 1; k < N; k++) {
+				s -= lu[i*N + k] * x[k*M + c];
+			}
+			x[i*M + c] = s / lu[i*N + i];
+		}
+	}
+}
+
+/**
+ * @brief Inverts a general square matrix through its LU decomposition.
+ *
+ * @return false if @p A is (numerically) singular.
+ */
+template <uint16_t N, typename value_type>
+bool inverse(const TMatrix<N, N, value_type>& A, TMatrix<N, N, value_type>& inv)
+{
+	TMatrix<N, N, value_type> lu;
+	uint8_t perm[N];
+	const bool ok = luDecompose(A, lu, perm);
+	luSolve(lu, perm, TMatrix<N, N, value_type>::identity(), inv);
+	return ok;
+}
+
+/**
+ * @brief Inverts a symmetric positive definite matrix (such as a Kalman
+ * innovation covariance) through its Cholesky decomposition.
+ *
+ * About half the work of inverse().  Only the lower triangle of @p A is read.
+ *
+ * @return false if @p A is not (numerically) positive definite.
+ */
+template <uint16_t N, typename value_type>
+bool inverseSPD(const TMatrix<N, N, value_type>& A, TMatrix<N, N, value_type>& inv)
+{
+	TMatrix<N, N, value_type> l;
+	const bool ok = choleskyDecompose(A, l);
+	inv = TMatrix<N, N, value_type>::identity();
+	choleskySolve(l, inv, inv);
+	return ok;
+}
+
+#endif /* TMATRIX_DECOMP_H */
@@ -0,0 +1,283 @@
+#ifndef TMATRIX_EXPR_H
+#define TMATRIX_EXPR_H
+
+/**
+ * @file tmatrix_expr.h
+ *
+ * @brief Expression templates for TMatrix.
+ *
+ * The regular TMatrix operators return a new matrix from every operation, so
+ * something like a*s + c*t builds three full temporaries.  Wrapping an operand
+ * in lazy() turns the rest of the expression into a tree of small nodes that
+ * is only evaluated when it is assigned to a TMatrix, in one loop over the
+ * destination and without intermediate matrices:
+ *
+ * @code
+ * P = lazy(F) * P * Ft + Q;       // F*P is stored once, the rest is fused
+ * x = lazy(x) + K * (lazy(z) - lazy(H) * x);
+ * @endcode
+ *
+ * Element-wise nodes (+, -, scalar *, scalar /, unary -) never store anything.
+ * A matrix product node reads its operands directly if they are matrices, and
+ * stores an operand only when it is itself an expression, since each of its
+ * elements is needed several times.  Assigning an expression to a matrix that
+ * it reads inside a product (x = lazy(A) * x) is detected, and goes through a
+ * temporary like the regular operators do.
+ *
+ * This is opt-in: code that doesn't call lazy() gets exactly the same operators
+ * as before.  Call eval() on an expression to get a TMatrix back, e.g. to use
+ * transpose() or print().
+ *
+ * @note Expressions hold references to the matrices they read.  Don't keep an
+ * expression (e.g. in an auto variable) beyond the statement that builds it.
+ */
+
+template <uint16_t, uint16_t, typename> class TMatrix;
+
+// Keeps a scalar parameter out of template argument deduction, so that
+// lazy(m) * 2.0 works for a float matrix.
+template <typename T> struct TMatrixNonDeduced { typedef T type; };
+
+/**
+ * @brief Base of every matrix expression node.
+ *
+ * Derived must provide value_type at(uint16_t row, uint16_t col) const and
+ * bool readsInProduct(const value_type* data) const.
+ */
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename Derived>
+class TMatrixExpr {
+public:
+	const Derived& derived() const { return static_cast<const Derived&>(*this); }
+
+	value_type operator()(uint16_t row, uint16_t col) const { return derived().at(row, col); }
+
+	/** @brief Evaluates the expression into a new matrix. */
+	TMatrix<Rows, Cols, value_type> eval() const { return TMatrix<Rows, Cols, value_type>(*this); }
+};
+
+/**
+ * @brief Leaf node reading an existing matrix.
+ */
+template <uint16_t Rows, uint16_t Cols, typename value_type>
+class TMatrixRefExpr : public TMatrixExpr<Rows, Cols, value_type, TMatrixRefExpr<Rows, Cols, value_type> > {
+	const value_type* mData;
+public:
+	explicit TMatrixRefExpr(const value_type* data) : mData(data) {}
+
+	value_type at(uint16_t row, uint16_t col) const { return mData[row*Cols + col]; }
+
+	// element-wise reads of the destination are always safe
+	bool readsInProduct(const value_type*) const { return false; }
+
+	// used by product nodes to check whether they read the destination
+	const value_type* data() const { return mData; }
+};
+
+/**
+ * @brief Leaf node holding an evaluated sub-expression (product operands only).
+ */
+template <uint16_t Rows, uint16_t Cols, typename value_type>
+class TMatrixValueExpr : public TMatrixExpr<Rows, Cols, value_type, TMatrixValueExpr<Rows, Cols, value_type> > {
+	TMatrix<Rows, Cols, value_type> mValue;
+public:
+	template <typename E>
+	explicit TMatrixValueExpr(const TMatrixExpr<Rows, Cols, value_type, E>& e) : mValue(e) {}
+
+	value_type at(uint16_t row, uint16_t col) const { return mValue.row(row)[col]; }
+	bool readsInProduct(const value_type*) const { return false; }
+	const value_type* data() const { return mValue.row(0); }
+};
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename L, typename R>
+class TMatrixSumExpr : public TMatrixExpr<Rows, Cols, value_type, TMatrixSumExpr<Rows, Cols, value_type, L, R> > {
+	L mLhs;
+	R mRhs;
+public:
+	TMatrixSumExpr(const L& lhs, const R& rhs) : mLhs(lhs), mRhs(rhs) {}
+
+	value_type at(uint16_t row, uint16_t col) const { return mLhs.at(row, col) + mRhs.at(row, col); }
+	bool readsInProduct(const value_type* d) const { return mLhs.readsInProduct(d) || mRhs.readsInProduct(d); }
+};
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename L, typename R>
+class TMatrixDifferenceExpr : public TMatrixExpr<Rows, Cols, value_type, TMatrixDifferenceExpr<Rows, Cols, value_type, L, R> > {
+	L mLhs;
+	R mRhs;
+public:
+	TMatrixDifferenceExpr(const L& lhs, const R& rhs) : mLhs(lhs), mRhs(rhs) {}
+
+	value_type at(uint16_t row, uint16_t col) const { return mLhs.at(row, col) - mRhs.at(row, col); }
+	bool readsInProduct(const value_type* d) const { return mLhs.readsInProduct(d) || mRhs.readsInProduct(d); }
+};
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename E>
+class TMatrixScaledExpr : public TMatrixExpr<Rows, Cols, value_type, TMatrixScaledExpr<Rows, Cols, value_type, E> > {
+	E mExpr;
+	value_type mScale;
+public:
+	TMatrixScaledExpr(const E& e, value_type s) : mExpr(e), mScale(s) {}
+
+	value_type at(uint16_t row, uint16_t col) const { return mExpr.at(row, col) * mScale; }
+	bool readsInProduct(const value_type* d) const { return mExpr.readsInProduct(d); }
+};
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename E>
+class TMatrixQuotientExpr : public TMatrixExpr<Rows, Cols, value_type, TMatrixQuotientExpr<Rows, Cols, value_type, E> > {
+	E mExpr;
+	value_type mDivisor;
+public:
+	TMatrixQuotientExpr(const E& e, value_type s) : mExpr(e), mDivisor(s) {}
+
+	value_type at(uint16_t row, uint16_t col) const { return mExpr.at(row, col) / mDivisor; }
+	bool readsInProduct(const value_type* d) const { return mExpr.readsInProduct(d); }
+};
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename E>
+class TMatrixNegatedExpr : public TMatrixExpr<Rows, Cols, value_type, TMatrixNegatedExpr<Rows, Cols, value_type, E> > {
+	E mExpr;
+public:
+	explicit TMatrixNegatedExpr(const E& e) : mExpr(e) {}
+
+	value_type at(uint16_t row, uint16_t col) const { return -mExpr.at(row, col); }
+	bool readsInProduct(const value_type* d) const { return mExpr.readsInProduct(d); }
+};
+
+/**
+ * @brief Matrix product node.  L and R are always leaf nodes (TMatrixRefExpr or TMatrixValueExpr).
+ */
+template <uint16_t Rows, uint16_t Inner, uint16_t Cols, typename value_type, typename L, typename R>
+class TMatrixProductExpr : public TMatrixExpr<Rows, Cols, value_type, TMatrixProductExpr<Rows, Inner, Cols, value_type, L, R> > {
+	L mLhs;
+	R mRhs;
+public:
+	TMatrixProductExpr(const L& lhs, const R& rhs) : mLhs(lhs), mRhs(rhs) {}
+
+	value_type at(uint16_t row, uint16_t col) const {
+		const value_type* l = mLhs.data() + row*Inner;
+		const value_type* r = mRhs.data() + col;
+		typename TMatrixPrecision<value_type>::accumulator_type sum = 0;
+		for (uint16_t k = 0; k < Inner; k++) {
+			sum += l[k] * r[k*Cols];
+		}
+		return sum;
+	}
+
+	bool readsInProduct(const value_type* d) const { return mLhs.data() == d || mRhs.data() == d; }
+};
+
+// Maps an expression to the leaf a product node keeps of it: matrices are
+// read in place, anything else is evaluated once.
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename E>
+struct TMatrixProductOperand {
+	typedef TMatrixValueExpr<Rows, Cols, value_type> type;
+	static type make(const TMatrixExpr<Rows, Cols, value_type, E>& e) { return type(e); }
+};
+
+template <uint16_t Rows, uint16_t Cols, typename value_type>
+struct TMatrixProductOperand<Rows, Cols, value_type, TMatrixRefExpr<Rows, Cols, value_type> > {
+	typedef TMatrixRefExpr<Rows, Cols, value_type> type;
+	static type make(const TMatrixExpr<Rows, Cols, value_type, type>& e) { return e.derived(); }
+};
+
+/**
+ * @brief Starts an expression at a matrix.  See the file comment.
+ */
+template <uint16_t Rows, uint16_t Cols, typename value_type>
+TMatrixRefExpr<Rows, Cols, value_type> lazy(const TMatrix<Rows, Cols, value_type>& m) {
+	return TMatrixRefExpr<Rows, Cols, value_type>(m.row(0));
+}
+
+// expression (+|-) expression, and mixed with plain matrices
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename L, typename R>
+TMatrixSumExpr<Rows, Cols, value_type, L, R>
+operator+(const TMatrixExpr<Rows, Cols, value_type, L>& lhs, const TMatrixExpr<Rows, Cols, value_type, R>& rhs) {
+	return TMatrixSumExpr<Rows, Cols, value_type, L, R>(lhs.derived(), rhs.derived());
+}
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename L>
+TMatrixSumExpr<Rows, Cols, value_type, L, TMatrixRefExpr<Rows, Cols, value_type> >
+operator+(const TMatrixExpr<Rows, Cols, value_type, L>& lhs, const TMatrix<Rows, Cols, value_type>& rhs) {
+	return lhs + lazy(rhs);
+}
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename R>
+TMatrixSumExpr<Rows, Cols, value_type, TMatrixRefExpr<Rows, Cols, value_type>, R>
+operator+(const TMatrix<Rows, Cols, value_type>& lhs, const TMatrixExpr<Rows, Cols, value_type, R>& rhs) {
+	return lazy(lhs) + rhs;
+}
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename L, typename R>
+TMatrixDifferenceExpr<Rows, Cols, value_type, L, R>
+operator-(const TMatrixExpr<Rows, Cols, value_type, L>& lhs, const TMatrixExpr<Rows, Cols, value_type, R>& rhs) {
+	return TMatrixDifferenceExpr<Rows, Cols, value_type, L, R>(lhs.derived(), rhs.derived());
+}
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename L>
+TMatrixDifferenceExpr<Rows, Cols, value_type, L, TMatrixRefExpr<Rows, Cols, value_type> >
+operator-(const TMatrixExpr<Rows, Cols, value_type, L>& lhs, const TMatrix<Rows, Cols, value_type>& rhs) {
+	return lhs - lazy(rhs);
+}
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename R>
+TMatrixDifferenceExpr<Rows, Cols, value_type, TMatrixRefExpr<Rows, Cols, value_type>, R>
+operator-(const TMatrix<Rows, Cols, value_type>& lhs, const TMatrixExpr<Rows, Cols, value_type, R>& rhs) {
+	return lazy(lhs) - rhs;
+}
+
+// scalar operations
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename E>
+TMatrixScaledExpr<Rows, Cols, value_type, E>
+operator*(const TMatrixExpr<Rows, Cols, value_type, E>& e, typename TMatrixNonDeduced<value_type>::type s) {
+	return TMatrixScaledExpr<Rows, Cols, value_type, E>(e.derived(), s);
+}
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename E>
+TMatrixScaledExpr<Rows, Cols, value_type, E>
+operator*(typename TMatrixNonDeduced<value_type>::type s, const TMatrixExpr<Rows, Cols, value_type, E>& e) {
+	return TMatrixScaledExpr<Rows, Cols, value_type, E>(e.derived(), s);
+}
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename E>
+TMatrixQuotientExpr<Rows, Cols, value_type, E>
+operator/(const TMatrixExpr<Rows, Cols, value_type, E>& e, typename TMatrixNonDeduced<value_type>::type s) {
+	return TMatrixQuotientExpr<Rows, Cols, value_type, E>(e.derived(), s);
+}
+
+template <uint16_t Rows, uint16_t Cols, typename value_type, typename E>
+TMatrixNegatedExpr<Rows, Cols, value_type, E>
+operator-(const TMatrixExpr<Rows, Cols, value_type, E>& e) {
+	return TMatrixNegatedExpr<Rows, Cols, value_type, E>(e.derived());
+}
+
+// matrix products
+
+template <uint16_t Rows, uint16_t Inner, uint16_t Cols, typename value_type, typename L, typename R>
+TMatrixProductExpr<Rows, Inner, Cols, value_type,
+		typename TMatrixProductOperand<Rows, Inner, value_type, L>::type,
+		typename TMatrixProductOperand<Inner, Cols, value_type, R>::type>
+operator*(const TMatrixExpr<Rows, Inner, value_type, L>& lhs, const TMatrixExpr<Inner, Cols, value_type, R>& rhs) {
+	typedef TMatrixProductOperand<Rows, Inner, value_type, L> LhsOperand;
+	typedef TMatrixProductOperand<Inner, Cols, value_type, R> RhsOperand;
+	return TMatrixProductExpr<Rows, Inner, Cols, value_type, typename LhsOperand::type, typename RhsOperand::type>(
+			LhsOperand::make(lhs), RhsOperand::make(rhs));
+}
+
+template <uint16_t Rows, uint16_t Inner, uint16_t Cols, typename value_type, typename L>
+TMatrixProductExpr<Rows, Inner, Cols, value_type,
+		typename TMatrixProductOperand<Rows, Inner, value_type, L>::type,
+		TMatrixRefExpr<Inner, Cols, value_type> >
+operator*(const TMatrixExpr<Rows, Inner, value_type, L>& lhs, const TMatrix<Inner, Cols, value_type>& rhs) {
+	return lhs * lazy(rhs);
+}
+
+template <uint16_t Rows, uint16_t Inner, uint16_t Cols, typename value_type, typename R>
+TMatrixProductExpr<Rows, Inner, Cols, value_type,
+		TMatrixRefExpr<Rows, Inner, value_type>,
+		typename TMatrixProductOperand<Inner, Cols, value_type, R>::type>
+operator*(const TMatrix<Rows, Inner, value_type>& lhs, const TMatrixExpr<Inner, Cols, value_type, R>& rhs) {
+	return lazy(lhs) * rhs;
+}
+
+#endif /* TMATRIX_EXPR_H */
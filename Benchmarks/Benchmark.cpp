@@ -0,0 +1,21 @@
+#include "Benchmark.h"
+
+volatile float benchmarkSink;
+
+void printBenchmark(Stream& out, const char* name, uint32_t elapsedUs, uint32_t operations)
+{
+    float nsPerOp = operations == 0 ? 0 : elapsedUs * 1000.0f / operations;
+    out.printf("%-36s %10.2f ns/op\n", name, static_cast<double>(nsPerOp));
+}
+
+void fillBenchmarkData(float* data, size_t count, uint32_t seed)
+{
+    // xorshift32 so host and target produce the same data
+    uint32_t state = seed ? seed : 1;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = (state & 0xFFFF) / 32767.5f - 1.0f;
+    }
+}
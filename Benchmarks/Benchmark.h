@@ -0,0 +1,37 @@
+//
+// Small helpers shared by the benchmark suites.  The suites run both on the
+// board (call them from main) and on a PC through the host build in host/.
+//
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <mbed.h>
+
+// Iterations of each timed loop.  Lower it for slow targets.
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 100000
+#endif
+
+/**
+ * Results of every benchmark are folded into this so the compiler can't
+ * throw the timed work away.
+ */
+extern volatile float benchmarkSink;
+
+/**
+ * Prints one result line: "<name> <nanoseconds per operation> ns/op".
+ *
+ * @param out Stream to print to
+ * @param name Name of the benchmark
+ * @param elapsedUs Time taken by the whole loop, in microseconds
+ * @param operations Number of operations the loop performed
+ */
+void printBenchmark(Stream& out, const char* name, uint32_t elapsedUs, uint32_t operations);
+
+/**
+ * Fills an array with repeatable pseudo-random values in [-1, 1].
+ */
+void fillBenchmarkData(float* data, size_t count, uint32_t seed);
+
+#endif //BENCHMARK_H
@@ -0,0 +1,169 @@
+#include "DecompositionBenchmarks.h"
+#include "Benchmark.h"
+
+#include <stdio.h>
+#include <tmatrix_decomp.h>
+
+// number of distinct matrices cycled through
+#define DECOMP_BENCH_SETS 16
+
+namespace
+{
+    /**
+     * Textbook Gauss-Jordan inversion with partial pivoting, sized at runtime:
+     * what one would write without the fixed-size templates.  a is destroyed.
+     */
+    bool gaussJordanInverse(float* a, float* inv, int n)
+    {
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+                inv[i * n + j] = i == j ? 1.0f : 0.0f;
+            }
+        }
+        for (int k = 0; k < n; ++k) {
+            int p = k;
+            for (int i = k + 1; i < n; ++i) {
+                if (fabsf(a[i * n + k]) > fabsf(a[p * n + k])) {
+                    p = i;
+                }
+            }
+            if (a[p * n + k] == 0) {
+                return false;
+            }
+            if (p != k) {
+                for (int j = 0; j < n; ++j) {
+                    float t = a[k * n + j]; a[k * n + j] = a[p * n + j]; a[p * n + j] = t;
+                    t = inv[k * n + j]; inv[k * n + j] = inv[p * n + j]; inv[p * n + j] = t;
+                }
+            }
+            const float d = 1.0f / a[k * n + k];
+            for (int j = 0; j < n; ++j) {
+                a[k * n + j] *= d;
+                inv[k * n + j] *= d;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (i != k) {
+                    const float f = a[i * n + k];
+                    for (int j = 0; j < n; ++j) {
+                        a[i * n + j] -= f * a[k * n + j];
+                        inv[i * n + j] -= f * inv[k * n + j];
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    template <uint16_t N>
+    float residual(const TMatrix<N, N, float>& a, const TMatrix<N, N, float>& inv)
+    {
+        const TMatrix<N, N, float> r = a * inv - TMatrix<N, N, float>::identity();
+        float m = 0;
+        for (uint16_t i = 0; i < N * N; ++i) {
+            m = fmaxf(m, fabsf(r.row(0)[i]));
+        }
+        return m;
+    }
+
+    template <uint16_t N>
+    void benchSize(Stream& out)
+    {
+        // symmetric positive definite test matrices, like a Kalman innovation covariance
+        static TMatrix<N, N, float> sets[DECOMP_BENCH_SETS];
+        for (uint16_t s = 0; s < DECOMP_BENCH_SETS; ++s) {
+            TMatrix<N, N, float> m;
+            fillBenchmarkData(m.row(0), N * N, 40 + s);
+            sets[s] = m * m.transpose() + TMatrix<N, N, float>::identity() * 0.1f;
+        }
+
+        const uint32_t iterations = BENCH_ITERATIONS / N;
+        char name[40];
+        Timer timer;
+        float sink = 0;
+        TMatrix<N, N, float> inv;
+        float gaussError = 0, luError = 0, spdError = 0;
+        bool ok = true;
+
+        timer.start();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            TMatrix<N, N, float> a = sets[i % DECOMP_BENCH_SETS];
+            ok &= gaussJordanInverse(a.row(0), inv.row(0), N);
+            sink += inv.row(0)[i % N];
+            if (i < DECOMP_BENCH_SETS) {
+                gaussError = fmaxf(gaussError, residual(sets[i], inv));
+            }
+        }
+        timer.stop();
+        snprintf(name, sizeof(name), "gaussJordanInverse(n=%d)", N);
+        printBenchmark(out, name, timer.read_us(), iterations);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            ok &= inverse(sets[i % DECOMP_BENCH_SETS], inv);
+            sink += inv.row(0)[i % N];
+            if (i < DECOMP_BENCH_SETS) {
+                luError = fmaxf(luError, residual(sets[i], inv));
+            }
+        }
+        timer.stop();
+        snprintf(name, sizeof(name), "inverse<%d>(LU)", N);
+        printBenchmark(out, name, timer.read_us(), iterations);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            ok &= inverseSPD(sets[i % DECOMP_BENCH_SETS], inv);
+            sink += inv.row(0)[i % N];
+            if (i < DECOMP_BENCH_SETS) {
+                spdError = fmaxf(spdError, residual(sets[i], inv));
+            }
+        }
+        timer.stop();
+        snprintf(name, sizeof(name), "inverseSPD<%d>(Cholesky)", N);
+        printBenchmark(out, name, timer.read_us(), iterations);
+
+        // solving for one vector, the usual way to apply an inverse
+        TMatrix<N, 1, float> b, x;
+        fillBenchmarkData(b.row(0), N, 60);
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            TMatrix<N, N, float> l;
+            ok &= choleskyDecompose(sets[i % DECOMP_BENCH_SETS], l);
+            choleskySolve(l, b, x);
+            sink += x[i % N];
+        }
+        timer.stop();
+        snprintf(name, sizeof(name), "choleskySolve<%d>", N);
+        printBenchmark(out, name, timer.read_us(), iterations);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            TMatrix<N, N, float> l;
+            TMatrix<N, 1, float> d;
+            ok &= ldltDecompose(sets[i % DECOMP_BENCH_SETS], l, d);
+            ldltSolve(l, d, b, x);
+            sink += x[i % N];
+        }
+        timer.stop();
+        snprintf(name, sizeof(name), "ldltSolve<%d>", N);
+        printBenchmark(out, name, timer.read_us(), iterations);
+
+        benchmarkSink = sink;
+        out.printf("%-36s %10.2e %.2e %.2e%s\n", "residual(gauss lu cholesky)",
+                   static_cast<double>(gaussError), static_cast<double>(luError), static_cast<double>(spdError),
+                   ok ? "" : " FAILED");
+    }
+}
+
+void runDecompositionBenchmarks(Stream& out)
+{
+    out.printf("# fixed-size decompositions, %d iterations / n\n", BENCH_ITERATIONS);
+
+    benchSize<3>(out);
+    benchSize<4>(out);
+    benchSize<6>(out);
+    benchSize<9>(out);
+}
@@ -0,0 +1,17 @@
+//
+// The fixed-size decompositions in tmatrix_decomp.h against a generic,
+// runtime-sized Gauss-Jordan inverse, for the matrix sizes the filters use.
+//
+
+#ifndef DECOMPOSITION_BENCHMARKS_H
+#define DECOMPOSITION_BENCHMARKS_H
+
+#include <mbed.h>
+
+/**
+ * Runs the decomposition benchmarks and prints the largest |A * inverse(A) - I|
+ * element of each method.
+ */
+void runDecompositionBenchmarks(Stream& out);
+
+#endif //DECOMPOSITION_BENCHMARKS_H
@@ -0,0 +1,75 @@
+#include "EulerBenchmarks.h"
+#include "Benchmark.h"
+
+#include <quaternion.h>
+#include <EulerBatch.h>
+
+// quaternions converted per batch
+#define EULER_BENCH_BATCH 256
+
+namespace
+{
+    float qx[EULER_BENCH_BATCH];
+    float qy[EULER_BENCH_BATCH];
+    float qz[EULER_BENCH_BATCH];
+    float qw[EULER_BENCH_BATCH];
+
+    float roll[EULER_BENCH_BATCH];
+    float pitch[EULER_BENCH_BATCH];
+    float yaw[EULER_BENCH_BATCH];
+
+    // wrap an angle difference into [-pi, pi] so that yaw near +-pi compares correctly
+    float angleDifference(float a, float b)
+    {
+        float d = a - b;
+        while (d > FAST_MATH_PI) d -= 2 * FAST_MATH_PI;
+        while (d < -FAST_MATH_PI) d += 2 * FAST_MATH_PI;
+        return fabsf(d);
+    }
+}
+
+void runEulerBenchmarks(Stream& out)
+{
+    out.printf("# euler conversion, %d iterations\n", BENCH_ITERATIONS);
+
+    fillBenchmarkData(qx, EULER_BENCH_BATCH, 11);
+    fillBenchmarkData(qy, EULER_BENCH_BATCH, 12);
+    fillBenchmarkData(qz, EULER_BENCH_BATCH, 13);
+    fillBenchmarkData(qw, EULER_BENCH_BATCH, 14);
+    quatNormalizeBatch(qx, qy, qz, qw, EULER_BENCH_BATCH);
+
+    const uint32_t batches = BENCH_ITERATIONS / EULER_BENCH_BATCH;
+    Timer timer;
+    float sink = 0;
+
+    timer.start();
+    for (uint32_t b = 0; b < batches; ++b) {
+        for (size_t i = 0; i < EULER_BENCH_BATCH; ++i) {
+            TVector3 e = Quaternion(qx[i], qy[i], qz[i], qw[i]).euler();
+            sink += e[2];
+        }
+    }
+    timer.stop();
+    printBenchmark(out, "quaternion.euler(libm)", timer.read_us(), batches * EULER_BENCH_BATCH);
+
+    timer.reset();
+    timer.start();
+    for (uint32_t b = 0; b < batches; ++b) {
+        quaternionsToEuler(qx, qy, qz, qw, roll, pitch, yaw, EULER_BENCH_BATCH);
+        sink += yaw[b % EULER_BENCH_BATCH];
+    }
+    timer.stop();
+    printBenchmark(out, "quaternionsToEuler(batch)", timer.read_us(), batches * EULER_BENCH_BATCH);
+
+    benchmarkSink = sink;
+
+    float maxError = 0;
+    for (size_t i = 0; i < EULER_BENCH_BATCH; ++i) {
+        TVector3 e = Quaternion(qx[i], qy[i], qz[i], qw[i]).euler();
+        maxError = fmaxf(maxError, angleDifference(roll[i], e[0]));
+        maxError = fmaxf(maxError, angleDifference(pitch[i], e[1]));
+        maxError = fmaxf(maxError, angleDifference(yaw[i], e[2]));
+    }
+    out.printf("%-36s %10.2e rad (bound %.2e)\n", "quaternionsToEuler.maxError",
+               static_cast<double>(maxError), static_cast<double>(EULER_BATCH_MAX_ERROR));
+}
@@ -0,0 +1,16 @@
+//
+// Throughput of quaternionsToEuler() against Quaternion::euler() (libm).
+//
+
+#ifndef EULER_BENCHMARKS_H
+#define EULER_BENCHMARKS_H
+
+#include <mbed.h>
+
+/**
+ * Runs the Euler conversion benchmarks and prints the largest difference
+ * between the two implementations seen on the benchmark data.
+ */
+void runEulerBenchmarks(Stream& out);
+
+#endif //EULER_BENCHMARKS_H
@@ -0,0 +1,156 @@
+#include "ExpressionBenchmarks.h"
+#include "Benchmark.h"
+
+#include <tmatrix.h>
+
+// a 6 state filter (e.g. heading, rate and gyro bias in two axes) observing 3 values
+typedef TMatrix<6, 6, float> StateMatrix;
+typedef TMatrix<6, 1, float> StateVector;
+typedef TMatrix<3, 6, float> ObservationMatrix;
+typedef TMatrix<6, 3, float> GainMatrix;
+typedef TMatrix<3, 1, float> MeasurementVector;
+
+namespace
+{
+    StateMatrix F, Ft, P, Q;
+    StateVector x;
+    ObservationMatrix H;
+    GainMatrix K;
+    MeasurementVector z;
+
+    void fill(float* data, size_t count, uint32_t seed, float scale)
+    {
+        fillBenchmarkData(data, count, seed);
+        for (size_t i = 0; i < count; ++i) {
+            data[i] *= scale;
+        }
+    }
+
+    void setupData()
+    {
+        fill(F.row(0), 36, 21, 0.1f);
+        for (uint16_t i = 0; i < 6; ++i) {
+            F.element(i, i) += 1.0f;
+        }
+        Ft = F.transpose();
+        fill(P.row(0), 36, 22, 0.01f);
+        P = P * P.transpose() + StateMatrix::identity();
+        fill(Q.row(0), 36, 23, 0.001f);
+        fill(x.row(0), 6, 24, 1.0f);
+        fill(H.row(0), 18, 25, 1.0f);
+        fill(K.row(0), 18, 26, 0.1f);
+        fill(z.row(0), 3, 27, 1.0f);
+    }
+
+    template <uint16_t R, uint16_t C>
+    float maxDifference(const TMatrix<R, C, float>& a, const TMatrix<R, C, float>& b)
+    {
+        float d = 0;
+        for (uint16_t i = 0; i < R; ++i) {
+            for (uint16_t j = 0; j < C; ++j) {
+                d = fmaxf(d, fabsf(a.element(i, j) - b.element(i, j)));
+            }
+        }
+        return d;
+    }
+}
+
+void runExpressionBenchmarks(Stream& out)
+{
+    out.printf("# tmatrix expression templates, %d iterations\n", BENCH_ITERATIONS);
+    setupData();
+
+    Timer timer;
+    float sink = 0;
+    float maxError = 0;
+    StateMatrix resultA, resultB;
+    StateVector stateA, stateB;
+    const float s = 0.5f, t = 0.25f;
+
+    // element-wise blend: a*s + c*t
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        resultA = P * s + Q * t;
+        sink += resultA.element(i % 6, 0);
+    }
+    timer.stop();
+    printBenchmark(out, "ekf.blend(a*s+c*t)", timer.read_us(), BENCH_ITERATIONS);
+
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        resultB = lazy(P) * s + lazy(Q) * t;
+        sink += resultB.element(i % 6, 0);
+    }
+    timer.stop();
+    printBenchmark(out, "ekf.blend(a*s+c*t).lazy", timer.read_us(), BENCH_ITERATIONS);
+    maxError = fmaxf(maxError, maxDifference(resultA, resultB));
+
+    // covariance prediction: F P F^T + Q
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        resultA = F * P * Ft + Q;
+        sink += resultA.element(i % 6, 0);
+    }
+    timer.stop();
+    printBenchmark(out, "ekf.predict(F*P*Ft+Q)", timer.read_us(), BENCH_ITERATIONS);
+
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        resultB = lazy(F) * P * Ft + Q;
+        sink += resultB.element(i % 6, 0);
+    }
+    timer.stop();
+    printBenchmark(out, "ekf.predict(F*P*Ft+Q).lazy", timer.read_us(), BENCH_ITERATIONS);
+    maxError = fmaxf(maxError, maxDifference(resultA, resultB));
+
+    // state update: x + K (z - H x), written back into x
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        stateA = x;
+        stateA = stateA + K * (z - H * stateA);
+        sink += stateA[i % 6];
+    }
+    timer.stop();
+    printBenchmark(out, "ekf.update(x+K*(z-H*x))", timer.read_us(), BENCH_ITERATIONS);
+
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        stateB = x;
+        stateB = lazy(stateB) + K * (lazy(z) - lazy(H) * stateB);
+        sink += stateB[i % 6];
+    }
+    timer.stop();
+    printBenchmark(out, "ekf.update(x+K*(z-H*x)).lazy", timer.read_us(), BENCH_ITERATIONS);
+    maxError = fmaxf(maxError, maxDifference(stateA, stateB));
+
+    // covariance update: (I - K H) P, which reads the destination inside a product
+    const StateMatrix I = StateMatrix::identity();
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        resultA = P;
+        resultA = (I - K * H) * resultA;
+        sink += resultA.element(i % 6, 0);
+    }
+    timer.stop();
+    printBenchmark(out, "ekf.covariance((I-K*H)*P)", timer.read_us(), BENCH_ITERATIONS);
+
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        resultB = P;
+        resultB = (lazy(I) - lazy(K) * H) * resultB;
+        sink += resultB.element(i % 6, 0);
+    }
+    timer.stop();
+    printBenchmark(out, "ekf.covariance((I-K*H)*P).lazy", timer.read_us(), BENCH_ITERATIONS);
+    maxError = fmaxf(maxError, maxDifference(resultA, resultB));
+
+    benchmarkSink = sink;
+    out.printf("%-36s %10.2e\n", "lazy.maxDifference", static_cast<double>(maxError));
+}
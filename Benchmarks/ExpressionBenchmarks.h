@@ -0,0 +1,17 @@
+//
+// Typical EKF update expressions written with the regular TMatrix operators
+// and with lazy() expression templates.
+//
+
+#ifndef EXPRESSION_BENCHMARKS_H
+#define EXPRESSION_BENCHMARKS_H
+
+#include <mbed.h>
+
+/**
+ * Runs the expression template benchmarks and prints the largest difference
+ * between the regular and lazy results.
+ */
+void runExpressionBenchmarks(Stream& out);
+
+#endif //EXPRESSION_BENCHMARKS_H
@@ -0,0 +1,167 @@
+#include "InterpolationBenchmarks.h"
+#include "Benchmark.h"
+
+#include <quaternion.h>
+#include <ReportResampler.h>
+
+// number of distinct quaternion pairs cycled through
+#define INTERP_BENCH_SETS 64
+
+// simulated report periods and output period of the resampler benchmark, in us
+#define INTERP_ROTATION_PERIOD 10000
+#define INTERP_ACCEL_PERIOD 20000
+#define INTERP_OUTPUT_PERIOD 5000
+
+// rotation rate of the simulated IMU, rad/s
+#define INTERP_YAW_RATE 2.0
+
+// rotation samples precomputed for the resampler benchmark
+#define INTERP_YAW_SAMPLES 256
+
+// report IDs of the two simulated reports
+#define INTERP_ROTATION_ID 0x05
+#define INTERP_ACCEL_ID 0x01
+
+namespace
+{
+    Quaternion fromData[INTERP_BENCH_SETS];
+    Quaternion toData[INTERP_BENCH_SETS];
+    Quaternion yawData[INTERP_YAW_SAMPLES];
+
+    // angle in radians of the rotation between two unit quaternions.  Taken from the
+    // vector part of the difference rotation, as acos(dot) can't resolve small angles in float.
+    float angleBetween(const Quaternion& a, const Quaternion& b)
+    {
+        float s = (a.conjugate() * b).complex().norm();
+        return s >= 1 ? static_cast<float>(M_PI) : 2 * std::asin(s);
+    }
+
+    // the simulated IMU's rotation some time after the start.  Worked out in double,
+    // so that float rounding of the growing angle doesn't count as interpolation error.
+    Quaternion yawAt(uint32_t elapsedUs)
+    {
+        double halfYaw = std::fmod(0.5 * INTERP_YAW_RATE * 1e-6 * elapsedUs, 2 * M_PI);
+        return Quaternion(0, 0, static_cast<float>(std::sin(halfYaw)), static_cast<float>(std::cos(halfYaw)));
+    }
+
+    // pairs of rotations a few degrees apart, like consecutive samples, and the simulated IMU's samples
+    void setupData()
+    {
+        float data[INTERP_BENCH_SETS * 6];
+        fillBenchmarkData(data, INTERP_BENCH_SETS * 6, 41);
+        for (size_t i = 0; i < INTERP_BENCH_SETS; ++i) {
+            Quaternion a, step;
+            a.scaledAxis(TVector3(data[i * 6] * 3, data[i * 6 + 1] * 3, data[i * 6 + 2] * 3));
+            step.scaledAxis(TVector3(data[i * 6 + 3], data[i * 6 + 4], data[i * 6 + 5]) * 0.1f);
+            fromData[i] = a;
+            toData[i] = a * step;
+        }
+
+        for (size_t i = 0; i < INTERP_YAW_SAMPLES; ++i) {
+            yawData[i] = yawAt(i * INTERP_ROTATION_PERIOD);
+        }
+    }
+
+    void benchSlerp(Stream& out)
+    {
+        Timer timer;
+        float sink = 0;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            float t = static_cast<float>(i % 16) / 16;
+            sink += Quaternion::slerp(fromData[i % INTERP_BENCH_SETS], toData[i % INTERP_BENCH_SETS], t).w();
+        }
+        timer.stop();
+        printBenchmark(out, "quaternion.slerp", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            float t = static_cast<float>(i % 16) / 16;
+            sink += Quaternion::nlerp(fromData[i % INTERP_BENCH_SETS], toData[i % INTERP_BENCH_SETS], t).w();
+        }
+        timer.stop();
+        printBenchmark(out, "quaternion.nlerp", timer.read_us(), BENCH_ITERATIONS);
+
+        float maxAngle = 0;
+        for (uint32_t i = 0; i < INTERP_BENCH_SETS * 16; ++i) {
+            float t = static_cast<float>(i % 16) / 16;
+            const Quaternion& a = fromData[i / 16];
+            const Quaternion& b = toData[i / 16];
+            float angle = angleBetween(Quaternion::slerp(a, b, t), Quaternion::nlerp(a, b, t));
+            if (angle > maxAngle) {
+                maxAngle = angle;
+            }
+        }
+
+        benchmarkSink = sink;
+        out.printf("%-36s %10.2e rad\n", "max angle(slerp nlerp)", static_cast<double>(maxAngle));
+    }
+
+    // pushes a steady yaw rotation at one rate and a vector at half that rate, polling
+    // after every sample.  If maxAngle is given, every frame is compared to the true rotation.
+    uint32_t runResampler(ReportResampler& resampler, uint32_t samples, float& sink, float* maxAngle)
+    {
+        // start the timestamps just before they wrap, which the resampler must not notice
+        const uint32_t start = 0xFFFFFFFFu - 50 * INTERP_ROTATION_PERIOD;
+        uint32_t frames = 0;
+        ResampledFrame frame;
+
+        for (uint32_t i = 0; i < samples; ++i) {
+            uint32_t t = start + i * INTERP_ROTATION_PERIOD;
+            resampler.push(INTERP_ROTATION_ID, t, yawData[i % INTERP_YAW_SAMPLES]);
+            if (i % (INTERP_ACCEL_PERIOD / INTERP_ROTATION_PERIOD) == 0) {
+                resampler.push(INTERP_ACCEL_ID, t, TVector3(0, 0, static_cast<float>(i)));
+            }
+
+            while (resampler.poll(frame)) {
+                if (maxAngle) {
+                    float angle = angleBetween(frame.quaternion(0), yawAt(frame.timestamp - start));
+                    if (angle > *maxAngle) {
+                        *maxAngle = angle;
+                    }
+                }
+                sink += frame.values[1][2];
+                ++frames;
+            }
+        }
+        return frames;
+    }
+
+    void benchResampler(Stream& out, ReportResampler::QuaternionInterpolation interpolation, const char* name)
+    {
+        ReportResampler resampler(INTERP_OUTPUT_PERIOD);
+        resampler.addChannel(INTERP_ROTATION_ID, ReportResampler::QUATERNION);
+        resampler.addChannel(INTERP_ACCEL_ID, ReportResampler::VECTOR);
+        resampler.setQuaternionInterpolation(interpolation);
+
+        Timer timer;
+        float sink = 0;
+
+        // the table wraps around after INTERP_YAW_SAMPLES, which jumps the rotation
+        // back, so accuracy is only checked over one pass of it
+        float maxAngle = 0;
+        runResampler(resampler, INTERP_YAW_SAMPLES, sink, &maxAngle);
+
+        resampler.restart();
+        timer.start();
+        uint32_t frames = runResampler(resampler, BENCH_ITERATIONS, sink, NULL);
+        timer.stop();
+
+        benchmarkSink = sink;
+        printBenchmark(out, name, timer.read_us(), frames);
+        out.printf("%-36s %10.2e rad, %u dropped\n", "  max angle to true rotation", static_cast<double>(maxAngle),
+                   static_cast<unsigned>(resampler.droppedFrames()));
+    }
+}
+
+void runInterpolationBenchmarks(Stream& out)
+{
+    out.printf("# interpolation, %d iterations\n", BENCH_ITERATIONS);
+
+    setupData();
+    benchSlerp(out);
+    benchResampler(out, ReportResampler::NLERP, "resampler(nlerp) per frame");
+    benchResampler(out, ReportResampler::SLERP, "resampler(slerp) per frame");
+}
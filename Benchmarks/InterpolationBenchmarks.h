@@ -0,0 +1,17 @@
+//
+// Quaternion slerp against nlerp, and the cost of putting two reports at
+// different rates onto one clock with ReportResampler.
+//
+
+#ifndef INTERPOLATION_BENCHMARKS_H
+#define INTERPOLATION_BENCHMARKS_H
+
+#include <mbed.h>
+
+/**
+ * Runs the interpolation benchmarks and prints the largest angle between
+ * slerp and nlerp, and between resampled and true rotations.
+ */
+void runInterpolationBenchmarks(Stream& out);
+
+#endif //INTERPOLATION_BENCHMARKS_H
@@ -0,0 +1,215 @@
+#include "KernelBenchmarks.h"
+#include "Benchmark.h"
+
+#include <quaternion.h>
+#include <QuaternionKernels.h>
+
+// number of distinct inputs cycled through by the single-operation loops
+#define KERNEL_BENCH_SETS 64
+
+// number of elements processed per call of the batch kernels
+#define KERNEL_BENCH_BATCH 256
+
+namespace
+{
+    float quatData[KERNEL_BENCH_SETS * 4];
+    float vecData[KERNEL_BENCH_SETS * 4];
+    float matData[KERNEL_BENCH_SETS * 16];
+
+    float batchX[KERNEL_BENCH_BATCH];
+    float batchY[KERNEL_BENCH_BATCH];
+    float batchZ[KERNEL_BENCH_BATCH];
+    float batchW[KERNEL_BENCH_BATCH];
+
+    void setupData()
+    {
+        fillBenchmarkData(quatData, sizeof(quatData) / sizeof(float), 1);
+        fillBenchmarkData(vecData, sizeof(vecData) / sizeof(float), 2);
+        fillBenchmarkData(matData, sizeof(matData) / sizeof(float), 3);
+
+        for (size_t i = 0; i < KERNEL_BENCH_SETS; ++i) {
+            quatNormalize(quatData + i * 4);
+        }
+    }
+
+    void resetBatch()
+    {
+        fillBenchmarkData(batchX, KERNEL_BENCH_BATCH, 4);
+        fillBenchmarkData(batchY, KERNEL_BENCH_BATCH, 5);
+        fillBenchmarkData(batchZ, KERNEL_BENCH_BATCH, 6);
+        fillBenchmarkData(batchW, KERNEL_BENCH_BATCH, 7);
+    }
+
+    void benchProduct(Stream& out)
+    {
+        Timer timer;
+        float sink = 0;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Quaternion a(quatData + (i % KERNEL_BENCH_SETS) * 4);
+            Quaternion b(quatData + ((i + 1) % KERNEL_BENCH_SETS) * 4);
+            sink += (a * b).w();
+        }
+        timer.stop();
+        printBenchmark(out, "quaternion.product", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            float r[4];
+            quatProduct(quatData + (i % KERNEL_BENCH_SETS) * 4, quatData + ((i + 1) % KERNEL_BENCH_SETS) * 4, r);
+            sink += r[3];
+        }
+        timer.stop();
+        printBenchmark(out, "kernel.quatProduct", timer.read_us(), BENCH_ITERATIONS);
+
+        benchmarkSink = sink;
+    }
+
+    void benchRotate(Stream& out)
+    {
+        Timer timer;
+        float sink = 0;
+
+        // what Quaternion::rotatedVector() used to do: two full quaternion products
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Quaternion q(quatData + (i % KERNEL_BENCH_SETS) * 4);
+            TVector3 v(vecData + (i % KERNEL_BENCH_SETS) * 4);
+            sink += ((q * Quaternion(v, 0)) * q.conjugate()).x();
+        }
+        timer.stop();
+        printBenchmark(out, "quaternion.rotate(two products)", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Quaternion q(quatData + (i % KERNEL_BENCH_SETS) * 4);
+            TVector3 v(vecData + (i % KERNEL_BENCH_SETS) * 4);
+            sink += q.rotatedVector(v)[0];
+        }
+        timer.stop();
+        printBenchmark(out, "quaternion.rotatedVector", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            float r[3];
+            quatRotate(quatData + (i % KERNEL_BENCH_SETS) * 4, vecData + (i % KERNEL_BENCH_SETS) * 4, r);
+            sink += r[0];
+        }
+        timer.stop();
+        printBenchmark(out, "kernel.quatRotate", timer.read_us(), BENCH_ITERATIONS);
+
+        resetBatch();
+        const uint32_t batches = BENCH_ITERATIONS / KERNEL_BENCH_BATCH;
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < batches; ++i) {
+            quatRotateBatch(quatData + (i % KERNEL_BENCH_SETS) * 4, batchX, batchY, batchZ,
+                            batchX, batchY, batchZ, KERNEL_BENCH_BATCH);
+        }
+        timer.stop();
+        sink += batchX[0];
+        printBenchmark(out, "kernel.quatRotateBatch", timer.read_us(), batches * KERNEL_BENCH_BATCH);
+
+        benchmarkSink = sink;
+    }
+
+    void benchNormalize(Stream& out)
+    {
+        Timer timer;
+        float sink = 0;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Quaternion q(vecData + (i % KERNEL_BENCH_SETS) * 4);
+            sink += (q / q.norm()).w();
+        }
+        timer.stop();
+        printBenchmark(out, "quaternion.normalize", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            float q[4];
+            memcpy(q, vecData + (i % KERNEL_BENCH_SETS) * 4, sizeof(q));
+            quatNormalize(q);
+            sink += q[3];
+        }
+        timer.stop();
+        printBenchmark(out, "kernel.quatNormalize", timer.read_us(), BENCH_ITERATIONS);
+
+        resetBatch();
+        const uint32_t batches = BENCH_ITERATIONS / KERNEL_BENCH_BATCH;
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < batches; ++i) {
+            quatNormalizeBatch(batchX, batchY, batchZ, batchW, KERNEL_BENCH_BATCH);
+        }
+        timer.stop();
+        sink += batchW[0];
+        printBenchmark(out, "kernel.quatNormalizeBatch", timer.read_us(), batches * KERNEL_BENCH_BATCH);
+
+        benchmarkSink = sink;
+    }
+
+    void benchMatVec(Stream& out)
+    {
+        Timer timer;
+        float sink = 0;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            TMatrix3 m(matData + (i % KERNEL_BENCH_SETS) * 16);
+            TVector3 v(vecData + (i % KERNEL_BENCH_SETS) * 4);
+            sink += (m * v)[0];
+        }
+        timer.stop();
+        printBenchmark(out, "tmatrix.3x3*vector", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            float r[3];
+            matVec3(matData + (i % KERNEL_BENCH_SETS) * 16, vecData + (i % KERNEL_BENCH_SETS) * 4, r);
+            sink += r[0];
+        }
+        timer.stop();
+        printBenchmark(out, "kernel.matVec3", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            TMatrix4 m(matData + (i % KERNEL_BENCH_SETS) * 16);
+            TVector4 v(vecData + (i % KERNEL_BENCH_SETS) * 4);
+            sink += (m * v)[0];
+        }
+        timer.stop();
+        printBenchmark(out, "tmatrix.4x4*vector", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            float r[4];
+            matVec4(matData + (i % KERNEL_BENCH_SETS) * 16, vecData + (i % KERNEL_BENCH_SETS) * 4, r);
+            sink += r[0];
+        }
+        timer.stop();
+        printBenchmark(out, "kernel.matVec4", timer.read_us(), BENCH_ITERATIONS);
+
+        benchmarkSink = sink;
+    }
+}
+
+void runKernelBenchmarks(Stream& out)
+{
+    out.printf("# quaternion / matrix kernels, %d iterations\n", BENCH_ITERATIONS);
+    setupData();
+
+    benchProduct(out);
+    benchRotate(out);
+    benchNormalize(out);
+    benchMatVec(out);
+}
@@ -0,0 +1,16 @@
+//
+// Benchmarks of the kernels in QuaternionKernels.h against the
+// equivalent Quaternion / TMatrix methods.
+//
+
+#ifndef KERNEL_BENCHMARKS_H
+#define KERNEL_BENCHMARKS_H
+
+#include <mbed.h>
+
+/**
+ * Runs the quaternion and matrix-vector kernel benchmarks, printing one line per case.
+ */
+void runKernelBenchmarks(Stream& out);
+
+#endif //KERNEL_BENCHMARKS_H
@@ -0,0 +1,104 @@
+#include "PrecisionBenchmarks.h"
+#include "Benchmark.h"
+
+#include <tmatrix.h>
+
+namespace
+{
+    // a 6 state filter observing 3 values, as in ExpressionBenchmarks, in either precision
+    template <typename T>
+    struct Filter
+    {
+        TMatrix<6, 6, T> F, Ft, P, Q, nextP;
+        TMatrix<6, 1, T> x, nextX;
+        TMatrix<3, 6, T> H;
+        TMatrix<6, 3, T> Ht;
+        TMatrix<3, 3, T> R;
+        TMatrix<3, 1, T> z;
+        TMatrix<6, 3, T> K;
+
+        template <uint16_t Rows, uint16_t Cols>
+        static void fill(TMatrix<Rows, Cols, T>& m, uint32_t seed, float scale)
+        {
+            float data[Rows * Cols];
+            fillBenchmarkData(data, Rows * Cols, seed);
+            for (uint16_t i = 0; i < Rows * Cols; ++i) {
+                m.row(0)[i] = static_cast<T>(data[i] * scale);
+            }
+        }
+
+        void setup()
+        {
+            fill(F, 31, 0.1f);
+            for (uint16_t i = 0; i < 6; ++i) {
+                F.element(i, i) += 1;
+            }
+            Ft = F.transpose();
+            fill(P, 32, 0.01f);
+            P = P * P.transpose() + TMatrix<6, 6, T>::identity();
+            fill(Q, 33, 0.001f);
+            fill(x, 34, 1.0f);
+            fill(H, 35, 1.0f);
+            Ht = H.transpose();
+            R = TMatrix<3, 3, T>::identity() * static_cast<T>(0.1f);
+            fill(z, 36, 1.0f);
+            fill(K, 37, 0.1f);
+        }
+
+        // predict and update with a fixed gain, so the two precisions take identical steps.
+        // Every step starts from the same P and x to keep the values bounded.
+        void step()
+        {
+            nextP = F * P * Ft + Q;
+            nextX = F * x;
+            nextX = nextX + K * (z - H * nextX);
+            nextP = nextP - K * (H * nextP * Ht + R) * K.transpose();
+        }
+    };
+
+    Filter<float> floatFilter;
+    Filter<double> doubleFilter;
+
+    template <typename T>
+    float timeSteps(Filter<T>& filter, uint32_t steps, float& sink)
+    {
+        Timer timer;
+        filter.setup();
+
+        timer.start();
+        for (uint32_t i = 0; i < steps; ++i) {
+            filter.step();
+            sink += static_cast<float>(filter.nextX[i % 6]);
+        }
+        timer.stop();
+        return timer.read_us();
+    }
+
+    float maxRelativeDifference(const Filter<float>& a, const Filter<double>& b)
+    {
+        double d = 0;
+        for (uint16_t i = 0; i < 6; ++i) {
+            d = fmax(d, fabs(static_cast<double>(a.nextX[i]) - b.nextX[i]) / fmax(fabs(b.nextX[i]), 1e-6));
+            for (uint16_t j = 0; j < 6; ++j) {
+                const double p = b.nextP.element(i, j);
+                d = fmax(d, fabs(static_cast<double>(a.nextP.element(i, j)) - p) / fmax(fabs(p), 1e-6));
+            }
+        }
+        return static_cast<float>(d);
+    }
+}
+
+void runPrecisionBenchmarks(Stream& out)
+{
+    // a filter step is about 30 times the work of one benchmark operation elsewhere
+    const uint32_t steps = BENCH_ITERATIONS / 32;
+    out.printf("# float versus double EKF steps, %d steps\n", (int)steps);
+
+    float sink = 0;
+    printBenchmark(out, "ekf.step<float>", timeSteps(floatFilter, steps, sink), steps);
+    printBenchmark(out, "ekf.step<double>", timeSteps(doubleFilter, steps, sink), steps);
+    benchmarkSink = sink;
+
+    out.printf("%-36s %10.2e\n", "ekf.step.maxRelativeDifference",
+               static_cast<double>(maxRelativeDifference(floatFilter, doubleFilter)));
+}
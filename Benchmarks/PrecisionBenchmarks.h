@@ -0,0 +1,17 @@
+//
+// The same EKF steps computed with float and with double matrices, to show
+// what a filter pays for asking for double (see TMatrixPrecision in tmatrix.h).
+//
+
+#ifndef PRECISION_BENCHMARKS_H
+#define PRECISION_BENCHMARKS_H
+
+#include <mbed.h>
+
+/**
+ * Runs the float versus double benchmarks and prints the largest relative
+ * difference between the float and double results.
+ */
+void runPrecisionBenchmarks(Stream& out);
+
+#endif //PRECISION_BENCHMARKS_H
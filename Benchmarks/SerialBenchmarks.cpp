@@ -0,0 +1,174 @@
+#include "SerialBenchmarks.h"
+#include "Benchmark.h"
+
+#include <quaternion.h>
+#include <Telemetry.h>
+#include <TxRing.h>
+#include <Log.h>
+
+// time the UART takes per byte at 57600 baud, 8N1, in us
+#define SERIAL_BENCH_BYTE_TIME (1e6 / 5760)
+
+namespace
+{
+    TxRing ring;
+
+    // the writing side of BufferedSerialTx, without the UART
+    class RingStream : public Stream
+    {
+    protected:
+        virtual int _putc(int c)
+        {
+            ring.put(static_cast<uint8_t>(c));
+            return c;
+        }
+    };
+
+    // what the TX interrupt does, all at once
+    void drainRing()
+    {
+        uint8_t byte;
+        while (ring.get(byte)) {
+        }
+    }
+
+    void printStall(Stream& out, const char* name, uint32_t elapsedUs, uint32_t operations, uint32_t bytes)
+    {
+        printBenchmark(out, name, elapsedUs, operations);
+        out.printf("%-36s %10.1f us blocking (%u bytes at 57600 baud)\n", "",
+                   static_cast<double>(bytes) * SERIAL_BENCH_BYTE_TIME, static_cast<unsigned>(bytes));
+    }
+
+    void benchPut(Stream& out)
+    {
+        Timer timer;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            ring.put(static_cast<uint8_t>(i));
+            if ((i & 255) == 255) {
+                drainRing();
+            }
+        }
+        timer.stop();
+        drainRing();
+        printBenchmark(out, "txring.put per byte", timer.read_us(), BENCH_ITERATIONS);
+    }
+
+    // one rotation sample in its own telemetry frame, as main.cpp sends it at low rates
+    void benchFrame(Stream& out)
+    {
+        RingStream stream;
+        TelemetryEncoder encoder(stream);
+        int16_t words[5] = {1000, -2000, 3000, 15000, 200};
+        Timer timer;
+
+        // the first frame has an extra delimiter, keep it out of the byte count
+        encoder.add(SENSOR_REPORTID_ROTATION_VECTOR, 3, 0, words, 5);
+        encoder.flush();
+        drainRing();
+
+        uint32_t bytes = ring.used();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            encoder.add(SENSOR_REPORTID_ROTATION_VECTOR, 3, i * 10000, words, 5);
+            encoder.flush();
+            if (i == 0) {
+                bytes = ring.used();
+            }
+            drainRing();
+        }
+        timer.stop();
+        printStall(out, "buffered telemetry frame", timer.read_us(), BENCH_ITERATIONS, bytes);
+    }
+
+    // the text line main.cpp used to print
+    void benchText(Stream& out)
+    {
+        RingStream stream;
+        Quaternion rotation;
+        rotation.scaledAxis(TVector3(0.3f, -0.2f, 1.1f));
+        Timer timer;
+        uint32_t bytes = 0;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            TVector3 eulerDegrees = rotation.euler() * static_cast<float>(180.0 / M_PI);
+            eulerDegrees.print(stream, true);
+            stream.printf(" %f", static_cast<double>(i * 0.05f));
+            stream.printf("\n");
+            if (i == 0) {
+                bytes = ring.used();
+            }
+            drainRing();
+        }
+        timer.stop();
+        printStall(out, "buffered text line", timer.read_us(), BENCH_ITERATIONS, bytes);
+    }
+
+    // the driver's longest error message: queued by the logger, against formatted with printf
+    void benchLog(Stream& out)
+    {
+        RingStream stream;
+        float minPeriod = 0.0025f;
+        Timer timer;
+        LogEntry entry;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            LOG_MSG(PERIOD_TOO_SHORT, static_cast<uint8_t>(i), i * 1e-4f, minPeriod);
+            if ((i & (LOG_RING_ENTRIES - 1)) == LOG_RING_ENTRIES - 1) {
+                while (logPop(entry)) {
+                }
+            }
+        }
+        timer.stop();
+        while (logPop(entry)) {
+        }
+        printBenchmark(out, "LOG_MSG, 3 arguments", timer.read_us(), BENCH_ITERATIONS);
+
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            stream.printf("Error: attempt made to set report 0x%02hhx to period of %.06f s, which is smaller than its min period of %.06f s.\n",
+                          static_cast<uint8_t>(i), static_cast<double>(i * 1e-4f), static_cast<double>(minPeriod));
+            drainRing();
+        }
+        timer.stop();
+        printBenchmark(out, "printf of the same message", timer.read_us(), BENCH_ITERATIONS);
+    }
+
+    // fills the ring three times over without draining: the newest TX_RING_SIZE bytes must be kept, in order
+    void checkOverflow(Stream& out)
+    {
+        uint32_t droppedBefore = ring.droppedBytes();
+        for (uint32_t i = 0; i < 3 * TX_RING_SIZE; ++i) {
+            ring.put(static_cast<uint8_t>(i));
+        }
+
+        uint32_t misplaced = 0;
+        uint32_t kept = 0;
+        uint8_t byte;
+        while (ring.get(byte)) {
+            if (byte != static_cast<uint8_t>(2 * TX_RING_SIZE + kept)) {
+                ++misplaced;
+            }
+            ++kept;
+        }
+
+        out.printf("%-36s %u kept, %u dropped, %u out of order\n", "  overflow (drop oldest)",
+                   static_cast<unsigned>(kept), static_cast<unsigned>(ring.droppedBytes() - droppedBefore),
+                   static_cast<unsigned>(misplaced));
+    }
+}
+
+void runSerialBenchmarks(Stream& out)
+{
+    out.printf("# serial output, %d iterations, %d byte ring\n", BENCH_ITERATIONS, TX_RING_SIZE);
+
+    benchPut(out);
+    benchFrame(out);
+    benchText(out);
+    benchLog(out);
+    checkOverflow(out);
+}
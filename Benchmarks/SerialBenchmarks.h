@@ -0,0 +1,18 @@
+//
+// How long writing output holds up the sensor loop: blocking on a 57600 baud
+// UART against queueing into the TxRing that BufferedSerialTx sends from.
+//
+
+#ifndef SERIAL_BENCHMARKS_H
+#define SERIAL_BENCHMARKS_H
+
+#include <mbed.h>
+
+/**
+ * Runs the serial output benchmarks and prints the time per byte and the loop
+ * stall of one telemetry frame and one text line, the cost of a deferred log message
+ * against printf, and checks the overflow policy.
+ */
+void runSerialBenchmarks(Stream& out);
+
+#endif //SERIAL_BENCHMARKS_H
@@ -0,0 +1,202 @@
+#include "TelemetryBenchmarks.h"
+#include "Benchmark.h"
+
+#include <quaternion.h>
+#include <Telemetry.h>
+#include <FlightRecorder.h>
+
+// number of distinct rotation samples cycled through
+#define TELEMETRY_BENCH_SETS 64
+
+// serial link the IMU output goes over, in bytes per second (57600 baud, 8N1)
+#define TELEMETRY_LINK_BYTES_PER_SECOND 5760
+
+namespace
+{
+    // a stream that only counts what is written to it, so the link isn't timed
+    class CountingStream : public Stream
+    {
+    public:
+        CountingStream() : count(0) {}
+
+        uint32_t count;
+
+    protected:
+        virtual int _putc(int c)
+        {
+            ++count;
+            return c;
+        }
+    };
+
+    Quaternion rotations[TELEMETRY_BENCH_SETS];
+    int16_t rotationWords[TELEMETRY_BENCH_SETS][5];
+
+    void setupData()
+    {
+        float data[TELEMETRY_BENCH_SETS * 3];
+        fillBenchmarkData(data, TELEMETRY_BENCH_SETS * 3, 53);
+        for (size_t i = 0; i < TELEMETRY_BENCH_SETS; ++i) {
+            rotations[i].scaledAxis(TVector3(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]) * 3);
+            for (uint16_t j = 0; j < 4; ++j) {
+                rotationWords[i][j] = static_cast<int16_t>(rotations[i].row(0)[j] * (1 << ROTATION_Q_POINT));
+            }
+            rotationWords[i][4] = static_cast<int16_t>(0.05f * (1 << ROTATION_ACCURACY_Q_POINT));
+        }
+    }
+
+    void printResult(Stream& out, const char* name, uint32_t elapsedUs, uint32_t bytes)
+    {
+        printBenchmark(out, name, elapsedUs, BENCH_ITERATIONS);
+        float bytesPerSample = static_cast<float>(bytes) / BENCH_ITERATIONS;
+        out.printf("%-36s %10.2f B/sample, %.0f samples/s at 57600 baud\n", "", static_cast<double>(bytesPerSample),
+                   static_cast<double>(TELEMETRY_LINK_BYTES_PER_SECOND / bytesPerSample));
+    }
+
+    // what main.cpp printed for each sample: Euler angles in degrees and the time, as text
+    void benchText(Stream& out)
+    {
+        CountingStream link;
+        Timer timer;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            TVector3 eulerDegrees = rotations[i % TELEMETRY_BENCH_SETS].euler() * static_cast<float>(180.0 / M_PI);
+            eulerDegrees.print(link, true);
+            link.printf(" %f", static_cast<double>(i * 0.01f));
+            link.printf("\n");
+        }
+        timer.stop();
+
+        printResult(out, "text rotation sample", timer.read_us(), link.count);
+    }
+
+    // the raw words and sensor timestamp, framed as binary telemetry
+    void benchBinary(Stream& out)
+    {
+        CountingStream link;
+        TelemetryEncoder encoder(link);
+        Timer timer;
+
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            encoder.add(SENSOR_REPORTID_ROTATION_VECTOR, 3, i * 10000, rotationWords[i % TELEMETRY_BENCH_SETS], 5);
+        }
+        encoder.flush();
+        timer.stop();
+
+        printResult(out, "binary rotation sample", timer.read_us(), link.count);
+
+        // and with a frame per sample, as when main.cpp flushes every loop at a low report rate
+        link.count = 0;
+        timer.reset();
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            encoder.add(SENSOR_REPORTID_ROTATION_VECTOR, 3, i * 10000, rotationWords[i % TELEMETRY_BENCH_SETS], 5);
+            encoder.flush();
+        }
+        timer.stop();
+
+        printResult(out, "binary rotation sample, 1 per frame", timer.read_us(), link.count);
+    }
+
+    // decodes what the encoder wrote and checks every word made it through
+    void checkRoundTrip(Stream& out)
+    {
+        class DecodingStream : public Stream
+        {
+        public:
+            TelemetryDecoder decoder;
+            uint32_t records;
+            uint32_t mismatches;
+
+            DecodingStream() : records(0), mismatches(0) {}
+
+        protected:
+            virtual int _putc(int c)
+            {
+                if (decoder.push(static_cast<uint8_t>(c))) {
+                    TelemetryRecord record;
+                    while (decoder.nextRecord(record)) {
+                        const int16_t* expected = rotationWords[records % TELEMETRY_BENCH_SETS];
+                        for (uint8_t i = 0; i < 5; ++i) {
+                            if (record.schema == NULL || record.words[i] != expected[i]) {
+                                ++mismatches;
+                            }
+                        }
+                        ++records;
+                    }
+                }
+                return c;
+            }
+        };
+
+        DecodingStream link;
+        TelemetryEncoder encoder(link);
+        for (uint32_t i = 0; i < 1000; ++i) {
+            encoder.add(SENSOR_REPORTID_ROTATION_VECTOR, 3, i * 10000, rotationWords[i % TELEMETRY_BENCH_SETS], 5);
+        }
+        encoder.flush();
+
+        out.printf("%-36s %u records, %u mismatched words, %u bad frames\n", "  round trip",
+                   static_cast<unsigned>(link.records), static_cast<unsigned>(link.mismatches),
+                   static_cast<unsigned>(link.decoder.badFrames()));
+    }
+
+    FlightRecorder recorder;
+
+    // a sample on every 10 ms of a level chair, until an impact at sample 5000
+    void benchFlightRecorder(Stream& out)
+    {
+        int16_t gravity[3] = {0, 0, static_cast<int16_t>(9.8f * (1 << ACCELEROMETER_Q_POINT))};
+        int16_t impact[3] = {static_cast<int16_t>(40.0f * (1 << ACCELEROMETER_Q_POINT)), 0, 0};
+        Timer timer;
+
+        recorder.setTriggers(0);
+        timer.start();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            if (i & 1) {
+                recorder.add(SENSOR_REPORTID_GRAVITY, 3, i * 5000, gravity, 3);
+            } else {
+                recorder.add(SENSOR_REPORTID_ROTATION_VECTOR, 3, i * 5000, rotationWords[i % TELEMETRY_BENCH_SETS], 5);
+            }
+        }
+        timer.stop();
+        printBenchmark(out, "flightrecorder.add", timer.read_us(), BENCH_ITERATIONS);
+
+        // with the triggers on: an impact, then one second more
+        recorder.setTriggers(FlightRecorder::TRIGGER_ALL);
+        recorder.rearm();
+        uint32_t added = 0;
+        for (uint32_t i = 0; i < 20000; ++i) {
+            const int16_t* words = (i == 5000) ? impact : gravity;
+            if (recorder.add(SENSOR_REPORTID_ACCELEROMETER, 3, i * 10000, words, 3)) {
+                ++added;
+            }
+        }
+
+        // the dump must start right after the samples the ring dropped, and decode cleanly
+        CountingStream link;
+        TelemetryEncoder encoder(link);
+        uint32_t dumped = recorder.dump(encoder);
+        size_t cursor = 0;
+        TelemetryRecord first;
+        recorder.readRecord(cursor, first);
+
+        out.printf("%-36s cause %u at %u us, %u added, %u kept (%u B/record), first at %u us\n", "  impact trigger",
+                   recorder.triggerCause(), static_cast<unsigned>(recorder.triggerTime()), static_cast<unsigned>(added),
+                   static_cast<unsigned>(dumped), static_cast<unsigned>(FlightRecorder::recordLength(SENSOR_REPORTID_ACCELEROMETER)),
+                   static_cast<unsigned>(first.timestamp));
+    }
+}
+
+void runTelemetryBenchmarks(Stream& out)
+{
+    out.printf("# telemetry, %d iterations\n", BENCH_ITERATIONS);
+
+    setupData();
+    benchText(out);
+    benchBinary(out);
+    checkRoundTrip(out);
+    benchFlightRecorder(out);
+}
@@ -0,0 +1,17 @@
+//
+// Cost and size of one rotation sample sent as text (the old main.cpp output)
+// and as a binary telemetry record.
+//
+
+#ifndef TELEMETRY_BENCHMARKS_H
+#define TELEMETRY_BENCHMARKS_H
+
+#include <mbed.h>
+
+/**
+ * Runs the telemetry benchmarks and prints the time and bytes per sample of
+ * each output format, and the most samples per second a 57600 baud link carries.
+ */
+void runTelemetryBenchmarks(Stream& out);
+
+#endif //TELEMETRY_BENCHMARKS_H
@@ -0,0 +1,39 @@
+/*
+ * Host (Linux) stand-in for mbed's BlockDevice interface, so BlockLog builds
+ * against the simulated devices of host/SimBlockDevice.h.  Only on the include
+ * path of the host build.
+ */
+
+#ifndef HOST_BLOCK_DEVICE_H
+#define HOST_BLOCK_DEVICE_H
+
+#include <stdint.h>
+
+typedef uint64_t bd_addr_t;
+typedef uint64_t bd_size_t;
+
+enum {
+	BD_ERROR_OK = 0,
+	BD_ERROR_DEVICE_ERROR = -4001
+};
+
+class BlockDevice
+{
+public:
+	virtual ~BlockDevice() {}
+
+	virtual int init() = 0;
+	virtual int deinit() = 0;
+	virtual int sync() { return 0; }
+
+	virtual int read(void* buffer, bd_addr_t addr, bd_size_t size) = 0;
+	virtual int program(const void* buffer, bd_addr_t addr, bd_size_t size) = 0;
+	virtual int erase(bd_addr_t addr, bd_size_t size) { return 0; }
+
+	virtual bd_size_t get_read_size() const = 0;
+	virtual bd_size_t get_program_size() const = 0;
+	virtual bd_size_t get_erase_size() const { return get_program_size(); }
+	virtual bd_size_t size() const = 0;
+};
+
+#endif /* HOST_BLOCK_DEVICE_H */
@@ -0,0 +1,154 @@
+/*
+ * Replay transport for the host build: an I2C device that plays back the
+ * packets of an SHTP capture (see BNOWrapper/ShtpCapture.h) to the unmodified
+ * BNO080 driver.
+ *
+ * Each packet the IMU sent is signalled on the interrupt line at the time the
+ * capture recorded for its interrupt, on the HostClock's virtual time, so the
+ * driver timestamps every sample exactly as it did on the board.  Construct the
+ * replay right before the driver, so that their clocks start together.  If the
+ * driver is still busy with the previous packet when a packet is due, it is
+ * signalled as soon as the driver is done, and counted as late.
+ *
+ * What the driver sends is accepted and counted, not checked.
+ */
+
+#ifndef HOST_SHTP_REPLAY_H
+#define HOST_SHTP_REPLAY_H
+
+#include <mbed.h>
+
+#include <vector>
+
+class ShtpReplay : public HostI2CDevice, public HostClockClient
+{
+public:
+	ShtpReplay(PinName intPin, uint8_t address) :
+		_intPin(intPin),
+		_address(address),
+		_next(0),
+		_current(false),
+		_readyAt(0),
+		_lastTimestamp(0),
+		_wraps(0),
+		_packetsRead(0),
+		_packetsLate(0),
+		_writes(0)
+	{
+		HostClock::useVirtualTime();
+		HostClock::attach(this);
+		I2C::attachDevice(_address, this);
+		HostPins::write(_intPin, 1);
+		_start = HostClock::now();
+	}
+
+	~ShtpReplay()
+	{
+		HostClock::detach(this);
+		I2C::attachDevice(_address, NULL);
+	}
+
+	/**
+	 * Adds a packet the IMU sent, in capture order.
+	 * @param timestamp Its interrupt time from the capture, in us; wraps of the 32 bit clock are followed.
+	 */
+	void add(uint32_t timestamp, const uint8_t* data, size_t length)
+	{
+		if (!_packets.empty() && timestamp < _lastTimestamp && _lastTimestamp - timestamp > 0x80000000u) {
+			_wraps++;
+		}
+		_lastTimestamp = timestamp;
+
+		Packet packet;
+		packet.due = _start + ((static_cast<int64_t>(_wraps) << 32) + timestamp) * 1000 - HostClock::pollCost();
+		packet.bytes.assign(data, data + length);
+		_packets.push_back(packet);
+	}
+
+	/// true once the driver has read every packet
+	bool done() const { return _next >= _packets.size() && !_current; }
+
+	size_t packets() const { return _packets.size(); }
+	uint32_t packetsRead() const { return _packetsRead; }
+
+	/// Packets signalled after their recorded time, because the driver was still busy
+	uint32_t packetsLate() const { return _packetsLate; }
+
+	/// Writes from the driver
+	uint32_t writes() const { return _writes; }
+
+	virtual int read(char* data, int length)
+	{
+		memset(data, 0, length);
+		if (!_current) {
+			return 0;
+		}
+
+		const std::vector<uint8_t>& bytes = _packets[_next].bytes;
+		memcpy(data, bytes.data(), static_cast<size_t>(length) < bytes.size() ? length : bytes.size());
+
+		// a read of the whole packet ends it; the header read before it doesn't
+		if (static_cast<size_t>(length) >= bytes.size()) {
+			_current = false;
+			_next++;
+			_packetsRead++;
+			_readyAt = HostClock::now() + HOST_SHTP_REPLAY_GAP;
+			HostPins::write(_intPin, 1);
+		}
+		return 0;
+	}
+
+	virtual int write(const char* data, int length)
+	{
+		_writes++;
+		return 0;
+	}
+
+	virtual int64_t nextEvent()
+	{
+		if (_current || _next >= _packets.size()) {
+			return INT64_MAX;
+		}
+		return _packets[_next].due > _readyAt ? _packets[_next].due : _readyAt;
+	}
+
+	virtual void runEvent()
+	{
+		if (_current || _next >= _packets.size()) {
+			return;
+		}
+		if (HostClock::now() > _packets[_next].due) {
+			_packetsLate++;
+		}
+		_current = true;
+		HostPins::write(_intPin, 0);
+	}
+
+private:
+	/// Time between the driver reading a packet and the next interrupt, in ns
+	static const int64_t HOST_SHTP_REPLAY_GAP = 20000;
+
+	struct Packet
+	{
+		int64_t due;	///< virtual time of its interrupt, in ns
+		std::vector<uint8_t> bytes;
+	};
+
+	PinName _intPin;
+	uint8_t _address;
+	int64_t _start;
+
+	std::vector<Packet> _packets;
+	size_t _next;
+	bool _current;
+	int64_t _readyAt;
+
+	uint32_t _lastTimestamp;
+	uint32_t _wraps;
+
+	uint32_t _packetsRead;
+	uint32_t _packetsLate;
+	uint32_t _writes;
+};
+
+#endif /* HOST_SHTP_REPLAY_H */
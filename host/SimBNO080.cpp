@@ -0,0 +1,684 @@
+#include "SimBNO080.h"
+
+#include <math.h>
+
+/// Samples the simulated FIFO holds before it drops the oldest
+#define SIM_BNO080_FIFO_SAMPLES 1024
+
+/// Length of the SHTP header in front of every packet
+#define SIM_BNO080_HEADER_SIZE 4
+
+#define SIM_BNO080_GRAVITY 9.80665f
+
+namespace
+{
+	/// Length of each sensor report, header included, by report ID (SH-2 section 6.5); 0 for unknown IDs
+	uint8_t reportLength(uint8_t reportID)
+	{
+		switch (reportID) {
+			case SENSOR_REPORTID_ACCELEROMETER:
+			case SENSOR_REPORTID_GYROSCOPE_CALIBRATED:
+			case SENSOR_REPORTID_MAGNETIC_FIELD_CALIBRATED:
+			case SENSOR_REPORTID_LINEAR_ACCELERATION:
+			case SENSOR_REPORTID_GRAVITY:
+				return 10;
+			case SENSOR_REPORTID_ROTATION_VECTOR:
+			case SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR:
+				return 14;
+			case SENSOR_REPORTID_GAME_ROTATION_VECTOR:
+				return 12;
+			case SENSOR_REPORTID_MAGNETIC_FIELD_UNCALIBRATED:
+				return 16;
+			case SENSOR_REPORTID_TAP_DETECTOR:
+				return 5;
+			case SENSOR_REPORTID_STEP_COUNTER:
+				return 12;
+			case SENSOR_REPORTID_SIGNIFICANT_MOTION:
+			case SENSOR_REPORTID_STABILITY_CLASSIFIER:
+			case SENSOR_REPORTID_SHAKE_DETECTOR:
+				return 6;
+			case SENSOR_REPORTID_STEP_DETECTOR:
+				return 8;
+			default:
+				return 0;
+		}
+	}
+
+	/// FRS record holding a report's metadata (SH-2 section 5.1), 0 if none
+	uint16_t metadataRecord(uint8_t reportID)
+	{
+		switch (reportID) {
+			case SENSOR_REPORTID_ACCELEROMETER: return 0xE301;
+			case SENSOR_REPORTID_LINEAR_ACCELERATION: return 0xE303;
+			case SENSOR_REPORTID_GRAVITY: return 0xE304;
+			case SENSOR_REPORTID_GYROSCOPE_CALIBRATED: return 0xE306;
+			case SENSOR_REPORTID_MAGNETIC_FIELD_CALIBRATED: return 0xE309;
+			case SENSOR_REPORTID_MAGNETIC_FIELD_UNCALIBRATED: return 0xE30A;
+			case SENSOR_REPORTID_ROTATION_VECTOR: return 0xE30B;
+			case SENSOR_REPORTID_GAME_ROTATION_VECTOR: return 0xE30C;
+			case SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR: return 0xE30D;
+			case SENSOR_REPORTID_TAP_DETECTOR: return 0xE313;
+			case SENSOR_REPORTID_STEP_DETECTOR: return 0xE314;
+			case SENSOR_REPORTID_STEP_COUNTER: return 0xE315;
+			case SENSOR_REPORTID_SIGNIFICANT_MOTION: return 0xE316;
+			case SENSOR_REPORTID_STABILITY_CLASSIFIER: return 0xE317;
+			case SENSOR_REPORTID_SHAKE_DETECTOR: return 0xE318;
+			default: return 0;
+		}
+	}
+
+	/// Q point of a report's data, as its metadata gives it
+	uint8_t reportQPoint(uint8_t reportID)
+	{
+		switch (reportID) {
+			case SENSOR_REPORTID_ACCELEROMETER:
+			case SENSOR_REPORTID_LINEAR_ACCELERATION:
+			case SENSOR_REPORTID_GRAVITY:
+				return ACCELEROMETER_Q_POINT;
+			case SENSOR_REPORTID_GYROSCOPE_CALIBRATED:
+				return GYRO_Q_POINT;
+			case SENSOR_REPORTID_MAGNETIC_FIELD_CALIBRATED:
+			case SENSOR_REPORTID_MAGNETIC_FIELD_UNCALIBRATED:
+				return MAGNETOMETER_Q_POINT;
+			case SENSOR_REPORTID_ROTATION_VECTOR:
+			case SENSOR_REPORTID_GAME_ROTATION_VECTOR:
+			case SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR:
+				return ROTATION_Q_POINT;
+			default:
+				return 0;
+		}
+	}
+
+	/// Fastest rate of each report, from the BNO080 datasheet
+	uint32_t defaultMinPeriod(uint8_t reportID)
+	{
+		switch (reportID) {
+			case SENSOR_REPORTID_MAGNETIC_FIELD_CALIBRATED:
+			case SENSOR_REPORTID_MAGNETIC_FIELD_UNCALIBRATED:
+			case SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR:
+				return 10000;
+			case SENSOR_REPORTID_GYROSCOPE_CALIBRATED:
+				return 2500;
+			case SENSOR_REPORTID_ACCELEROMETER:
+			case SENSOR_REPORTID_LINEAR_ACCELERATION:
+			case SENSOR_REPORTID_GRAVITY:
+			case SENSOR_REPORTID_ROTATION_VECTOR:
+			case SENSOR_REPORTID_GAME_ROTATION_VECTOR:
+				return 2500;
+			default:
+				return 5000;
+		}
+	}
+
+	void put16(uint8_t* out, uint16_t value)
+	{
+		out[0] = static_cast<uint8_t>(value);
+		out[1] = static_cast<uint8_t>(value >> 8);
+	}
+
+	void put32(uint8_t* out, uint32_t value)
+	{
+		put16(out, static_cast<uint16_t>(value));
+		put16(out + 2, static_cast<uint16_t>(value >> 16));
+	}
+
+	uint32_t get32(const uint8_t* in)
+	{
+		return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 |
+			   static_cast<uint32_t>(in[2]) << 16 | static_cast<uint32_t>(in[3]) << 24;
+	}
+
+	// a value in a Q point, saturated to 16 bits
+	uint16_t toQ(float value, uint8_t qPoint)
+	{
+		float scaled = roundf(ldexpf(value, qPoint));
+		if (scaled > 32767.0f) {
+			scaled = 32767.0f;
+		} else if (scaled < -32768.0f) {
+			scaled = -32768.0f;
+		}
+		return static_cast<uint16_t>(static_cast<int16_t>(scaled));
+	}
+}
+
+SimBNO080::SimBNO080(PinName intPin, PinName rstPin, uint8_t address) :
+	_intPin(intPin),
+	_rstPin(rstPin),
+	_address(address),
+	_bootTime(50000),
+	_packetGap(20),
+	_yawRate(0.2f),
+	_bootAt(INT64_MAX),
+	_readyAt(0),
+	_inReset(false),
+	_pendingDue(INT64_MAX),
+	_currentSamples(0),
+	_writeRecord(0),
+	_writeLength(0),
+	_commandSequence(0),
+	_samplesTaken(0),
+	_samplesSent(0),
+	_samplesDropped(0),
+	_packetsSent(0),
+	_resets(0)
+{
+	for (uint8_t id = 0; id <= MAX_SENSOR_REPORTID; id++) {
+		_reports[id].minPeriod = defaultMinPeriod(id);
+		_reports[id].status = 3;
+	}
+
+	HostClock::useVirtualTime();
+	HostClock::attach(this);
+	I2C::attachDevice(_address, this);
+	HostPins::watch(_rstPin, callback(this, &SimBNO080::onResetPin));
+
+	// power up
+	reset();
+	_bootAt = HostClock::now() + static_cast<int64_t>(_bootTime) * 1000;
+}
+
+SimBNO080::~SimBNO080()
+{
+	HostClock::detach(this);
+	I2C::attachDevice(_address, NULL);
+	HostPins::watch(_rstPin, Callback<void(int)>());
+}
+
+void SimBNO080::setReportStatus(uint8_t reportID, uint8_t status)
+{
+	if (reportID <= MAX_SENSOR_REPORTID) {
+		_reports[reportID].status = status & 0x3;
+	}
+}
+
+void SimBNO080::setMinPeriod(uint8_t reportID, uint32_t us)
+{
+	if (reportID <= MAX_SENSOR_REPORTID) {
+		_reports[reportID].minPeriod = us;
+	}
+}
+
+bool SimBNO080::writtenRecord(uint16_t recordID, std::vector<uint32_t>& words) const
+{
+	std::map<uint16_t, std::vector<uint32_t> >::const_iterator record = _records.find(recordID);
+	if (record == _records.end()) {
+		return false;
+	}
+	words = record->second;
+	return true;
+}
+
+uint32_t SimBNO080::reportInterval(uint8_t reportID) const
+{
+	return reportID <= MAX_SENSOR_REPORTID ? _reports[reportID].interval : 0;
+}
+
+uint32_t SimBNO080::batchInterval(uint8_t reportID) const
+{
+	return reportID <= MAX_SENSOR_REPORTID ? _reports[reportID].batch : 0;
+}
+
+int SimBNO080::read(char* data, int length)
+{
+	uint8_t* out = reinterpret_cast<uint8_t*>(data);
+	memset(out, 0, length);
+	if (_current.empty()) {
+		// nothing to send: a header with length 0
+		return 0;
+	}
+
+	size_t copied = static_cast<size_t>(length) < _current.size() ? length : _current.size();
+	memcpy(out, _current.data(), copied);
+
+	// a read that takes the whole packet ends it; a shorter one (the header on its own) doesn't
+	if (static_cast<size_t>(length) >= _current.size()) {
+		_packetsSent++;
+		_samplesSent += _currentSamples;
+		_current.clear();
+		_currentSamples = 0;
+		_readyAt = HostClock::now() + static_cast<int64_t>(_packetGap) * 1000;
+		HostPins::write(_intPin, 1);
+	}
+	return 0;
+}
+
+int SimBNO080::write(const char* data, int length)
+{
+	const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+	if (length < SIM_BNO080_HEADER_SIZE || _inReset) {
+		return 0;
+	}
+
+	uint8_t channel = in[2];
+	const uint8_t* payload = in + SIM_BNO080_HEADER_SIZE;
+	size_t payloadLength = length - SIM_BNO080_HEADER_SIZE;
+
+	if (channel == CHANNEL_CONTROL && payloadLength > 0) {
+		handleControl(payload, payloadLength);
+	} else if (channel == CHANNEL_EXECUTABLE && payloadLength > 0 && payload[0] == EXECUTABLE_REPORTID_RESET) {
+		reset();
+		_bootAt = HostClock::now() + static_cast<int64_t>(_bootTime) * 1000;
+	}
+
+	signalNext();
+	return 0;
+}
+
+int64_t SimBNO080::nextEvent()
+{
+	int64_t next = _bootAt;
+	if (_inReset) {
+		return next;
+	}
+
+	for (uint8_t id = 0; id <= MAX_SENSOR_REPORTID; id++) {
+		if (_reports[id].interval > 0 && _reports[id].nextSample < next) {
+			next = _reports[id].nextSample;
+		}
+	}
+
+	if (_current.empty()) {
+		int64_t ready = INT64_MAX;
+		if (!_queue.empty()) {
+			ready = _readyAt;
+		} else if (!_pending.empty()) {
+			ready = _pendingDue > _readyAt ? _pendingDue : _readyAt;
+		}
+		if (ready < next) {
+			next = ready;
+		}
+	}
+	return next;
+}
+
+void SimBNO080::runEvent()
+{
+	int64_t now = HostClock::now();
+
+	if (_bootAt <= now) {
+		_bootAt = INT64_MAX;
+		boot();
+	}
+
+	for (uint8_t id = 0; id <= MAX_SENSOR_REPORTID; id++) {
+		ReportState& report = _reports[id];
+		while (report.interval > 0 && report.nextSample <= now) {
+			if (_pending.size() >= SIM_BNO080_FIFO_SAMPLES) {
+				_pending.pop_front();
+				_samplesDropped++;
+			}
+
+			Sample sample = {id, report.nextSample};
+			_pending.push_back(sample);
+			int64_t due = sample.time + static_cast<int64_t>(report.batch) * 1000;
+			if (due < _pendingDue) {
+				_pendingDue = due;
+			}
+
+			report.nextSample += static_cast<int64_t>(report.interval) * 1000;
+			_samplesTaken++;
+		}
+	}
+
+	signalNext();
+}
+
+void SimBNO080::reset()
+{
+	_queue.clear();
+	_pending.clear();
+	_pendingDue = INT64_MAX;
+	_current.clear();
+	_currentSamples = 0;
+	_bootAt = INT64_MAX;
+	_writeRecord = 0;
+	_writeLength = 0;
+	memset(_channelSequence, 0, sizeof(_channelSequence));
+
+	for (uint8_t id = 0; id <= MAX_SENSOR_REPORTID; id++) {
+		_reports[id].interval = 0;
+		_reports[id].batch = 0;
+		_reports[id].sequence = 0;
+	}
+
+	HostPins::write(_intPin, 1);
+}
+
+void SimBNO080::onResetPin(int value)
+{
+	if (value == 0) {
+		reset();
+		_inReset = true;
+	} else if (_inReset) {
+		_inReset = false;
+		_bootAt = HostClock::now() + static_cast<int64_t>(_bootTime) * 1000;
+	}
+}
+
+void SimBNO080::boot()
+{
+	_resets++;
+
+	// a short advertisement (SHTP section 5): GUID, max cargo write and read, max transfer write and read, app name
+	static const uint8_t advertisement[] = {
+		COMMAND_REPORTID_ADVERTISEMENT,
+		1, 4, 0, 0, 0, 0,
+		2, 2, 0x80, 0x01,
+		3, 2, 0x84, 0x00,
+		4, 2, 0x80, 0x01,
+		5, 2, 0x84, 0x00,
+		8, 5, 'S', 'H', 'T', 'P', 0
+	};
+	queuePacket(CHANNEL_COMMAND, advertisement, sizeof(advertisement));
+
+	// then the unsolicited initialize response, and the reset notification that the driver waits for
+	sendCommandResponse(COMMAND_UNSOLICITED_INITIALIZE, 0);
+
+	static const uint8_t resetComplete[] = {EXECUTABLE_REPORTID_RESET};
+	queuePacket(CHANNEL_EXECUTABLE, resetComplete, sizeof(resetComplete));
+}
+
+void SimBNO080::queuePacket(uint8_t channel, const uint8_t* payload, size_t length)
+{
+	std::vector<uint8_t> packet(SIM_BNO080_HEADER_SIZE + length);
+	put16(packet.data(), static_cast<uint16_t>(packet.size()));
+	packet[2] = channel;
+	packet[3] = _channelSequence[channel]++;
+	memcpy(packet.data() + SIM_BNO080_HEADER_SIZE, payload, length);
+	_queue.push_back(packet);
+}
+
+void SimBNO080::handleControl(const uint8_t* payload, size_t length)
+{
+	switch (payload[0]) {
+		case SHTP_REPORT_COMMAND_REQUEST:
+			// the tare command (and the orientation commands sent with it) is never acknowledged
+			if (length >= 3 && payload[2] != COMMAND_TARE) {
+				sendCommandResponse(payload[2], payload[1]);
+			}
+			break;
+
+		case SHTP_REPORT_PRODUCT_ID_REQUEST: {
+			uint8_t response[16] = {SHTP_REPORT_PRODUCT_ID_RESPONSE, 1, 3, 2};
+			put32(response + 4, 10003608);	// part number
+			put32(response + 8, 829);		// build
+			put16(response + 12, 0x1F);		// patch
+			queuePacket(CHANNEL_CONTROL, response, sizeof(response));
+			break;
+		}
+
+		case SHTP_REPORT_SET_FEATURE_COMMAND: {
+			uint8_t id = payload[1];
+			if (length < 13 || id > MAX_SENSOR_REPORTID || reportLength(id) == 0) {
+				break;
+			}
+
+			ReportState& report = _reports[id];
+			uint32_t interval = get32(payload + 5);
+			if (interval > 0 && interval < report.minPeriod) {
+				interval = report.minPeriod;
+			}
+			if (interval != report.interval) {
+				report.nextSample = HostClock::now() + static_cast<int64_t>(interval) * 1000;
+			}
+			report.interval = interval;
+			report.batch = get32(payload + 9);
+
+			// Get Feature Response: the same layout as the request, with the interval actually used
+			uint8_t response[17];
+			memcpy(response, payload, length < sizeof(response) ? length : sizeof(response));
+			response[0] = SHTP_REPORT_GET_FEATURE_RESPONSE;
+			put32(response + 5, interval);
+			queuePacket(CHANNEL_CONTROL, response, sizeof(response));
+			break;
+		}
+
+		case SHTP_REPORT_FRS_READ_REQUEST:
+			if (length >= 8) {
+				sendFRSRecord(static_cast<uint16_t>(payload[4] | payload[5] << 8),
+							  static_cast<uint16_t>(payload[2] | payload[3] << 8),
+							  static_cast<uint16_t>(payload[6] | payload[7] << 8));
+			}
+			break;
+
+		case SHTP_REPORT_FRS_WRITE_REQUEST:
+			if (length >= 6) {
+				_writeLength = static_cast<uint16_t>(payload[2] | payload[3] << 8);
+				_writeRecord = static_cast<uint16_t>(payload[4] | payload[5] << 8);
+				_writeWords.assign(_writeLength, 0);
+				if (_writeLength == 0) {
+					// a zero length write erases the record
+					_records.erase(_writeRecord);
+					_writeRecord = 0;
+					sendFRSWriteResponse(3, 0);
+				} else {
+					sendFRSWriteResponse(4, 0); // ready for the data
+				}
+			}
+			break;
+
+		case SHTP_REPORT_FRS_WRITE_DATA: {
+			uint16_t offset = static_cast<uint16_t>(payload[2] | payload[3] << 8);
+			if (length < 8 || _writeLength == 0) {
+				sendFRSWriteResponse(6, offset); // data while not in write mode
+				break;
+			}
+			for (uint16_t word = 0; word < 2 && offset + word < _writeLength; word++) {
+				_writeWords[offset + word] = get32(payload + 4 + word * 4);
+			}
+			sendFRSWriteResponse(0, offset);
+			if (offset + 2 >= _writeLength) {
+				_records[_writeRecord] = _writeWords;
+				_writeRecord = 0;
+				_writeLength = 0;
+				sendFRSWriteResponse(8, offset);	// record valid
+				sendFRSWriteResponse(3, offset);	// write completed
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+void SimBNO080::sendFRSWriteResponse(uint8_t status, uint16_t offset)
+{
+	uint8_t response[4] = {SHTP_REPORT_FRS_WRITE_RESPONSE, status};
+	put16(response + 2, offset);
+	queuePacket(CHANNEL_CONTROL, response, sizeof(response));
+}
+
+void SimBNO080::sendCommandResponse(uint8_t command, uint8_t commandSequence)
+{
+	// status R0 = 0: success
+	uint8_t response[16] = {SHTP_REPORT_COMMAND_RESPONSE, _commandSequence++, command, commandSequence, 0};
+	queuePacket(CHANNEL_CONTROL, response, sizeof(response));
+}
+
+void SimBNO080::sendFRSRecord(uint16_t recordID, uint16_t offset, uint16_t blockSize)
+{
+	uint32_t words[16] = {0};
+	size_t numWords = 0;
+
+	std::map<uint16_t, std::vector<uint32_t> >::const_iterator written = _records.find(recordID);
+	if (written != _records.end()) {
+		numWords = written->second.size() < 16 ? written->second.size() : 16;
+		memcpy(words, written->second.data(), numWords * sizeof(uint32_t));
+	} else if (recordID == FRS_RECORDID_SERIAL_NUMBER) {
+		words[0] = 0x00C0FFEE;
+		numWords = 1;
+	}
+
+	for (uint8_t id = 0; id <= MAX_SENSOR_REPORTID && numWords == 0; id++) {
+		if (metadataRecord(id) != recordID || recordID == 0) {
+			continue;
+		}
+		uint8_t qPoint = reportQPoint(id);
+		words[1] = 32767;									// range
+		words[2] = 1;										// resolution
+		words[3] = 512 | 4 << 16;							// 0.5 mA in Q10, record revision 4
+		words[4] = _reports[id].minPeriod;
+		words[6] = 100;										// batch buffer
+		words[7] = qPoint | static_cast<uint32_t>(qPoint) << 16;
+		words[8] = static_cast<uint32_t>(qPoint) << 16;
+		words[9] = 1000000;									// max period
+		numWords = 10;
+	}
+
+	uint8_t response[16] = {SHTP_REPORT_FRS_READ_RESPONSE};
+	put16(response + 12, recordID);
+
+	if (numWords == 0 || offset >= numWords) {
+		response[1] = 1; // unrecognized FRS type
+		queuePacket(CHANNEL_CONTROL, response, sizeof(response));
+		return;
+	}
+
+	size_t count = numWords - offset;
+	if (blockSize != 0 && blockSize < count) {
+		count = blockSize;
+	}
+
+	for (size_t i = 0; i < count; i += 2) {
+		uint8_t dataLength = count - i >= 2 ? 2 : 1;
+		uint8_t status = i + dataLength >= count ? 3 : 0; // 3: record completed
+		response[1] = static_cast<uint8_t>(dataLength << 4 | status);
+		put16(response + 2, static_cast<uint16_t>(offset + i));
+		put32(response + 4, words[offset + i]);
+		put32(response + 8, dataLength == 2 ? words[offset + i + 1] : 0);
+		queuePacket(CHANNEL_CONTROL, response, sizeof(response));
+	}
+}
+
+void SimBNO080::buildSensorPacket()
+{
+	const int64_t tick = 100000; // the IMU's 100 us timestamp unit, in ns
+	int64_t now = HostClock::now();
+
+	// the base timestamp goes back from now to the oldest sample
+	uint32_t baseDelta = static_cast<uint32_t>((now - _pending.front().time + tick - 1) / tick);
+	int64_t reference = now - static_cast<int64_t>(baseDelta) * tick;
+
+	std::vector<uint8_t> payload(5);
+	payload[0] = SHTP_REPORT_BASE_TIMESTAMP;
+	put32(payload.data() + 1, baseDelta);
+
+	uint32_t samples = 0;
+	while (!_pending.empty()) {
+		const Sample& sample = _pending.front();
+		int64_t delay = (sample.time - reference) / tick;
+		bool rebase = delay > 0x3FFF;
+		size_t length = reportLength(sample.reportID) + (rebase ? 5 : 0);
+		if (payload.size() + length > SIM_BNO080_MAX_PAYLOAD) {
+			break;
+		}
+
+		if (rebase) {
+			// move the time base up to this sample (SH-2 section 7.2.2)
+			size_t at = payload.size();
+			payload.resize(at + 5);
+			payload[at] = SENSOR_REPORTID_TIMESTAMP_REBASE;
+			put32(payload.data() + at + 1, static_cast<uint32_t>(delay));
+			reference += delay * tick;
+			delay = 0;
+		}
+
+		ReportState& report = _reports[sample.reportID];
+		size_t at = payload.size();
+		payload.resize(at + reportLength(sample.reportID));
+		payload[at] = sample.reportID;
+		payload[at + 1] = report.sequence++;
+		payload[at + 2] = static_cast<uint8_t>(report.status | (delay >> 8) << 2);
+		payload[at + 3] = static_cast<uint8_t>(delay);
+		sampleData(sample.reportID, sample.time, payload.data() + at + 4);
+
+		_pending.pop_front();
+		samples++;
+	}
+
+	queuePacket(CHANNEL_REPORTS, payload.data(), payload.size());
+	_current = _queue.back();
+	_queue.pop_back();
+	_currentSamples = samples;
+
+	_pendingDue = INT64_MAX;
+	for (size_t i = 0; i < _pending.size(); i++) {
+		int64_t due = _pending[i].time + static_cast<int64_t>(_reports[_pending[i].reportID].batch) * 1000;
+		if (due < _pendingDue) {
+			_pendingDue = due;
+		}
+	}
+}
+
+size_t SimBNO080::sampleData(uint8_t reportID, int64_t time, uint8_t* out) const
+{
+	size_t length = reportLength(reportID) - 4;
+	memset(out, 0, length);
+
+	float yaw = _yawRate * static_cast<float>(time * 1e-9);
+	float sinHalf = sinf(yaw / 2);
+	float cosHalf = cosf(yaw / 2);
+
+	switch (reportID) {
+		case SENSOR_REPORTID_ACCELEROMETER:
+		case SENSOR_REPORTID_GRAVITY:
+			put16(out + 4, toQ(SIM_BNO080_GRAVITY, ACCELEROMETER_Q_POINT));
+			break;
+
+		case SENSOR_REPORTID_GYROSCOPE_CALIBRATED:
+			put16(out + 4, toQ(_yawRate, GYRO_Q_POINT));
+			break;
+
+		case SENSOR_REPORTID_MAGNETIC_FIELD_CALIBRATED:
+		case SENSOR_REPORTID_MAGNETIC_FIELD_UNCALIBRATED:
+			// a 22 uT horizontal, -42 uT vertical field, turning against the yaw
+			put16(out, toQ(22.0f * cosf(yaw), MAGNETOMETER_Q_POINT));
+			put16(out + 2, toQ(-22.0f * sinf(yaw), MAGNETOMETER_Q_POINT));
+			put16(out + 4, toQ(-42.0f, MAGNETOMETER_Q_POINT));
+			if (reportID == SENSOR_REPORTID_MAGNETIC_FIELD_UNCALIBRATED) {
+				put16(out + 6, toQ(5.0f, MAGNETOMETER_Q_POINT));
+				put16(out + 8, toQ(-3.0f, MAGNETOMETER_Q_POINT));
+				put16(out + 10, toQ(2.0f, MAGNETOMETER_Q_POINT));
+			}
+			break;
+
+		case SENSOR_REPORTID_ROTATION_VECTOR:
+		case SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR:
+			// the quaternion is the same as the game rotation's
+			put16(out + 8, toQ(0.05f, ROTATION_ACCURACY_Q_POINT));
+			// fall through
+		case SENSOR_REPORTID_GAME_ROTATION_VECTOR:
+			put16(out + 4, toQ(sinHalf, ROTATION_Q_POINT));
+			put16(out + 6, toQ(cosHalf, ROTATION_Q_POINT));
+			break;
+
+		case SENSOR_REPORTID_STABILITY_CLASSIFIER:
+			out[0] = 4; // in motion
+			break;
+
+		default:
+			break;
+	}
+	return length;
+}
+
+void SimBNO080::signalNext()
+{
+	int64_t now = HostClock::now();
+	if (!_current.empty() || _inReset || now < _readyAt) {
+		return;
+	}
+
+	if (!_queue.empty()) {
+		_current = _queue.front();
+		_queue.pop_front();
+		_currentSamples = 0;
+	} else if (!_pending.empty() && _pendingDue <= now) {
+		buildSensorPacket();
+	} else {
+		return;
+	}
+
+	HostPins::write(_intPin, 0);
+}
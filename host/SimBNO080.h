@@ -0,0 +1,188 @@
+/*
+ * Simulated BNO080 for the host build: an I2C device that speaks enough SHTP
+ * for the unmodified BNO080 driver to start it up and stream reports from it.
+ *
+ * It answers the reset (pin or executable channel) with the advertisement, the
+ * executable reset notification and the unsolicited initialize response, and
+ * handles initialize and the other commands, product ID requests, Set Feature,
+ * FRS reads of the report metadata and serial number, and FRS writes, which it
+ * keeps across resets like the IMU's flash.  Enabled reports are
+ * sampled at their interval and sent as the IMU would: a base timestamp, then
+ * the reports with their delays, several in one packet when they are batched
+ * or pile up while the host is busy, with timestamp rebases when the delays
+ * outgrow 14 bits.  The interrupt line falls when a packet is ready and rises
+ * when the host has read all of it.
+ *
+ * It runs on the HostClock's virtual time, which the constructor switches to,
+ * so a run is deterministic.  The samples are a steady yaw rotation: gravity
+ * along z, the rotation vectors turning about z at yawRate, and the Earth's
+ * field turning the other way in the magnetometer.
+ */
+
+#ifndef HOST_SIM_BNO080_H
+#define HOST_SIM_BNO080_H
+
+#include <mbed.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "BNO080Constants.h"
+
+/// Most bytes of one packet after its header: what the driver can store
+#define SIM_BNO080_MAX_PAYLOAD 128
+
+class SimBNO080 : public HostI2CDevice, public HostClockClient
+{
+public:
+
+	/**
+	 * Attaches to the I2C bus at address and to the pins, and switches the HostClock to virtual time.
+	 * Boots straight away, as after power up.
+	 */
+	SimBNO080(PinName intPin, PinName rstPin, uint8_t address = 0x4B);
+	~SimBNO080();
+
+	/// Time from the end of a reset to the advertisement, in us.  50 ms unless set.
+	void setBootTime(uint32_t us) { _bootTime = us; }
+
+	/// Time between the host reading a packet and the next one being ready, in us.  20 us unless set.
+	void setPacketGap(uint32_t us) { _packetGap = us; }
+
+	/// Accuracy status (0 to 3) sent with a report's samples.  3 unless set.
+	void setReportStatus(uint8_t reportID, uint8_t status);
+
+	/// Turn rate of the simulated motion about z, in rad/s.  0.2 unless set.
+	void setYawRate(float radPerSecond) { _yawRate = radPerSecond; }
+
+	/// Shortest interval a report accepts, in us, as its metadata says
+	void setMinPeriod(uint8_t reportID, uint32_t us);
+
+	/// Interval the host set for a report, in us (0 = off)
+	uint32_t reportInterval(uint8_t reportID) const;
+
+	/// Batch interval the host set for a report, in us
+	uint32_t batchInterval(uint8_t reportID) const;
+
+	/// Samples taken of all reports
+	uint32_t samplesTaken() const { return _samplesTaken; }
+
+	/// Samples sent to the host in packets that it read
+	uint32_t samplesSent() const { return _samplesSent; }
+
+	/// Samples the full FIFO dropped, oldest first
+	uint32_t samplesDropped() const { return _samplesDropped; }
+
+	/// Samples waiting to be sent
+	size_t samplesPending() const { return _pending.size(); }
+
+	/// Packets the host read completely, on every channel
+	uint32_t packetsSent() const { return _packetsSent; }
+
+	/**
+	 * Words of an FRS record the host wrote.
+	 * @return false if the host hasn't written it.
+	 */
+	bool writtenRecord(uint16_t recordID, std::vector<uint32_t>& words) const;
+
+	/// Resets done, power up included
+	uint32_t resets() const { return _resets; }
+
+	// HostI2CDevice
+	virtual int read(char* data, int length);
+	virtual int write(const char* data, int length);
+
+	// HostClockClient
+	virtual int64_t nextEvent();
+	virtual void runEvent();
+
+private:
+
+	struct ReportState
+	{
+		uint32_t interval;		///< us, 0 = off
+		uint32_t batch;			///< us
+		uint32_t minPeriod;		///< us
+		uint8_t status;
+		uint8_t sequence;
+		int64_t nextSample;		///< ns
+	};
+
+	struct Sample
+	{
+		uint8_t reportID;
+		int64_t time;			///< ns
+	};
+
+	PinName _intPin;
+	PinName _rstPin;
+	uint8_t _address;
+
+	uint32_t _bootTime;
+	uint32_t _packetGap;
+	float _yawRate;
+
+	/// Time of the boot in progress, INT64_MAX if none
+	int64_t _bootAt;
+
+	/// Earliest time the next packet may be signalled
+	int64_t _readyAt;
+
+	bool _inReset;
+
+	ReportState _reports[MAX_SENSOR_REPORTID + 1];
+
+	/// Control and other non-sensor packets waiting, with their headers
+	std::deque<std::vector<uint8_t> > _queue;
+
+	/// Samples taken but not yet put in a packet
+	std::deque<Sample> _pending;
+
+	/// Time at which the first pending sample's batch interval runs out, INT64_MAX if none
+	int64_t _pendingDue;
+
+	/// Packet the interrupt line is signalling, with its header; empty if none
+	std::vector<uint8_t> _current;
+	uint32_t _currentSamples;
+
+	/// FRS records the host wrote, which survive resets
+	std::map<uint16_t, std::vector<uint32_t> > _records;
+
+	/// FRS write in progress: its record and length in words, 0 if none
+	uint16_t _writeRecord;
+	uint16_t _writeLength;
+	std::vector<uint32_t> _writeWords;
+
+	uint8_t _channelSequence[6];
+	uint8_t _commandSequence;
+
+	uint32_t _samplesTaken;
+	uint32_t _samplesSent;
+	uint32_t _samplesDropped;
+	uint32_t _packetsSent;
+	uint32_t _resets;
+
+	void reset();
+	void boot();
+	void onResetPin(int value);
+
+	/// Queues a packet on a channel
+	void queuePacket(uint8_t channel, const uint8_t* payload, size_t length);
+
+	void handleControl(const uint8_t* payload, size_t length);
+	void sendCommandResponse(uint8_t command, uint8_t commandSequence);
+	void sendFRSRecord(uint16_t recordID, uint16_t offset, uint16_t blockSize);
+	void sendFRSWriteResponse(uint8_t status, uint16_t offset);
+
+	/// Builds the next sensor packet from the pending samples, as many as fit
+	void buildSensorPacket();
+
+	/// Data of one sample after its 4 byte header; returns its length
+	size_t sampleData(uint8_t reportID, int64_t time, uint8_t* out) const;
+
+	/// Signals the next packet if one is ready and none is being read
+	void signalNext();
+};
+
+#endif /* HOST_SIM_BNO080_H */
@@ -0,0 +1,120 @@
+/*
+ * RAM block device for the host build, with the timing of a real SD card or
+ * flash chip so the cost of each write can be simulated, and a power cut that
+ * tears a program part way through.
+ */
+
+#ifndef HOST_SIM_BLOCK_DEVICE_H
+#define HOST_SIM_BLOCK_DEVICE_H
+
+#include <string.h>
+#include <vector>
+
+#include "BlockDevice.h"
+
+/**
+ * Geometry and timing of a simulated device.  Times are in microseconds.
+ */
+struct SimBlockTiming {
+	const char* name;
+	bd_size_t readSize;
+	bd_size_t programSize;
+	bd_size_t eraseSize;
+	uint32_t eraseTime;         ///< per erase unit
+	uint32_t programTime;       ///< per program unit
+	uint32_t stallInterval;     ///< a long busy period every this many programs (SD card housekeeping), 0 for none
+	uint32_t stallTime;
+};
+
+class SimBlockDevice : public BlockDevice
+{
+public:
+	SimBlockDevice(const SimBlockTiming& timing, bd_size_t size) :
+		_timing(timing),
+		_data(size, 0xFF),
+		_programs(0),
+		_busyTime(0),
+		_cutAfter(-1)
+	{
+	}
+
+	virtual int init() { return 0; }
+	virtual int deinit() { return 0; }
+
+	virtual int read(void* buffer, bd_addr_t addr, bd_size_t size)
+	{
+		if (addr % _timing.readSize != 0 || size % _timing.readSize != 0 || addr + size > _data.size()) {
+			return BD_ERROR_DEVICE_ERROR;
+		}
+		memcpy(buffer, &_data[addr], size);
+		return 0;
+	}
+
+	virtual int program(const void* buffer, bd_addr_t addr, bd_size_t size)
+	{
+		if (addr % _timing.programSize != 0 || size % _timing.programSize != 0 || addr + size > _data.size()) {
+			return BD_ERROR_DEVICE_ERROR;
+		}
+
+		// bytes are programmed in order; a power cut stops part way
+		bd_size_t written = size;
+		if (_cutAfter >= 0 && static_cast<bd_size_t>(_cutAfter) < size) {
+			written = static_cast<bd_size_t>(_cutAfter);
+		}
+		memcpy(&_data[addr], buffer, written);
+
+		_busyTime += (size / _timing.programSize) * _timing.programTime;
+		if (_timing.stallInterval > 0 && ++_programs % _timing.stallInterval == 0) {
+			_busyTime += _timing.stallTime;
+		}
+
+		if (written < size) {
+			_cutAfter = -1;
+			return BD_ERROR_DEVICE_ERROR;
+		}
+		return 0;
+	}
+
+	virtual int erase(bd_addr_t addr, bd_size_t size)
+	{
+		if (addr % _timing.eraseSize != 0 || size % _timing.eraseSize != 0 || addr + size > _data.size()) {
+			return BD_ERROR_DEVICE_ERROR;
+		}
+		memset(&_data[addr], 0xFF, size);
+		_busyTime += (size / _timing.eraseSize) * _timing.eraseTime;
+		return 0;
+	}
+
+	virtual bd_size_t get_read_size() const { return _timing.readSize; }
+	virtual bd_size_t get_program_size() const { return _timing.programSize; }
+	virtual bd_size_t get_erase_size() const { return _timing.eraseSize; }
+	virtual bd_size_t size() const { return _data.size(); }
+
+	/// Time an erase and program of size bytes will take, including any housekeeping stall
+	uint64_t writeTime(bd_size_t size) const
+	{
+		uint64_t time = (size / _timing.eraseSize) * _timing.eraseTime + (size / _timing.programSize) * _timing.programTime;
+		if (_timing.stallInterval > 0 && (_programs + 1) % _timing.stallInterval == 0) {
+			time += _timing.stallTime;
+		}
+		return time;
+	}
+
+	/// Simulated time the device has been busy, in microseconds
+	uint64_t busyTime() const { return _busyTime; }
+
+	/// Contents of the device, e.g. to save as an image
+	const uint8_t* data() const { return &_data[0]; }
+
+	/// Makes the next program stop after this many bytes, as if the power went
+	void cutPowerAfter(int bytes) { _cutAfter = bytes; }
+
+private:
+	SimBlockTiming _timing;
+	std::vector<uint8_t> _data;
+	uint32_t _programs;
+	uint64_t _busyTime;
+	int _cutAfter;
+};
+
+#endif /* HOST_SIM_BLOCK_DEVICE_H */
@@ -0,0 +1,31 @@
+//
+// Entry point of the host benchmark build: runs every benchmark suite and
+// prints the results to stdout.
+//
+
+#include <mbed.h>
+
+#include "KernelBenchmarks.h"
+#include "EulerBenchmarks.h"
+#include "ExpressionBenchmarks.h"
+#include "PrecisionBenchmarks.h"
+#include "DecompositionBenchmarks.h"
+#include "InterpolationBenchmarks.h"
+#include "TelemetryBenchmarks.h"
+#include "SerialBenchmarks.h"
+
+int main()
+{
+    Serial out;
+
+    runKernelBenchmarks(out);
+    runEulerBenchmarks(out);
+    runExpressionBenchmarks(out);
+    runPrecisionBenchmarks(out);
+    runDecompositionBenchmarks(out);
+    runInterpolationBenchmarks(out);
+    runTelemetryBenchmarks(out);
+    runSerialBenchmarks(out);
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+//
+// Host tool: runs BlockLog against simulated block devices to see whether the
+// logging keeps up.  For each device and sample rate it simulates a recording in
+// virtual time: the IMU adds samples at the profile's rate, and a writer thread
+// writes each full block, taking as long as the device would.  Samples are lost
+// when both buffers are full before the device has finished.
+//
+// Then it checks crash safety: a power cut in the middle of a block, a remount,
+// and that every complete block is still read back and the torn one is not.
+//
+//   blocklog_sim [seconds]      simulated recording length, 600 by default
+//
+
+#include <mbed.h>
+
+#include "BlockLog.h"
+#include "SimBlockDevice.h"
+
+// size of the simulated devices
+#define SIM_DEVICE_SIZE (32 * 1024 * 1024)
+
+// typical figures from data sheets, in us
+static const SimBlockTiming devices[] = {
+	// SD card over SPI at 25 MHz, with the card's own housekeeping now and then
+	{"sd card (spi)", 512, 512, 512, 0, 600, 64, 150000},
+	// SPI NOR flash, typical times (W25Q128: 45 ms sector erase, 0.7 ms page program)
+	{"spi nor, typical", 1, 256, 4096, 45000, 700, 0, 0},
+	// the same chip at its maximum times (400 ms erase, 3 ms program)
+	{"spi nor, worst case", 1, 256, 4096, 400000, 3000, 0, 0}
+};
+
+// reports recorded at the profile rate: rotation, gyro and linear acceleration
+static const uint8_t simReports[] = {
+	SENSOR_REPORTID_ROTATION_VECTOR,
+	SENSOR_REPORTID_GYROSCOPE_CALIBRATED,
+	SENSOR_REPORTID_LINEAR_ACCELERATION
+};
+
+static const uint32_t rates[] = {100, 400};
+
+static void simulate(const SimBlockTiming& timing, uint32_t rate, uint32_t seconds)
+{
+	SimBlockDevice device(timing, SIM_DEVICE_SIZE);
+	BlockLog log(device);
+	if (!log.mount()) {
+		printf("%-20s mount failed\n", timing.name);
+		return;
+	}
+
+	const uint64_t period = 1000000 / rate;
+	const uint64_t end = static_cast<uint64_t>(seconds) * 1000000;
+	int16_t words[TELEMETRY_MAX_WORDS] = {100, -200, 300, 16000, 50};
+
+	bool writing = false;
+	uint64_t finishAt = 0;
+	uint32_t samples = 0;
+	uint32_t bytesPerTick = 0;
+	for (size_t r = 0; r < sizeof(simReports); r++) {
+		bytesPerTick += TELEMETRY_RECORD_HEADER_SIZE + 2 * telemetrySchema(simReports[r])->numWords;
+	}
+
+	for (uint64_t now = 0; now < end; now += period) {
+		// the writer finishes blocks and starts the next one, until it catches up with now
+		while (true) {
+			if (writing && finishAt <= now) {
+				log.service();
+				writing = false;
+			}
+			if (!writing && log.blockReady()) {
+				writing = true;
+				finishAt = (finishAt > now ? finishAt : now) + device.writeTime(BLOCK_LOG_BLOCK_SIZE);
+				continue;
+			}
+			break;
+		}
+
+		for (size_t r = 0; r < sizeof(simReports); r++) {
+			log.add(simReports[r], 3, static_cast<uint32_t>(now), words, TELEMETRY_MAX_WORDS);
+			samples++;
+		}
+	}
+
+	double elapsed = end / 1e6;
+	printf("%-20s %4u Hz %8.0f B/s in %9.0f B/s written %5.1f%% busy %8u lost (%.3f%%)\n", timing.name,
+		   static_cast<unsigned>(rate), bytesPerTick * static_cast<double>(rate),
+		   static_cast<double>(log.blocksWritten()) * BLOCK_LOG_BLOCK_SIZE / elapsed,
+		   100.0 * static_cast<double>(device.busyTime()) / static_cast<double>(end),
+		   static_cast<unsigned>(log.samplesLost()), 100.0 * log.samplesLost() / samples);
+}
+
+// writes some blocks into a small region (so the ring wraps), cuts the power in
+// the middle of the next one, and checks what a remount finds
+static bool checkCrash(const SimBlockTiming& timing)
+{
+	const uint32_t regionBlocks = 16;
+	const uint32_t blocks = 37;
+	SimBlockDevice device(timing, SIM_DEVICE_SIZE);
+	int16_t words[TELEMETRY_MAX_WORDS] = {1, 2, 3, 4, 5};
+
+	BlockLog log(device, BLOCK_LOG_BLOCK_SIZE, regionBlocks * BLOCK_LOG_BLOCK_SIZE);
+	log.mount();
+	uint32_t t = 0;
+	while (log.blocksWritten() < blocks) {
+		log.add(SENSOR_REPORTID_ROTATION_VECTOR, 3, t++, words, 5);
+		log.service();
+	}
+
+	// fill the next block, and lose the power half way through writing it
+	while (!log.blockReady()) {
+		log.add(SENSOR_REPORTID_ROTATION_VECTOR, 3, t++, words, 5);
+	}
+	device.cutPowerAfter(BLOCK_LOG_BLOCK_SIZE / 2);
+	log.service();
+
+	BlockLog remounted(device, BLOCK_LOG_BLOCK_SIZE, regionBlocks * BLOCK_LOG_BLOCK_SIZE);
+	remounted.mount();
+
+	static uint8_t buffer[BLOCK_LOG_BLOCK_SIZE];
+	uint32_t valid = 0;
+	uint32_t newest = 0;
+	for (uint32_t i = 0; i < regionBlocks; i++) {
+		BlockLogFooter footer;
+		if (remounted.readBlock(i, buffer, footer)) {
+			valid++;
+			newest = footer.sequence > newest ? footer.sequence : newest;
+		}
+	}
+
+	// the torn block was the 38th (sequence 37): the 15 before it survive, and the log goes on after the last good one
+	bool ok = valid == regionBlocks - 1 && newest == blocks - 1 && remounted.nextSequence() == blocks;
+	printf("%-20s crash: %u of %u blocks valid, newest %u, resumes at sequence %u: %s\n", timing.name,
+		   static_cast<unsigned>(valid), static_cast<unsigned>(regionBlocks), static_cast<unsigned>(newest),
+		   static_cast<unsigned>(remounted.nextSequence()), ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t seconds = argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 600;
+
+	printf("# %u s recordings, %u byte blocks, double buffered\n", static_cast<unsigned>(seconds), BLOCK_LOG_BLOCK_SIZE);
+	for (size_t d = 0; d < sizeof(devices) / sizeof(devices[0]); d++) {
+		for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+			simulate(devices[d], rates[r], seconds);
+		}
+	}
+
+	bool ok = true;
+	for (size_t d = 0; d < sizeof(devices) / sizeof(devices[0]); d++) {
+		ok = checkCrash(devices[d]) && ok;
+	}
+	return ok ? 0 : 1;
+}
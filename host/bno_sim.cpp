@@ -0,0 +1,211 @@
+//
+// Host tool: runs the unmodified BNO080 driver against a simulated IMU
+// (SimBNO080.h) in virtual time, to measure what the firmware gets out of each
+// of BNO080Wheelchair's report profiles.  For each profile it starts the IMU,
+// enables the profile's reports and polls it like main.cpp does, then prints
+// how many samples arrived, how many packets that took, the latency from a
+// sample's timestamp to its callback, and how fast the host ran the driver.
+//
+// Then it does the same through BNO080Wheelchair::setup() with resampling on,
+// to check that the wheelchair layer runs too, and prints how evenly each
+// report's samples arrived (see BNOWrapper/RateMonitor.h).
+//
+// Last, it traces the latency of each stage from sensor to consumer (see
+// BNOWrapper/LatencyTracer.h) with the outdoor profile, on a 100 kHz and a
+// 400 kHz bus, while a control loop reads the heading through the wheelchair's
+// getters the way the chair's code does.  The rate monitor shows whether the
+// samples still came at their periods, polled that slowly.
+//
+//   bno_sim [seconds] [poll period us]     10 s, 1000 us by default
+//
+
+#include <mbed.h>
+
+#include <chrono>
+
+#include "BNO080Wheelchair.h"
+#include "Log.h"
+#include "SimBNO080.h"
+
+#define SIM_SDA PB_9
+#define SIM_SCL PB_8
+#define SIM_INT PA_6
+#define SIM_RST PA_5
+#define SIM_ADDRESS 0x4B
+#define SIM_I2C_FREQUENCY 400000
+
+static Serial pc(USBTX, USBRX);
+
+static const BNO080Profile* const profiles[] = {
+	&PROFILE_LEGACY,
+	&PROFILE_INDOOR_NAVIGATION,
+	&PROFILE_OUTDOOR,
+	&PROFILE_PARKED,
+	&PROFILE_MOUNTING_CALIBRATION
+};
+
+// what the sample callback sees during a run
+struct RunStats
+{
+	BNO080* imu;
+	uint32_t samples;
+	uint64_t latencySum;
+	uint32_t latencyMax;
+};
+
+static RunStats stats;
+
+static void onSample(const BNO080::SensorSample& sample)
+{
+	uint32_t latency = stats.imu->getHostTime() - sample.timestamp;
+	stats.samples++;
+	stats.latencySum += latency;
+	if (latency > stats.latencyMax) {
+		stats.latencyMax = latency;
+	}
+}
+
+static double hostSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// drops what the driver logged, printing only errors
+static void drainLog()
+{
+	LogEntry entry;
+	while (logPop(entry)) {
+		if (logLevel(entry.id) <= LOG_LEVEL_ERROR) {
+			char text[160];
+			logFormat(text, sizeof(text), entry.id, entry.args, entry.numArgs);
+			fprintf(stderr, "  driver: %s\n", text);
+		}
+	}
+}
+
+static void runProfile(const BNO080Profile& profile, float seconds, int pollPeriod)
+{
+	SimBNO080 sim(SIM_INT, SIM_RST, SIM_ADDRESS);
+	BNO080 imu(&pc, SIM_SDA, SIM_SCL, SIM_INT, SIM_RST, SIM_ADDRESS, SIM_I2C_FREQUENCY);
+
+	memset(&stats, 0, sizeof(stats));
+	stats.imu = &imu;
+
+	if (!imu.begin()) {
+		drainLog();
+		printf("%-10s begin() failed\n", profile.name);
+		return;
+	}
+	for (uint8_t i = 0; i < profile.numReports; i++) {
+		imu.enableReport(profile.reports[i].report, profile.reports[i].period, profile.reports[i].batchInterval);
+	}
+	imu.attachSampleCallback(onSample);
+
+	// measure from here, once the setup traffic is done
+	uint32_t takenBefore = sim.samplesTaken();
+	uint32_t packetsBefore = sim.packetsSent();
+	int64_t start = HostClock::now();
+	int64_t end = start + static_cast<int64_t>(seconds * 1e9f);
+	double hostStart = hostSeconds();
+
+	while (HostClock::now() < end) {
+		wait_us(pollPeriod);
+		imu.updateData();
+		drainLog();
+	}
+
+	double hostTime = hostSeconds() - hostStart;
+	double virtualTime = (HostClock::now() - start) * 1e-9;
+	printf("%-10s %9.1f %9.1f %9.1f %9.1f %9.1f %8u %9.0f\n", profile.name,
+		   (sim.samplesTaken() - takenBefore) / virtualTime,
+		   stats.samples / virtualTime,
+		   (sim.packetsSent() - packetsBefore) / virtualTime,
+		   stats.samples > 0 ? static_cast<double>(stats.latencySum) / stats.samples : 0.0,
+		   static_cast<double>(stats.latencyMax),
+		   static_cast<unsigned>(sim.samplesDropped()),
+		   virtualTime / hostTime);
+}
+
+static void runWheelchair(float seconds, int pollPeriod)
+{
+	SimBNO080 sim(SIM_INT, SIM_RST, SIM_ADDRESS);
+	BNO080Wheelchair chair(&pc, SIM_SDA, SIM_SCL, SIM_INT, SIM_RST, SIM_ADDRESS, SIM_I2C_FREQUENCY);
+	RateMonitor rates;
+	chair.setRateMonitor(&rates);
+	chair.setProfile(PROFILE_OUTDOOR);
+	if (!chair.setup()) {
+		drainLog();
+		printf("wheelchair: setup() failed\n");
+		return;
+	}
+	// the reports' first samples came during the setup traffic
+	rates.resetStatistics();
+	chair.enableResampling(10000);
+
+	int64_t end = HostClock::now() + static_cast<int64_t>(seconds * 1e9f);
+	uint32_t frames = 0;
+	ResampledFrame frame;
+	while (HostClock::now() < end) {
+		wait_us(pollPeriod);
+		chair.imu.updateData();
+		while (chair.resampler.poll(frame)) {
+			frames++;
+		}
+		drainLog();
+	}
+
+	printf("wheelchair (%s): %u samples taken, %u resampled frames at 100 Hz, yaw %.2f rad/s\n",
+		   chair.profile().name, static_cast<unsigned>(sim.samplesTaken()), static_cast<unsigned>(frames),
+		   static_cast<double>(chair.imu.gyroRotation[2]));
+	rates.print(pc);
+}
+
+static void runLatencyTrace(float seconds, int frequency)
+{
+	SimBNO080 sim(SIM_INT, SIM_RST, SIM_ADDRESS);
+	BNO080Wheelchair chair(&pc, SIM_SDA, SIM_SCL, SIM_INT, SIM_RST, SIM_ADDRESS, frequency);
+	RateMonitor rates;
+	chair.setRateMonitor(&rates);
+	chair.setProfile(PROFILE_OUTDOOR);
+	if (!chair.setup()) {
+		drainLog();
+		printf("latency trace: setup() failed\n");
+		return;
+	}
+
+	// the setup traffic doesn't count
+	LatencyTracer tracer;
+	chair.setLatencyTracer(&tracer);
+	rates.resetStatistics();
+
+	int64_t end = HostClock::now() + static_cast<int64_t>(seconds * 1e9f);
+	while (HostClock::now() < end) {
+		chair.rotation();
+		chair.gyro_z();
+		drainLog();
+	}
+
+	printf("# latency trace, %s profile, I2C at %d kHz\n", chair.profile().name, frequency / 1000);
+	tracer.print(pc);
+	rates.print(pc);
+}
+
+int main(int argc, char** argv)
+{
+	float seconds = argc > 1 ? static_cast<float>(atof(argv[1])) : 10.0f;
+	int pollPeriod = argc > 2 ? atoi(argv[2]) : 1000;
+
+	printf("# %.0f s of virtual time per profile, polling every %d us, I2C at %d kHz\n",
+		   static_cast<double>(seconds), pollPeriod, SIM_I2C_FREQUENCY / 1000);
+	printf("%-10s %9s %9s %9s %9s %9s %8s %9s\n", "# profile", "taken/s", "got/s", "packets/s",
+		   "lat us", "max us", "dropped", "speedup");
+	for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+		runProfile(*profiles[i], seconds, pollPeriod);
+	}
+
+	runWheelchair(seconds, pollPeriod);
+
+	runLatencyTrace(seconds, 100000);
+	runLatencyTrace(seconds, 400000);
+	return 0;
+}
@@ -0,0 +1,417 @@
+//
+// Host tool: throughput and latency of the BNO080 driver against the simulated
+// IMU (SimBNO080.h).  It sweeps report sets, report intervals, batching and the
+// I2C clock, and for each configuration runs the unmodified driver in virtual
+// time, polling it every millisecond, and measures:
+//
+//   samples_per_s, packets_per_s  what reached the sample callback, and in how many packets
+//   cycles_per_sample             host CPU spent in updateData() per sample (the TSC on x86,
+//                                 ns elsewhere), the simulated bus included; the least of
+//                                 BENCH_RUNS runs, as anything else on the host only adds to it
+//   dropped                       samples the IMU took that never reached the callback: lost
+//                                 on the way, dropped by its full FIFO, or left queued in it by
+//                                 a driver that can't keep up
+//   lat_p50_us ... lat_max_us     time from a sample's timestamp to its callback
+//
+// as CSV, one configuration per line.  Everything but cycles_per_sample is
+// deterministic, so it can be compared exactly against a stored baseline:
+//
+//   driver_bench [-t seconds] [--save file] [--compare file]
+//
+// --compare prints each regression to stderr and exits with 1 if there are any.
+// cycles_per_sample depends on the machine; record the baseline on the machine
+// that compares against it (make bench-driver uses driver_bench_baseline.csv).
+//
+
+#include <mbed.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "BNO080.h"
+#include "Log.h"
+#include "SimBNO080.h"
+
+#define SIM_SDA PB_9
+#define SIM_SCL PB_8
+#define SIM_INT PA_6
+#define SIM_RST PA_5
+#define SIM_ADDRESS 0x4B
+
+// how often the driver is polled, in us
+#define BENCH_POLL_PERIOD 1000
+
+// run time before measuring, so the setup traffic is done, in us
+#define BENCH_SETTLE_TIME 500000
+
+// runs of each configuration, for cycles_per_sample
+#define BENCH_RUNS 7
+
+// how long the start and the end of a run are watched for the lowest backlog of the IMU, in us;
+// longer than the batch intervals and report periods, so a backlog that keeps up empties in it
+#define BENCH_BACKLOG_WINDOW 250000
+
+// allowed change before --compare calls it a regression; host CPU time is noisy, so cycles get a wide margin
+#define BENCH_RATE_TOLERANCE 0.01
+#define BENCH_LATENCY_TOLERANCE 0.10
+#define BENCH_LATENCY_SLACK_US 100
+#define BENCH_CYCLES_TOLERANCE 1.00
+
+struct ReportSet
+{
+	const char* name;
+	const BNO080::Report* reports;
+	uint8_t numReports;
+};
+
+static const BNO080::Report rotationReports[] = {BNO080::ROTATION};
+static const BNO080::Report navigationReports[] = {BNO080::GAME_ROTATION, BNO080::GYROSCOPE, BNO080::LINEAR_ACCELERATION};
+static const BNO080::Report allReports[] = {
+	BNO080::TOTAL_ACCELERATION, BNO080::LINEAR_ACCELERATION, BNO080::GRAVITY_ACCELERATION,
+	BNO080::GYROSCOPE, BNO080::MAG_FIELD, BNO080::ROTATION
+};
+
+#define REPORT_SET(name, reports) {name, reports, sizeof(reports) / sizeof(reports[0])}
+
+static const ReportSet reportSets[] = {
+	REPORT_SET("rotation", rotationReports),
+	REPORT_SET("navigation", navigationReports),
+	REPORT_SET("all", allReports)
+};
+
+// report intervals in ms (the IMU raises each to its minimum period, 2.5 ms for most, 10 ms for the magnetometer)
+static const uint16_t intervals[] = {50, 10, 5};
+
+// batch intervals in ms, 0 = off
+static const uint16_t batchIntervals[] = {0, 50};
+
+static const int busClocks[] = {100000, 400000};
+
+struct BenchResult
+{
+	double samplesPerSecond;
+	double packetsPerSecond;
+	double cyclesPerSample;
+	uint32_t dropped;
+	uint32_t latencyP50;
+	uint32_t latencyP90;
+	uint32_t latencyP99;
+	uint32_t latencyMax;
+};
+
+#define BENCH_CSV_HEADER "reports,interval_ms,batch_ms,i2c_khz,samples_per_s,packets_per_s,cycles_per_sample," \
+	"dropped,lat_p50_us,lat_p90_us,lat_p99_us,lat_max_us"
+
+static Serial debugPort(USBTX, USBRX);
+
+static BNO080* benchImu;
+static bool measuring;
+static std::vector<uint32_t> latencies;
+
+static void onSample(const BNO080::SensorSample& sample)
+{
+	if (measuring) {
+		latencies.push_back(benchImu->getHostTime() - sample.timestamp);
+	}
+}
+
+static uint64_t cpuTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, uint32_t percent)
+{
+	if (sorted.empty()) {
+		return 0;
+	}
+	size_t index = (sorted.size() - 1) * percent / 100;
+	return sorted[index];
+}
+
+// a poll of the main loop: wait, then read whatever the IMU has
+static uint64_t poll(BNO080& imu)
+{
+	wait_us(BENCH_POLL_PERIOD);
+	uint64_t start = cpuTicks();
+	imu.updateData();
+	uint64_t ticks = cpuTicks() - start;
+
+	// the driver logs to the ring; nothing reads it here
+	LogEntry entry;
+	while (logPop(entry)) {
+	}
+	return ticks;
+}
+
+static bool runConfig(const ReportSet& set, uint16_t interval, uint16_t batch, int busClock, float seconds,
+					  BenchResult& result)
+{
+	SimBNO080 sim(SIM_INT, SIM_RST, SIM_ADDRESS);
+	BNO080 imu(&debugPort, SIM_SDA, SIM_SCL, SIM_INT, SIM_RST, SIM_ADDRESS, busClock);
+	benchImu = &imu;
+	measuring = false;
+	latencies.clear();
+
+	if (!imu.begin()) {
+		return false;
+	}
+	imu.attachSampleCallback(onSample);
+	for (uint8_t i = 0; i < set.numReports; i++) {
+		imu.enableReport(set.reports[i], interval, batch);
+	}
+
+	int64_t settleEnd = HostClock::now() + static_cast<int64_t>(BENCH_SETTLE_TIME) * 1000;
+	while (HostClock::now() < settleEnd) {
+		poll(imu);
+	}
+
+	measuring = true;
+	uint32_t sentBefore = sim.samplesSent();
+	uint32_t droppedBefore = sim.samplesDropped();
+	uint32_t packetsBefore = sim.packetsSent();
+	uint64_t ticks = 0;
+	int64_t start = HostClock::now();
+	int64_t end = start + static_cast<int64_t>(seconds * 1e9f);
+	int64_t window = static_cast<int64_t>(BENCH_BACKLOG_WINDOW) * 1000;
+
+	// a driver that keeps up empties the IMU's queue now and then, one that doesn't leaves more in it every time
+	size_t startBacklog = SIZE_MAX;
+	size_t endBacklog = SIZE_MAX;
+	while (HostClock::now() < end) {
+		ticks += poll(imu);
+		int64_t now = HostClock::now();
+		if (now < start + window) {
+			startBacklog = std::min(startBacklog, sim.samplesPending());
+		}
+		if (now >= end - window) {
+			endBacklog = std::min(endBacklog, sim.samplesPending());
+		}
+	}
+	measuring = false;
+
+	double elapsed = (HostClock::now() - start) * 1e-9;
+	uint32_t sent = sim.samplesSent() - sentBefore;
+	uint32_t received = static_cast<uint32_t>(latencies.size());
+
+	std::sort(latencies.begin(), latencies.end());
+	result.samplesPerSecond = received / elapsed;
+	result.packetsPerSecond = (sim.packetsSent() - packetsBefore) / elapsed;
+	result.cyclesPerSample = received > 0 ? static_cast<double>(ticks) / received : 0.0;
+	result.dropped = sent > received ? sent - received : 0;
+	result.dropped += sim.samplesDropped() - droppedBefore;
+	if (endBacklog != SIZE_MAX && endBacklog > startBacklog) {
+		result.dropped += static_cast<uint32_t>(endBacklog - startBacklog);
+	}
+	result.latencyP50 = percentile(latencies, 50);
+	result.latencyP90 = percentile(latencies, 90);
+	result.latencyP99 = percentile(latencies, 99);
+	result.latencyMax = latencies.empty() ? 0 : latencies.back();
+	return true;
+}
+
+// runs a configuration BENCH_RUNS times: all but cycles_per_sample come out the same every time, so it
+// keeps the least cycles_per_sample
+static bool runBest(const ReportSet& set, uint16_t interval, uint16_t batch, int busClock, float seconds,
+					BenchResult& result)
+{
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		BenchResult repeat = BenchResult();
+		if (!runConfig(set, interval, batch, busClock, seconds, repeat)) {
+			return false;
+		}
+		if (run == 0) {
+			result = repeat;
+		} else {
+			result.cyclesPerSample = std::min(result.cyclesPerSample, repeat.cyclesPerSample);
+		}
+	}
+	return true;
+}
+
+// the configuration columns of a line, which identify it in a baseline
+static std::string configKey(const ReportSet& set, uint16_t interval, uint16_t batch, int busClock)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%s,%u,%u,%d", set.name, static_cast<unsigned>(interval),
+			 static_cast<unsigned>(batch), busClock / 1000);
+	return key;
+}
+
+static void formatResult(char* line, size_t size, const std::string& key, const BenchResult& result)
+{
+	snprintf(line, size, "%s,%.1f,%.1f,%.0f,%u,%u,%u,%u,%u", key.c_str(), result.samplesPerSecond,
+			 result.packetsPerSecond, result.cyclesPerSample, static_cast<unsigned>(result.dropped),
+			 static_cast<unsigned>(result.latencyP50), static_cast<unsigned>(result.latencyP90),
+			 static_cast<unsigned>(result.latencyP99), static_cast<unsigned>(result.latencyMax));
+}
+
+static bool parseResult(const char* line, std::string& key, BenchResult& result)
+{
+	char name[32];
+	unsigned interval, batch, khz, dropped, p50, p90, p99, max;
+	if (sscanf(line, "%31[^,],%u,%u,%u,%lf,%lf,%lf,%u,%u,%u,%u,%u", name, &interval, &batch, &khz,
+			   &result.samplesPerSecond, &result.packetsPerSecond, &result.cyclesPerSample, &dropped,
+			   &p50, &p90, &p99, &max) != 12) {
+		return false;
+	}
+
+	char keyText[64];
+	snprintf(keyText, sizeof(keyText), "%s,%u,%u,%u", name, interval, batch, khz);
+	key = keyText;
+	result.dropped = dropped;
+	result.latencyP50 = p50;
+	result.latencyP90 = p90;
+	result.latencyP99 = p99;
+	result.latencyMax = max;
+	return true;
+}
+
+static bool loadBaseline(const char* path, std::map<std::string, BenchResult>& baseline)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL) {
+		return false;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		std::string key;
+		BenchResult result;
+		if (line[0] != '#' && parseResult(line, key, result)) {
+			baseline[key] = result;
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+static bool latencyWorse(uint32_t now, uint32_t base)
+{
+	return now > base * (1 + BENCH_LATENCY_TOLERANCE) + BENCH_LATENCY_SLACK_US;
+}
+
+// prints every metric of a configuration that got worse than the baseline; returns how many
+static int compareResult(const std::string& key, const BenchResult& now, const BenchResult& base)
+{
+	int regressions = 0;
+	if (now.samplesPerSecond < base.samplesPerSecond * (1 - BENCH_RATE_TOLERANCE)) {
+		fprintf(stderr, "regression: %s samples_per_s %.1f -> %.1f\n", key.c_str(), base.samplesPerSecond, now.samplesPerSecond);
+		regressions++;
+	}
+	if (now.dropped > base.dropped) {
+		fprintf(stderr, "regression: %s dropped %u -> %u\n", key.c_str(), static_cast<unsigned>(base.dropped),
+				static_cast<unsigned>(now.dropped));
+		regressions++;
+	}
+	if (base.cyclesPerSample > 0 && now.cyclesPerSample > base.cyclesPerSample * (1 + BENCH_CYCLES_TOLERANCE)) {
+		fprintf(stderr, "regression: %s cycles_per_sample %.0f -> %.0f\n", key.c_str(), base.cyclesPerSample, now.cyclesPerSample);
+		regressions++;
+	}
+
+	const char* names[] = {"lat_p50_us", "lat_p90_us", "lat_p99_us", "lat_max_us"};
+	const uint32_t nowLatency[] = {now.latencyP50, now.latencyP90, now.latencyP99, now.latencyMax};
+	const uint32_t baseLatency[] = {base.latencyP50, base.latencyP90, base.latencyP99, base.latencyMax};
+	for (size_t i = 0; i < 4; i++) {
+		if (latencyWorse(nowLatency[i], baseLatency[i])) {
+			fprintf(stderr, "regression: %s %s %u -> %u\n", key.c_str(), names[i], static_cast<unsigned>(baseLatency[i]),
+					static_cast<unsigned>(nowLatency[i]));
+			regressions++;
+		}
+	}
+	return regressions;
+}
+
+int main(int argc, char** argv)
+{
+	float seconds = 5.0f;
+	const char* savePath = NULL;
+	const char* comparePath = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			seconds = static_cast<float>(atof(argv[++i]));
+		} else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+			savePath = argv[++i];
+		} else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+			comparePath = argv[++i];
+		} else {
+			fprintf(stderr, "usage: driver_bench [-t seconds] [--save file] [--compare file]\n");
+			return 2;
+		}
+	}
+
+	std::map<std::string, BenchResult> baseline;
+	if (comparePath != NULL && !loadBaseline(comparePath, baseline)) {
+		fprintf(stderr, "Error: can't read baseline %s\n", comparePath);
+		return 2;
+	}
+
+	FILE* save = NULL;
+	if (savePath != NULL) {
+		save = fopen(savePath, "w");
+		if (save == NULL) {
+			fprintf(stderr, "Error: can't write %s\n", savePath);
+			return 2;
+		}
+		fprintf(save, "# driver_bench -t %g\n%s\n", static_cast<double>(seconds), BENCH_CSV_HEADER);
+	}
+
+	printf("%s\n", BENCH_CSV_HEADER);
+	int regressions = 0;
+	int missing = 0;
+	for (size_t s = 0; s < sizeof(reportSets) / sizeof(reportSets[0]); s++) {
+		for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+			for (size_t b = 0; b < sizeof(batchIntervals) / sizeof(batchIntervals[0]); b++) {
+				for (size_t c = 0; c < sizeof(busClocks) / sizeof(busClocks[0]); c++) {
+					std::string key = configKey(reportSets[s], intervals[i], batchIntervals[b], busClocks[c]);
+					BenchResult result = BenchResult();
+					if (!runBest(reportSets[s], intervals[i], batchIntervals[b], busClocks[c], seconds, result)) {
+						fprintf(stderr, "Error: %s: the driver didn't start\n", key.c_str());
+						regressions++;
+						continue;
+					}
+
+					char line[256];
+					formatResult(line, sizeof(line), key, result);
+					printf("%s\n", line);
+					if (save != NULL) {
+						fprintf(save, "%s\n", line);
+					}
+
+					if (comparePath != NULL) {
+						std::map<std::string, BenchResult>::const_iterator base = baseline.find(key);
+						if (base == baseline.end()) {
+							missing++;
+						} else {
+							regressions += compareResult(key, result, base->second);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (save != NULL) {
+		fclose(save);
+	}
+	if (comparePath != NULL) {
+		fprintf(stderr, "# %d regressions against %s", regressions, comparePath);
+		if (missing > 0) {
+			fprintf(stderr, ", %d configurations not in it", missing);
+		}
+		fprintf(stderr, "\n");
+	}
+	return regressions > 0 ? 1 : 0;
+}
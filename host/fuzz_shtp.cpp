@@ -0,0 +1,388 @@
+//
+// Fuzz target for the BNO080 driver's receive path: arbitrary bytes from the
+// IMU go through receivePacket() and processPacket() via updateData(), with
+// the sample, status and packet callbacks attached.  Built with AddressSanitizer
+// and UndefinedBehaviorSanitizer (array bounds included), so a read or write
+// outside the driver's buffers stops the run.
+//
+// The input is what the IMU sends, as the driver reads it: each packet's
+// 4 byte header, then the packet again, header and all, for the body read.  In
+// the input every packet appears once; the device serves its header twice.
+// A header the driver rejects without reading the body is skipped.
+//
+// LLVMFuzzerTestOneInput() is the libFuzzer entry point: with clang,
+//
+//   clang++ -fsanitize=fuzzer,address,undefined -DFUZZ_LIBFUZZER ...
+//
+// gives a coverage guided fuzzer.  Without it, main() below is a standalone
+// runner with the same command line shape:
+//
+//   fuzz_shtp [-runs=N] [-seed=N] [-max_len=N] corpus_dir_or_file...
+//
+// runs every corpus input, then N inputs mutated from them at random.  An
+// input that fails a sanitizer check is written to crash-<hash> first.
+// fuzz_corpus/shtp holds the regression corpus: `make -C host fuzz` runs it.
+//
+
+#include <mbed.h>
+
+#include <dirent.h>
+#include <signal.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "BNO080.h"
+#include "Log.h"
+
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#define FUZZ_INT PA_6
+#define FUZZ_ADDRESS 0x4B
+
+// Serves the fuzz input to the driver as the IMU's side of the bus
+class FuzzDevice : public HostI2CDevice
+{
+public:
+	FuzzDevice(const uint8_t* data, size_t size) :
+		_data(data),
+		_size(size),
+		_position(0),
+		_headerRead(false)
+	{
+		I2C::attachDevice(FUZZ_ADDRESS, this);
+		HostPins::write(FUZZ_INT, 1);
+		updateInterrupt();
+	}
+
+	~FuzzDevice()
+	{
+		I2C::attachDevice(FUZZ_ADDRESS, NULL);
+	}
+
+	bool done() const { return _position >= _size; }
+
+	virtual int read(char* data, int length)
+	{
+		if (!_headerRead) {
+			// a header read: the body read that follows starts at the same place
+			copy(data, length);
+			_headerRead = true;
+			return 0;
+		}
+
+		copy(data, length);
+		_position += static_cast<size_t>(length);
+		_headerRead = false;
+		updateInterrupt();
+		return 0;
+	}
+
+	virtual int write(const char* data, int length)
+	{
+		return 0;
+	}
+
+	/// Called when the driver returns: a header read without a body read was rejected, so skip it
+	void endTransfer()
+	{
+		if (_headerRead) {
+			_position += SHTP_HEADER_SIZE;
+			_headerRead = false;
+			updateInterrupt();
+		}
+	}
+
+private:
+	const uint8_t* _data;
+	size_t _size;
+	size_t _position;
+	bool _headerRead;
+
+	void copy(char* data, int length)
+	{
+		memset(data, 0, static_cast<size_t>(length));
+		if (_position < _size) {
+			size_t available = _size - _position;
+			memcpy(data, _data + _position, static_cast<size_t>(length) < available ? length : available);
+		}
+	}
+
+	void updateInterrupt()
+	{
+		HostPins::write(FUZZ_INT, done() ? 1 : 0);
+	}
+};
+
+static Serial pc(USBTX, USBRX);
+static volatile uint32_t sink;
+
+static void onSample(const BNO080::SensorSample& sample)
+{
+	uint32_t sum = sample.timestamp + sample.status;
+	for (uint8_t i = 0; i < sample.numValues; i++) {
+		sum += static_cast<uint16_t>(sample.values[i]);
+	}
+	sink = sum;
+}
+
+static void onStatus(const BNO080::StatusChange& change)
+{
+	sink = change.dwellTime;
+}
+
+static void onPacket(const BNO080::RawPacket& packet)
+{
+	uint32_t sum = packet.timestamp;
+	for (uint16_t i = 0; i < packet.length; i++) {
+		sum += packet.data[i];
+	}
+	sink = sum;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	HostClock::useVirtualTime();
+	FuzzDevice device(data, size);
+
+	// on the heap, so that AddressSanitizer sees the end of the object
+	BNO080* imu = new BNO080(&pc, PB_9, PB_8, FUZZ_INT, PA_5, FUZZ_ADDRESS, 400000);
+	imu->attachSampleCallback(onSample);
+	imu->attachStatusCallback(onStatus);
+	imu->attachPacketCallback(onPacket);
+
+	// every call reads at least one packet or rejects a header, so this always ends
+	while (!device.done()) {
+		imu->updateData();
+		device.endTransfer();
+
+		LogEntry entry;
+		while (logPop(entry)) {
+		}
+	}
+
+	delete imu;
+	return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+static std::vector<std::vector<uint8_t> > corpus;
+static const std::vector<uint8_t>* currentInput = NULL;
+static uint32_t randomState = 1;
+
+static uint32_t random32()
+{
+	// xorshift32
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+static uint32_t hashInput(const std::vector<uint8_t>& input)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < input.size(); i++) {
+		hash = (hash ^ input[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static void saveCurrentInput()
+{
+	if (currentInput == NULL) {
+		return;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "crash-%08x", static_cast<unsigned>(hashInput(*currentInput)));
+	FILE* file = fopen(name, "wb");
+	if (file != NULL) {
+		fwrite(currentInput->data(), 1, currentInput->size(), file);
+		fclose(file);
+		fprintf(stderr, "input written to %s\n", name);
+	}
+}
+
+static void onAbort(int signal)
+{
+	saveCurrentInput();
+	::signal(signal, SIG_DFL);
+	raise(signal);
+}
+
+// UndefinedBehaviorSanitizer aborts on a finding, so that onAbort() saves the input.
+// AddressSanitizer exits instead, and saves it through its death callback.
+extern "C" const char* __ubsan_default_options()
+{
+	return "abort_on_error=1:print_stacktrace=1";
+}
+
+static bool loadFile(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL) {
+		return false;
+	}
+	std::vector<uint8_t> input;
+	int c;
+	while ((c = fgetc(file)) != EOF) {
+		input.push_back(static_cast<uint8_t>(c));
+	}
+	fclose(file);
+	corpus.push_back(input);
+	return true;
+}
+
+static bool loadPath(const std::string& path)
+{
+	DIR* dir = opendir(path.c_str());
+	if (dir == NULL) {
+		return loadFile(path);
+	}
+
+	std::vector<std::string> names;
+	while (dirent* entry = readdir(dir)) {
+		if (entry->d_name[0] != '.') {
+			names.push_back(entry->d_name);
+		}
+	}
+	closedir(dir);
+
+	// in name order, so that runs are repeatable
+	std::sort(names.begin(), names.end());
+	for (size_t i = 0; i < names.size(); i++) {
+		if (!loadFile(path + "/" + names[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// values of the SHTP length and report fields around the edges of the driver's checks
+static const uint16_t interestingLengths[] = {0, 1, 3, 4, 5, 9, 127, 128, 132, 133, 511, 512, 513, 0x7FFF, 0x8000, 0xFFFF};
+
+static void mutate(std::vector<uint8_t>& input, size_t maxLength)
+{
+	unsigned mutations = 1 + random32() % 4;
+	for (unsigned m = 0; m < mutations; m++) {
+		size_t size = input.size();
+		switch (random32() % 6) {
+			case 0:
+				// flip a bit
+				if (size > 0) {
+					input[random32() % size] ^= static_cast<uint8_t>(1 << (random32() % 8));
+				}
+				break;
+			case 1:
+				// set a byte
+				if (size > 0) {
+					input[random32() % size] = static_cast<uint8_t>(random32());
+				}
+				break;
+			case 2:
+				// insert bytes
+				if (size < maxLength) {
+					size_t count = 1 + random32() % 8;
+					size_t at = random32() % (size + 1);
+					for (size_t i = 0; i < count; i++) {
+						input.insert(input.begin() + static_cast<long>(at), static_cast<uint8_t>(random32()));
+					}
+				}
+				break;
+			case 3:
+				// erase bytes
+				if (size > 0) {
+					size_t at = random32() % size;
+					size_t count = 1 + random32() % 8;
+					input.erase(input.begin() + static_cast<long>(at),
+								input.begin() + static_cast<long>(at + count < size ? at + count : size));
+				}
+				break;
+			case 4: {
+				// a 16 bit field, e.g. a packet length, to an edge value
+				if (size >= 2) {
+					uint16_t value = interestingLengths[random32() % (sizeof(interestingLengths) / sizeof(interestingLengths[0]))];
+					size_t at = random32() % (size - 1);
+					input[at] = static_cast<uint8_t>(value);
+					input[at + 1] = static_cast<uint8_t>(value >> 8);
+				}
+			}
+			break;
+			default: {
+				// splice in a piece of another input
+				const std::vector<uint8_t>& other = corpus[random32() % corpus.size()];
+				if (!other.empty()) {
+					size_t from = random32() % other.size();
+					size_t count = 1 + random32() % (other.size() - from);
+					size_t at = random32() % (size + 1);
+					input.insert(input.begin() + static_cast<long>(at), other.begin() + static_cast<long>(from),
+								 other.begin() + static_cast<long>(from + count));
+				}
+			}
+			break;
+		}
+	}
+
+	if (input.size() > maxLength) {
+		input.resize(maxLength);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long runs = 0;
+	size_t maxLength = 4096;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "-runs=", 6) == 0) {
+			runs = strtoul(argv[i] + 6, NULL, 0);
+		} else if (strncmp(argv[i], "-seed=", 6) == 0) {
+			randomState = static_cast<uint32_t>(strtoul(argv[i] + 6, NULL, 0));
+			if (randomState == 0) {
+				randomState = 1;
+			}
+		} else if (strncmp(argv[i], "-max_len=", 9) == 0) {
+			maxLength = strtoul(argv[i] + 9, NULL, 0);
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "usage: fuzz_shtp [-runs=N] [-seed=N] [-max_len=N] corpus_dir_or_file...\n");
+			return 2;
+		} else if (!loadPath(argv[i])) {
+			fprintf(stderr, "Error: can't read %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+#ifdef __SANITIZE_ADDRESS__
+	__sanitizer_set_death_callback(saveCurrentInput);
+#endif
+	signal(SIGABRT, onAbort);
+
+	for (size_t i = 0; i < corpus.size(); i++) {
+		currentInput = &corpus[i];
+		LLVMFuzzerTestOneInput(corpus[i].data(), corpus[i].size());
+	}
+	fprintf(stderr, "%u corpus inputs passed\n", static_cast<unsigned>(corpus.size()));
+
+	if (runs > 0) {
+		if (corpus.empty()) {
+			corpus.push_back(std::vector<uint8_t>());
+		}
+		std::vector<uint8_t> input;
+		for (unsigned long run = 0; run < runs; run++) {
+			input = corpus[random32() % corpus.size()];
+			mutate(input, maxLength);
+			currentInput = &input;
+			LLVMFuzzerTestOneInput(input.data(), input.size());
+		}
+		fprintf(stderr, "%lu mutated inputs passed\n", runs);
+	}
+
+	currentInput = NULL;
+	return 0;
+}
+
+#endif
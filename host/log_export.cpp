@@ -0,0 +1,545 @@
+//
+// Host tool: turns recorded IMU data into one set of column files per report,
+// for analysis with numpy, pandas and the like.  Reads either format the board
+// writes, with the decoders the firmware uses:
+//
+//   telemetry   the COBS framed stream of Telemetry.h, as captured from the serial port
+//   blocklog    an image of the block device written by BlockLog (e.g. dd of the SD card)
+//
+// For each report it writes, into the output directory:
+//
+//   <report>.timestamp_us.u64   sample times, unwrapped from the 32 bit sensor clock
+//   <report>.status.u8          accuracy status, 0 to 3
+//   <report>.value<n>.f32       each word, scaled by its Q point
+//
+// all little endian arrays with one entry per sample (numpy.fromfile reads them),
+// or <report>.csv with --csv.  Records of reports without a schema are counted and skipped.
+//
+// The input is memory mapped and cut into chunks at frame or block boundaries,
+// which are decoded on all cores; the chunks are then written out in order.
+//
+//   log_export [-f telemetry|blocklog] [-o dir] [-j threads] [--csv] [--null] input
+//   log_export --synth telemetry|blocklog <hours> output
+//
+// --null decodes without writing anything, to time the decoding alone.
+// --synth writes a test recording: rotation, gyro and linear acceleration at 400 Hz.
+//
+
+#include <mbed.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Telemetry.h"
+#include "BlockLog.h"
+#include "SimBlockDevice.h"
+
+// bytes of telemetry, or blocks of a block log, that one thread decodes at a time
+#define EXPORT_TELEMETRY_CHUNK (16 * 1024 * 1024)
+#define EXPORT_BLOCKLOG_CHUNK 4096
+
+// rate and reports of --synth recordings
+#define SYNTH_RATE 400
+
+static const uint8_t synthReports[] = {
+	SENSOR_REPORTID_ROTATION_VECTOR,
+	SENSOR_REPORTID_GYROSCOPE_CALIBRATED,
+	SENSOR_REPORTID_LINEAR_ACCELERATION
+};
+
+// the samples of one report within a chunk, column by column
+struct Columns {
+	std::vector<uint32_t> timestamp;
+	std::vector<uint8_t> status;
+	std::vector<float> values[TELEMETRY_MAX_WORDS];
+};
+
+// everything decoded from one chunk
+struct Chunk {
+	Columns reports[256];
+	uint32_t records;
+	uint32_t unknown;
+	uint32_t bad;
+
+	// telemetry frame sequence numbers, to count lost frames across chunks
+	bool haveSequence;
+	uint8_t firstSequence;
+	uint8_t lastSequence;
+	uint32_t lostFrames;
+
+	Chunk() : records(0), unknown(0), bad(0), haveSequence(false), firstSequence(0), lastSequence(0), lostFrames(0) {}
+};
+
+static void addRecord(Chunk& chunk, const TelemetryRecord& record)
+{
+	if (record.schema == NULL) {
+		chunk.unknown++;
+		return;
+	}
+
+	Columns& columns = chunk.reports[record.reportID];
+	columns.timestamp.push_back(record.timestamp);
+	columns.status.push_back(record.status);
+	for (uint8_t i = 0; i < record.numWords; i++) {
+		columns.values[i].push_back(record.value(i));
+	}
+	chunk.records++;
+}
+
+// decodes the frames that start in [begin, end).  A frame starts after a 0 byte.
+static void decodeTelemetry(const uint8_t* data, size_t size, size_t begin, size_t end, Chunk& chunk)
+{
+	size_t pos = begin;
+	if (begin > 0) {
+		const void* zero = memchr(data + begin - 1, 0, size - (begin - 1));
+		pos = zero ? static_cast<const uint8_t*>(zero) - data + 1 : size;
+	}
+
+	TelemetryDecoder decoder;
+	TelemetryRecord record;
+	while (pos < end) {
+		const void* zero = memchr(data + pos, 0, size - pos);
+		size_t frameEnd = zero ? static_cast<const uint8_t*>(zero) - data : size;
+
+		if (frameEnd > pos && decoder.decodeFrame(data + pos, frameEnd - pos)) {
+			if (!chunk.haveSequence) {
+				chunk.haveSequence = true;
+				chunk.firstSequence = decoder.sequence();
+			}
+			chunk.lastSequence = decoder.sequence();
+			while (decoder.nextRecord(record)) {
+				addRecord(chunk, record);
+			}
+		}
+		pos = frameEnd + 1;
+	}
+
+	chunk.bad = decoder.badFrames();
+	chunk.lostFrames = decoder.lostFrames();
+}
+
+// decodes the blocks order[begin, end), which are indices into the image in sequence order
+static void decodeBlocks(const uint8_t* data, const std::vector<uint32_t>& order, size_t begin, size_t end, Chunk& chunk)
+{
+	TelemetryRecord record;
+	for (size_t i = begin; i < end; i++) {
+		const uint8_t* block = data + static_cast<size_t>(order[i]) * BLOCK_LOG_BLOCK_SIZE;
+		BlockLogFooter footer;
+		if (!BlockLog::checkBlock(block, footer)) {
+			chunk.bad++;
+			continue;
+		}
+
+		size_t offset = 0;
+		while (offset < footer.payloadLength) {
+			size_t length = telemetryParseRecord(block + offset, footer.payloadLength - offset, record);
+			if (length == 0) {
+				break;
+			}
+			addRecord(chunk, record);
+			offset += length;
+		}
+	}
+}
+
+// one report's output files, and the state to unwrap its timestamps
+struct ReportOutput {
+	bool open;
+	FILE* timestamp;
+	FILE* status;
+	FILE* values[TELEMETRY_MAX_WORDS];
+	FILE* csv;
+	uint64_t high;
+	uint32_t last;
+	uint64_t samples;
+};
+
+class Exporter {
+public:
+	Exporter(const std::string& dir, bool csv, bool null) : _dir(dir), _csv(csv), _null(null)
+	{
+		memset(_outputs, 0, sizeof(_outputs));
+	}
+
+	~Exporter()
+	{
+		for (int id = 0; id < 256; id++) {
+			ReportOutput& out = _outputs[id];
+			if (!out.open) {
+				continue;
+			}
+			closeFile(out.timestamp);
+			closeFile(out.status);
+			closeFile(out.csv);
+			for (uint8_t i = 0; i < TELEMETRY_MAX_WORDS; i++) {
+				closeFile(out.values[i]);
+			}
+		}
+	}
+
+	// writes a chunk's samples after those of the chunks before it
+	void write(const Chunk& chunk)
+	{
+		for (int id = 0; id < 256; id++) {
+			const Columns& columns = chunk.reports[id];
+			size_t n = columns.timestamp.size();
+			if (n == 0) {
+				continue;
+			}
+
+			const TelemetrySchema* schema = telemetrySchema(static_cast<uint8_t>(id));
+			ReportOutput& out = _outputs[id];
+			if (!out.open) {
+				openReport(out, schema);
+			}
+
+			std::vector<uint64_t> timestamps(n);
+			for (size_t s = 0; s < n; s++) {
+				// the sensor clock wraps every 71 minutes
+				uint32_t t = columns.timestamp[s];
+				if (out.samples > 0 && t < out.last && out.last - t > 0x80000000u) {
+					out.high += 0x100000000ull;
+				}
+				out.last = t;
+				out.samples++;
+				timestamps[s] = out.high + t;
+			}
+
+			if (_null) {
+				continue;
+			}
+			if (_csv) {
+				for (size_t s = 0; s < n; s++) {
+					fprintf(out.csv, "%llu,%u", static_cast<unsigned long long>(timestamps[s]), columns.status[s]);
+					for (uint8_t i = 0; i < schema->numWords; i++) {
+						fprintf(out.csv, ",%.7g", static_cast<double>(columns.values[i][s]));
+					}
+					fputc('\n', out.csv);
+				}
+			} else {
+				fwrite(&timestamps[0], sizeof(uint64_t), n, out.timestamp);
+				fwrite(&columns.status[0], 1, n, out.status);
+				for (uint8_t i = 0; i < schema->numWords; i++) {
+					fwrite(&columns.values[i][0], sizeof(float), n, out.values[i]);
+				}
+			}
+		}
+	}
+
+	void printSummary(FILE* f) const
+	{
+		for (int id = 0; id < 256; id++) {
+			if (_outputs[id].open) {
+				fprintf(f, "  %-24s %llu samples\n", telemetrySchema(static_cast<uint8_t>(id))->name,
+						static_cast<unsigned long long>(_outputs[id].samples));
+			}
+		}
+	}
+
+private:
+	std::string _dir;
+	bool _csv;
+	bool _null;
+	ReportOutput _outputs[256];
+
+	FILE* openFile(const std::string& name, const char* suffix)
+	{
+		std::string path = _dir + "/" + name + suffix;
+		FILE* f = fopen(path.c_str(), "wb");
+		if (f == NULL) {
+			fprintf(stderr, "Error: can't create %s\n", path.c_str());
+			exit(1);
+		}
+		return f;
+	}
+
+	static void closeFile(FILE* f)
+	{
+		if (f != NULL) {
+			fclose(f);
+		}
+	}
+
+	void openReport(ReportOutput& out, const TelemetrySchema* schema)
+	{
+		out.open = true;
+		if (_null) {
+			return;
+		}
+
+		std::string name = schema->name;
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		if (_csv) {
+			out.csv = openFile(name, ".csv");
+			fprintf(out.csv, "timestamp_us,status");
+			for (uint8_t i = 0; i < schema->numWords; i++) {
+				fprintf(out.csv, ",value%u", i);
+			}
+			fputc('\n', out.csv);
+			return;
+		}
+
+		out.timestamp = openFile(name, ".timestamp_us.u64");
+		out.status = openFile(name, ".status.u8");
+		for (uint8_t i = 0; i < schema->numWords; i++) {
+			char suffix[16];
+			snprintf(suffix, sizeof(suffix), ".value%u.f32", i);
+			out.values[i] = openFile(name, suffix);
+		}
+	}
+};
+
+// a Stream that writes to a file, for --synth telemetry
+class FileStream : public Stream
+{
+public:
+	explicit FileStream(FILE* file) : _file(file) {}
+
+protected:
+	virtual int _putc(int c) { return fputc(c, _file); }
+
+private:
+	FILE* _file;
+};
+
+// the words of sample i of a synthetic recording
+static void synthWords(uint64_t i, uint8_t report, int16_t* words)
+{
+	float phase = static_cast<float>(i % 40000) * 1.5708e-4f;
+	for (uint8_t w = 0; w < TELEMETRY_MAX_WORDS; w++) {
+		words[w] = static_cast<int16_t>(8000 * std::sin(phase + w + report));
+	}
+}
+
+static int synthesize(const char* format, float hours, const char* path)
+{
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "Error: can't create %s\n", path);
+		return 1;
+	}
+
+	uint64_t ticks = static_cast<uint64_t>(hours * 3600 * SYNTH_RATE);
+	int16_t words[TELEMETRY_MAX_WORDS];
+
+	if (strcmp(format, "telemetry") == 0) {
+		FileStream stream(f);
+		TelemetryEncoder encoder(stream);
+		for (uint64_t i = 0; i < ticks; i++) {
+			for (size_t r = 0; r < sizeof(synthReports); r++) {
+				synthWords(i, synthReports[r], words);
+				encoder.add(synthReports[r], 3, static_cast<uint32_t>(i * (1000000 / SYNTH_RATE)), words, TELEMETRY_MAX_WORDS);
+			}
+		}
+		encoder.flush();
+	} else if (strcmp(format, "blocklog") == 0) {
+		// the device is sized for the recording plus a spare block, so the ring doesn't wrap
+		uint64_t bytes = 0;
+		for (size_t r = 0; r < sizeof(synthReports); r++) {
+			bytes += ticks * (TELEMETRY_RECORD_HEADER_SIZE + 2 * telemetrySchema(synthReports[r])->numWords);
+		}
+		uint64_t blocks = bytes / (BLOCK_LOG_PAYLOAD_SIZE - 2 * TELEMETRY_MAX_WORDS - TELEMETRY_RECORD_HEADER_SIZE) + 2;
+		static const SimBlockTiming timing = {"image", 512, 512, 512, 0, 0, 0, 0};
+		SimBlockDevice device(timing, blocks * BLOCK_LOG_BLOCK_SIZE);
+		BlockLog log(device);
+		log.mount();
+		for (uint64_t i = 0; i < ticks; i++) {
+			for (size_t r = 0; r < sizeof(synthReports); r++) {
+				synthWords(i, synthReports[r], words);
+				log.add(synthReports[r], 3, static_cast<uint32_t>(i * (1000000 / SYNTH_RATE)), words, TELEMETRY_MAX_WORDS);
+				log.service();
+			}
+		}
+		log.flush();
+		log.service();
+		fwrite(device.data(), 1, device.size(), f);
+	} else {
+		fprintf(stderr, "Error: unknown format %s\n", format);
+		fclose(f);
+		return 1;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+// a block log image is a whole number of blocks, with a valid block among the first few
+static bool looksLikeBlockLog(const uint8_t* data, size_t size)
+{
+	if (size == 0 || size % BLOCK_LOG_BLOCK_SIZE != 0) {
+		return false;
+	}
+	BlockLogFooter footer;
+	for (size_t i = 0; i < 16 && i < size / BLOCK_LOG_BLOCK_SIZE; i++) {
+		if (BlockLog::checkBlock(data + i * BLOCK_LOG_BLOCK_SIZE, footer)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: log_export [-f telemetry|blocklog] [-o dir] [-j threads] [--csv] [--null] input\n"
+			"       log_export --synth telemetry|blocklog <hours> output\n");
+	exit(2);
+}
+
+int main(int argc, char** argv)
+{
+	const char* format = NULL;
+	const char* input = NULL;
+	std::string dir = ".";
+	unsigned threads = std::thread::hardware_concurrency();
+	bool csv = false;
+	bool null = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--synth") == 0) {
+			if (i + 3 >= argc) {
+				usage();
+			}
+			return synthesize(argv[i + 1], static_cast<float>(atof(argv[i + 2])), argv[i + 3]);
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			format = argv[++i];
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			dir = argv[++i];
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			threads = static_cast<unsigned>(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--csv") == 0) {
+			csv = true;
+		} else if (strcmp(argv[i], "--null") == 0) {
+			null = true;
+		} else if (argv[i][0] == '-' || input != NULL) {
+			usage();
+		} else {
+			input = argv[i];
+		}
+	}
+	if (input == NULL) {
+		usage();
+	}
+	if (threads == 0) {
+		threads = 1;
+	}
+
+	int fd = open(input, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "Error: can't open %s\n", input);
+		return 1;
+	}
+	size_t size = static_cast<size_t>(st.st_size);
+	const uint8_t* data = NULL;
+	if (size > 0) {
+		void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			fprintf(stderr, "Error: can't map %s\n", input);
+			return 1;
+		}
+		madvise(map, size, MADV_SEQUENTIAL);
+		data = static_cast<const uint8_t*>(map);
+	}
+
+	bool blockLog = format ? strcmp(format, "blocklog") == 0 : looksLikeBlockLog(data, size);
+	if (format && !blockLog && strcmp(format, "telemetry") != 0) {
+		usage();
+	}
+	if (!null) {
+		mkdir(dir.c_str(), 0777);
+	}
+
+	Timer timer;
+	timer.start();
+
+	// the blocks in the order they were written, which the ring may have wrapped
+	std::vector<uint32_t> order;
+	size_t units = size;
+	size_t chunkUnits = EXPORT_TELEMETRY_CHUNK;
+	if (blockLog) {
+		std::vector<std::pair<uint32_t, uint32_t> > sequences;
+		BlockLogFooter footer;
+		for (size_t i = 0; i < size / BLOCK_LOG_BLOCK_SIZE; i++) {
+			if (BlockLog::parseFooter(data + i * BLOCK_LOG_BLOCK_SIZE, footer)) {
+				sequences.push_back(std::make_pair(footer.sequence, static_cast<uint32_t>(i)));
+			}
+		}
+		std::sort(sequences.begin(), sequences.end());
+		for (size_t i = 0; i < sequences.size(); i++) {
+			order.push_back(sequences[i].second);
+		}
+		units = order.size();
+		chunkUnits = EXPORT_BLOCKLOG_CHUNK;
+	}
+
+	// chunks are decoded a round of one per thread at a time, then written in order
+	Exporter exporter(dir, csv, null);
+	uint64_t records = 0, unknown = 0, bad = 0, lost = 0;
+	bool haveSequence = false;
+	uint8_t lastSequence = 0;
+
+	for (size_t roundStart = 0; roundStart < units; roundStart += chunkUnits * threads) {
+		std::vector<Chunk*> chunks;
+		std::vector<std::thread> workers;
+		for (unsigned t = 0; t < threads; t++) {
+			size_t begin = roundStart + t * chunkUnits;
+			if (begin >= units) {
+				break;
+			}
+			size_t end = std::min(begin + chunkUnits, units);
+			Chunk* chunk = new Chunk();
+			chunks.push_back(chunk);
+			if (blockLog) {
+				workers.push_back(std::thread(decodeBlocks, data, std::cref(order), begin, end, std::ref(*chunk)));
+			} else {
+				workers.push_back(std::thread(decodeTelemetry, data, size, begin, end, std::ref(*chunk)));
+			}
+		}
+
+		for (size_t c = 0; c < chunks.size(); c++) {
+			workers[c].join();
+			const Chunk& chunk = *chunks[c];
+			exporter.write(chunk);
+
+			records += chunk.records;
+			unknown += chunk.unknown;
+			bad += chunk.bad;
+			lost += chunk.lostFrames;
+			if (chunk.haveSequence) {
+				if (haveSequence) {
+					lost += static_cast<uint8_t>(chunk.firstSequence - lastSequence - 1);
+				}
+				haveSequence = true;
+				lastSequence = chunk.lastSequence;
+			}
+			delete chunks[c];
+		}
+	}
+
+	timer.stop();
+	double seconds = timer.read_us() / 1e6;
+
+	fprintf(stderr, "%s: %llu samples, %llu unknown records, %llu bad %s", blockLog ? "blocklog" : "telemetry",
+			static_cast<unsigned long long>(records), static_cast<unsigned long long>(unknown),
+			static_cast<unsigned long long>(bad), blockLog ? "blocks" : "frames");
+	if (!blockLog) {
+		fprintf(stderr, ", %llu lost frames", static_cast<unsigned long long>(lost));
+	}
+	fprintf(stderr, "\n");
+	exporter.printSummary(stderr);
+	fprintf(stderr, "%.2f s on %u threads: %.1f M samples/s, %.0f MB/s\n", seconds, threads,
+			records / seconds / 1e6, size / seconds / 1e6);
+
+	if (data != NULL) {
+		munmap(const_cast<uint8_t*>(data), size);
+	}
+	close(fd);
+	return 0;
+}
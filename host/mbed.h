@@ -0,0 +1,545 @@
+/*
+ * Host (Linux) stand-in for the parts of mbed.h that this project uses.
+ *
+ * This lets the math headers, benchmarks and host tools build with a normal
+ * g++/clang++ toolchain, and the BNO080 driver run against a simulated IMU
+ * (SimBNO080.h) on a virtual clock.  It is only on the include path of the
+ * host build (see host/Makefile); mbed-cli ignores this directory.
+ */
+
+#ifndef HOST_MBED_H
+#define HOST_MBED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <cmath>
+#include <math.h>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+#define MBED_ASSERT(expr) assert(expr)
+
+/**
+ * Output stream.  Like mbed's Stream, everything funnels through _putc(), and
+ * printf() formats into a local buffer first.
+ */
+class Stream
+{
+public:
+	virtual ~Stream() {}
+
+	int putc(int c) { return _putc(c); }
+
+	int puts(const char* s)
+	{
+		while (*s) {
+			_putc(*s++);
+		}
+		return 0;
+	}
+
+	int printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+	{
+		va_list args;
+		va_start(args, format);
+		int r = vprintf(format, args);
+		va_end(args);
+		return r;
+	}
+
+	int vprintf(const char* format, va_list args)
+	{
+		char buffer[512];
+		int r = vsnprintf(buffer, sizeof(buffer), format, args);
+		for (int i = 0; i < r && i < (int)sizeof(buffer) - 1; i++) {
+			_putc(buffer[i]);
+		}
+		return r;
+	}
+
+protected:
+	virtual int _putc(int c) = 0;
+	virtual int _getc() { return -1; }
+};
+
+/**
+ * Serial port.  On the host, output goes to stdout and the pins and baud rate are ignored.
+ */
+class Serial : public Stream
+{
+public:
+	template <typename Pin>
+	Serial(Pin, Pin, int baud = 9600) { (void)baud; }
+	Serial() {}
+
+	void baud(int) {}
+
+protected:
+	virtual int _putc(int c) { return fputc(c, stdout); }
+	virtual int _getc() { return fgetc(stdin); }
+};
+
+/**
+ * Something simulated that has to act at given times, see HostClock.
+ */
+class HostClockClient
+{
+public:
+	virtual ~HostClockClient() {}
+
+	/// Time in ns of the next thing it has to do, or INT64_MAX if there is none
+	virtual int64_t nextEvent() = 0;
+
+	/// Called with the clock at nextEvent()
+	virtual void runEvent() = 0;
+};
+
+/**
+ * Time base of the host build, in ns.  It follows the host's monotonic clock
+ * until a simulation calls useVirtualTime().  Virtual time only moves when
+ * wait() is called, when a Timer is read (each read of a polling loop costs
+ * pollCost()), and when a simulated bus transfer takes place.  So a simulated
+ * run is deterministic, and takes no longer than the CPU needs.
+ *
+ * As virtual time moves, the attached clients run their events at the times
+ * they asked for, so pin changes, and the interrupts they raise, happen at the
+ * right time even in the middle of a wait.
+ */
+class HostClock
+{
+public:
+	static int64_t now()
+	{
+		return state().isVirtual ? state().virtualTime : realNow();
+	}
+
+	static bool isVirtual() { return state().isVirtual; }
+
+	/**
+	 * Switches to virtual time, starting from 0.
+	 */
+	static void useVirtualTime()
+	{
+		state().isVirtual = true;
+		state().virtualTime = 0;
+	}
+
+	/**
+	 * Moves virtual time forward, running the clients' events on the way.
+	 * Within an event (an interrupt handler reading a Timer) time just moves,
+	 * so that events don't run inside each other.
+	 */
+	static void advance(int64_t ns)
+	{
+		State& s = state();
+		int64_t target = s.virtualTime + ns;
+		if (s.advancing) {
+			s.virtualTime = target;
+			return;
+		}
+
+		s.advancing = true;
+		while (true) {
+			HostClockClient* next = NULL;
+			int64_t nextTime = target;
+			for (size_t i = 0; i < HOST_CLOCK_MAX_CLIENTS; i++) {
+				if (s.clients[i] != NULL && s.clients[i]->nextEvent() <= nextTime) {
+					next = s.clients[i];
+					nextTime = next->nextEvent();
+				}
+			}
+			if (next == NULL) {
+				break;
+			}
+			if (nextTime > s.virtualTime) {
+				s.virtualTime = nextTime;
+			}
+			next->runEvent();
+		}
+		if (target > s.virtualTime) {
+			s.virtualTime = target;
+		}
+		s.advancing = false;
+	}
+
+	static void attach(HostClockClient* client)
+	{
+		for (size_t i = 0; i < HOST_CLOCK_MAX_CLIENTS; i++) {
+			if (state().clients[i] == NULL) {
+				state().clients[i] = client;
+				return;
+			}
+		}
+		assert(!"too many HostClock clients");
+	}
+
+	static void detach(HostClockClient* client)
+	{
+		for (size_t i = 0; i < HOST_CLOCK_MAX_CLIENTS; i++) {
+			if (state().clients[i] == client) {
+				state().clients[i] = NULL;
+			}
+		}
+	}
+
+	/// Virtual time that one read of a Timer takes, 1 us unless set
+	static int64_t pollCost() { return state().pollCost; }
+
+	static void setPollCost(int64_t ns) { state().pollCost = ns; }
+
+private:
+	static const size_t HOST_CLOCK_MAX_CLIENTS = 4;
+
+	struct State
+	{
+		bool isVirtual;
+		bool advancing;
+		int64_t virtualTime;
+		int64_t pollCost;
+		HostClockClient* clients[HOST_CLOCK_MAX_CLIENTS];
+	};
+
+	static State& state()
+	{
+		static State s = {false, false, 0, 1000, {NULL}};
+		return s;
+	}
+
+	static int64_t realNow()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+};
+
+/**
+ * Stopwatch timer on the HostClock.
+ */
+class Timer
+{
+public:
+	Timer() : _running(false), _accumulated(0) {}
+
+	void start()
+	{
+		if (!_running) {
+			_startTime = now();
+			_running = true;
+		}
+	}
+
+	void stop()
+	{
+		if (_running) {
+			_accumulated += now() - _startTime;
+			_running = false;
+		}
+	}
+
+	void reset()
+	{
+		_accumulated = 0;
+		_startTime = now();
+	}
+
+	float read() { return elapsed() / 1e9f; }
+	int read_ms() { return static_cast<int>(elapsed() / 1000000); }
+	int read_us() { return static_cast<int>(elapsed() / 1000); }
+	uint64_t read_high_resolution_us() { return static_cast<uint64_t>(elapsed() / 1000); }
+
+private:
+	static int64_t now() { return HostClock::now(); }
+
+	int64_t elapsed()
+	{
+		// a read in a polling loop is what moves virtual time along
+		if (HostClock::isVirtual()) {
+			HostClock::advance(HostClock::pollCost());
+		}
+		return _accumulated + (_running ? now() - _startTime : 0);
+	}
+
+	bool _running;
+	int64_t _startTime;
+	int64_t _accumulated;
+};
+
+inline void wait_us(int us)
+{
+	if (HostClock::isVirtual()) {
+		HostClock::advance(static_cast<int64_t>(us) * 1000);
+		return;
+	}
+
+	Timer t;
+	t.start();
+	while (t.read_us() < us) {
+	}
+}
+
+inline void wait(float s) { wait_us(static_cast<int>(s * 1e6f)); }
+
+/**
+ * The free running microsecond counter under Timer and wait(), wrapping at 32 bits.
+ */
+inline uint32_t us_ticker_read()
+{
+	return static_cast<uint32_t>(HostClock::now() / 1000);
+}
+
+inline bool core_util_atomic_cas_u8(volatile uint8_t* ptr, uint8_t* expectedCurrentValue, uint8_t desiredValue)
+{
+	return __atomic_compare_exchange_n(ptr, expectedCurrentValue, desiredValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+inline bool core_util_atomic_cas_u16(volatile uint16_t* ptr, uint16_t* expectedCurrentValue, uint16_t desiredValue)
+{
+	return __atomic_compare_exchange_n(ptr, expectedCurrentValue, desiredValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/// The memory barrier of CMSIS, which is a compiler barrier as well
+inline void __DMB()
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+inline void __enable_irq() {}
+inline void __disable_irq() {}
+
+namespace mbed
+{
+/**
+ * Function or member function to call back, like mbed's Callback.
+ */
+template <typename F>
+class Callback;
+
+template <typename R, typename... Args>
+class Callback<R(Args...)>
+{
+public:
+	Callback() {}
+
+	Callback(R (*function)(Args...))
+	{
+		if (function != NULL) {
+			_function = function;
+		}
+	}
+
+	template <typename T, typename U>
+	Callback(U* object, R (T::*method)(Args...))
+		: _function([object, method](Args... args) { return (object->*method)(args...); })
+	{
+	}
+
+	R call(Args... args) const { return _function(args...); }
+
+	R operator()(Args... args) const { return _function(args...); }
+
+	explicit operator bool() const { return static_cast<bool>(_function); }
+
+private:
+	std::function<R(Args...)> _function;
+};
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(U* object, R (T::*method)(Args...))
+{
+	return Callback<R(Args...)>(object, method);
+}
+
+template <typename R, typename... Args>
+Callback<R(Args...)> callback(R (*function)(Args...))
+{
+	return Callback<R(Args...)>(function);
+}
+}
+
+using mbed::Callback;
+using mbed::callback;
+
+/**
+ * The board's pins that this project names.  On the host a pin is just a value
+ * that the board's objects and simulated devices share.
+ */
+enum PinName
+{
+	PA_5, PA_6, PA_7, PB_8, PB_9,
+	D4, D5, D10, D12,
+	USBTX, USBRX,
+	HOST_PIN_COUNT,
+	NC = -1
+};
+
+/**
+ * Levels of the pins, and who wants to hear when they change.
+ */
+class HostPins
+{
+public:
+	static int read(PinName pin) { return valid(pin) ? state()[pin].value : 0; }
+
+	/**
+	 * Sets a pin, and on a change runs its InterruptIn handler and its watcher.
+	 */
+	static void write(PinName pin, int value)
+	{
+		if (!valid(pin)) {
+			return;
+		}
+		Pin& p = state()[pin];
+		value = value ? 1 : 0;
+		if (value == p.value) {
+			return;
+		}
+		p.value = value;
+		if (value == 0 && p.fall) {
+			p.fall();
+		} else if (value == 1 && p.rise) {
+			p.rise();
+		}
+		if (p.watcher) {
+			p.watcher(value);
+		}
+	}
+
+	static void onFall(PinName pin, Callback<void()> handler) { if (valid(pin)) state()[pin].fall = handler; }
+	static void onRise(PinName pin, Callback<void()> handler) { if (valid(pin)) state()[pin].rise = handler; }
+
+	/**
+	 * Lets a simulated device see what the board drives onto a pin.
+	 */
+	static void watch(PinName pin, Callback<void(int)> watcher) { if (valid(pin)) state()[pin].watcher = watcher; }
+
+private:
+	struct Pin
+	{
+		Pin() : value(1) {}
+		int value;
+		Callback<void()> fall;
+		Callback<void()> rise;
+		Callback<void(int)> watcher;
+	};
+
+	static bool valid(PinName pin) { return pin >= 0 && pin < HOST_PIN_COUNT; }
+
+	static Pin* state()
+	{
+		static Pin pins[HOST_PIN_COUNT];
+		return pins;
+	}
+};
+
+class DigitalIn
+{
+public:
+	DigitalIn(PinName pin) : _pin(pin) {}
+	int read() { return HostPins::read(_pin); }
+	operator int() { return read(); }
+
+private:
+	PinName _pin;
+};
+
+class DigitalOut
+{
+public:
+	DigitalOut(PinName pin, int value = 0) : _pin(pin) { write(value); }
+	void write(int value) { HostPins::write(_pin, value); }
+	int read() { return HostPins::read(_pin); }
+	DigitalOut& operator=(int value) { write(value); return *this; }
+	operator int() { return read(); }
+
+private:
+	PinName _pin;
+};
+
+class InterruptIn
+{
+public:
+	InterruptIn(PinName pin) : _pin(pin) {}
+	~InterruptIn()
+	{
+		fall(Callback<void()>());
+		rise(Callback<void()>());
+	}
+	int read() { return HostPins::read(_pin); }
+	operator int() { return read(); }
+	void fall(Callback<void()> handler) { HostPins::onFall(_pin, handler); }
+	void rise(Callback<void()> handler) { HostPins::onRise(_pin, handler); }
+
+private:
+	PinName _pin;
+};
+
+/**
+ * A simulated device on the host's I2C bus.
+ */
+class HostI2CDevice
+{
+public:
+	virtual ~HostI2CDevice() {}
+
+	/// @return 0 if the device acknowledged
+	virtual int read(char* data, int length) = 0;
+	virtual int write(const char* data, int length) = 0;
+};
+
+/**
+ * I2C master.  Transfers go to the device attached at the address, and in
+ * virtual time take as long as they would on the bus: 9 clocks a byte,
+ * address byte included.
+ */
+class I2C
+{
+public:
+	I2C(PinName sda, PinName scl) : _frequency(100000) {}
+
+	void frequency(int hz) { _frequency = hz; }
+
+	/// @return 0 on success, -1 if no device answers at the address
+	int read(int address, char* data, int length, bool repeated = false)
+	{
+		busTime(length);
+		HostI2CDevice* device = devices()[(address >> 1) & 0x7F];
+		return device != NULL ? device->read(data, length) : -1;
+	}
+
+	int write(int address, const char* data, int length, bool repeated = false)
+	{
+		busTime(length);
+		HostI2CDevice* device = devices()[(address >> 1) & 0x7F];
+		return device != NULL ? device->write(data, length) : -1;
+	}
+
+	/**
+	 * Puts a simulated device on the bus (NULL to take it off).
+	 * @param address 7 bit address
+	 */
+	static void attachDevice(uint8_t address, HostI2CDevice* device) { devices()[address & 0x7F] = device; }
+
+private:
+	int _frequency;
+
+	void busTime(int length)
+	{
+		if (HostClock::isVirtual()) {
+			HostClock::advance(static_cast<int64_t>(length + 1) * 9 * 1000000000 / _frequency);
+		}
+	}
+
+	static HostI2CDevice** devices()
+	{
+		static HostI2CDevice* table[128] = {NULL};
+		return table;
+	}
+};
+
+#endif /* HOST_MBED_H */
@@ -0,0 +1,117 @@
+//
+// Host tool: works out the IMU mounting from a recorded calibration log, with
+// the same MountingCalibration code that runs on the board.
+//
+// The log is text, one sample per line:
+//
+//   <maneuver> <dt> <x> <y> <z>
+//
+// where maneuver is level, tilted or drive, dt is the time since the previous
+// sample in seconds, and x y z is the gravity report (level, tilted) or the
+// linear acceleration report (drive) in m/s^2.  Lines starting with # are skipped.
+//
+//   mounting_cal [log]      reads stdin if no log is given
+//
+
+#include <mbed.h>
+
+#include "MountingCalibration.h"
+#include "BNO080Constants.h"
+
+// degrees per radian, for the printout
+#define DEGREES (180.0 / M_PI)
+
+static MountingCalibration::Phase parsePhase(const char* name)
+{
+	if (strcmp(name, "level") == 0) {
+		return MountingCalibration::LEVEL;
+	} else if (strcmp(name, "tilted") == 0) {
+		return MountingCalibration::TILTED;
+	} else if (strcmp(name, "drive") == 0) {
+		return MountingCalibration::DRIVE;
+	}
+	return MountingCalibration::IDLE;
+}
+
+// the words setSensorOrientation() sends, so they can be pasted into a BNO080::OrientationQ
+static int q14(float value)
+{
+	return static_cast<int>(lroundf(value * (1 << ORIENTATION_QUAT_Q_POINT)));
+}
+
+int main(int argc, char** argv)
+{
+	FILE* log = stdin;
+	if (argc > 1) {
+		log = fopen(argv[1], "r");
+		if (log == NULL) {
+			fprintf(stderr, "Error: can't open %s\n", argv[1]);
+			return 1;
+		}
+	}
+
+	MountingCalibration calibration;
+	char line[256];
+	unsigned lineNumber = 0;
+
+	while (fgets(line, sizeof(line), log) != NULL) {
+		lineNumber++;
+		if (line[0] == '#' || line[0] == '\n') {
+			continue;
+		}
+
+		char name[16];
+		float dt, x, y, z;
+		if (sscanf(line, "%15s %f %f %f %f", name, &dt, &x, &y, &z) != 5) {
+			fprintf(stderr, "Error: can't parse line %u\n", lineNumber);
+			return 1;
+		}
+
+		// a change of maneuver starts its recording; maneuvers may be split up in the log
+		MountingCalibration::Phase phase = parsePhase(name);
+		if (phase == MountingCalibration::IDLE) {
+			fprintf(stderr, "Error: unknown maneuver \"%s\" on line %u\n", name, lineNumber);
+			return 1;
+		}
+		if (phase != calibration.phase()) {
+			if (calibration.sampleCount(phase) > 0) {
+				fprintf(stderr, "Warning: %s recorded twice, line %u replaces the earlier samples\n", name, lineNumber);
+			}
+			calibration.begin(phase);
+		}
+
+		if (phase == MountingCalibration::DRIVE) {
+			calibration.addLinearAcceleration(TVector3(x, y, z), dt);
+		} else {
+			calibration.addGravity(TVector3(x, y, z));
+		}
+	}
+
+	if (log != stdin) {
+		fclose(log);
+	}
+
+	printf("samples: level %u, tilted %u, drive %u\n",
+		   static_cast<unsigned>(calibration.sampleCount(MountingCalibration::LEVEL)),
+		   static_cast<unsigned>(calibration.sampleCount(MountingCalibration::TILTED)),
+		   static_cast<unsigned>(calibration.sampleCount(MountingCalibration::DRIVE)));
+
+	MountingResult result;
+	if (!calibration.solve(result)) {
+		fprintf(stderr, "Error: not enough usable samples (need level, plus tilted or a straight drive)\n");
+		return 2;
+	}
+
+	const Quaternion& q = result.orientation;
+	TVector3 euler = q.euler();
+	printf("orientation (x y z w): %.6f %.6f %.6f %.6f\n",
+		   static_cast<double>(q.x()), static_cast<double>(q.y()), static_cast<double>(q.z()), static_cast<double>(q.w()));
+	printf("roll pitch yaw: %.2f %.2f %.2f deg\n",
+		   static_cast<double>(euler[0]) * DEGREES, static_cast<double>(euler[1]) * DEGREES,
+		   static_cast<double>(euler[2]) * DEGREES);
+	printf("OrientationQ: {%d, %d, %d, %d}\n", q14(q.x()), q14(q.y()), q14(q.z()), q14(q.w()));
+	printf("tilt %.1f deg, drive curvature %.3f, heading disagreement %.2f deg, level noise %.3f m/s^2\n",
+		   static_cast<double>(result.tiltAngle) * DEGREES, static_cast<double>(result.driveCurvature),
+		   static_cast<double>(result.headingDisagreement) * DEGREES, static_cast<double>(result.levelNoise));
+	return 0;
+}
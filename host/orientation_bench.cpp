@@ -0,0 +1,85 @@
+//
+// Host tool: what setting a fixed mounting from a constexpr BNO080::OrientationQ
+// saves over setSensorOrientation(Quaternion), which converts the floats to Q14
+// on every call (and logs them at LOG_LEVEL_DEBUG).  make orientation-bench builds it twice, with
+// ORIENTATION_AT_COMPILE_TIME 0 and 1, so each binary only uses one of the two
+// overloads, and with unused functions dropped at link time like the firmware
+// build.  It then prints the size of both and runs both:
+//
+//   orientation_bench_quaternion [calls]
+//   orientation_bench_constexpr [calls]
+//
+// print the ns per call, the least of several runs, against the simulated IMU.
+// Both calls send the same command, so the difference is the conversion.
+//
+
+#include <mbed.h>
+
+#include <chrono>
+
+#include "BNO080.h"
+#include "Log.h"
+#include "SimBNO080.h"
+
+#define SIM_SDA PB_9
+#define SIM_SCL PB_8
+#define SIM_INT PA_6
+#define SIM_RST PA_5
+#define SIM_ADDRESS 0x4B
+
+#ifndef ORIENTATION_AT_COMPILE_TIME
+#define ORIENTATION_AT_COMPILE_TIME 1
+#endif
+
+// runs of the calls, keeping the fastest
+#define ORIENTATION_BENCH_RUNS 7
+
+// the example mounting of the datasheet: rotated 90 degrees about z
+#if ORIENTATION_AT_COMPILE_TIME
+static constexpr BNO080::OrientationQ mounting = BNO080::orientationToQ(Quaternion(0, 0, -SQRT_2 / 2, SQRT_2 / 2));
+static_assert(mounting.z == -11585 && mounting.w == 11585, "the words are computed at compile time");
+#endif
+
+static Serial debugPort(USBTX, USBRX);
+
+static void setMounting(BNO080& imu)
+{
+#if ORIENTATION_AT_COMPILE_TIME
+	imu.setSensorOrientation(mounting);
+#else
+	imu.setSensorOrientation(Quaternion(0, 0, -SQRT_2 / 2, SQRT_2 / 2));
+#endif
+
+	// with LOG_LEVEL_DEBUG the Quaternion overload logs each call; empty the ring, as the firmware's loop would
+	LogEntry entry;
+	while (logPop(entry)) {
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int calls = argc > 1 ? atoi(argv[1]) : 10000;
+
+	SimBNO080 sim(SIM_INT, SIM_RST, SIM_ADDRESS);
+	BNO080 imu(&debugPort, SIM_SDA, SIM_SCL, SIM_INT, SIM_RST, SIM_ADDRESS, 400000);
+	if (!imu.begin()) {
+		fprintf(stderr, "Error: the driver didn't start\n");
+		return 1;
+	}
+
+	double best = 0;
+	for (int run = 0; run < ORIENTATION_BENCH_RUNS; run++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < calls; i++) {
+			setMounting(imu);
+		}
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+		if (run == 0 || ns < best) {
+			best = ns;
+		}
+	}
+
+	printf("setSensorOrientation(%s)  %8.1f ns/call\n",
+		   ORIENTATION_AT_COMPILE_TIME ? "constexpr OrientationQ" : "Quaternion", best);
+	return 0;
+}
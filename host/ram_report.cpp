@@ -0,0 +1,66 @@
+//
+// Host tool: prints the RAM each part of the driver takes in the configuration
+// it is built with, next to its budget from BNOWrapper/MemoryBudget.h.  The
+// budgets themselves are checked when MemoryBudget.cpp compiles, so an over
+// budget configuration doesn't get this far.
+//
+//   make ram-report RAM_CONFIG="-DSTORED_PACKET_SIZE=64 -DBNO080_IMU_COUNT=2"
+//
+// builds it with the given sizes and runs it.  Classes that hold pointers come
+// out a little larger here than on the board, where pointers are 4 bytes.
+//
+
+#include <mbed.h>
+
+#include "MemoryBudget.h"
+#include "BNO080Wheelchair.h"
+#include "Telemetry.h"
+#include "ShtpCapture.h"
+#include "TxRing.h"
+#include "Log.h"
+#include "Profile.h"
+
+static void printPart(const char* name, size_t bytes, size_t budget)
+{
+	printf("%-28s %8u %8u\n", name, static_cast<unsigned>(bytes), static_cast<unsigned>(budget));
+}
+
+// a part without a budget of its own, counted in the one above
+static void printSubPart(const char* name, size_t bytes)
+{
+	printf("  %-26s %8u\n", name, static_cast<unsigned>(bytes));
+}
+
+int main(int argc, char** argv)
+{
+	size_t driverParts = BNO080_PACKET_RAM + BNO080_REPORT_RAM + BNO080_STATUS_STATISTICS_RAM + BNO080_METADATA_RAM;
+	size_t wheelchairParts = sizeof(BNO080) + sizeof(FlightRecorder) + sizeof(ReportResampler) + sizeof(MountingCalibration);
+
+	printf("%-28s %8s %8s\n", "# part", "bytes", "budget");
+	printPart("BNO080", sizeof(BNO080), BNO080_RAM_BUDGET);
+	printPart("  packet buffers", BNO080_PACKET_RAM, BNO080_PACKET_RAM_BUDGET);
+	printSubPart("per report state", BNO080_REPORT_RAM);
+	printSubPart("status statistics", BNO080_STATUS_STATISTICS_RAM);
+	printSubPart("metadata", BNO080_METADATA_RAM);
+	printSubPart("readings, callbacks, pins", sizeof(BNO080) - driverParts);
+
+	printPart("BNO080Wheelchair", sizeof(BNO080Wheelchair), BNO080_WHEELCHAIR_RAM_BUDGET);
+	printSubPart("BNO080", sizeof(BNO080));
+	printPart("  FlightRecorder", sizeof(FlightRecorder), FLIGHT_RECORDER_RAM_BUDGET);
+	printPart("  ReportResampler", sizeof(ReportResampler), RESAMPLER_RAM_BUDGET);
+	printSubPart("MountingCalibration", sizeof(MountingCalibration));
+	printSubPart("the rest", sizeof(BNO080Wheelchair) - wheelchairParts);
+
+	printPart("LatencyTracer", sizeof(LatencyTracer), LATENCY_TRACER_RAM_BUDGET);
+	printPart("RateMonitor", sizeof(RateMonitor), RATE_MONITOR_RAM_BUDGET);
+	printPart("log ring", LOG_RING_RAM, LOG_RAM_BUDGET);
+	printPart("profiling", PROFILE_RAM, PROFILE_RAM_BUDGET);
+	printPart("TelemetryEncoder", sizeof(TelemetryEncoder), TELEMETRY_RAM_BUDGET);
+	printPart("ShtpCaptureEncoder", sizeof(ShtpCaptureEncoder), SHTP_CAPTURE_RAM_BUDGET);
+	printPart("TxRing", sizeof(TxRing), TX_RING_RAM_BUDGET);
+
+	size_t total = BNO080_IMU_COUNT * sizeof(BNO080) + LOG_RING_RAM + PROFILE_RAM;
+	printf("# %u x BNO080, the log and profiling: %u of %u bytes\n", static_cast<unsigned>(BNO080_IMU_COUNT),
+		   static_cast<unsigned>(total), static_cast<unsigned>(BNO080_TOTAL_RAM_BUDGET));
+	return 0;
+}
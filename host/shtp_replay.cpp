@@ -0,0 +1,235 @@
+//
+// Host tool: replays an SHTP capture (see BNOWrapper/ShtpCapture.h) through the
+// unmodified BNO080 driver, to reproduce on a PC what the driver did with the
+// packets of a field problem.  The packets are signalled at their recorded
+// interrupt times (see ShtpReplay.h), so the samples come out with the
+// timestamps they had on the board.
+//
+// By default it runs as fast as it can, which makes it a decode benchmark on
+// real data too: the throughput goes to stderr at the end.  --realtime keeps to
+// the capture's own pace instead.  --csv prints every decoded sample:
+//
+//   timestamp_us,report,status,value0,value1,...
+//
+// scaled like telemetry_decode's output.
+//
+//   shtp_replay [--realtime] [--csv] [--i2c hz] capture
+//   shtp_replay --synth seconds [--csv] output
+//
+// --synth records a capture of the driver running against the simulated IMU
+// (rotation, gyro, linear acceleration and magnetic field), with --csv
+// printing the samples as the driver decoded them live, to compare with a replay.
+//
+
+#include <mbed.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "BNO080.h"
+#include "Log.h"
+#include "ShtpCapture.h"
+#include "Telemetry.h"
+#include "ShtpReplay.h"
+#include "SimBNO080.h"
+
+#define REPLAY_SDA PB_9
+#define REPLAY_SCL PB_8
+#define REPLAY_INT PA_6
+#define REPLAY_RST PA_5
+#define REPLAY_ADDRESS 0x4B
+
+// how often --synth polls the driver, in us
+#define SYNTH_POLL_PERIOD 1000
+
+// Stream that writes to a file
+class FileStream : public Stream
+{
+public:
+	explicit FileStream(FILE* file) : _file(file) {}
+
+protected:
+	virtual int _putc(int c) { return fputc(c, _file); }
+
+private:
+	FILE* _file;
+};
+
+static Serial pc(USBTX, USBRX);
+static bool printSamples = false;
+static uint32_t samples = 0;
+static ShtpCaptureEncoder* capture = NULL;
+
+static void onSample(const BNO080::SensorSample& sample)
+{
+	samples++;
+	if (!printSamples) {
+		return;
+	}
+
+	const TelemetrySchema* schema = telemetrySchema(sample.report);
+	if (schema == NULL) {
+		printf("%u,?%02x,%u", static_cast<unsigned>(sample.timestamp), sample.report, sample.status);
+		for (uint8_t i = 0; i < sample.numValues; i++) {
+			printf(",%d", sample.values[i]);
+		}
+	} else {
+		printf("%u,%s,%u", static_cast<unsigned>(sample.timestamp), schema->name, sample.status);
+		for (uint8_t i = 0; i < schema->numWords; i++) {
+			uint8_t qPoint = (i == schema->numWords - 1) ? schema->lastQPoint : schema->qPoint;
+			printf(",%.6g", static_cast<double>(ldexpf(static_cast<float>(sample.values[i]), -qPoint)));
+		}
+	}
+	printf("\n");
+}
+
+static void onPacket(const BNO080::RawPacket& packet)
+{
+	capture->add(packet.outbound, packet.timestamp, packet.data, packet.length);
+}
+
+static void dropLog()
+{
+	LogEntry entry;
+	while (logPop(entry)) {
+	}
+}
+
+static double hostSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int synth(float seconds, const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Error: can't write %s\n", path);
+		return 1;
+	}
+	FileStream out(file);
+	ShtpCaptureEncoder encoder(out);
+	capture = &encoder;
+
+	SimBNO080 sim(REPLAY_INT, REPLAY_RST, REPLAY_ADDRESS);
+	BNO080 imu(&pc, REPLAY_SDA, REPLAY_SCL, REPLAY_INT, REPLAY_RST, REPLAY_ADDRESS, 400000);
+	imu.attachPacketCallback(onPacket);
+	imu.attachSampleCallback(onSample);
+
+	if (!imu.begin()) {
+		fprintf(stderr, "Error: the driver didn't start\n");
+		fclose(file);
+		return 1;
+	}
+	imu.enableReport(BNO080::ROTATION, 20);
+	imu.enableReport(BNO080::GYROSCOPE, 20);
+	imu.enableReport(BNO080::LINEAR_ACCELERATION, 50);
+	imu.enableReport(BNO080::MAG_FIELD, 100);
+
+	int64_t end = HostClock::now() + static_cast<int64_t>(seconds * 1e9f);
+	while (HostClock::now() < end) {
+		wait_us(SYNTH_POLL_PERIOD);
+		imu.updateData();
+		dropLog();
+	}
+
+	fclose(file);
+	fprintf(stderr, "%u packets (%u bytes) captured, %u samples\n", static_cast<unsigned>(encoder.packetsSent()),
+			static_cast<unsigned>(encoder.bytesSent()), static_cast<unsigned>(samples));
+	return 0;
+}
+
+static int replay(const char* path, bool realtime, int frequency)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Error: can't open %s\n", path);
+		return 1;
+	}
+
+	ShtpReplay device(REPLAY_INT, REPLAY_ADDRESS);
+	ShtpCaptureDecoder decoder;
+	uint32_t outbound = 0;
+	int c;
+	while ((c = fgetc(file)) != EOF) {
+		if (!decoder.push(static_cast<uint8_t>(c))) {
+			continue;
+		}
+		if (decoder.outbound()) {
+			outbound++;
+		} else {
+			device.add(decoder.timestamp(), decoder.packet(), decoder.packetLength());
+		}
+	}
+	fclose(file);
+
+	BNO080 imu(&pc, REPLAY_SDA, REPLAY_SCL, REPLAY_INT, REPLAY_RST, REPLAY_ADDRESS, frequency);
+	imu.attachSampleCallback(onSample);
+
+	double hostStart = hostSeconds();
+	int64_t virtualStart = HostClock::now();
+	while (!device.done()) {
+		// go straight to the next interrupt
+		int64_t next = device.nextEvent();
+		if (HostPins::read(REPLAY_INT) != 0 && next != INT64_MAX && next > HostClock::now()) {
+			if (realtime) {
+				double wake = hostStart + (next - virtualStart) * 1e-9;
+				double now = hostSeconds();
+				if (wake > now) {
+					std::this_thread::sleep_for(std::chrono::duration<double>(wake - now));
+				}
+			}
+			HostClock::advance(next - HostClock::now());
+		}
+		imu.updateData();
+		dropLog();
+	}
+
+	double hostTime = hostSeconds() - hostStart;
+	double virtualTime = (HostClock::now() - virtualStart) * 1e-9;
+	fprintf(stderr, "%u packets replayed (%u late), %u sent by the driver in the capture, %u samples\n",
+			static_cast<unsigned>(device.packetsRead()), static_cast<unsigned>(device.packetsLate()),
+			static_cast<unsigned>(outbound), static_cast<unsigned>(samples));
+	fprintf(stderr, "%u bad frames, %u lost frames, %u other frames\n", static_cast<unsigned>(decoder.badFrames()),
+			static_cast<unsigned>(decoder.lostFrames()), static_cast<unsigned>(decoder.otherFrames()));
+	fprintf(stderr, "%.1f s of capture in %.3f s: %.0f packets/s, %.0f samples/s\n", virtualTime, hostTime,
+			device.packetsRead() / hostTime, samples / hostTime);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	bool realtime = false;
+	int frequency = 400000;
+	float synthSeconds = 0;
+	const char* path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--realtime") == 0) {
+			realtime = true;
+		} else if (strcmp(argv[i], "--csv") == 0) {
+			printSamples = true;
+		} else if (strcmp(argv[i], "--i2c") == 0 && i + 1 < argc) {
+			frequency = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--synth") == 0 && i + 1 < argc) {
+			synthSeconds = static_cast<float>(atof(argv[++i]));
+		} else if (path == NULL && argv[i][0] != '-') {
+			path = argv[i];
+		} else {
+			path = NULL;
+			break;
+		}
+	}
+
+	if (path == NULL) {
+		fprintf(stderr, "usage: shtp_replay [--realtime] [--csv] [--i2c hz] capture\n"
+				"       shtp_replay --synth seconds [--csv] output\n");
+		return 2;
+	}
+
+	if (synthSeconds > 0) {
+		return synth(synthSeconds, path);
+	}
+	return replay(path, realtime, frequency);
+}
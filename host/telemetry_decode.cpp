@@ -0,0 +1,149 @@
+//
+// Host tool: decodes the binary telemetry that main.cpp sends (see
+// BNOWrapper/Telemetry.h) into CSV, one sample per line:
+//
+//   sequence,timestamp_us,report,status,value0,value1,...
+//
+// Values are scaled by the report's Q points.  Records with an unknown report or
+// schema version are printed with their raw words and a report name of "?<id>".
+// Log records (see BNOWrapper/Log.h) are formatted into their message,
+// profiling records (see BNOWrapper/Profile.h) into times in ns:
+//
+//   sequence,timestamp_us,LOG,level,"message"
+//   sequence,timestamp_us,PROFILE,scope,count,min,mean,p99,max
+//
+// latency records (see BNOWrapper/LatencyTracer.h) into times in us:
+//
+//   sequence,timestamp_us,LATENCY,report,stage,count,p50,p99,max
+//
+// and rate records (see BNOWrapper/RateMonitor.h) into times in us, with "ok"
+// or "LOW" for whether the report meets its rate:
+//
+//   sequence,timestamp_us,RATE,report,intervals,missed,period,mean,stddev,max_gap,ok
+//
+// Frame counts go to stderr at the end.
+//
+//   telemetry_decode [capture]      reads stdin if no capture is given
+//
+
+#include <mbed.h>
+
+#include "Telemetry.h"
+#include "Log.h"
+#include "Profile.h"
+#include "LatencyTracer.h"
+
+// a log record holds the message ID, then each argument as a low and a high word
+static void printLogRecord(const TelemetryRecord& record)
+{
+	uint32_t args[LOG_MAX_ARGS];
+	for (uint8_t i = 0; i < LOG_MAX_ARGS; i++) {
+		args[i] = static_cast<uint16_t>(record.words[1 + 2 * i]) |
+				  static_cast<uint32_t>(static_cast<uint16_t>(record.words[2 + 2 * i])) << 16;
+	}
+
+	uint16_t id = static_cast<uint16_t>(record.words[0]);
+	char text[256];
+	logFormat(text, sizeof(text), id, args, LOG_MAX_ARGS);
+
+	// CSV quoting: double any quotes in the message
+	printf(",%s,\"", logLevelName(logLevel(id)));
+	for (const char* c = text; *c != '\0'; c++) {
+		if (*c == '"') {
+			putchar('"');
+		}
+		putchar(*c);
+	}
+	putchar('"');
+}
+
+int main(int argc, char** argv)
+{
+	FILE* capture = stdin;
+	if (argc > 1) {
+		capture = fopen(argv[1], "rb");
+		if (capture == NULL) {
+			fprintf(stderr, "Error: can't open %s\n", argv[1]);
+			return 1;
+		}
+	}
+
+	TelemetryDecoder decoder;
+	TelemetryRecord record;
+	uint32_t records = 0;
+
+	printf("sequence,timestamp_us,report,status,values\n");
+
+	int c;
+	while ((c = fgetc(capture)) != EOF) {
+		if (!decoder.push(static_cast<uint8_t>(c))) {
+			continue;
+		}
+
+		while (decoder.nextRecord(record)) {
+			records++;
+			if (record.schema != NULL && record.reportID == TELEMETRY_REPORTID_LOG) {
+				printf("%u,%u,%s", decoder.sequence(), static_cast<unsigned>(record.timestamp), record.schema->name);
+				printLogRecord(record);
+			} else if (record.schema != NULL && record.reportID == TELEMETRY_REPORTID_PROFILE) {
+				uint32_t count = static_cast<uint16_t>(record.words[1]) | static_cast<uint32_t>(static_cast<uint16_t>(record.words[2])) << 16;
+				printf("%u,%u,%s,\"%s\",%u", decoder.sequence(), static_cast<unsigned>(record.timestamp),
+					   record.schema->name, profileScopeName(static_cast<uint8_t>(record.words[0])), static_cast<unsigned>(count));
+				for (uint8_t i = 3; i < 7; i++) {
+					printf(",%u", static_cast<unsigned>(profileDecodeTime(static_cast<uint16_t>(record.words[i]))));
+				}
+			} else if (record.schema != NULL && record.reportID == TELEMETRY_REPORTID_LATENCY) {
+				uint8_t report = static_cast<uint8_t>(record.words[0]);
+				const TelemetrySchema* reportSchema = telemetrySchema(report);
+				uint32_t count = static_cast<uint16_t>(record.words[2]) | static_cast<uint32_t>(static_cast<uint16_t>(record.words[3])) << 16;
+				printf("%u,%u,%s,", decoder.sequence(), static_cast<unsigned>(record.timestamp), record.schema->name);
+				if (reportSchema != NULL) {
+					printf("%s", reportSchema->name);
+				} else {
+					printf("?%02x", report);
+				}
+				printf(",\"%s\",%u", LatencyTracer::stageName(static_cast<uint8_t>(record.words[1])), static_cast<unsigned>(count));
+				for (uint8_t i = 4; i < 7; i++) {
+					printf(",%u", static_cast<unsigned>(profileDecodeTime(static_cast<uint16_t>(record.words[i]))));
+				}
+			} else if (record.schema != NULL && record.reportID == TELEMETRY_REPORTID_RATE) {
+				uint8_t report = static_cast<uint8_t>(record.words[0]);
+				const TelemetrySchema* reportSchema = telemetrySchema(report);
+				printf("%u,%u,%s,", decoder.sequence(), static_cast<unsigned>(record.timestamp), record.schema->name);
+				if (reportSchema != NULL) {
+					printf("%s", reportSchema->name);
+				} else {
+					printf("?%02x", report);
+				}
+				printf(",%u,%u", static_cast<unsigned>(static_cast<uint16_t>(record.words[1])),
+					   static_cast<unsigned>(static_cast<uint16_t>(record.words[2])));
+				for (uint8_t i = 3; i < 7; i++) {
+					printf(",%u", static_cast<unsigned>(profileDecodeTime(static_cast<uint16_t>(record.words[i]))));
+				}
+				printf(",%s", (record.words[0] & 0x100) != 0 ? "LOW" : "ok");
+			} else if (record.schema != NULL) {
+				printf("%u,%u,%s,%u", decoder.sequence(), static_cast<unsigned>(record.timestamp),
+					   record.schema->name, record.status);
+				for (uint8_t i = 0; i < record.numWords; i++) {
+					printf(",%.7g", static_cast<double>(record.value(i)));
+				}
+			} else {
+				printf("%u,%u,?%02x,%u", decoder.sequence(), static_cast<unsigned>(record.timestamp),
+					   record.reportID, record.status);
+				for (uint8_t i = 0; i < record.numWords; i++) {
+					printf(",%d", record.words[i]);
+				}
+			}
+			printf("\n");
+		}
+	}
+
+	fprintf(stderr, "%u records in %u frames, %u bad frames, %u lost frames\n",
+			static_cast<unsigned>(records), static_cast<unsigned>(decoder.validFrames()),
+			static_cast<unsigned>(decoder.badFrames()), static_cast<unsigned>(decoder.lostFrames()));
+
+	if (capture != stdin) {
+		fclose(capture);
+	}
+	return 0;
+}
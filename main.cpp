@@ -1,12 +1,71 @@
 #include <mbed.h>
 #include <BNO080.h>
+#include <BufferedSerialTx.h>
+#include <Telemetry.h>
+#include <ShtpCapture.h>
+#include <Log.h>
+#include <Profile.h>
+#include <LatencyTracer.h>
+#include <RateMonitor.h>
 #include "Watchdog.h"
 
+// 1 sends samples as binary telemetry frames (decode with host/telemetry_decode),
+// 0 prints the Euler angles as text
+#define TELEMETRY_BINARY 1
+
+// 1 queues output and sends it from the UART interrupt, 0 uses the blocking Serial
+// (to compare the loop statistics)
+#define SERIAL_BUFFERED 1
+
+// 1 also sends every SHTP packet to and from the IMU as capture frames, to replay
+// on a PC with host/shtp_replay (telemetry_decode counts them as bad frames)
+#define SHTP_CAPTURE 0
+
+// 1 traces how old each rotation sample is by the time the loop uses it, stage by
+// stage, and sends the latencies with the loop statistics
+#define LATENCY_TRACE 0
+
+// 1 checks the interval between the samples of each report against its period,
+// and sends the interval statistics with the loop statistics
+#define RATE_MONITOR 1
+
+// how often the loop statistics are sent, in us
+#define LOOP_STATS_PERIOD 1000000
+
+#if TELEMETRY_BINARY
+static TelemetryEncoder* telemetry;
+
+// called by the IMU driver for every sample it parses
+static void onSample(const BNO080::SensorSample& sample)
+{
+    telemetry->add(sample.report, sample.status, sample.timestamp, sample.values, sample.numValues);
+}
+
+static int16_t saturate16(uint32_t value)
+{
+    return static_cast<int16_t>(value > 32767 ? 32767 : value);
+}
+#endif
+
+#if SHTP_CAPTURE
+static ShtpCaptureEncoder* capture;
+
+// called by the IMU driver for every packet it sends or reads
+static void onPacket(const BNO080::RawPacket& packet)
+{
+    capture->add(packet.outbound, packet.timestamp, packet.data, packet.length);
+}
+#endif
+
 int main()
 {
 	Timer t;
 	t.start();
+#if SERIAL_BUFFERED
+    BufferedSerialTx pc(USBTX, USBRX, 57600);
+#else
     Serial pc(USBTX, USBRX, 57600);
+#endif
    // Watchdog dog;
     //dog.Configure(200000);         //need to find the time for entire program to run
 
@@ -14,19 +73,59 @@ int main()
     // These pin assignments are specific to stm32- L432KC
     //BNO080 imu(&pc, D4, D5, D12, D10, 0x4b, 100000);
     BNO080 imu(&pc, PB_9, PB_8, PA_6, PA_5, 0x4b, 100000);
+#if SHTP_CAPTURE
+    // from before begin(), so the replay sees the startup too
+    ShtpCaptureEncoder captureEncoder(pc);
+    capture = &captureEncoder;
+    imu.attachPacketCallback(onPacket);
+#endif
     imu.begin();
 
+#if RATE_MONITOR
+    // before enabling the reports, so that it gets their periods
+    RateMonitor rates;
+    imu.attachRateMonitor(&rates);
+#endif
+
+#if LATENCY_TRACE
+    LatencyTracer tracer;
+    imu.attachLatencyTracer(&tracer);
+#endif
+
+#if TELEMETRY_BINARY
+    TelemetryEncoder encoder(pc);
+    telemetry = &encoder;
+    imu.attachSampleCallback(onSample);
+#endif
+
     // Tell the IMU to report rotation every 100ms and acceleration every 200ms
 
     imu.enableReport(BNO080::TOTAL_ACCELERATION, 100);
     imu.enableReport(BNO080::ROTATION, 100);
 
+    // time each pass through the loop, not counting the wait: this is how long
+    // reading the IMU and writing the output hold up the next read
+    Timer loopTimer;
+    loopTimer.start();
+    uint32_t maxLoopTime = 0;
+    uint32_t loops = 0;
+    uint32_t statsStart = t.read_us();
+    uint32_t lastDropped = 0;
+
     while (true) {
         wait(.05);
+        loopTimer.reset();
 
         // poll the IMU for new data -- this returns true if any packets were received
 
         if(imu.updateData()) {
+#if LATENCY_TRACE
+            tracer.sampleConsumed(BNO080::ROTATION, imu.getHostTime());
+#endif
+#if TELEMETRY_BINARY
+            // the samples were added as they were parsed; send them before the next wait
+            encoder.flush();
+#else
             // now check for the specific type of data that was received (can be multiple at once)
             //if (imu.hasNewData(BNO080::TOTAL_ACCELERATION) || imu.hasNewData(BNO080::ROTATION)) {
                 //pc.printf("Total Accel: ");
@@ -38,6 +137,7 @@ int main()
                 eulerDegrees.print(pc, true);
                 pc.printf(" %f", t.read());
                 pc.printf("\n");
+#endif
 
                // dog.Service();
             //}
@@ -46,6 +146,59 @@ int main()
         }
        // else
         	//pc.printf("no data 1\r\n");
+
+        // the driver only queued its messages; format or send them now, outside the IMU reads
+#if TELEMETRY_BINARY
+        if (logDrain(encoder) > 0) {
+            encoder.flush();
+        }
+#else
+        logDrainText(pc);
+#endif
+
+        uint32_t loopTime = loopTimer.read_us();
+        if (loopTime > maxLoopTime) {
+            maxLoopTime = loopTime;
+        }
+        loops++;
+
+        if (static_cast<uint32_t>(t.read_us()) - statsStart >= LOOP_STATS_PERIOD) {
+#if SERIAL_BUFFERED
+            uint32_t dropped = pc.droppedBytes();
+#else
+            uint32_t dropped = 0;
+#endif
+#if TELEMETRY_BINARY
+            int16_t words[3] = {saturate16(maxLoopTime), saturate16(loops), saturate16(dropped - lastDropped)};
+            encoder.add(TELEMETRY_REPORTID_LOOP_STATS, 0, imu.getHostTime(), words, 3);
+#if PROFILE_ENABLED
+            profileSend(encoder, imu.getHostTime());
+#endif
+#if LATENCY_TRACE
+            tracer.send(encoder, imu.getHostTime());
+#endif
+#if RATE_MONITOR
+            rates.send(encoder, imu.getHostTime());
+#endif
+            encoder.flush();
+#else
+            pc.printf("# loop max %u us, %u loops, %u bytes dropped\n", static_cast<unsigned>(maxLoopTime),
+                      static_cast<unsigned>(loops), static_cast<unsigned>(dropped - lastDropped));
+#if PROFILE_ENABLED
+            profilePrint(pc);
+#endif
+#if LATENCY_TRACE
+            tracer.print(pc);
+#endif
+#if RATE_MONITOR
+            rates.print(pc);
+#endif
+#endif
+            lastDropped = dropped;
+            maxLoopTime = 0;
+            loops = 0;
+            statsStart = t.read_us();
+        }
     }
 
 }